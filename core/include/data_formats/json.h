@@ -8,6 +8,9 @@
 
 class json;
 json parse_json(std::wistream &_in);
+// Writes a JSON structure as compact JSON text. Doubles that aren't finite can't be
+// represented in JSON, so they're written as null.
+void write_json(std::wostream &out, const json &j);
 
 struct json_object_descriptor {
 	size_t obj_pos{ 0 };
@@ -39,6 +42,7 @@ public:
 	// descriptor does not point to a valid array;
 	std::optional<json_array *> get(json_array_descriptor desc) noexcept;
 	json_value_or_descriptor get_root() const noexcept;
+	void set_root(json_value_or_descriptor _root) noexcept;
 
 	// Adds a JSON object to the list of objects owned by this JSON structure. An object
 	// descriptor is created and returned to the caller. Until the caller puts the descriptor
@@ -59,6 +63,7 @@ private:
 	json_value_or_descriptor root{ nullptr };
 
 	friend json parse_json(std::wistream &_in);
+	friend void write_json(std::wostream &out, const json &j);
 };
 
 class json_parse_error : public std::runtime_error {
@@ -1,5 +1,6 @@
 #pragma once
 #include <functional>
+#include <span>
 #include <vector>
 #include "contact.h"
 #include "primitive.h"
@@ -11,4 +12,28 @@ namespace phys {
 	// to a reference to the shape with a lower `type`, and the second argument
 	// can be statically cast to a reference to the shape with a higher `type`.
 	using collision_algorithm_func = std::function<void(primitive&, primitive&, contact_container&)>;
+
+	struct collision_pair {
+		primitive * a{};
+		primitive * b{};
+	};
+
+	// Collides every pair in `pairs`, and sets `ends[i]` to the size of `contacts`
+	// after the contacts for `pairs[i]` are added. Every pair in a batch has the same
+	// shape types, in ascending order of `type` like the arguments of a
+	// `collision_algorithm_func`. `ctx` is the context that the algorithm was
+	// registered with.
+	using batch_collision_func = void (*)(
+		void * ctx,
+		std::span<const collision_pair> pairs,
+		contact_container &contacts,
+		std::span<size_t> ends
+	);
+
+	// A collision algorithm that is called once for a whole batch of pairs, through a
+	// plain function pointer instead of a `std::function`
+	struct batch_collision_algorithm {
+		batch_collision_func run{};
+		void * ctx{};
+	};
 }
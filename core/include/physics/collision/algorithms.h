@@ -1,6 +1,10 @@
 #pragma once
 #include "algorithm.h"
 
+namespace phys {
+	class feature_cache;
+}
+
 namespace phys::algorithms {
 	extern collision_algorithm_func sphere_sphere_collision;
 	extern collision_algorithm_func sphere_plane_collision;
@@ -8,6 +12,51 @@ namespace phys::algorithms {
 	extern collision_algorithm_func plane_box_collision;
 	extern collision_algorithm_func sphere_box_collision;
 	extern collision_algorithm_func box_box_collision;
+	extern collision_algorithm_func plane_convex_hull_collision;
+	extern collision_algorithm_func box_convex_hull_collision;
+	extern collision_algorithm_func convex_hull_convex_hull_collision;
+	extern collision_algorithm_func sphere_capsule_collision;
+	extern collision_algorithm_func plane_capsule_collision;
+	// Falls back to GJK and EPA if the capsule's segment enters the box
+	extern collision_algorithm_func box_capsule_collision;
+	extern collision_algorithm_func capsule_capsule_collision;
+	extern collision_algorithm_func plane_cylinder_collision;
+	// Finds the contact between any two spheres, boxes, convex hulls, capsules, or
+	// cylinders with GJK and EPA instead of V-Clip. It generates at most one contact,
+	// at the midpoint of the deepest points of each shape, so resting boxes need
+	// more iterations of the solver to settle than they do with V-Clip's face
+	// clipping.
+	extern collision_algorithm_func gjk_collision;
+
+	// The algorithms above as batch algorithms. They have no state, so they can be
+	// called from multiple threads at once.
+	extern const batch_collision_algorithm sphere_sphere_batch;
+	extern const batch_collision_algorithm sphere_plane_batch;
+	extern const batch_collision_algorithm plane_plane_batch;
+	extern const batch_collision_algorithm plane_box_batch;
+	extern const batch_collision_algorithm sphere_box_batch;
+	extern const batch_collision_algorithm box_box_batch;
+	extern const batch_collision_algorithm plane_convex_hull_batch;
+	extern const batch_collision_algorithm box_convex_hull_batch;
+	extern const batch_collision_algorithm convex_hull_convex_hull_batch;
+	extern const batch_collision_algorithm sphere_capsule_batch;
+	extern const batch_collision_algorithm plane_capsule_batch;
+	extern const batch_collision_algorithm box_capsule_batch;
+	extern const batch_collision_algorithm capsule_capsule_batch;
+	extern const batch_collision_algorithm plane_cylinder_batch;
+	extern const batch_collision_algorithm gjk_batch;
+
+	// Box-box collision that starts V-Clip from the closest features found for the
+	// same pair of boxes in `cache`. The cache must outlive the returned function.
+	collision_algorithm_func cached_box_box_collision(feature_cache &cache);
+	// Like `cached_box_box_collision`, for a convex hull and a box or another convex
+	// hull
+	collision_algorithm_func cached_convex_hull_collision(feature_cache &cache);
+	// Batch forms of `cached_box_box_collision` and `cached_convex_hull_collision`.
+	// Batches that share a cache can run at the same time, as long as no pair is in
+	// more than one of them in a frame.
+	batch_collision_algorithm cached_box_box_batch(feature_cache &cache);
+	batch_collision_algorithm cached_convex_hull_batch(feature_cache &cache);
 
 	void init_algorithms();
 }
\ No newline at end of file
@@ -2,14 +2,27 @@
 #include "../math.h"
 
 namespace phys {
+	// `T(a, b)` must enclose both `a` and `b`. `growth` returns the increase in
+	// size that would result from enclosing another volume, and `enlarged` returns
+	// a copy of the volume grown by a margin in every direction.
 	template <typename T>
-	concept bounding_volume = requires(T t, const T ct) {
+	concept bounding_volume = requires(T t, const T ct, real r) {
 		{ T(ct, ct) } -> std::convertible_to<T>;
 		{ ct.overlaps(ct) } -> std::convertible_to<bool>;
+		{ ct.contains(ct) } -> std::convertible_to<bool>;
 		{ ct.growth(ct) } -> std::convertible_to<real>;
+		{ ct.enlarged(r) } -> std::convertible_to<T>;
 		{ ct == ct } -> std::convertible_to<bool>;
 	} && std::default_initializable<T>;
 
+	// A bounding volume that can be used to build a BVH from scratch with the
+	// surface area heuristic
+	template <typename T>
+	concept buildable_volume = bounding_volume<T> && requires(const T ct) {
+		{ ct.centroid() } -> std::convertible_to<vec3>;
+		{ ct.surface_area() } -> std::convertible_to<real>;
+	};
+
 	struct bounding_sphere {
 		vec3 center{};
 		real radius{};
@@ -19,7 +32,12 @@ namespace phys {
 		bounding_sphere(const bounding_sphere &a, const bounding_sphere &b);
 
 		bool overlaps(const bounding_sphere &other) const;
+		bool contains(const bounding_sphere &other) const;
 		real growth(const bounding_sphere &other) const;
+		bounding_sphere enlarged(real margin) const;
+
+		vec3 centroid() const;
+		real surface_area() const;
 
 		friend bool operator==(const bounding_sphere &a, const bounding_sphere &b);
 
@@ -27,5 +45,31 @@ namespace phys {
 		real volume() const;
 	};
 
-	static_assert(bounding_volume<bounding_sphere>);
+	static_assert(buildable_volume<bounding_sphere>);
+
+	// An axis-aligned bounding box. This is a much tighter fit than a sphere for long
+	// or flat objects.
+	struct aabb {
+		vec3 min{};
+		vec3 max{};
+
+		aabb() = default;
+		aabb(const vec3 &_min, const vec3 &_max);
+		aabb(const aabb &a, const aabb &b);
+		explicit aabb(const bounding_sphere &sphere);
+
+		bool overlaps(const aabb &other) const;
+		bool contains(const aabb &other) const;
+		// Growth is measured in surface area, which is a better estimate of the
+		// cost of a node than volume is
+		real growth(const aabb &other) const;
+		aabb enlarged(real margin) const;
+
+		vec3 centroid() const;
+		real surface_area() const;
+
+		friend bool operator==(const aabb &a, const aabb &b);
+	};
+
+	static_assert(buildable_volume<aabb>);
 }
@@ -3,8 +3,12 @@
 #include <stack>
 #include <vector>
 #include "bounding_volumes.h"
+#include "sah_builder.h"
 
 namespace phys {
+	// A BVH whose nodes own their children. Inserting an object rotates the nodes
+	// on the path from its leaf to the root, so objects that are inserted in order
+	// don't turn the tree into a list. Removing an object only refits the path.
 	template <bounding_volume Volume, typename Identifier>
 	class bvh {
 	public:
@@ -22,12 +26,28 @@ namespace phys {
 			);
 		};
 
+		bvh() = default;
+		// Every object's volume is enlarged by `_margin` before it's stored in the tree.
+		// An update that moves an object's volume somewhere within its enlarged
+		// volume leaves the tree untouched.
+		explicit bvh(real _margin);
+
 		void insert(Identifier id, const Volume &vol);
 		bool remove(Identifier id);
 		void update(Identifier id, const Volume &vol);
 		bool has(Identifier id) const;
 		size_t size() const;
 
+		// Replaces everything in the BVH with `objects`, a range of (id, volume) pairs
+		// with unique ids. The tree is built top-down with the surface area
+		// heuristic, which gives a much better tree than inserting the objects one at
+		// a time. Large subtrees are built in parallel.
+		template <typename Range> requires buildable_volume<Volume>
+		void build(
+			const Range &objects,
+			size_t min_parallel_objects = sah_builder<Volume, Identifier>::default_min_parallel_objects
+		);
+
 		template <typename Container>
 		void generate_coarse_collisions(Container &pairs) const;
 
@@ -67,9 +87,19 @@ namespace phys {
 
 		std::vector<id_node> ids{};
 		std::unique_ptr<node> root{};
+		real margin{};
 
 		template <typename Container>
 		void generate_coarse_collisions_with(Container &pairs, node * n, node * tree) const;
+
+		// Refits every node from `n` up to the root, and rotates each node on the way
+		// up
+		void rotate_parent_volumes(node * n);
+		// Swaps a child of `n` with a grandchild on the other side if that makes the
+		// tree smaller. The children's volumes must be up to date.
+		void rotate(node * n);
+		// The pointer that owns `n`, which must not be the root
+		static std::unique_ptr<node>& owner(node * n);
 	};
 }
 
@@ -117,7 +147,12 @@ phys::bvh<Volume, Identifier>::id_node::id_node(Identifier _id, phys::bvh<Volume
 	id(_id), n(_n) {}
 
 template <phys::bounding_volume Volume, typename Identifier>
-void phys::bvh<Volume, Identifier>::insert(Identifier id, const Volume &vol) {
+phys::bvh<Volume, Identifier>::bvh(real _margin) :
+	margin(_margin) {}
+
+template <phys::bounding_volume Volume, typename Identifier>
+void phys::bvh<Volume, Identifier>::insert(Identifier id, const Volume &tight_vol) {
+	const Volume vol = tight_vol.enlarged(margin);
 	auto id_i = std::lower_bound(std::begin(ids), std::end(ids), id);
 
 	if (id_i != std::end(ids) && id_i->id == id) {
@@ -158,7 +193,70 @@ void phys::bvh<Volume, Identifier>::insert(Identifier id, const Volume &vol) {
 	assert(id_i->id == old_id);
 	id_i->n = n->left.get();
 
-	n->recalculate_parent_volumes();
+	rotate_parent_volumes(n);
+}
+
+template <phys::bounding_volume Volume, typename Identifier>
+void phys::bvh<Volume, Identifier>::rotate_parent_volumes(node * n) {
+	while (n) {
+		assert(! n->is_leaf());
+
+		rotate(n);
+		n->vol = Volume(n->left->vol, n->right->vol);
+		n = n->parent;
+	}
+}
+
+template <phys::bounding_volume Volume, typename Identifier>
+void phys::bvh<Volume, Identifier>::rotate(node * n) {
+	node * b = n->left.get();
+	node * c = n->right.get();
+
+	// Each candidate rotation swaps a child of `n` with a grandchild on the other
+	// side. The cost of a rotation is how much the node that receives the child
+	// grows (or shrinks, if negative): swapping `b` with `f` turns `c = (f, g)` into
+	// `c = (b, g)`, which changes the size of `c` by `g.growth(b) - g.growth(f)`.
+	real best_cost{};
+	node * child{};
+	node * grandchild{};
+
+	const auto try_rotation = [&](node * from, node * to, node * stays) {
+		const real cost = stays->vol.growth(from->vol) - stays->vol.growth(to->vol);
+
+		if (cost < best_cost) {
+			best_cost = cost;
+			child = from;
+			grandchild = to;
+		}
+	};
+
+	if (! c->is_leaf()) {
+		try_rotation(b, c->left.get(), c->right.get());
+		try_rotation(b, c->right.get(), c->left.get());
+	}
+
+	if (! b->is_leaf()) {
+		try_rotation(c, b->left.get(), b->right.get());
+		try_rotation(c, b->right.get(), b->left.get());
+	}
+
+	if (! child) {
+		return;
+	}
+
+	node * grandparent = grandchild->parent;
+
+	std::swap(owner(child), owner(grandchild));
+	child->parent = grandparent;
+	grandchild->parent = n;
+	grandparent->vol = Volume(grandparent->left->vol, grandparent->right->vol);
+}
+
+template <phys::bounding_volume Volume, typename Identifier>
+std::unique_ptr<typename phys::bvh<Volume, Identifier>::node>& phys::bvh<Volume, Identifier>::owner(node * n) {
+	assert(n->parent);
+
+	return (n == n->parent->left.get()) ? n->parent->left : n->parent->right;
 }
 
 template <phys::bounding_volume Volume, typename Identifier>
@@ -231,6 +329,12 @@ bool phys::bvh<Volume, Identifier>::remove(Identifier id) {
 
 template <phys::bounding_volume Volume, typename Identifier>
 void phys::bvh<Volume, Identifier>::update(Identifier id, const Volume &vol) {
+	auto id_i = std::lower_bound(std::begin(ids), std::end(ids), id);
+
+	if (id_i != std::end(ids) && id_i->id == id && id_i->n->vol.contains(vol)) {
+		return;
+	}
+
 	bool was_present = remove(id);
 
 	if (was_present) {
@@ -252,6 +356,57 @@ size_t phys::bvh<Volume, Identifier>::size() const {
 	return ids.size();
 }
 
+template <phys::bounding_volume Volume, typename Identifier>
+template <typename Range> requires phys::buildable_volume<Volume>
+void phys::bvh<Volume, Identifier>::build(const Range &objects, size_t min_parallel_objects) {
+	sah_builder<Volume, Identifier> builder(min_parallel_objects);
+
+	for (const auto &[id, vol] : objects) {
+		builder.add(id, vol.enlarged(margin));
+	}
+
+	const auto built = builder.build();
+
+	ids.clear();
+	root.reset();
+
+	if (built.empty()) {
+		return;
+	}
+
+	ids.reserve((built.size() + 1) / 2);
+	root = std::make_unique<node>(built[0].vol, built[0].id);
+
+	std::stack<std::pair<size_t, node *>> nodes{};
+
+	nodes.push({ 0, root.get() });
+
+	while (! nodes.empty()) {
+		auto [i, n] = nodes.top();
+		nodes.pop();
+
+		if (built[i].is_leaf()) {
+			ids.push_back(id_node(built[i].id, n));
+			continue;
+		}
+
+		const size_t left = i + 1;
+		const size_t right = built[i].right;
+
+		n->left = std::make_unique<node>(built[left].vol, built[left].id);
+		n->right = std::make_unique<node>(built[right].vol, built[right].id);
+		n->left->parent = n;
+		n->right->parent = n;
+
+		nodes.push({ left, n->left.get() });
+		nodes.push({ right, n->right.get() });
+	}
+
+	std::sort(std::begin(ids), std::end(ids));
+
+	assert(std::adjacent_find(std::begin(ids), std::end(ids)) == std::end(ids));
+}
+
 template <phys::bounding_volume Volume, typename Identifier>
 template <typename Container>
 void phys::bvh<Volume, Identifier>::generate_coarse_collisions(Container &pairs) const {
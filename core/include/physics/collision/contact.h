@@ -12,6 +12,10 @@ namespace phys {
 		vec3 point;
 		vec3 normal;
 		real penetration;
+		// The impulses that resolved the contact, along the normal and tangent to it.
+		// A solver can start from these the next time it sees the same contact.
+		real normal_impulse{};
+		vec3 tangent_impulse{};
 
 		contact(
 			rigid_body * _a,
@@ -0,0 +1,67 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include "contact.h"
+#include "primitive.h"
+#include "primitive_pair.h"
+
+namespace phys {
+	// Keeps the contacts between each pair of primitives from one frame to the next,
+	// so that a solver can start from last frame's impulses (warm starting). Contacts
+	// are regenerated from scratch every frame, so each new contact is matched to the
+	// closest old contact between the same pair of primitives. Contacts are compared
+	// in the local space of their first body, so contacts on a moving body still
+	// match.
+	//
+	// Every frame, call `begin_frame`, then `warm_start` for each pair of primitives
+	// that the broadphase reports, then solve, then `store` for each of those pairs,
+	// then `end_frame`. A pair that isn't seen in a frame is forgotten.
+	class contact_cache {
+	public:
+		// Each pair remembers at most this many contacts
+		static inline constexpr size_t max_contacts_per_pair = 8;
+
+		// Contacts that are closer than this to an old contact are considered to be
+		// the same contact
+		real matching_distance;
+
+		explicit contact_cache(real _matching_distance = (real)0.05);
+
+		void begin_frame();
+		// Copies the impulses of last frame's contacts between `a` and `b` to the
+		// matching contacts in `contacts`
+		void warm_start(const primitive &a, const primitive &b, std::span<contact> contacts);
+		// Remembers the solved contacts between `a` and `b`
+		void store(const primitive &a, const primitive &b, std::span<const contact> contacts);
+		// Forgets every pair that wasn't seen since `begin_frame`
+		void end_frame();
+		void clear();
+
+		// The number of pairs being remembered
+		size_t size() const;
+
+	private:
+#ifdef DEBUG
+	public:
+#endif
+		struct cached_contact {
+			vec3 local_point{};
+			real normal_impulse{};
+			vec3 tangent_impulse{};
+		};
+
+		struct manifold {
+			std::array<cached_contact, max_contacts_per_pair> contacts{};
+			size_t num_contacts{};
+			uint64_t last_frame{};
+		};
+
+		std::unordered_map<primitive_pair, manifold, primitive_pair_hash> manifolds{};
+		uint64_t frame{};
+
+		static primitive_pair make_pair(const primitive &a, const primitive &b);
+		static vec3 to_local(const contact &c);
+	};
+}
@@ -1,25 +1,48 @@
 #pragma once
+#include <array>
+#include <span>
+#include <vector>
 #include "algorithm.h"
 #include "contact.h"
 #include "primitive.h"
 
 namespace phys {
+	class thread_pool;
+
+	// An algorithm is registered either as a `collision_algorithm_func` or as a
+	// `batch_collision_algorithm`. The other one is empty.
 	struct collision_algorithm {
 		int shape_type_1{};
 		int shape_type_2{};
 		collision_algorithm_func algorithm{};
+		batch_collision_algorithm batch{};
 
 		collision_algorithm(
 			int _shape_type_1,
 			int _shape_type_2,
 			const collision_algorithm_func &_algorithm
 		);
+		collision_algorithm(
+			int _shape_type_1,
+			int _shape_type_2,
+			const batch_collision_algorithm &_batch
+		);
 
 		collision_algorithm() = default;
 	};
 
+	// The contacts in `[begin, end)` of a contact container are between `a` and `b`
+	struct contact_range {
+		primitive * a{};
+		primitive * b{};
+		size_t begin{};
+		size_t end{};
+	};
+
 	class contact_generator {
 	public:
+		static inline constexpr size_t default_narrowphase_grain = 64;
+
 		contact_generator();
 
 		void generate_contacts(
@@ -27,6 +50,32 @@ namespace phys {
 			primitive &b,
 			contact_container &contacts
 		) const;
+		// Generates contacts for every pair in `pairs`. The pairs are grouped by their
+		// shape types, and each group is passed to its algorithm in one call. The
+		// contacts for each pair are contiguous, and a range is added to `ranges` for
+		// every pair, in the order that the groups were collided. The primitives
+		// in each range are in ascending order of `type`.
+		//
+		// This can be called from multiple threads at once as long as the registered
+		// algorithms can. The built in algorithms can, and the ones that use a
+		// `feature_cache` can as long as each pair is only collided once per frame.
+		void generate_contacts(
+			std::span<const collision_pair> pairs,
+			contact_container &contacts,
+			std::vector<contact_range> &ranges
+		) const;
+		// Like the function above, but the pairs are split into chunks of `grain`
+		// pairs that are collided on `pool`. Each chunk gets its own contacts, which
+		// are joined in order at the end, so the contacts and ranges are the same as
+		// they would be on one thread. The algorithms must be safe to call from
+		// multiple threads.
+		void generate_contacts(
+			thread_pool &pool,
+			std::span<const collision_pair> pairs,
+			contact_container &contacts,
+			std::vector<contact_range> &ranges,
+			size_t grain = default_narrowphase_grain
+		) const;
 
 		void register_collision_algorithm(
 			shape_type shape_type_1,
@@ -43,9 +92,37 @@ namespace phys {
 			int shape_type_2,
 			const collision_algorithm_func &algorithm
 		);
+		void register_collision_algorithm(
+			shape_type shape_type_1,
+			shape_type shape_type_2,
+			const batch_collision_algorithm &batch
+		);
+		void register_collision_algorithm(
+			shape_type shape_type_1,
+			int shape_type_2,
+			const batch_collision_algorithm &batch
+		);
+		void register_collision_algorithm(
+			int shape_type_1,
+			int shape_type_2,
+			const batch_collision_algorithm &batch
+		);
 	private:
 		static inline constexpr size_t max_shapes = 16;
+		static inline constexpr size_t num_buckets = max_shapes * max_shapes;
+
+		// The first pair of each shape type pair's bucket, and the end of the last
+		// bucket
+		using bucket_offsets = std::array<size_t, num_buckets + 1>;
 
 		collision_algorithm algs[max_shapes][max_shapes]{};
+
+		// The algorithm for the shape types of `a` and `b`. Throws `std::invalid_argument`
+		// if either shape type is out of range or if no algorithm was registered for
+		// the pair.
+		const collision_algorithm &find_algorithm(const primitive &a, const primitive &b) const;
+		// Sorts `pairs` into buckets by their shape types, keeping the order of the
+		// pairs in each bucket. Throws if a pair has no collision algorithm.
+		bucket_offsets sort_pairs(std::span<const collision_pair> pairs, std::vector<collision_pair> &out) const;
 	};
 }
@@ -0,0 +1,116 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include "primitive.h"
+#include "primitive_pair.h"
+#include "vclip.h"
+
+namespace phys {
+	// Keeps the closest features between each pair of primitives from one frame to
+	// the next. Objects move very little between frames, so last frame's closest
+	// features are usually still the closest features, or a step or two away from
+	// them. Starting V-Clip from them makes each query close to O(1).
+	//
+	// Features are remembered by their positions in the polyhedra's vertex, edge and
+	// face arrays, so the polyhedron given for a primitive must have the same features
+	// every frame (its vertices can move). Every frame, call `begin_frame`, then
+	// `closest_features` for each pair of primitives, then `end_frame`. A pair that
+	// isn't seen in a frame is forgotten.
+	//
+	// `closest_features` can be called from multiple threads at once, as long as
+	// each pair is only given once per frame. The other functions can't.
+	class feature_cache {
+	public:
+		struct statistics {
+			// Queries that started from the features that were found last frame
+			size_t hits{};
+			// Queries for pairs that weren't in the cache
+			size_t misses{};
+			// Hits that didn't converge from last frame's features and were run again
+			// from a vertex of each polyhedron
+			size_t restarts{};
+			// Total number of V-Clip steps over every query
+			size_t steps{};
+			// Most V-Clip steps taken by any one query
+			size_t max_steps{};
+
+			size_t queries() const;
+			real steps_per_query() const;
+		};
+
+		void begin_frame();
+		// Runs V-Clip between `p_a`, the polyhedron of `a`, and `p_b`, the polyhedron
+		// of `b`, starting from the closest features that were found for `a` and `b`
+		// last time. V-Clip can go around in a loop when it starts from an edge or a
+		// face that's almost on the boundary of a Voronoi region, so if it doesn't
+		// converge, it's run again from a vertex of each polyhedron.
+		vclip::algorithm_result closest_features(
+			const primitive &a,
+			const primitive &b,
+			const vclip::polyhedron &p_a,
+			const vclip::polyhedron &p_b,
+			size_t max_steps = SIZE_MAX
+		);
+		// Like the function above, but `p_b` is in `b`'s space, and `b_to_a` is a rigid
+		// transform from there to the space of `p_a`
+		vclip::algorithm_result closest_features(
+			const primitive &a,
+			const primitive &b,
+			const vclip::polyhedron &p_a,
+			const vclip::polyhedron &p_b,
+			const mat4 &b_to_a,
+			size_t max_steps = SIZE_MAX
+		);
+		// Forgets every pair that wasn't seen since `begin_frame`
+		void end_frame();
+		void clear();
+
+		// The number of pairs being remembered
+		size_t size() const;
+
+		const statistics& get_stats() const;
+		void reset_stats();
+
+	private:
+#ifdef DEBUG
+	public:
+#endif
+		enum class feature_type : uint8_t {
+			Vertex,
+			Edge,
+			Face
+		};
+
+		struct feature_ref {
+			feature_type type{};
+			size_t index{};
+
+			static std::optional<feature_ref> find(const vclip::polyhedron &p, const vclip::feature &f);
+			std::optional<vclip::feature> get(const vclip::polyhedron &p) const;
+		};
+
+		struct entry {
+			feature_ref f1{};
+			feature_ref f2{};
+			uint64_t last_frame{};
+		};
+
+		// Guards `entries` and `stats` in `closest_features`
+		std::mutex mutex{};
+		std::unordered_map<primitive_pair, entry, primitive_pair_hash> entries{};
+		statistics stats{};
+		uint64_t frame{};
+
+		// `b_to_a` is null if the polyhedra are in the same space
+		vclip::algorithm_result query(
+			const primitive &a,
+			const primitive &b,
+			const vclip::polyhedron &p_a,
+			const vclip::polyhedron &p_b,
+			const mat4 * b_to_a,
+			size_t max_steps
+		);
+	};
+}
@@ -0,0 +1,575 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+#include "bounding_volumes.h"
+#include "sah_builder.h"
+#include "small_vector.h"
+
+namespace phys {
+	// A BVH with the same interface as `bvh`, but with every node stored in one
+	// contiguous array. Nodes refer to their parents and children by index, and
+	// removed nodes are kept on a free list to be reused by later insertions. Once
+	// the node array has grown to its working size, inserting, removing, and updating
+	// objects does not allocate, and traversals walk a single block of memory instead
+	// of chasing pointers.
+	//
+	// Leaf volumes can be enlarged by a margin so that objects that move a little
+	// each frame don't need to be reinserted, and the tree is rebalanced with local
+	// rotations whenever a leaf is inserted. Removing a leaf only refits the volumes
+	// above it.
+	template <bounding_volume Volume, typename Identifier>
+	class flat_bvh {
+	public:
+		struct coarse_collision_pair {
+			Volume v1;
+			Volume v2;
+			Identifier id1;
+			Identifier id2;
+
+			coarse_collision_pair(
+				const Volume &_v1,
+				const Volume &_v2,
+				Identifier _id1,
+				Identifier _id2
+			);
+		};
+
+		flat_bvh() = default;
+		// Every object's volume is enlarged by `_margin` before it's stored in the tree.
+		// An update that moves an object's volume somewhere within its enlarged
+		// volume leaves the tree untouched.
+		explicit flat_bvh(real _margin);
+
+		void insert(Identifier id, const Volume &vol);
+		bool remove(Identifier id);
+		void update(Identifier id, const Volume &vol);
+		bool has(Identifier id) const;
+		size_t size() const;
+		// Reserves space for `num_objects` objects so that the node array does not
+		// need to grow until there are more than `num_objects` objects in the tree
+		void reserve(size_t num_objects);
+
+		// Replaces everything in the BVH with `objects`, a range of (id, volume) pairs
+		// with unique ids. The tree is built top-down with the surface area
+		// heuristic, which gives a much better tree than inserting the objects one at
+		// a time. Large subtrees are built in parallel.
+		template <typename Range> requires buildable_volume<Volume>
+		void build(
+			const Range &objects,
+			size_t min_parallel_objects = sah_builder<Volume, Identifier>::default_min_parallel_objects
+		);
+
+		template <typename Container>
+		void generate_coarse_collisions(Container &pairs) const;
+
+		// Calls `f(id)` for every object whose (enlarged) volume overlaps `vol`
+		template <typename F>
+		void query(const Volume &vol, F &&f) const;
+
+	private:
+#ifdef DEBUG
+	public:
+#endif
+		using node_index = uint32_t;
+
+		static inline constexpr node_index null_node = UINT32_MAX;
+
+		struct node {
+			Volume vol{};
+			Identifier id{};
+
+			// For a node on the free list, this is the index of the next free node
+			node_index parent{ null_node };
+			node_index left{ null_node };
+			node_index right{ null_node };
+
+			node(const Volume &_vol, Identifier _id);
+
+			bool is_leaf() const;
+		};
+
+		struct id_node {
+			Identifier id{};
+			node_index n{ null_node };
+
+			id_node(Identifier _id);
+			id_node(Identifier _id, node_index _n);
+
+			friend bool operator<(const id_node &a, const id_node &b) {
+				return a.id < b.id;
+			}
+
+			friend bool operator==(const id_node &a, const id_node &b) {
+				return a.id == b.id;
+			}
+		};
+
+		struct node_pair {
+			node_index a;
+			node_index b;
+		};
+
+		std::vector<node> nodes{};
+		std::vector<id_node> ids{};
+		node_index root{ null_node };
+		node_index free_list{ null_node };
+		real margin{};
+
+		node_index allocate_node(const Volume &vol, Identifier id);
+		void free_node(node_index i);
+		void replace_child(node_index parent, node_index old_child, node_index new_child);
+		// Refits every node from `i` up to the root. Nodes are also rotated on the way
+		// up if `with_rotations` is set.
+		void recalculate_parent_volumes(node_index i, bool with_rotations);
+		// Swaps one of the node's children with one of its grandchildren if that
+		// makes the child that receives the grandchild smaller
+		void rotate(node_index i);
+		// Links a leaf into the tree
+		void insert_leaf(node_index leaf);
+		// Unlinks a leaf from the tree, but does not free it
+		void remove_leaf(node_index leaf);
+
+		template <typename Container>
+		void generate_coarse_collisions_with(
+			Container &pairs,
+			std::vector<node_pair> &pair_stack,
+			node_index n,
+			node_index tree
+		) const;
+	};
+}
+
+template <phys::bounding_volume Volume, typename Identifier>
+phys::flat_bvh<Volume, Identifier>::coarse_collision_pair::coarse_collision_pair(
+	const Volume &_v1,
+	const Volume &_v2,
+	Identifier _id1,
+	Identifier _id2
+) :
+	v1(_v1),
+	v2(_v2),
+	id1(_id1),
+	id2(_id2)
+{}
+
+template <phys::bounding_volume Volume, typename Identifier>
+phys::flat_bvh<Volume, Identifier>::flat_bvh(real _margin) :
+	margin(_margin) {}
+
+template <phys::bounding_volume Volume, typename Identifier>
+phys::flat_bvh<Volume, Identifier>::node::node(const Volume &_vol, Identifier _id) :
+	vol(_vol), id(_id) {}
+
+template <phys::bounding_volume Volume, typename Identifier>
+bool phys::flat_bvh<Volume, Identifier>::node::is_leaf() const {
+	return left == null_node;
+}
+
+template <phys::bounding_volume Volume, typename Identifier>
+phys::flat_bvh<Volume, Identifier>::id_node::id_node(Identifier _id) :
+	id(_id), n(null_node) {}
+
+template <phys::bounding_volume Volume, typename Identifier>
+phys::flat_bvh<Volume, Identifier>::id_node::id_node(Identifier _id, node_index _n) :
+	id(_id), n(_n) {}
+
+template <phys::bounding_volume Volume, typename Identifier>
+typename phys::flat_bvh<Volume, Identifier>::node_index phys::flat_bvh<Volume, Identifier>::allocate_node(
+	const Volume &vol,
+	Identifier id
+) {
+	if (free_list == null_node) {
+		assert(nodes.size() < null_node);
+
+		nodes.emplace_back(vol, id);
+
+		return (node_index)(nodes.size() - 1);
+	}
+
+	node_index i = free_list;
+	free_list = nodes[i].parent;
+	nodes[i] = node(vol, id);
+
+	return i;
+}
+
+template <phys::bounding_volume Volume, typename Identifier>
+void phys::flat_bvh<Volume, Identifier>::free_node(node_index i) {
+	nodes[i].left = null_node;
+	nodes[i].right = null_node;
+	nodes[i].parent = free_list;
+	free_list = i;
+}
+
+template <phys::bounding_volume Volume, typename Identifier>
+void phys::flat_bvh<Volume, Identifier>::replace_child(
+	node_index parent,
+	node_index old_child,
+	node_index new_child
+) {
+	if (parent == null_node) {
+		root = new_child;
+	} else if (nodes[parent].left == old_child) {
+		nodes[parent].left = new_child;
+	} else {
+		assert(nodes[parent].right == old_child);
+
+		nodes[parent].right = new_child;
+	}
+
+	nodes[new_child].parent = parent;
+}
+
+template <phys::bounding_volume Volume, typename Identifier>
+void phys::flat_bvh<Volume, Identifier>::recalculate_parent_volumes(node_index i, bool with_rotations) {
+	while (i != null_node) {
+		node &n = nodes[i];
+
+		assert(! n.is_leaf());
+		assert(n.right != null_node);
+
+		if (with_rotations) {
+			rotate(i);
+		}
+
+		n.vol = Volume(nodes[n.left].vol, nodes[n.right].vol);
+		i = n.parent;
+	}
+}
+
+template <phys::bounding_volume Volume, typename Identifier>
+void phys::flat_bvh<Volume, Identifier>::rotate(node_index i) {
+	const node_index b = nodes[i].left;
+	const node_index c = nodes[i].right;
+
+	// Each candidate rotation swaps a child of `i` with a grandchild on the other
+	// side. The cost of a rotation is how much the node that receives the child
+	// grows (or shrinks, if negative): swapping `b` with `f` turns `c = (f, g)` into
+	// `c = (b, g)`, which changes the size of `c` by `g.growth(b) - g.growth(f)`.
+	real best_cost{};
+	node_index child{ null_node };
+	node_index grandchild{ null_node };
+
+	const auto try_rotation = [&](node_index from, node_index to, node_index stays) {
+		const Volume &vol = nodes[stays].vol;
+		const real cost = vol.growth(nodes[from].vol) - vol.growth(nodes[to].vol);
+
+		if (cost < best_cost) {
+			best_cost = cost;
+			child = from;
+			grandchild = to;
+		}
+	};
+
+	if (! nodes[c].is_leaf()) {
+		try_rotation(b, nodes[c].left, nodes[c].right);
+		try_rotation(b, nodes[c].right, nodes[c].left);
+	}
+
+	if (! nodes[b].is_leaf()) {
+		try_rotation(c, nodes[b].left, nodes[b].right);
+		try_rotation(c, nodes[b].right, nodes[b].left);
+	}
+
+	if (child == null_node) {
+		return;
+	}
+
+	const node_index grandparent = nodes[grandchild].parent;
+
+	replace_child(i, child, grandchild);
+	replace_child(grandparent, grandchild, child);
+
+	node &g = nodes[grandparent];
+	g.vol = Volume(nodes[g.left].vol, nodes[g.right].vol);
+}
+
+template <phys::bounding_volume Volume, typename Identifier>
+void phys::flat_bvh<Volume, Identifier>::insert_leaf(node_index leaf) {
+	if (root == null_node) {
+		root = leaf;
+		nodes[leaf].parent = null_node;
+		return;
+	}
+
+	const Volume &vol = nodes[leaf].vol;
+	node_index sibling = root;
+
+	while (! nodes[sibling].is_leaf()) {
+		const node &n = nodes[sibling];
+		real left_growth = nodes[n.left].vol.growth(vol);
+		real right_growth = nodes[n.right].vol.growth(vol);
+
+		if (left_growth < right_growth) {
+			sibling = n.left;
+		} else {
+			sibling = n.right;
+		}
+	}
+
+	// The old leaf and the new leaf become children of a new internal node, which
+	// takes the old leaf's place in the tree
+	node_index old_parent = nodes[sibling].parent;
+	node_index new_parent = allocate_node(Volume(nodes[sibling].vol, nodes[leaf].vol), Identifier{});
+
+	replace_child(old_parent, sibling, new_parent);
+	nodes[new_parent].left = sibling;
+	nodes[new_parent].right = leaf;
+	nodes[sibling].parent = new_parent;
+	nodes[leaf].parent = new_parent;
+
+	recalculate_parent_volumes(old_parent, true);
+}
+
+template <phys::bounding_volume Volume, typename Identifier>
+void phys::flat_bvh<Volume, Identifier>::remove_leaf(node_index leaf) {
+	if (leaf == root) {
+		assert(nodes[leaf].parent == null_node);
+
+		root = null_node;
+		return;
+	}
+
+	node_index parent = nodes[leaf].parent;
+
+	assert(parent != null_node);
+
+	node_index sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+	node_index grandparent = nodes[parent].parent;
+
+	replace_child(grandparent, parent, sibling);
+	free_node(parent);
+	nodes[leaf].parent = null_node;
+
+	// Removing a leaf can't unbalance the tree as much as inserting one can, so the
+	// cost of evaluating rotations is only paid on insertion
+	recalculate_parent_volumes(grandparent, false);
+}
+
+template <phys::bounding_volume Volume, typename Identifier>
+void phys::flat_bvh<Volume, Identifier>::insert(Identifier id, const Volume &vol) {
+	auto id_i = std::lower_bound(std::begin(ids), std::end(ids), id);
+
+	if (id_i != std::end(ids) && id_i->id == id) {
+		return;
+	}
+
+	node_index leaf = allocate_node(vol.enlarged(margin), id);
+
+	ids.insert(id_i, id_node(id, leaf));
+	insert_leaf(leaf);
+}
+
+template <phys::bounding_volume Volume, typename Identifier>
+bool phys::flat_bvh<Volume, Identifier>::remove(Identifier id) {
+	auto id_i = std::lower_bound(std::begin(ids), std::end(ids), id);
+
+	if (id_i == std::end(ids) || id_i->id != id) {
+		return false;
+	}
+
+	node_index leaf = id_i->n;
+
+	ids.erase(id_i);
+	remove_leaf(leaf);
+	free_node(leaf);
+
+	return true;
+}
+
+template <phys::bounding_volume Volume, typename Identifier>
+void phys::flat_bvh<Volume, Identifier>::update(Identifier id, const Volume &vol) {
+	auto id_i = std::lower_bound(std::begin(ids), std::end(ids), id);
+
+	if (id_i == std::end(ids) || id_i->id != id) {
+		return;
+	}
+
+	// The leaf keeps its node, so the id list doesn't need to change
+	node_index leaf = id_i->n;
+
+	if (nodes[leaf].vol.contains(vol)) {
+		return;
+	}
+
+	remove_leaf(leaf);
+	nodes[leaf].vol = vol.enlarged(margin);
+	insert_leaf(leaf);
+}
+
+template <phys::bounding_volume Volume, typename Identifier>
+bool phys::flat_bvh<Volume, Identifier>::has(Identifier id) const {
+	auto id_i = std::lower_bound(std::begin(ids), std::end(ids), id_node(id));
+
+	return (id_i != std::end(ids)) && id_i->id == id;
+}
+
+template <phys::bounding_volume Volume, typename Identifier>
+size_t phys::flat_bvh<Volume, Identifier>::size() const {
+	return ids.size();
+}
+
+template <phys::bounding_volume Volume, typename Identifier>
+void phys::flat_bvh<Volume, Identifier>::reserve(size_t num_objects) {
+	if (! num_objects) {
+		return;
+	}
+
+	// A full binary tree with N leaves has 2N - 1 nodes
+	nodes.reserve((2 * num_objects) - 1);
+	ids.reserve(num_objects);
+}
+
+template <phys::bounding_volume Volume, typename Identifier>
+template <typename Range> requires phys::buildable_volume<Volume>
+void phys::flat_bvh<Volume, Identifier>::build(const Range &objects, size_t min_parallel_objects) {
+	sah_builder<Volume, Identifier> builder(min_parallel_objects);
+
+	for (const auto &[id, vol] : objects) {
+		builder.add(id, vol.enlarged(margin));
+	}
+
+	const auto built = builder.build();
+
+	nodes.clear();
+	ids.clear();
+	root = null_node;
+	free_list = null_node;
+
+	if (built.empty()) {
+		return;
+	}
+
+	// The builder's nodes are already in one array, so they can be copied over
+	// directly with the same indices
+	nodes.reserve(built.size());
+	ids.reserve((built.size() + 1) / 2);
+
+	for (node_index i = 0; i < (node_index)built.size(); i++) {
+		nodes.emplace_back(built[i].vol, built[i].id);
+
+		if (built[i].is_leaf()) {
+			ids.push_back(id_node(built[i].id, i));
+		} else {
+			nodes[i].left = i + 1;
+			nodes[i].right = built[i].right;
+		}
+	}
+
+	for (node_index i = 0; i < (node_index)nodes.size(); i++) {
+		if (! nodes[i].is_leaf()) {
+			nodes[nodes[i].left].parent = i;
+			nodes[nodes[i].right].parent = i;
+		}
+	}
+
+	root = 0;
+	std::sort(std::begin(ids), std::end(ids));
+
+	assert(std::adjacent_find(std::begin(ids), std::end(ids)) == std::end(ids));
+}
+
+template <phys::bounding_volume Volume, typename Identifier>
+template <typename Container>
+void phys::flat_bvh<Volume, Identifier>::generate_coarse_collisions(Container &pairs) const {
+	if (root == null_node || nodes[root].is_leaf()) {
+		return;
+	}
+
+	std::vector<node_index> node_stack{};
+	std::vector<node_pair> pair_stack{};
+
+	node_stack.reserve(64);
+	pair_stack.reserve(64);
+	node_stack.push_back(root);
+
+	while (! node_stack.empty()) {
+		const node &n = nodes[node_stack.back()];
+		node_stack.pop_back();
+
+		if (! nodes[n.left].is_leaf()) {
+			node_stack.push_back(n.left);
+		}
+
+		if (! nodes[n.right].is_leaf()) {
+			node_stack.push_back(n.right);
+		}
+
+		if (nodes[n.left].vol.overlaps(nodes[n.right].vol)) {
+			generate_coarse_collisions_with(pairs, pair_stack, n.left, n.right);
+		}
+	}
+}
+
+template <phys::bounding_volume Volume, typename Identifier>
+template <typename F>
+void phys::flat_bvh<Volume, Identifier>::query(const Volume &vol, F &&f) const {
+	if (root == null_node) {
+		return;
+	}
+
+	// Queries are often made once per object per frame, so the stack is kept
+	// inline. It only allocates for very unbalanced trees.
+	util::small_vector<node_index, 64> node_stack{};
+
+	node_stack.push_back(root);
+
+	while (! node_stack.empty()) {
+		const node &n = nodes[node_stack.back()];
+		node_stack.pop_back();
+
+		if (! n.vol.overlaps(vol)) {
+			continue;
+		}
+
+		if (n.is_leaf()) {
+			f(n.id);
+		} else {
+			node_stack.push_back(n.left);
+			node_stack.push_back(n.right);
+		}
+	}
+}
+
+template <phys::bounding_volume Volume, typename Identifier>
+template <typename Container>
+void phys::flat_bvh<Volume, Identifier>::generate_coarse_collisions_with(
+	Container &pairs,
+	std::vector<node_pair> &pair_stack,
+	node_index n,
+	node_index tree
+) const {
+	// The caller has already checked that `n` and `tree` overlap
+	pair_stack.clear();
+	pair_stack.push_back({ n, tree });
+
+	while (! pair_stack.empty()) {
+		node_pair p = pair_stack.back();
+		pair_stack.pop_back();
+
+		const node &a = nodes[p.a];
+		const node &b = nodes[p.b];
+
+		if (a.is_leaf() && b.is_leaf()) {
+			pairs.insert(std::end(pairs), coarse_collision_pair(a.vol, b.vol, a.id, b.id));
+		} else if (! a.is_leaf()) {
+			if (nodes[a.left].vol.overlaps(b.vol)) {
+				pair_stack.push_back({ a.left, p.b });
+			}
+
+			if (nodes[a.right].vol.overlaps(b.vol)) {
+				pair_stack.push_back({ a.right, p.b });
+			}
+		} else {
+			if (a.vol.overlaps(nodes[b.left].vol)) {
+				pair_stack.push_back({ p.a, b.left });
+			}
+
+			if (a.vol.overlaps(nodes[b.right].vol)) {
+				pair_stack.push_back({ p.a, b.right });
+			}
+		}
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <concepts>
+#include "../math.h"
+
+// GJK finds the distance between two convex shapes from nothing but their support
+// functions, and EPA finds how deeply they penetrate when GJK finds that they
+// intersect. Unlike V-Clip, neither needs the shapes' topology, so they work for
+// curved shapes as well as polyhedra.
+namespace phys::gjk {
+	// A convex shape with a support function, which returns the point of the shape
+	// in world space that is furthest in the direction `dir`. `dir` isn't normalized.
+	template <typename T>
+	concept convex_shape = requires(const T &shape, const vec3 &dir) {
+		{ shape.support(dir) } -> std::convertible_to<vec3>;
+	};
+
+	// Refers to any `convex_shape`. The shape must outlive the reference.
+	class shape_ref {
+	public:
+		template <convex_shape T>
+		shape_ref(const T &_shape);
+
+		vec3 support(const vec3 &dir) const;
+
+	private:
+		const void * shape{};
+		vec3 (*support_func)(const void * shape, const vec3 &dir){};
+	};
+
+	inline constexpr size_t default_max_iterations = 64;
+
+	struct distance_result {
+		// True if the shapes overlap. The other fields are only set if they don't.
+		bool is_intersecting{};
+		real dist{};
+		// The closest points on each shape
+		vec3 point_a{};
+		vec3 point_b{};
+		size_t iterations{};
+	};
+
+	struct penetration_result {
+		// False if the shapes don't overlap. The other fields are only set if they
+		// do.
+		bool is_intersecting{};
+		// Points from `a` to `b`. Moving `b` along the normal by `depth` separates
+		// the shapes.
+		vec3 normal{};
+		real depth{};
+		// The points of each shape that are deepest inside the other shape
+		vec3 point_a{};
+		vec3 point_b{};
+		size_t iterations{};
+	};
+
+	distance_result distance(shape_ref a, shape_ref b, size_t max_iterations = default_max_iterations);
+	// Runs GJK, then EPA if the shapes intersect
+	penetration_result penetration(shape_ref a, shape_ref b, size_t max_iterations = default_max_iterations);
+}
+
+template <phys::gjk::convex_shape T>
+phys::gjk::shape_ref::shape_ref(const T &_shape) :
+	shape(&_shape),
+	support_func([](const void * s, const vec3 &dir) -> vec3 {
+		return static_cast<const T *>(s)->support(dir);
+	})
+{}
+
+inline phys::vec3 phys::gjk::shape_ref::support(const vec3 &dir) const {
+	return support_func(shape, dir);
+}
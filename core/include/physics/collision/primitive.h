@@ -1,12 +1,16 @@
 #pragma once
 #include "../math.h"
 #include "../rigid_body.h"
+#include "bounding_volumes.h"
 
 namespace phys {
 	enum class shape_type {
 		Sphere = 0,
 		Plane,
 		Box,
+		ConvexHull,
+		Capsule,
+		Cylinder,
 		// Not a primitive - indicates the end of known shape types. Consumers can implement
 		// their own shape types with `type` starting at `shape_type::Max`
 		Max
@@ -22,6 +26,9 @@ namespace phys {
 		virtual ~primitive() = default;
 
 		const mat4& get_inv_offset() const;
+		// Returns a world-space box around the primitive. Primitives that have no
+		// bounds, like planes, return a box with infinite extents.
+		virtual aabb get_bounds() const = 0;
 
 	protected:
 		primitive(
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+#include "primitive.h"
+
+namespace phys {
+	// Two primitives, used as a key by the caches that keep data for each pair of
+	// primitives from one frame to the next. The caches decide what order the
+	// primitives are stored in.
+	struct primitive_pair {
+		const primitive * a{};
+		const primitive * b{};
+
+		friend bool operator==(const primitive_pair &a, const primitive_pair &b) = default;
+	};
+
+	struct primitive_pair_hash {
+		size_t operator()(const primitive_pair &p) const;
+	};
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <span>
 #include "primitive.h"
 #include "vclip.h"
 
@@ -8,6 +9,12 @@ namespace phys {
 		real radius;
 
 		sphere(rigid_body * _body, const mat4 &_offset, real _radius);
+
+		aabb get_bounds() const override;
+
+		// Returns the point of the sphere in world space that is furthest in the
+		// direction `dir`
+		vec3 support(const vec3 &dir) const;
 	};
 
 	class plane : public primitive {
@@ -16,6 +23,8 @@ namespace phys {
 		real offset;
 
 		plane(rigid_body * _body, const vec3 &_normal, real _offset);
+
+		aabb get_bounds() const override;
 	};
 
 	class box : public primitive {
@@ -24,8 +33,100 @@ namespace phys {
 
 		box(rigid_body * _body, const mat4 &_offset, const vec3 &_half_size);
 
+		aabb get_bounds() const override;
+
+		// Returns the vertex of the box in world space that is furthest in the
+		// direction `dir`
+		vec3 support(const vec3 &dir) const;
+
 		// Converts the box to a VClip polyhedron. The polyhedron is expressed in
 		// world space.
 		vclip::polyhedron to_polyhedron() const;
+		// Returns the box as a VClip polyhedron in its own space, centered at the
+		// origin and aligned with the axes. It has the same features as the polyhedron
+		// returned by `to_polyhedron`. It's built with the box, and again only if
+		// `half_size` changes, so it isn't safe to change `half_size` while the box is
+		// being collided on another thread.
+		const vclip::polyhedron& get_local_polyhedron() const;
+
+	private:
+		mutable vclip::polyhedron local_polyhedron{};
+		mutable vec3 local_half_size{};
+	};
+
+	class thread_pool;
+
+	// A convex polyhedron, such as the hull of a mesh
+	class convex_hull : public primitive {
+	public:
+		// `_polyhedron` is in the primitive's own space. Throws `vclip::geometry_error`
+		// if it isn't a valid convex polyhedron.
+		convex_hull(rigid_body * _body, const mat4 &_offset, vclip::polyhedron _polyhedron);
+		// Builds the hull of `points` with `quickhull`
+		convex_hull(
+			rigid_body * _body,
+			const mat4 &_offset,
+			std::span<const vec3> points,
+			thread_pool * pool = nullptr
+		);
+
+		aabb get_bounds() const override;
+
+		// Returns the vertex of the hull in world space that is furthest in the
+		// direction `dir`
+		vec3 support(const vec3 &dir) const;
+
+		// Converts the hull to a VClip polyhedron in world space
+		vclip::polyhedron to_polyhedron() const;
+		// Returns the hull in its own space, with its adjacency compiled
+		const vclip::polyhedron& get_local_polyhedron() const;
+
+	private:
+		vclip::polyhedron local_polyhedron;
+	};
+
+	struct line_segment {
+		vec3 a{};
+		vec3 b{};
+	};
+
+	// A cylinder with hemispheres on each end: all of the points within `radius` of
+	// a line segment. The segment runs along the primitive's Y axis, from
+	// `-half_height` to `half_height`.
+	class capsule : public primitive {
+	public:
+		real radius;
+		real half_height;
+
+		capsule(rigid_body * _body, const mat4 &_offset, real _radius, real _half_height);
+
+		aabb get_bounds() const override;
+
+		// Returns the point of the capsule in world space that is furthest in the
+		// direction `dir`
+		vec3 support(const vec3 &dir) const;
+
+		// The capsule's line segment in world space
+		line_segment get_segment() const;
+	};
+
+	// A cylinder along the primitive's Y axis, from `-half_height` to `half_height`.
+	// This is the same shape as `shapes::make_cylinder` with a scale of
+	// `(2 * radius, 2 * half_height, 2 * radius)`.
+	class cylinder : public primitive {
+	public:
+		real radius;
+		real half_height;
+
+		cylinder(rigid_body * _body, const mat4 &_offset, real _radius, real _half_height);
+
+		aabb get_bounds() const override;
+
+		// Returns the point of the cylinder in world space that is furthest in the
+		// direction `dir`
+		vec3 support(const vec3 &dir) const;
+
+		// The line segment between the centers of the cylinder's caps, in world space
+		line_segment get_axis() const;
 	};
 }
@@ -0,0 +1,26 @@
+#pragma once
+#include <span>
+#include "../math.h"
+#include "vclip.h"
+
+namespace phys {
+	class thread_pool;
+
+	// With a thread pool, inputs with at least this many points are split into
+	// chunks whose hulls are built in parallel
+	inline constexpr size_t min_parallel_hull_points = 32768;
+
+	// Builds the convex hull of a set of points with Quickhull. Faces that are in the
+	// same plane are merged, so the hull of points scattered through a box has six
+	// quadrilateral faces, and points on the hull's faces or edges don't become
+	// vertices. The polyhedron is validated and its adjacency is compiled.
+	//
+	// With a thread pool, large inputs are split into chunks and the hull of each
+	// chunk is built on its own thread. Only the vertices of those hulls go into the
+	// final hull, so it's the same hull, although its features may be in a different
+	// order.
+	//
+	// Throws `std::invalid_argument` if there are fewer than four points, or if they
+	// are all in the same plane.
+	vclip::polyhedron quickhull(std::span<const vec3> points, thread_pool * pool = nullptr);
+}
@@ -0,0 +1,259 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <future>
+#include <vector>
+#include "bounding_volumes.h"
+
+namespace phys {
+	// A node in a BVH built by `sah_builder`. Nodes are laid out in depth-first order:
+	// the left child of an internal node immediately follows it, and the right child
+	// follows the left child's subtree. A subtree with N objects always takes up
+	// 2N - 1 nodes, so the position of every subtree is known before it's built and
+	// separate subtrees can be built in parallel without any synchronization.
+	template <buildable_volume Volume, typename Identifier>
+	struct sah_node {
+		Volume vol{};
+		Identifier id{};
+		// The index of the right child, or zero for a leaf. The root is at index zero
+		// and it's never a child, so zero can't be a valid right child.
+		uint32_t right{};
+
+		bool is_leaf() const;
+	};
+
+	// Builds a BVH top-down from a set of objects with a binned surface area
+	// heuristic. Objects are split along the axis in which their centroids are most
+	// spread out, at the bin boundary that minimizes the surface area of each half
+	// weighted by the number of objects in it.
+	template <buildable_volume Volume, typename Identifier>
+	class sah_builder {
+	public:
+		using node = sah_node<Volume, Identifier>;
+
+		// Subtrees with at least this many objects have their left half built on
+		// another thread
+		static inline constexpr size_t default_min_parallel_objects = 4096;
+
+		// Pass zero for `_min_parallel_objects` to build everything on the calling
+		// thread
+		explicit sah_builder(size_t _min_parallel_objects = default_min_parallel_objects);
+
+		void reserve(size_t num_objects);
+		void add(Identifier id, const Volume &vol);
+
+		// Builds the tree and clears the builder. The root is at index zero, and the
+		// tree is empty if no objects were added.
+		std::vector<node> build();
+
+	private:
+		static inline constexpr size_t num_bins = 16;
+		// Past this depth, objects are split at the median instead. This bounds the
+		// depth of the tree (and the recursion) when the heuristic keeps choosing very
+		// uneven splits.
+		static inline constexpr size_t max_sah_depth = 48;
+
+		struct item {
+			Identifier id{};
+			Volume vol{};
+			vec3 centroid{};
+		};
+
+		struct bin {
+			Volume vol{};
+			size_t count{};
+		};
+
+		std::vector<item> items{};
+		size_t min_parallel_objects{};
+
+		void build_subtree(std::vector<node> &nodes, size_t n, size_t begin, size_t end, size_t depth);
+		// Reorders the objects in `[begin, end)` and returns the index of the first
+		// object in the right half
+		size_t partition(size_t begin, size_t end, size_t depth);
+		size_t partition_at_median(size_t begin, size_t end, int axis);
+	};
+}
+
+template <phys::buildable_volume Volume, typename Identifier>
+bool phys::sah_node<Volume, Identifier>::is_leaf() const {
+	return right == 0;
+}
+
+template <phys::buildable_volume Volume, typename Identifier>
+phys::sah_builder<Volume, Identifier>::sah_builder(size_t _min_parallel_objects) :
+	min_parallel_objects(_min_parallel_objects) {}
+
+template <phys::buildable_volume Volume, typename Identifier>
+void phys::sah_builder<Volume, Identifier>::reserve(size_t num_objects) {
+	items.reserve(num_objects);
+}
+
+template <phys::buildable_volume Volume, typename Identifier>
+void phys::sah_builder<Volume, Identifier>::add(Identifier id, const Volume &vol) {
+	items.push_back(item{ id, vol, vol.centroid() });
+}
+
+template <phys::buildable_volume Volume, typename Identifier>
+std::vector<typename phys::sah_builder<Volume, Identifier>::node> phys::sah_builder<Volume, Identifier>::build() {
+	std::vector<node> nodes{};
+
+	if (items.empty()) {
+		return nodes;
+	}
+
+	assert(items.size() <= (UINT32_MAX / 2));
+
+	nodes.resize((2 * items.size()) - 1);
+	build_subtree(nodes, 0, 0, items.size(), 0);
+	items.clear();
+
+	return nodes;
+}
+
+template <phys::buildable_volume Volume, typename Identifier>
+void phys::sah_builder<Volume, Identifier>::build_subtree(
+	std::vector<node> &nodes,
+	size_t n,
+	size_t begin,
+	size_t end,
+	size_t depth
+) {
+	if (end - begin == 1) {
+		nodes[n].vol = items[begin].vol;
+		nodes[n].id = items[begin].id;
+		nodes[n].right = 0;
+		return;
+	}
+
+	const size_t mid = partition(begin, end, depth);
+	const size_t left = n + 1;
+	const size_t right = n + (2 * (mid - begin));
+
+	if (min_parallel_objects && (end - begin) >= min_parallel_objects) {
+		std::future<void> left_done = std::async(std::launch::async, [&, left, begin, mid, depth]() {
+			build_subtree(nodes, left, begin, mid, depth + 1);
+		});
+
+		build_subtree(nodes, right, mid, end, depth + 1);
+		left_done.get();
+	} else {
+		build_subtree(nodes, left, begin, mid, depth + 1);
+		build_subtree(nodes, right, mid, end, depth + 1);
+	}
+
+	nodes[n].vol = Volume(nodes[left].vol, nodes[right].vol);
+	nodes[n].id = Identifier{};
+	nodes[n].right = (uint32_t)right;
+}
+
+template <phys::buildable_volume Volume, typename Identifier>
+size_t phys::sah_builder<Volume, Identifier>::partition(size_t begin, size_t end, size_t depth) {
+	using namespace phys::literals;
+
+	vec3 centroid_min = items[begin].centroid;
+	vec3 centroid_max = items[begin].centroid;
+
+	for (size_t i = begin + 1; i < end; i++) {
+		centroid_min = glm::min(centroid_min, items[i].centroid);
+		centroid_max = glm::max(centroid_max, items[i].centroid);
+	}
+
+	const vec3 extent = centroid_max - centroid_min;
+	int axis = 0;
+
+	if (extent.y > extent[axis]) {
+		axis = 1;
+	}
+
+	if (extent.z > extent[axis]) {
+		axis = 2;
+	}
+
+	if (extent[axis] <= 0.0_r || depth >= max_sah_depth) {
+		return partition_at_median(begin, end, axis);
+	}
+
+	const real axis_min = centroid_min[axis];
+	const real scale = (real)num_bins / extent[axis];
+	const auto bin_index = [&](const item &it) {
+		size_t b = (size_t)((it.centroid[axis] - axis_min) * scale);
+
+		return std::min(b, num_bins - 1);
+	};
+
+	std::array<bin, num_bins> bins{};
+
+	for (size_t i = begin; i < end; i++) {
+		bin &b = bins[bin_index(items[i])];
+
+		b.vol = b.count ? Volume(b.vol, items[i].vol) : items[i].vol;
+		b.count++;
+	}
+
+	// `right_costs[i]` is the cost of the right half when the split is just before
+	// bin `i`
+	std::array<real, num_bins> right_costs{};
+	Volume right_vol{};
+	size_t right_count = 0;
+
+	for (size_t i = num_bins - 1; i > 0; i--) {
+		if (bins[i].count) {
+			right_vol = right_count ? Volume(right_vol, bins[i].vol) : bins[i].vol;
+			right_count += bins[i].count;
+		}
+
+		right_costs[i] = right_count ? right_vol.surface_area() * (real)right_count : 0.0_r;
+	}
+
+	Volume left_vol{};
+	size_t left_count = 0;
+	size_t best_split = 0;
+	real best_cost{};
+
+	for (size_t i = 1; i < num_bins; i++) {
+		if (bins[i - 1].count) {
+			left_vol = left_count ? Volume(left_vol, bins[i - 1].vol) : bins[i - 1].vol;
+			left_count += bins[i - 1].count;
+		}
+
+		if (! left_count || left_count == (end - begin)) {
+			continue;
+		}
+
+		const real cost = left_vol.surface_area() * (real)left_count + right_costs[i];
+
+		if (! best_split || cost < best_cost) {
+			best_split = i;
+			best_cost = cost;
+		}
+	}
+
+	if (! best_split) {
+		return partition_at_median(begin, end, axis);
+	}
+
+	auto mid = std::partition(std::begin(items) + begin, std::begin(items) + end, [&](const item &it) {
+		return bin_index(it) < best_split;
+	});
+
+	return (size_t)(mid - std::begin(items));
+}
+
+template <phys::buildable_volume Volume, typename Identifier>
+size_t phys::sah_builder<Volume, Identifier>::partition_at_median(size_t begin, size_t end, int axis) {
+	const size_t mid = begin + ((end - begin) / 2);
+
+	std::nth_element(
+		std::begin(items) + begin,
+		std::begin(items) + mid,
+		std::begin(items) + end,
+		[axis](const item &a, const item &b) {
+			return a.centroid[axis] < b.centroid[axis];
+		}
+	);
+
+	return mid;
+}
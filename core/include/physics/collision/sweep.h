@@ -0,0 +1,56 @@
+#pragma once
+#include <optional>
+#include "../math.h"
+#include "bounding_volumes.h"
+
+// Swept sphere tests for continuous collision detection. Each test moves a sphere
+// in a straight line over one step and finds the first moment in the step at which
+// it touches something. A sphere that moves further than its radius in one step can
+// skip over a thin object if only its start and end positions are tested; sweeping
+// it can't.
+namespace phys {
+	struct triangle {
+		vec3 a{};
+		vec3 b{};
+		vec3 c{};
+
+		aabb get_bounds() const;
+	};
+
+	struct sweep_hit {
+		// The fraction of the step at which the sphere first touches, in [0, 1]
+		real t{};
+		// The center of the moving sphere at time `t`
+		vec3 center{};
+		// The contact normal at time `t`. Points towards the moving sphere.
+		vec3 normal{};
+	};
+
+	// The bounds of a sphere swept from `start` to `end`
+	aabb swept_bounds(const vec3 &start, const vec3 &end, real radius);
+
+	vec3 closest_point_on_triangle(const vec3 &p, const triangle &tri);
+
+	// Sweeps a sphere from `start` to `end` against a triangle. Both sides of the
+	// triangle are solid. If the sphere already overlaps the triangle at `start`,
+	// it hits at `t = 0` if it's moving further in, and misses if it's moving out.
+	std::optional<sweep_hit> sweep_sphere_triangle(
+		const vec3 &start,
+		const vec3 &end,
+		real radius,
+		const triangle &tri
+	);
+
+	// Sweeps two spheres that are both moving, and finds when they first touch.
+	// The hit's center is the center of `a`, and its normal points from `b` to `a`.
+	// Spheres that already overlap at the start of the step hit at `t = 0` if they're
+	// moving closer together, and miss if they're moving apart.
+	std::optional<sweep_hit> sweep_spheres(
+		const vec3 &a_start,
+		const vec3 &a_end,
+		real a_radius,
+		const vec3 &b_start,
+		const vec3 &b_end,
+		real b_radius
+	);
+}
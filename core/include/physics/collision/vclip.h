@@ -1,11 +1,14 @@
 #pragma once
 #include <array>
+#include <memory>
 #include <optional>
 #include <ranges>
+#include <span>
 #include <stdexcept>
 #include <variant>
 #include <vector>
 #include "physics/math.h"
+#include "small_vector.h"
 #include "traits.h"
 #include "util.h"
 
@@ -23,6 +26,10 @@ namespace phys {
 		struct face;
 		struct vplane;
 
+		// The Voronoi planes of a feature. Most features have few enough planes that
+		// they fit in the set without allocating.
+		using vplane_set = util::small_vector<vplane, 8>;
+
 		template <typename T>
 		concept feature_t =
 			std::same_as<T, vertex> ||
@@ -42,6 +49,8 @@ namespace phys {
 			std::ranges::view auto edges(const polyhedron &p) const && = delete;
 
 			std::vector<vplane> ve_planes(const polyhedron &p) const;
+			// Replaces the contents of `out` with the vertex's V-E planes
+			void ve_planes(const polyhedron &p, vplane_set &out) const;
 
 			friend bool operator==(const vertex &v1, const vertex &v2);
 		};
@@ -65,6 +74,9 @@ namespace phys {
 
 			std::vector<vplane> ve_planes(const polyhedron &p) const;
 			std::vector<vplane> fe_planes(const polyhedron &p) const;
+			// These replace the contents of `out` with the edge's planes
+			void ve_planes(const polyhedron &p, vplane_set &out) const;
+			void fe_planes(const polyhedron &p, vplane_set &out) const;
 
 			bool has_vertex(size_t i) const;
 
@@ -85,6 +97,9 @@ namespace phys {
 		struct face_cut_result;
 
 		struct face {
+			// Faces with at most this many vertices can be copied without allocating
+			static inline constexpr size_t max_inline_verts = 8;
+
 			// TODO: Make Unspecified the default and make Convex explicit
 			// in the VClip code
 			face(const std::vector<size_t> &_vs, convexity _convexity_hint = convexity::Convex);
@@ -92,11 +107,13 @@ namespace phys {
 			// Returns a view that will yield neighboring vertices
 			std::ranges::view auto vertices(const polyhedron &p) const &;
 			std::ranges::view auto vertices(const polyhedron &p) const && = delete;
-			// Returns a range that will yield neighboring edges
-			std::ranges::range auto edges() const &;
-			std::ranges::range auto edges() const && = delete;
+			// Returns a view that will yield neighboring edges
+			std::ranges::view auto edges() const &;
+			std::ranges::view auto edges() const && = delete;
 
 			std::vector<vplane> fe_planes(const polyhedron &p) const;
+			// Replaces the contents of `out` with the face's F-E planes
+			void fe_planes(const polyhedron &p, vplane_set &out) const;
 
 			bool has_edge(const edge &e) const;
 			bool has_vertex(size_t i) const;
@@ -105,7 +122,7 @@ namespace phys {
 			// vertex array. The winding order of the vertices determines the
 			// orientation of the face; the face normal points in the direction for
 			// which the vertices wind counter-clockwise.
-			const std::vector<size_t>& verts() const;
+			std::span<const size_t> verts() const;
 
 			inline size_t vert(size_t vert_idx) const {
 				assert(vert_idx < vs.size());
@@ -162,7 +179,7 @@ namespace phys {
 			friend polyhedron add(const polyhedron &p1, const polyhedron &p2);
 
 		private:
-			std::vector<size_t> vs;
+			util::small_vector<size_t, max_inline_verts> vs;
 			mutable vec3 norm{};
 			convexity convexity_hint;
 			mutable bool norm_needs_update{ true };
@@ -175,6 +192,40 @@ namespace phys {
 
 		using feature = std::variant<vertex, edge, face>;
 
+		// The neighbors of every feature of a polyhedron, and the directions of the
+		// Voronoi planes between them. Without these, finding a vertex's edges or an
+		// edge's faces means searching every edge or face of the polyhedron.
+		struct adjacency {
+			// The two faces on either side of an edge, in the order that they appear
+			// in the polyhedron
+			struct edge_faces {
+				std::array<size_t, 2> faces{};
+				// The edge, with its vertices in CCW order around each face
+				std::array<edge, 2> ccw_edges{ edge(0, 0), edge(0, 0) };
+				// The directions of the F-E planes between each face and the edge
+				std::array<vec3, 2> plane_dirs{};
+			};
+
+			// The edges around vertex `i` are at `[vertex_edge_offsets[i], vertex_edge_offsets[i + 1])`
+			// in `vertex_edges`, in the order that they appear in the polyhedron. The
+			// direction of the V-E plane between the vertex and each edge is at the same
+			// position in `vertex_plane_dirs`.
+			std::vector<size_t> vertex_edge_offsets{};
+			std::vector<size_t> vertex_edges{};
+			std::vector<vec3> vertex_plane_dirs{};
+			std::vector<edge_faces> edge_neighbors{};
+			// The edges of face `i` are at `[face_edge_offsets[i], face_edge_offsets[i + 1])`
+			// in `face_edges`, in CCW order. The direction of the F-E plane between the
+			// face and each edge is at the same position in `face_plane_dirs`.
+			std::vector<size_t> face_edge_offsets{};
+			std::vector<edge> face_edges{};
+			std::vector<vec3> face_plane_dirs{};
+
+			// These return `SIZE_MAX` if the feature isn't part of `p`
+			size_t edge_index(const polyhedron &p, const edge &e) const;
+			size_t face_index(const polyhedron &p, const face &f) const;
+		};
+
 		// A collection of features, defined with reference to a set of vertices.
 		// A polyhedron must be convex. `validate()` will verify that the polyhedron
 		// is convex and closed.
@@ -182,9 +233,20 @@ namespace phys {
 			std::vector<vertex> vertices{};
 			std::vector<edge> edges{};
 			std::vector<face> faces{};
+			// Set by `compile_adjacency`. The member functions that change the polyhedron
+			// clear it, but code that changes `vertices`, `edges` or `faces` directly
+			// must call `invalidate_adjacency`.
+			std::shared_ptr<const adjacency> adjacency_table{};
 
 			int euler_characteristic() const;
 
+			// Precomputes the neighbors of every feature and the directions of their
+			// Voronoi planes, which makes each step of V-Clip independent of the size of
+			// the polyhedron. The polyhedron must be closed. Translating the polyhedron
+			// doesn't change the directions, so translated copies keep the table.
+			void compile_adjacency();
+			void invalidate_adjacency();
+
 			void validate() const;
 			void validate_references() const;
 			void validate_geometry() const;
@@ -228,8 +290,9 @@ namespace phys {
 			polyhedron group(const feature &feat) const;
 			polyhedron translated(const vec3 &v) const;
 
-			std::ranges::range auto features() const &;
-			std::ranges::range auto features() const && = delete;
+			// Returns a view that will yield every vertex, then every edge, then every face
+			std::ranges::view auto features() const &;
+			std::ranges::view auto features() const && = delete;
 
 			void clear();
 
@@ -267,6 +330,8 @@ namespace phys {
 		};
 
 		std::vector<vplane> vplanes(const polyhedron &p, const feature &f);
+		// Replaces the contents of `out` with the Voronoi planes of `f`
+		void vplanes(const polyhedron &p, const feature &f, vplane_set &out);
 
 		enum class algorithm_step {
 			Continue,
@@ -291,11 +356,15 @@ namespace phys {
 
 		// The result of running the algorithm for two convex polyhedra. At termination,
 		// `state.step` will either be `Done` or `Penetration`. The algorithm only reports
-		// penetration for a vertex and a face, or an edge and a face.
+		// penetration for a vertex and a face, or an edge and a face. If the algorithm
+		// is stopped early, because it ran for `max_steps` or because it went back and
+		// forth between two pairs of features, `state.step` is still `Continue`.
 		struct algorithm_result {
 			const polyhedron &p1;
 			const polyhedron &p2;
 			algorithm_state state;
+			// The number of times the state was updated before the algorithm stopped
+			size_t steps{};
 
 			algorithm_result(
 				const polyhedron &_p1,
@@ -346,6 +415,20 @@ namespace phys {
 			const feature &_f2,
 			size_t max_steps = SIZE_MAX
 		);
+		// Like the function above, but `p2` is in its own space, and `p2_to_p1` is a
+		// rigid transform from that space to the space of `p1`. Neither polyhedron is
+		// copied or transformed, so both keep their adjacency tables. Instead, each
+		// vertex or edge is moved into the other polyhedron's space when it's tested
+		// against that polyhedron's Voronoi planes. The features in the result are in
+		// their own polyhedron's space.
+		algorithm_result closest_features(
+			const polyhedron &p1,
+			const polyhedron &p2,
+			const mat4 &p2_to_p1,
+			const feature &_f1,
+			const feature &_f2,
+			size_t max_steps = SIZE_MAX
+		);
 
 		struct clip_result {
 			edge e;
@@ -375,7 +458,7 @@ namespace phys {
 			const polyhedron &p_e,
 			const edge &e,
 			const feature &f,
-			const std::vector<vplane> &vps,
+			std::span<const vplane> vps,
 			std::optional<clip_result> prev_result = {}
 		);
 
@@ -424,18 +507,23 @@ namespace traits {
 	std::string to_string(const phys::vclip::algorithm_result &result, size_t indent);
 }
 
-inline std::ranges::range auto phys::vclip::polyhedron::features() const & {
-	auto to_feature =
-		[&]<typename T>(const T &t) {
-			return feature(t);
-		};
+inline std::ranges::view auto phys::vclip::polyhedron::features() const & {
+	const size_t num_features = vertices.size() + edges.size() + faces.size();
+
+	return std::ranges::views::iota((size_t)0, num_features) | std::ranges::views::transform(
+		[this](size_t i) {
+			if (i < vertices.size()) {
+				return feature(vertices[i]);
+			}
+
+			i -= vertices.size();
 
-	return util::concat_views(
-		vertices | std::ranges::views::transform(to_feature),
-		util::concat_views(
-			edges | std::ranges::views::transform(to_feature),
-			faces | std::ranges::views::transform(to_feature)
-		)
+			if (i < edges.size()) {
+				return feature(edges[i]);
+			}
+
+			return feature(faces[i - edges.size()]);
+		}
 	);
 }
 
@@ -472,13 +560,10 @@ inline std::ranges::view auto phys::vclip::face::vertices(const polyhedron &p) c
 	);
 }
 
-inline std::ranges::range auto phys::vclip::face::edges() const & {
-	return util::concat_views(
-		vs | std::ranges::views::slide(2) | std::ranges::views::transform(
-			[&](const auto &vs) {
-				return edge(vs[0], vs[1]);
-			}
-		),
-		std::ranges::owning_view(std::vector({ edge(vs[vs.size() - 1], vs[0])}))
+inline std::ranges::view auto phys::vclip::face::edges() const & {
+	return std::ranges::views::iota((size_t)0, vs.size()) | std::ranges::views::transform(
+		[this](size_t i) {
+			return edge(vs[i], vs[(i + 1) % vs.size()]);
+		}
 	);
 }
\ No newline at end of file
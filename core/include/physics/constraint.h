@@ -1,6 +1,13 @@
 #pragma once
 #include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <new>
+#include <optional>
+#include <span>
+#include <utility>
 #include <vector>
 #include "math.h"
 #include "particle.h"
@@ -11,9 +18,26 @@ namespace phys {
 		Inequality
 	};
 
+	// How a `particle_world` projects its constraints
+	enum class solver_mode {
+		// Position based dynamics. Each constraint's `stiffness` is spread over the
+		// solver iterations, so how stiff a constraint is depends on the number of
+		// iterations and on the timestep.
+		PBD,
+		// Extended position based dynamics. Each constraint's `compliance` is used
+		// instead of its stiffness, and a Lagrange multiplier is accumulated over the
+		// iterations of a step. How stiff a constraint is doesn't depend on the
+		// number of iterations or on the timestep.
+		XPBD
+	};
+
 	class constraint {
 	public:
 		real stiffness;
+		// The inverse of stiffness, used in XPBD mode. A compliance of zero makes the
+		// constraint perfectly stiff. A constraint without a compliance gets one from
+		// `stiffness` (see `get_xpbd_alpha`).
+		std::optional<real> compliance{};
 		constraint_type type;
 
 		constraint(real _stiffness, constraint_type _type);
@@ -22,16 +46,102 @@ namespace phys {
 		virtual real eval_constraint() const = 0;
 
 		virtual void project(real inv_solver_iterations) = 0;
+		// Projects the constraint with XPBD. `dt` is the length of the step. The
+		// default projects the constraint as if it were solved with PBD in one
+		// iteration.
+		virtual void project_xpbd(real dt);
+		// Resets the Lagrange multiplier that XPBD accumulates over the iterations of
+		// a step
+		virtual void reset_lambda();
 		virtual void update_velocities(real dt) = 0;
+		// The particles that are moved when the constraint is projected
+		virtual std::span<particle * const> get_particles() const = 0;
 
+		// How far the constraint is from being satisfied, which is zero if it's
+		// satisfied
+		real get_error() const;
 		bool is_satisfied() const;
+
+	protected:
+		// The compliance scaled by the timestep, for a constraint whose particles have
+		// a combined inverse mass of `w` along the gradient. Without a compliance,
+		// the result is chosen so that one XPBD iteration corrects the same fraction
+		// of the error as one PBD iteration with `stiffness` would, which makes a
+		// stiffness of one perfectly stiff. A stiffness of zero or less gives
+		// infinity, and the constraint should not be projected.
+		real get_xpbd_alpha(real dt, real w) const;
+
+	private:
+		friend class particle_world;
+
+		// Set by `particle_world` for its solver stats: zero for fixed constraints,
+		// and `i + 1` for the constraints made by its `i`th constraint generator
+		uint32_t source{};
+	};
+
+	// Holds constraints that only live for one frame, like collision constraints.
+	// Constraints are constructed in large blocks of memory, and clearing the arena
+	// destroys them but keeps the blocks for the next frame. Once the arena has
+	// grown to fit a frame's constraints, creating constraints doesn't allocate.
+	class constraint_arena {
+	public:
+		using iterator = std::vector<constraint *>::const_iterator;
+
+		explicit constraint_arena(size_t _block_size = default_block_size);
+		constraint_arena(const constraint_arena&) = delete;
+		constraint_arena& operator=(const constraint_arena&) = delete;
+		~constraint_arena();
+
+		template <std::derived_from<constraint> T, typename... Args>
+		T * emplace(Args&&... args);
+
+		// Destroys every constraint in the arena
+		void clear();
+		// Destroys the constraints for which `pred(c)` is true. The order of the other
+		// constraints is kept. Their memory isn't reused until the arena is cleared.
+		template <typename F>
+		void erase_if(F &&pred);
+		size_t size() const;
+		bool empty() const;
+
+		iterator begin() const;
+		iterator end() const;
+		constraint * operator[](size_t i) const;
+
+		static inline constexpr size_t default_block_size = 64 * 1024;
+
+	private:
+#ifdef DEBUG
+	public:
+#endif
+		struct block {
+			std::unique_ptr<std::byte[]> data{};
+			size_t size{};
+		};
+
+		std::vector<block> blocks{};
+		std::vector<constraint *> constraints{};
+		size_t block_size;
+		size_t current_block{};
+		size_t offset{};
+
+		void * allocate(size_t size, size_t align);
 	};
 
 	class constraint_generator {
 	public:
 		virtual ~constraint_generator() = default;
 
-		virtual void generate_constraints(real dt, std::vector<std::unique_ptr<constraint>> &constraints) = 0;
+		virtual void generate_constraints(real dt, constraint_arena &constraints) = 0;
+
+		// Called by `particle_world::step` before the first substep of a frame that is
+		// `frame_dt` long. A generator can find every pair of objects that might
+		// touch at any point in the frame here, with bounds that are expanded by how
+		// far the objects can move, so that `generate_constraints` only needs to
+		// check those pairs in each substep.
+		virtual void begin_frame(real frame_dt);
+		// Called after the last substep of a frame
+		virtual void end_frame();
 	};
 
 	template <const size_t N>
@@ -49,7 +159,10 @@ namespace phys {
 		virtual real eval_constraint() const = 0;
 		virtual vec3 eval_gradient(const particle &p) const = 0;
 		void project(real inv_solver_iterations) override;
+		void project_xpbd(real dt) override;
+		void reset_lambda() override;
 		virtual void update_velocities(real dt) = 0;
+		std::span<particle * const> get_particles() const override;
 
 		phys::particle * a() requires (N >= 1);
 		phys::particle * b() requires (N >= 2);
@@ -59,9 +172,34 @@ namespace phys {
 
 	private:
 		std::array<vec3, N> dps{};
+		real lambda{};
 	};
 }
 
+template <std::derived_from<phys::constraint> T, typename... Args>
+T * phys::constraint_arena::emplace(Args&&... args) {
+	static_assert(alignof(T) <= alignof(std::max_align_t));
+
+	T * out = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+
+	constraints.push_back(out);
+
+	return out;
+}
+
+template <typename F>
+void phys::constraint_arena::erase_if(F &&pred) {
+	std::erase_if(constraints, [&](constraint * c) {
+		if (! pred(c)) {
+			return false;
+		}
+
+		c->~constraint();
+
+		return true;
+	});
+}
+
 template <const size_t N>
 phys::particle_constraint<N>::particle_constraint(
 	real _stiffness,
@@ -103,6 +241,58 @@ void phys::particle_constraint<N>::project(real inv_solver_iterations) {
 	}
 }
 
+template <const size_t N>
+void phys::particle_constraint<N>::project_xpbd(real dt) {
+	using namespace phys::literals;
+
+	if constexpr (N == 0) {
+		return;
+	}
+
+	real w = 0.0_r;
+
+	for (size_t i = 0; i < N; i++) {
+		particle &p = *particles[i];
+		vec3 grad = eval_gradient(p);
+
+		w += (p.get_inv_mass() * phys::dot(grad, grad));
+		dps[i] = p.get_inv_mass() * grad;
+	}
+
+	const real alpha = get_xpbd_alpha(dt, w);
+
+	if (w == 0.0_r || alpha == infinity) {
+		return;
+	}
+
+	real d_lambda = (-eval_constraint() - alpha * lambda) / (w + alpha);
+
+	// An inequality constraint can only push its particles apart. Clamping the
+	// total over the step instead of each correction lets it undo a push that
+	// turned out to be too large, without ever pulling.
+	if (type == constraint_type::Inequality && lambda + d_lambda < 0.0_r) {
+		d_lambda = -lambda;
+	}
+
+	lambda += d_lambda;
+
+	for (size_t i = 0; i < N; i++) {
+		particles[i]->p += dps[i] * d_lambda;
+	}
+}
+
+template <const size_t N>
+void phys::particle_constraint<N>::reset_lambda() {
+	using namespace phys::literals;
+
+	lambda = 0.0_r;
+}
+
+template <const size_t N>
+std::span<phys::particle * const> phys::particle_constraint<N>::get_particles() const {
+	return particles;
+}
+
 template <const size_t N>
 phys::particle * phys::particle_constraint<N>::a() requires (N >= 1) {
 	return particles[0];
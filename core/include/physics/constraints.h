@@ -1,4 +1,13 @@
 #pragma once
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include "collision/flat_bvh.h"
+#include "collision/sweep.h"
 #include "constraint.h"
 
 namespace phys {
@@ -52,7 +61,7 @@ namespace phys {
 			real _friction
 		);
 
-		void generate_constraints(real dt, std::vector<std::unique_ptr<constraint>> &constraints) override;
+		void generate_constraints(real dt, constraint_arena &constraints) override;
 
 	private:
 		particle_container &particles;
@@ -66,6 +75,9 @@ namespace phys {
 	public:
 		real restitution;
 		real friction;
+		// If set, the particles are kept apart along this normal instead of along
+		// the line between them. Points from `b` to `a`.
+		std::optional<vec3> normal;
 
 		particle_collision_constraint(
 			particle * _a,
@@ -73,6 +85,16 @@ namespace phys {
 			real _restitution,
 			real _friction
 		);
+		// For particles that were swept into each other. By the end of the step,
+		// they may have passed each other's centers, so the line between them
+		// can't be used as the normal. `_normal` is the normal at the time of impact.
+		particle_collision_constraint(
+			particle * _a,
+			particle * _b,
+			vec3 _normal,
+			real _restitution,
+			real _friction
+		);
 
 		real eval_constraint() const override;
 		vec3 eval_gradient(const particle &p) const override;
@@ -84,6 +106,147 @@ namespace phys {
 		vec3 a_old_pos;
 		vec3 b_old_pos;
 	};
+
+	// A particle filter that accepts every particle
+	struct all_particles {
+		bool operator()(size_t) const;
+	};
+
+	// Generates a `particle_collision_constraint` for every pair of overlapping
+	// particles. Particles are binned into a spatial hash of cells as wide as the
+	// largest particle, so only particles in neighboring cells are tested against
+	// each other. `particle_filter` is called with the index of each particle in the
+	// container and can exclude particles from collision detection.
+	//
+	// With continuous collision detection, particles that move further than their
+	// radius in one step are swept from their positions to their predicted
+	// positions instead, so that they can't pass through each other. The swept
+	// particles are put in a BVH of the volumes that they sweep through, and every
+	// particle is tested against it.
+	template <typename particle_container, typename particle_filter = all_particles>
+	class particle_collision_constraint_generator : public constraint_generator {
+	public:
+		// Enables continuous collision detection
+		bool continuous{};
+
+		particle_collision_constraint_generator(
+			particle_container &_particles,
+			real _restitution,
+			real _friction,
+			particle_filter _filter = {}
+		);
+
+		void generate_constraints(real dt, constraint_arena &constraints) override;
+		// Finds every pair of particles that could touch during the frame, which
+		// `generate_constraints` then checks in each substep instead of searching
+		// the spatial hash again
+		void begin_frame(real frame_dt) override;
+		void end_frame() override;
+
+		// Calls `f(a, b)` for every pair of particles whose predicted positions
+		// overlap. `a` always comes before `b` in the container. If
+		// `skip_sleeping_pairs` is true, pairs of sleeping particles are skipped
+		// without being tested.
+		template <typename F>
+		void for_each_overlapping_pair(F &&f, bool skip_sleeping_pairs = false);
+
+	private:
+		struct cell {
+			int32_t x{};
+			int32_t y{};
+			int32_t z{};
+
+			friend bool operator==(const cell &a, const cell &b) = default;
+		};
+
+		struct cell_entry {
+			cell c{};
+			uint32_t particle{};
+		};
+
+		particle_container &particles;
+		real restitution;
+		real friction;
+		particle_filter filter;
+
+		// These are kept between frames so that the spatial hash doesn't allocate
+		// once it has grown to fit every particle
+		std::vector<particle *> candidates{};
+		std::vector<cell> cells{};
+		std::vector<uint32_t> bucket_ends{};
+		std::vector<cell_entry> entries{};
+
+		using swept_bvh = flat_bvh<aabb, uint32_t>;
+
+		std::vector<std::pair<uint32_t, aabb>> swept_volumes{};
+		std::vector<typename swept_bvh::coarse_collision_pair> swept_pairs{};
+		swept_bvh swept_particles{};
+
+		// The pairs found by `begin_frame`
+		std::vector<std::pair<particle *, particle *>> candidate_pairs{};
+		bool has_candidates{};
+
+		// Calls `f(a, b)` for every pair of particles whose spheres overlap, where
+		// `center(p)` and `radius(p)` give a particle's sphere. `a` always comes
+		// before `b` in the container. If `skip_sleeping_pairs` is true, pairs of
+		// sleeping particles are skipped: only awake particles are put in the spatial
+		// hash, and sleeping particles only look for awake neighbors in it.
+		template <typename Center, typename Radius, typename F>
+		void for_each_overlapping_sphere(Center &&center, Radius &&radius, F &&f, bool skip_sleeping_pairs = false);
+
+		// Calls `f(a, b)` for every pair of particles with at least one fast particle
+		// whose swept volumes overlap. `a` always comes before `b` in the container.
+		template <typename F>
+		void for_each_fast_pair(F &&f);
+
+		// Generates a constraint for a pair of candidate particles if they touch in
+		// this step
+		void collide(particle &a, particle &b, constraint_arena &constraints);
+
+		static size_t hash(const cell &c, size_t mask);
+		// True if the particle moves further than its radius in one step
+		static bool is_fast(const particle &p);
+	};
+
+	// Generates collision constraints between particles and static triangles, like
+	// the floors and walls of a level. The triangles are put in a BVH when the
+	// generator is created. Every particle is swept from its position to its
+	// predicted position, so a particle that would pass through a triangle in one
+	// step collides with it where it first touched it. The constraint keeps the
+	// particle on the near side of the tangent plane at the point of impact.
+	template <typename particle_container>
+	class static_mesh_collision_constraint_generator : public constraint_generator {
+	public:
+		static_mesh_collision_constraint_generator(
+			particle_container &_particles,
+			std::vector<triangle> _triangles,
+			real _restitution,
+			real _friction
+		);
+
+		void generate_constraints(real dt, constraint_arena &constraints) override;
+		// Finds the triangles that each particle could touch during the frame, so
+		// that the BVH is only searched once per frame
+		void begin_frame(real frame_dt) override;
+		void end_frame() override;
+
+	private:
+		particle_container &particles;
+		std::vector<triangle> triangles;
+		flat_bvh<aabb, uint32_t> tree{};
+		real restitution;
+		real friction;
+
+		// Each particle's candidate triangles, found by `begin_frame`. The
+		// triangles of each particle are next to each other.
+		std::vector<std::pair<particle *, uint32_t>> candidates{};
+		bool has_candidates{};
+
+		// Generates a constraint for the first triangle that the particle hits.
+		// `for_each_triangle(f)` calls `f` with the index of each triangle to test.
+		template <typename F>
+		void collide(particle &p, F &&for_each_triangle, constraint_arena &constraints);
+	};
 }
 
 template <typename particle_container>
@@ -104,19 +267,463 @@ phys::plane_collision_constraint_generator<particle_container>::plane_collision_
 template <typename particle_container>
 void phys::plane_collision_constraint_generator<particle_container>::generate_constraints(
 	real,
-	std::vector<std::unique_ptr<constraint>> &constraints
+	constraint_arena &constraints
 ) {
 	using namespace phys::literals;
 
 	for (particle &p : particles) {
-		if (phys::dot(p.p - origin, normal) < 0.0_r) {
-			constraints.push_back(std::make_unique<phys::plane_collision_constraint>(
+		// Sleeping particles don't move, so they can't move into the plane
+		if (! p.is_asleep() && phys::dot(p.p - origin, normal) < 0.0_r) {
+			constraints.emplace<phys::plane_collision_constraint>(
 				&p,
 				normal,
 				origin,
 				restitution,
 				friction
-			));
+			);
+		}
+	}
+}
+
+template <typename particle_container, typename particle_filter>
+phys::particle_collision_constraint_generator<particle_container, particle_filter>::particle_collision_constraint_generator(
+	particle_container &_particles,
+	real _restitution,
+	real _friction,
+	particle_filter _filter
+) :
+	particles(_particles),
+	restitution(_restitution),
+	friction(_friction),
+	filter(_filter)
+{}
+
+template <typename particle_container, typename particle_filter>
+void phys::particle_collision_constraint_generator<particle_container, particle_filter>::generate_constraints(
+	real,
+	constraint_arena &constraints
+) {
+	if (has_candidates) {
+		for (const auto &[a, b] : candidate_pairs) {
+			collide(*a, *b, constraints);
+		}
+
+		return;
+	}
+
+	if (! continuous) {
+		for_each_overlapping_pair([&](particle &a, particle &b) {
+			constraints.emplace<phys::particle_collision_constraint>(
+				&a,
+				&b,
+				restitution,
+				friction
+			);
+		}, true);
+
+		return;
+	}
+
+	for_each_overlapping_pair([&](particle &a, particle &b) {
+		// Pairs with a fast particle are handled below
+		if (is_fast(a) || is_fast(b)) {
+			return;
+		}
+
+		constraints.emplace<phys::particle_collision_constraint>(
+			&a,
+			&b,
+			restitution,
+			friction
+		);
+	}, true);
+
+	for_each_fast_pair([&](particle &a, particle &b) {
+		collide(a, b, constraints);
+	});
+}
+
+template <typename particle_container, typename particle_filter>
+void phys::particle_collision_constraint_generator<particle_container, particle_filter>::begin_frame(real frame_dt) {
+	candidate_pairs.clear();
+
+	for_each_overlapping_sphere(
+		[](const particle &p) -> const vec3& {
+			return p.pos;
+		},
+		[=](const particle &p) {
+			return p.radius + p.max_travel(frame_dt);
+		},
+		[&](particle &a, particle &b) {
+			candidate_pairs.push_back({ &a, &b });
 		}
+	);
+
+	has_candidates = true;
+}
+
+template <typename particle_container, typename particle_filter>
+void phys::particle_collision_constraint_generator<particle_container, particle_filter>::end_frame() {
+	candidate_pairs.clear();
+	has_candidates = false;
+}
+
+template <typename particle_container, typename particle_filter>
+void phys::particle_collision_constraint_generator<particle_container, particle_filter>::collide(
+	particle &a,
+	particle &b,
+	constraint_arena &constraints
+) {
+	if (a.is_asleep() && b.is_asleep()) {
+		return;
+	}
+
+	if (continuous && (is_fast(a) || is_fast(b))) {
+		const std::optional<sweep_hit> hit = sweep_spheres(a.pos, a.p, a.radius, b.pos, b.p, b.radius);
+
+		if (hit) {
+			constraints.emplace<phys::particle_collision_constraint>(
+				&a,
+				&b,
+				hit->normal,
+				restitution,
+				friction
+			);
+
+			return;
+		}
+
+		// The particles can miss each other while they're moving apart and still
+		// overlap at the end of the step
+	}
+
+	const vec3 diff = a.p - b.p;
+	const real min_dist = a.radius + b.radius;
+
+	if (phys::dot(diff, diff) < min_dist * min_dist) {
+		constraints.emplace<phys::particle_collision_constraint>(
+			&a,
+			&b,
+			restitution,
+			friction
+		);
+	}
+}
+
+template <typename particle_container, typename particle_filter>
+template <typename F>
+void phys::particle_collision_constraint_generator<particle_container, particle_filter>::for_each_overlapping_pair(F &&f, bool skip_sleeping_pairs) {
+	for_each_overlapping_sphere(
+		[](const particle &p) -> const vec3& {
+			return p.p;
+		},
+		[](const particle &p) {
+			return p.radius;
+		},
+		f,
+		skip_sleeping_pairs
+	);
+}
+
+template <typename particle_container, typename particle_filter>
+template <typename Center, typename Radius, typename F>
+void phys::particle_collision_constraint_generator<particle_container, particle_filter>::for_each_overlapping_sphere(
+	Center &&center,
+	Radius &&radius,
+	F &&f,
+	bool skip_sleeping_pairs
+) {
+	using namespace phys::literals;
+
+	candidates.clear();
+
+	real max_radius = 0.0_r;
+	size_t i = 0;
+
+	for (particle &p : particles) {
+		if (filter(i++)) {
+			candidates.push_back(&p);
+			max_radius = std::max(max_radius, radius(p));
+		}
+	}
+
+	const size_t num_candidates = candidates.size();
+
+	if (num_candidates < 2 || max_radius <= 0.0_r) {
+		return;
+	}
+
+	assert(num_candidates <= UINT32_MAX);
+
+	// Two particles can only overlap if they're less than one cell apart
+	const real inv_cell_size = 1.0_r / (2.0_r * max_radius);
+	const size_t num_buckets = std::bit_ceil(2 * num_candidates);
+	const size_t mask = num_buckets - 1;
+
+	const auto is_hashed = [&](size_t k) {
+		return ! skip_sleeping_pairs || ! candidates[k]->is_asleep();
+	};
+
+	cells.resize(num_candidates);
+	bucket_ends.assign(num_buckets, 0);
+
+	size_t num_hashed = 0;
+
+	for (size_t k = 0; k < num_candidates; k++) {
+		const vec3 &p = center(*candidates[k]);
+
+		cells[k] = cell{
+			(int32_t)std::floor(p.x * inv_cell_size),
+			(int32_t)std::floor(p.y * inv_cell_size),
+			(int32_t)std::floor(p.z * inv_cell_size)
+		};
+
+		if (is_hashed(k)) {
+			bucket_ends[hash(cells[k], mask)]++;
+			num_hashed++;
+		}
+	}
+
+	if (! num_hashed) {
+		return;
+	}
+
+	entries.resize(num_hashed);
+
+	// Counting sort: each bucket's count becomes its starting offset, and filling
+	// the bucket advances the offset to the end of the bucket
+	uint32_t offset = 0;
+
+	for (uint32_t &bucket : bucket_ends) {
+		uint32_t count = bucket;
+
+		bucket = offset;
+		offset += count;
+	}
+
+	for (size_t k = 0; k < num_candidates; k++) {
+		if (is_hashed(k)) {
+			entries[bucket_ends[hash(cells[k], mask)]++] = cell_entry{ cells[k], (uint32_t)k };
+		}
+	}
+
+	for (size_t k = 0; k < num_candidates; k++) {
+		particle &a = *candidates[k];
+		const cell &c = cells[k];
+		// A particle that isn't in the hash can't be found by the particles before
+		// it, so it looks for every neighbor instead of only the ones after it
+		const uint32_t first = is_hashed(k) ? (uint32_t)(k + 1) : 0;
+
+		for (int32_t dx = -1; dx <= 1; dx++) {
+			for (int32_t dy = -1; dy <= 1; dy++) {
+				for (int32_t dz = -1; dz <= 1; dz++) {
+					const cell neighbor{ c.x + dx, c.y + dy, c.z + dz };
+					const size_t bucket = hash(neighbor, mask);
+					const uint32_t begin = bucket ? bucket_ends[bucket - 1] : 0;
+					const uint32_t end = bucket_ends[bucket];
+
+					for (uint32_t e = begin; e < end; e++) {
+						// Different cells can share a bucket, so the cell is checked to
+						// make sure that each pair is only visited once
+						if (entries[e].particle < first || entries[e].particle == k || entries[e].c != neighbor) {
+							continue;
+						}
+
+						particle &b = *candidates[entries[e].particle];
+						const vec3 diff = center(a) - center(b);
+						const real min_dist = radius(a) + radius(b);
+
+						if (phys::dot(diff, diff) >= min_dist * min_dist) {
+							continue;
+						}
+
+						if (entries[e].particle < k) {
+							f(b, a);
+						} else {
+							f(a, b);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+template <typename particle_container, typename particle_filter>
+template <typename F>
+void phys::particle_collision_constraint_generator<particle_container, particle_filter>::for_each_fast_pair(F &&f) {
+	candidates.clear();
+	swept_volumes.clear();
+
+	size_t i = 0;
+
+	for (particle &p : particles) {
+		if (filter(i++)) {
+			if (is_fast(p)) {
+				swept_volumes.push_back({ (uint32_t)candidates.size(), swept_bounds(p.pos, p.p, p.radius) });
+			}
+
+			candidates.push_back(&p);
+		}
+	}
+
+	if (swept_volumes.empty()) {
+		return;
+	}
+
+	assert(candidates.size() <= UINT32_MAX);
+
+	swept_particles.build(swept_volumes);
+	swept_pairs.clear();
+	swept_particles.generate_coarse_collisions(swept_pairs);
+
+	// Fast particles against each other
+	for (const auto &pair : swept_pairs) {
+		const uint32_t first = std::min(pair.id1, pair.id2);
+		const uint32_t second = std::max(pair.id1, pair.id2);
+
+		f(*candidates[first], *candidates[second]);
+	}
+
+	// Slow particles against fast particles
+	for (uint32_t k = 0; k < (uint32_t)candidates.size(); k++) {
+		particle &a = *candidates[k];
+
+		if (is_fast(a)) {
+			continue;
+		}
+
+		swept_particles.query(swept_bounds(a.pos, a.p, a.radius), [&](uint32_t other) {
+			if (k < other) {
+				f(a, *candidates[other]);
+			} else {
+				f(*candidates[other], a);
+			}
+		});
+	}
+}
+
+template <typename particle_container, typename particle_filter>
+size_t phys::particle_collision_constraint_generator<particle_container, particle_filter>::hash(const cell &c, size_t mask) {
+	const uint32_t h = ((uint32_t)c.x * 73856093u) ^ ((uint32_t)c.y * 19349663u) ^ ((uint32_t)c.z * 83492791u);
+
+	return h & mask;
+}
+
+template <typename particle_container, typename particle_filter>
+bool phys::particle_collision_constraint_generator<particle_container, particle_filter>::is_fast(const particle &p) {
+	const vec3 d = p.p - p.pos;
+
+	return phys::dot(d, d) > p.radius * p.radius;
+}
+
+template <typename particle_container>
+phys::static_mesh_collision_constraint_generator<particle_container>::static_mesh_collision_constraint_generator(
+	particle_container &_particles,
+	std::vector<triangle> _triangles,
+	real _restitution,
+	real _friction
+) :
+	particles(_particles),
+	triangles(std::move(_triangles)),
+	restitution(_restitution),
+	friction(_friction)
+{
+	assert(triangles.size() <= UINT32_MAX);
+
+	std::vector<std::pair<uint32_t, aabb>> bounds{};
+
+	bounds.reserve(triangles.size());
+
+	for (uint32_t i = 0; i < (uint32_t)triangles.size(); i++) {
+		bounds.push_back({ i, triangles[i].get_bounds() });
+	}
+
+	tree.build(bounds);
+}
+
+template <typename particle_container>
+void phys::static_mesh_collision_constraint_generator<particle_container>::generate_constraints(
+	real,
+	constraint_arena &constraints
+) {
+	if (has_candidates) {
+		size_t begin = 0;
+
+		while (begin < candidates.size()) {
+			particle &p = *candidates[begin].first;
+			size_t end = begin + 1;
+
+			while (end < candidates.size() && candidates[end].first == &p) {
+				end++;
+			}
+
+			collide(p, [&](auto &&f) {
+				for (size_t i = begin; i < end; i++) {
+					f(candidates[i].second);
+				}
+			}, constraints);
+
+			begin = end;
+		}
+
+		return;
+	}
+
+	for (particle &p : particles) {
+		collide(p, [&](auto &&f) {
+			tree.query(swept_bounds(p.pos, p.p, p.radius), f);
+		}, constraints);
+	}
+}
+
+template <typename particle_container>
+void phys::static_mesh_collision_constraint_generator<particle_container>::begin_frame(real frame_dt) {
+	candidates.clear();
+
+	for (particle &p : particles) {
+		tree.query(aabb(p.pos, p.pos).enlarged(p.radius + p.max_travel(frame_dt)), [&](uint32_t i) {
+			candidates.push_back({ &p, i });
+		});
+	}
+
+	has_candidates = true;
+}
+
+template <typename particle_container>
+void phys::static_mesh_collision_constraint_generator<particle_container>::end_frame() {
+	candidates.clear();
+	has_candidates = false;
+}
+
+template <typename particle_container>
+template <typename F>
+void phys::static_mesh_collision_constraint_generator<particle_container>::collide(
+	particle &p,
+	F &&for_each_triangle,
+	constraint_arena &constraints
+) {
+	if (p.is_asleep()) {
+		return;
+	}
+
+	std::optional<sweep_hit> first_hit{};
+
+	for_each_triangle([&](uint32_t i) {
+		const std::optional<sweep_hit> hit = sweep_sphere_triangle(p.pos, p.p, p.radius, triangles[i]);
+
+		if (hit && (! first_hit || hit->t < first_hit->t)) {
+			first_hit = hit;
+		}
+	});
+
+	if (first_hit) {
+		constraints.emplace<phys::plane_collision_constraint>(
+			&p,
+			first_hit->normal,
+			first_hit->center,
+			restitution,
+			friction
+		);
 	}
 }
@@ -0,0 +1,84 @@
+#pragma once
+#include <span>
+#include <vector>
+#include "collision/contact.h"
+#include "math.h"
+#include "rigid_body.h"
+
+namespace phys {
+	// Resolves contacts between rigid bodies with sequential impulses. Each iteration
+	// applies an impulse at every contact that corrects the relative velocity there,
+	// clamping the total impulse so that contacts can push but never pull. Friction
+	// is applied the same way along the plane of the contact, and is limited by the
+	// normal impulse. Penetration is corrected by asking for a small separating
+	// velocity at each contact.
+	//
+	// With warm starting, the solver begins by applying the impulses that are already
+	// stored in each contact. When those come from the same contact last frame, the
+	// solver starts close to the solution and needs far fewer iterations.
+	class contact_solver {
+	public:
+		size_t iterations;
+		real friction{ (real)0.5 };
+		real restitution{};
+		// Contacts that approach slower than this don't bounce, so that resting
+		// contacts don't jitter
+		real restitution_threshold{ (real)1.0 };
+		// The fraction of the penetration that is corrected each step
+		real baumgarte{ (real)0.2 };
+		// Penetration that's allowed without any correction
+		real slop{ (real)0.01 };
+		bool warm_starting{ true };
+
+		explicit contact_solver(size_t _iterations);
+
+		// Changes the velocities of the bodies in `contacts`. The impulses that were
+		// applied are stored back in the contacts.
+		void solve(std::span<contact> contacts, real dt);
+
+	private:
+#ifdef DEBUG
+	public:
+#endif
+		// A direction along which the solver applies impulses at a contact, with
+		// everything that doesn't change between iterations precomputed
+		struct impulse_axis {
+			vec3 dir{};
+			// The angular parts of the axis for each body, before and after they're
+			// multiplied by the body's inverse inertia tensor
+			vec3 ang_a{};
+			vec3 ang_b{};
+			vec3 inv_ang_a{};
+			vec3 inv_ang_b{};
+			real mass{};
+			real impulse{};
+		};
+
+		struct contact_state {
+			contact * c{};
+			// The velocities of the bodies. These point at `static_velocity` for
+			// missing bodies.
+			vec3 * vel_a{};
+			vec3 * ang_vel_a{};
+			vec3 * vel_b{};
+			vec3 * ang_vel_b{};
+			real inv_mass_a{};
+			real inv_mass_b{};
+			// The normal, then the two tangents
+			impulse_axis axes[3]{};
+			real target_velocity{};
+		};
+
+		std::vector<contact_state> states{};
+		// Stands in for the velocity of a missing body. Missing bodies have no mass,
+		// so this is never changed.
+		vec3 static_velocity{};
+
+		void prepare(std::span<contact> contacts, real dt);
+		void apply_warm_start();
+		void solve_velocities();
+
+		static real velocity_along(const contact_state &s, const impulse_axis &axis);
+		static void apply_impulse(contact_state &s, const impulse_axis &axis, real impulse);
+	};
+}
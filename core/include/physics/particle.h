@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include "math.h"
 
 namespace phys {
@@ -21,12 +22,30 @@ namespace phys {
 		particle();
 
 		void integrate(real dt);
+		// How far the particle can move in `dt` with its current velocity and force,
+		// if nothing else pushes it
+		real max_travel(real dt) const;
 		void set_mass(real mass);
 		real get_mass() const;
 		real get_inv_mass() const;
 		bool has_finite_mass() const;
+		// True if the particle is in a sleeping island of a `particle_world`
+		bool is_asleep() const;
 
 	private:
+		friend class particle_world;
+		friend class particle_store;
+
 		real inv_mass;
+		// The index of the particle's handle in the `particle_store` of the world
+		// that it's in
+		uint32_t store_handle{ UINT32_MAX };
+		// Set by `particle_world`. While the particle is awake, `island` is scratch
+		// space for finding islands, and while it's asleep, it's the index of its
+		// sleeping island.
+		uint32_t island{};
+		// How long the particle has been moving slowly enough to sleep
+		real sleep_time{};
+		bool asleep{};
 	};
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include <span>
 #include "math.h"
 #include "particle.h"
 
@@ -8,5 +9,17 @@ namespace phys {
 		virtual ~particle_force_generator() = default;
 
 		virtual void update_force(particle &p, real duration) = 0;
+		// Applies the force to every particle in `particles` that isn't asleep. The
+		// default calls `update_force` for each particle. Generators that can apply
+		// their force to many particles at once should override this.
+		virtual void update_forces(std::span<particle * const> particles, real duration);
 	};
 }
+
+inline void phys::particle_force_generator::update_forces(std::span<particle * const> particles, real duration) {
+	for (particle * p : particles) {
+		if (! p->is_asleep()) {
+			update_force(*p, duration);
+		}
+	}
+}
@@ -9,6 +9,7 @@ namespace phys {
 		particle_gravity(const vec3 &_gravity);
 
 		void update_force(particle &p, real duration) override;
+		void update_forces(std::span<particle * const> particles, real duration) override;
 	};
 
 	class particle_drag : public particle_force_generator {
@@ -19,6 +20,7 @@ namespace phys {
 		particle_drag(real _k1, real _k2);
 
 		void update_force(particle &p, real duration) override;
+		void update_forces(std::span<particle * const> particles, real duration) override;
 	};
 
 	class particle_spring : public particle_force_generator {
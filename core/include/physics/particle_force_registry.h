@@ -1,27 +1,59 @@
 #pragma once
+#include <cstdint>
+#include <unordered_map>
 #include <vector>
 #include "math.h"
 #include "particle.h"
 #include "particle_force_generator.h"
 
 namespace phys {
-	struct particle_force_registration {
-		particle * p;
-		particle_force_generator * fg;
+	// Refers to a registration in a `particle_force_registry`. A handle becomes
+	// invalid when its registration is removed, even if the slot is later reused.
+	struct particle_force_handle {
+		uint32_t index{ UINT32_MAX };
+		uint32_t generation{};
 
-		friend bool operator==(const particle_force_registration &a, const particle_force_registration &b);
+		friend bool operator==(const particle_force_handle &a, const particle_force_handle &b) = default;
 	};
 
+	// Keeps the particles of each force generator together, so that each generator
+	// updates all of its particles with one call to `update_forces` instead of one
+	// virtual call per particle. Registrations are added and removed in constant time.
 	class particle_force_registry {
 	public:
-		void add(particle * p, particle_force_generator * fg);
+		particle_force_handle add(particle * p, particle_force_generator * fg);
+		// Returns false if the handle is no longer valid
+		bool remove(particle_force_handle h);
+		// Removes every registration of `p` with `fg`. This has to search the
+		// generator's particles, so removing by handle is faster.
 		void remove(particle * p, particle_force_generator * fg);
 		void clear();
 		void update_forces(real duration);
 
 	private:
-		using registry = std::vector<particle_force_registration>;
+		// A generator and the particles that it applies its force to. Removing a
+		// particle moves the last particle into its place.
+		struct group {
+			particle_force_generator * fg{};
+			std::vector<particle *> particles{};
+			// The handle of each particle's registration
+			std::vector<uint32_t> handles{};
+		};
 
-		registry registrations{};
+		// Where a registration is
+		struct slot {
+			uint32_t group{};
+			uint32_t index{};
+		};
+
+		std::vector<group> groups{};
+		std::unordered_map<const particle_force_generator *, uint32_t> group_indices{};
+
+		// Indexed by handle
+		std::vector<slot> slots{};
+		std::vector<uint32_t> generations{};
+		std::vector<uint32_t> free_handles{};
+
+		void remove_at(uint32_t group_index, uint32_t index);
 	};
 }
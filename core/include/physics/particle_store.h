@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "particle.h"
+
+namespace phys {
+	// Refers to a particle in a `particle_store`. A handle becomes invalid when its
+	// particle is removed, even if the slot is later reused by another particle.
+	struct particle_handle {
+		uint32_t index{ UINT32_MAX };
+		uint32_t generation{};
+
+		friend bool operator==(const particle_handle &a, const particle_handle &b) = default;
+	};
+
+	// Keeps track of the particles in a world and gives out handles to them. The
+	// particles are owned by the caller, and they are integrated in place.
+	//
+	// The store doesn't keep the particles' state in per-field arrays. Constraints,
+	// constraint generators, and force generators all read and write particles
+	// through pointers, so the arrays could only be copies that are filled and
+	// written back around every phase of a step, which is slower than integrating
+	// the particles where they are.
+	//
+	// Sleeping particles are kept after the awake particles, and the physics steps
+	// only loop over the awake particles.
+	class particle_store {
+	public:
+		particle_handle add(particle * p);
+		bool remove(particle_handle h);
+		bool remove(particle * p);
+		// Returns null if the handle is no longer valid
+		particle * get(particle_handle h) const;
+		size_t size() const;
+		size_t awake_size() const;
+
+		template <typename F>
+		void for_each(F &&f) const;
+		template <typename F>
+		void for_each_awake(F &&f) const;
+
+		// Stops integrating the particle. This should only be called between steps.
+		void sleep(particle * p);
+		// Starts integrating the particle again. This can be called in the middle of a
+		// step: a sleeping particle's predicted position is its position, so it's
+		// integrated as if it had been awake and still when the step started.
+		void wake(particle * p);
+
+	private:
+		// Dense arrays, indexed by slot. Removing a particle moves the last particle
+		// into its slot, so the arrays never have holes.
+		std::vector<particle *> particles{};
+		std::vector<uint32_t> slot_handles{};
+
+		// Indexed by handle. `handle_slots` maps a handle to the particle's slot.
+		std::vector<uint32_t> handle_slots{};
+		std::vector<uint32_t> generations{};
+		std::vector<uint32_t> free_handles{};
+
+		// The awake particles are in slots `[0, num_awake)`
+		size_t num_awake{};
+
+		void swap_slots(uint32_t a, uint32_t b);
+		// Returns the slot of a particle in this store, or `UINT32_MAX`
+		uint32_t find_slot(const particle * p) const;
+	};
+}
+
+template <typename F>
+void phys::particle_store::for_each(F &&f) const {
+	for (particle * p : particles) {
+		f(*p);
+	}
+}
+
+template <typename F>
+void phys::particle_store::for_each_awake(F &&f) const {
+	for (size_t i = 0; i < num_awake; i++) {
+		f(*particles[i]);
+	}
+}
@@ -1,9 +1,15 @@
 #pragma once
+#include <cstdint>
 #include <memory>
+#include <span>
+#include <unordered_map>
 #include <vector>
 #include "constraint.h"
 #include "particle.h"
 #include "particle_force_registry.h"
+#include "particle_store.h"
+#include "solver_stats.h"
+#include "thread_pool.h"
 
 namespace phys {
 	class particle_world {
@@ -17,9 +23,29 @@ namespace phys {
 
 		void prepare_frame();
 		void run_physics(real dt);
+		// Advances the world by a frame of `frame_dt`, split into `num_substeps`
+		// substeps of equal length. This does the same thing as calling
+		// `prepare_frame` and `run_physics` for each substep, except that forces are
+		// only updated once, and constraint generators find collision candidates
+		// once for the whole frame. Only the candidates are checked for collisions in
+		// each substep. In XPBD mode, many substeps with one solver iteration each
+		// converge faster than one step with many iterations.
+		void step(real frame_dt, size_t num_substeps);
 
-		void add_particle(particle * p);
+		const step_timings& get_step_timings() const;
+		// Iterations, errors, projections, and timings of the last step. Everything
+		// but the errors is always collected.
+		const solver_stats& get_solver_stats() const;
+		// Measuring the error takes an extra pass over the constraints after each
+		// solver iteration, so it's only done in one of every `interval` steps. It's
+		// measured in every step by default, and an interval of zero turns it off.
+		void set_error_sample_interval(size_t interval);
+
+		particle_handle add_particle(particle * p);
 		void remove_particle(particle * p);
+		void remove_particle(particle_handle h);
+		// Returns null if the particle has been removed
+		particle * get_particle(particle_handle h) const;
 
 		void add_fixed_constraint(constraint * c);
 		void remove_fixed_constraint(constraint * c);
@@ -27,17 +53,111 @@ namespace phys {
 		void add_constraint_generator(constraint_generator * generator);
 		void remove_constraint_generator(constraint_generator * generator);
 
+		// Projects constraints in parallel on `_pool`, or serially if `_pool` is null.
+		// In parallel mode, the constraints are colored every frame so that no two
+		// constraints with the same color share a particle. Each color's constraints
+		// are then projected concurrently, which gives the same result as projecting
+		// them one at a time.
+		void set_thread_pool(thread_pool * _pool);
+
+		// Constraints are projected with PBD by default. In XPBD mode, each
+		// constraint's compliance is used instead of its stiffness, so stiff
+		// constraints don't need more solver iterations. Constraints without a
+		// compliance get one from their stiffness.
+		void set_solver_mode(solver_mode _mode);
+
+		// An island is a group of particles that are connected by fixed or collision
+		// constraints. Particles with infinite mass don't connect islands. When every
+		// particle in an island has moved slower than `max_speed` for `time_to_sleep`
+		// seconds, the island is put to sleep: its particles aren't integrated, their
+		// forces aren't updated, and their constraints aren't projected until an awake
+		// particle collides with them or `wake_particle` is called. Sleeping is off
+		// by default, and a `max_speed` of zero turns it off again.
+		void set_sleep_thresholds(real max_speed, real _time_to_sleep);
+		// Wakes the particle's island. This must be called after moving a sleeping
+		// particle or changing its forces from outside of the world.
+		void wake_particle(particle * p);
+
 	private:
-		std::vector<particle *> particles{};
+#ifdef DEBUG
+	public:
+#endif
+		// A constraint can only be colored if it doesn't share a particle with a
+		// constraint of every color. Constraints that can't be colored are projected
+		// serially after (or before, when solving backwards) all of the colors.
+		static inline constexpr size_t max_colors = 64;
+		// Each task projects at most this many constraints
+		static inline constexpr size_t parallel_grain = 256;
+
+		// A group of sleeping particles, with the fixed constraints between them
+		struct island {
+			std::vector<particle *> particles{};
+			std::vector<constraint *> constraints{};
+		};
+
+		particle_store particles{};
 		std::vector<constraint_generator *> constraint_generators{};
+		// The fixed constraints of sleeping islands are kept in their islands
+		// instead
 		std::vector<constraint *> fixed_constraints{};
-		std::vector<std::unique_ptr<constraint>> collision_constraints{};
+		constraint_arena collision_constraints{};
 		size_t solver_iterations;
 		real inv_solver_iterations;
 		real min_pos_change_sqr;
 		bool solve_forward{};
+		thread_pool * pool{};
+		solver_mode mode{ solver_mode::PBD };
+
+		// Every constraint, sorted by color. The constraints with color `i` are in
+		// `[color_offsets[i], color_offsets[i + 1])`. The uncolored constraints have
+		// color `max_colors`.
+		std::vector<constraint *> colored_constraints{};
+		std::vector<size_t> color_offsets{};
+		std::vector<uint8_t> constraint_colors{};
+		// Bitmask of the colors used by each particle's constraints
+		std::unordered_map<const particle *, uint64_t> particle_colors{};
+
+		solver_stats stats{};
+		size_t error_sample_interval{ 1 };
+		// The number of steps since the error was last sampled
+		size_t steps_since_error_sample{};
+		bool measure_errors{};
+
+		real sleep_speed_sqr{};
+		real time_to_sleep{};
+		// Indexed by `particle::island`. An island's slot is reused after it wakes up.
+		std::vector<island> sleeping_islands{};
+		std::vector<uint32_t> free_islands{};
+		// Scratch space for finding islands among the awake particles. The particles
+		// are indexed by `particle::island`.
+		std::vector<particle *> awake_particles{};
+		std::vector<uint32_t> island_parents{};
+		std::vector<real> island_sleep_times{};
+		std::vector<uint32_t> new_islands{};
 
+		// Clears the stats and decides whether to sample the error in this step
+		void begin_stats();
+		// Moves the particles by one (sub)step, once their forces are up to date
+		void run_substep(real dt);
 		void generate_collision_constraints(real dt);
 		void solve_constraints(real dt);
+		void color_constraints();
+		void solve_constraints_in_parallel(real dt);
+		// Projects `c` with the world's solver mode
+		void project_constraint(constraint * c, real dt);
+		// Projects `c` if it isn't satisfied, and counts the projection in
+		// `projections[c->source]`. Returns true if `c` was projected.
+		bool solve_constraint(constraint * c, real dt, std::span<size_t> projections);
+		// Adds the error of every constraint after `iteration` iterations, if the
+		// error is sampled in this step
+		void measure_error(size_t iteration);
+		void wake_island(uint32_t i);
+		// Wakes the islands of sleeping particles that collide with awake particles,
+		// then destroys the collision constraints with no awake particles
+		void wake_touched_islands();
+		// Finds the islands of the awake particles with union-find, and puts the
+		// islands that have been still for long enough to sleep
+		void update_islands(real dt);
+		uint32_t find_island_root(uint32_t i);
 	};
 }
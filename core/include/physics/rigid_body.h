@@ -7,7 +7,7 @@ namespace phys {
 		vec3 pos{};
 		vec3 vel{};
 		vec3 acc{};
-		quat rot{};
+		quat rot{ identity<quat>() };
 		vec3 ang_vel{};
 		real linear_damping;
 		real angular_damping;
@@ -18,12 +18,19 @@ namespace phys {
 		real get_mass() const;
 		real get_inv_mass() const;
 		bool has_finite_mass() const;
+		// Sets the inertia tensor in the body's local space
+		void set_inertia_tensor(const mat3 &inertia_tensor);
+		const mat3& get_inv_inertia_tensor_world() const;
 		void setup();
 		void calculate_derived_data();
 		void add_force(const vec3 &f);
 		void add_force_at_world(const vec3 &f_world, const vec3 &at_world);
 		void add_force_at_local(const vec3 &f_world, const vec3 &at_local);
+		// Applies the accumulated forces to the body's velocity
 		void integrate(real dt);
+		// Moves and rotates the body by its velocity. This is separate from `integrate`
+		// so that a solver can change the velocity in between.
+		void integrate_position(real dt);
 		// Returns the local-to-world transformation matrix
 		const mat4& get_transform() const;
 		const mat4& get_inv_transform() const;
@@ -41,4 +48,10 @@ namespace phys {
 		void calculate_world_to_local();
 		void calculate_inv_inertia_tensor_world();
 	};
+
+	mat3 cuboid_inertia_tensor(real mass, const vec3 &half_size);
+	mat3 sphere_inertia_tensor(real mass, real radius);
+	// For a capsule or a cylinder along the Y axis
+	mat3 capsule_inertia_tensor(real mass, real radius, real half_height);
+	mat3 cylinder_inertia_tensor(real mass, real radius, real half_height);
 }
@@ -0,0 +1,89 @@
+#pragma once
+#include <vector>
+#include "collision/algorithm.h"
+#include "collision/bounding_volumes.h"
+#include "collision/bvh.h"
+#include "collision/contact_cache.h"
+#include "collision/contact_generator.h"
+#include "collision/feature_cache.h"
+#include "collision/primitive.h"
+#include "contact_solver.h"
+#include "rigid_body.h"
+#include "rigid_body_force_generator.h"
+
+namespace phys {
+	class thread_pool;
+
+	// With a thread pool, the narrowphase is split among the pool's threads once
+	// there are at least this many pairs to collide
+	inline constexpr size_t min_parallel_narrowphase_pairs = 256;
+
+	// Moves rigid bodies and resolves collisions between their primitives. Each step,
+	// the primitives' bounds are updated in a BVH, which gives the pairs of
+	// primitives that might be colliding. `collider` generates contacts for those
+	// pairs, and `solver` resolves the contacts by changing the bodies' velocities
+	// before they're moved. Contacts are matched with last frame's contacts between
+	// the same primitives, so that the solver can be warm started, and box-box
+	// collisions start V-Clip from last frame's closest features.
+	class rigid_body_world {
+	public:
+		contact_generator collider{};
+		contact_solver solver;
+
+		// The BVH stores each primitive's bounds enlarged by `_bvh_margin`, so that
+		// primitives that move a little don't change the tree. With `_pool`, contacts
+		// are generated on the pool's threads. The contacts are the same either way.
+		rigid_body_world(size_t _solver_iterations, real _bvh_margin = (real)0.1, thread_pool * _pool = nullptr);
+
+		void run_physics(real dt);
+
+		void add_body(rigid_body * body);
+		void remove_body(rigid_body * body);
+
+		// Primitives that belong to the same body never collide with each other
+		void add_primitive(primitive * prim);
+		void remove_primitive(primitive * prim);
+
+		void add_force_generator(rigid_body * body, rigid_body_force_generator * fg);
+		void remove_force_generator(rigid_body * body, rigid_body_force_generator * fg);
+
+		// The contacts that were resolved in the last step
+		const contact_container& get_contacts() const;
+
+	private:
+#ifdef DEBUG
+	public:
+#endif
+		using broadphase_tree = bvh<aabb, primitive *>;
+
+		struct force_registration {
+			rigid_body * body;
+			rigid_body_force_generator * fg;
+
+			friend bool operator==(const force_registration &a, const force_registration &b) = default;
+		};
+
+		std::vector<rigid_body *> bodies{};
+		std::vector<force_registration> force_registrations{};
+		// Primitives with finite bounds are kept in the BVH, and primitives with
+		// infinite bounds (like planes) are tested against every other primitive
+		std::vector<primitive *> bounded_primitives{};
+		std::vector<primitive *> unbounded_primitives{};
+		broadphase_tree broadphase;
+		thread_pool * pool;
+
+		std::vector<broadphase_tree::coarse_collision_pair> coarse_pairs{};
+		// The coarse pairs that can collide, and each unbounded primitive paired with
+		// each bounded primitive
+		std::vector<collision_pair> collision_pairs{};
+		contact_container contacts{};
+		std::vector<contact_range> contact_ranges{};
+		contact_cache persistent_contacts{};
+		feature_cache persistent_features{};
+
+		void update_broadphase();
+		void generate_contacts();
+		void store_contacts();
+		bool can_collide(const primitive &a, const primitive &b) const;
+	};
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <chrono>
+#include <vector>
+#include "../data_formats/json.h"
+#include "constraint.h"
+#include "math.h"
+
+namespace phys {
+	// How long each stage of the last step took. With substeps, the stages that run
+	// in every substep are summed over the substeps.
+	struct step_timings {
+		std::chrono::nanoseconds forces{};
+		// Finding collision candidates once per frame
+		std::chrono::nanoseconds candidates{};
+		std::chrono::nanoseconds integration{};
+		std::chrono::nanoseconds constraint_generation{};
+		std::chrono::nanoseconds projection{};
+		std::chrono::nanoseconds velocity_update{};
+		// Finding islands and putting them to sleep
+		std::chrono::nanoseconds islands{};
+	};
+
+	// The error of every constraint at one point in the solver. A constraint's
+	// error is how far it is from being satisfied.
+	struct solver_error {
+		real max{};
+		real sum_sqr{};
+		size_t num_constraints{};
+
+		void add(real error);
+		void merge(const solver_error &other);
+		real rms() const;
+	};
+
+	// What the constraint solver did in the last step. With substeps, everything is
+	// combined over the substeps.
+	struct solver_stats {
+		// The number of solver iterations that were run. The solver stops early when
+		// every constraint is satisfied.
+		size_t iterations{};
+		// `errors[0]` is the error before the first iteration, and `errors[i]` is the
+		// error after `i` iterations. Each error is measured in its own pass over the
+		// constraints once a sweep is done, so it doesn't mix two iterations. This is
+		// empty in steps where the error isn't sampled.
+		std::vector<solver_error> errors{};
+		// How many times constraints were projected. `projections[0]` counts the
+		// fixed constraints, and `projections[i + 1]` counts the constraints made by
+		// the world's `i`th constraint generator.
+		std::vector<size_t> projections{};
+		step_timings timings{};
+
+		// Resets the stats for a new step with `num_generators` constraint
+		// generators, but keeps the memory of `errors` and `projections`
+		void clear(size_t num_generators);
+		// The error after `iteration` iterations, which is added if it doesn't exist
+		solver_error& error_after(size_t iteration);
+		size_t get_fixed_projections() const;
+		// Projections of the constraints made by the world's `i`th constraint
+		// generator
+		size_t get_generator_projections(size_t i) const;
+	};
+
+	// Describes the stats as a JSON object. Times are in nanoseconds.
+	json to_json(const solver_stats &stats);
+}
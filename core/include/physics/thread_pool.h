@@ -0,0 +1,98 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace phys {
+	// A pool of worker threads with one task queue per worker. A worker takes tasks
+	// from the back of its own queue, and when that runs dry it steals tasks from the
+	// front of the other workers' queues. Threads that submit work also run tasks
+	// until their work is done, so a pool with no workers runs everything on the
+	// calling thread.
+	class thread_pool {
+	public:
+		explicit thread_pool(size_t num_threads = default_num_threads());
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+		~thread_pool();
+
+		size_t num_threads() const;
+
+		// Calls `f(begin, end)` on subranges of `[0, count)` that are at most `grain`
+		// items long, and returns once every subrange has been processed. `f` must
+		// not throw.
+		template <typename F>
+		void parallel_for(size_t count, size_t grain, F &&f);
+
+		// One less than the number of hardware threads, because the thread that
+		// submits work also does some of it
+		static size_t default_num_threads();
+
+	private:
+		struct job {
+			void (*run)(void * ctx, size_t begin, size_t end){};
+			void * ctx{};
+			std::atomic<size_t> remaining{};
+		};
+
+		struct task {
+			job * j{};
+			size_t begin{};
+			size_t end{};
+		};
+
+		struct task_queue {
+			std::mutex mutex{};
+			std::deque<task> tasks{};
+		};
+
+		std::vector<std::unique_ptr<task_queue>> queues{};
+		std::vector<std::thread> workers{};
+		std::mutex sleep_mutex{};
+		std::condition_variable wake{};
+		std::atomic<size_t> num_queued{};
+		std::atomic<size_t> next_queue{};
+		// Guarded by `sleep_mutex`
+		bool stopping{};
+
+		void submit(job &j, size_t count, size_t grain);
+		void help_until_done(job &j);
+		// Runs one task from any queue, starting with `first_queue`. Tasks are taken
+		// from the back of `first_queue` if `is_owner` is set, and from the front of
+		// every other queue.
+		bool try_run_task(size_t first_queue, bool is_owner);
+		void worker_main(size_t index);
+	};
+}
+
+template <typename F>
+void phys::thread_pool::parallel_for(size_t count, size_t grain, F &&f) {
+	using fn_t = std::remove_reference_t<F>;
+
+	if (! count) {
+		return;
+	}
+
+	grain = std::max<size_t>(grain, 1);
+
+	if (workers.empty() || count <= grain) {
+		f((size_t)0, count);
+		return;
+	}
+
+	job j{};
+
+	j.run = [](void * ctx, size_t begin, size_t end) {
+		(*static_cast<fn_t *>(ctx))(begin, end);
+	};
+	j.ctx = const_cast<void *>(static_cast<const void *>(std::addressof(f)));
+
+	submit(j, count, grain);
+	help_until_done(j);
+}
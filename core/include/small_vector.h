@@ -0,0 +1,326 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace util {
+	// A vector that keeps up to `N` elements inside itself, and only allocates memory
+	// on the heap when it grows past that. Copying a `small_vector` with `N` or fewer
+	// elements never allocates. Iterators are plain pointers, and like `std::vector`,
+	// they're invalidated when the vector grows.
+	template <typename T, const size_t N>
+	class small_vector {
+	public:
+		using value_type = T;
+		using size_type = size_t;
+		using iterator = T *;
+		using const_iterator = const T *;
+
+		small_vector() = default;
+		small_vector(std::initializer_list<T> items);
+		explicit small_vector(const std::vector<T> &items);
+
+		template <typename It>
+		small_vector(It first, It last);
+
+		small_vector(const small_vector &other);
+		small_vector(small_vector &&other) noexcept(std::is_nothrow_move_constructible_v<T>);
+
+		~small_vector();
+
+		small_vector& operator=(const small_vector &other);
+		small_vector& operator=(small_vector &&other) noexcept(std::is_nothrow_move_constructible_v<T>);
+
+		T& operator[](size_t i);
+		const T& operator[](size_t i) const;
+
+		T * data();
+		const T * data() const;
+
+		iterator begin();
+		iterator end();
+		const_iterator begin() const;
+		const_iterator end() const;
+
+		T& back();
+		const T& back() const;
+
+		size_t size() const;
+		bool empty() const;
+		size_t capacity() const;
+		// True if the elements are kept inside the vector instead of on the heap
+		bool is_inline() const;
+
+		void reserve(size_t new_capacity);
+		void push_back(const T &item);
+		void push_back(T &&item);
+
+		template <typename... Args>
+		T& emplace_back(Args&&... args);
+
+		void pop_back();
+		iterator erase(const_iterator pos);
+		void clear();
+
+	private:
+		alignas(T) std::byte buf[sizeof(T) * N];
+		T * items{ reinterpret_cast<T *>(buf) };
+		size_t count{};
+		size_t cap{ N };
+
+		void grow(size_t min_capacity);
+	};
+
+	template <typename T, const size_t N>
+	bool operator==(const small_vector<T, N> &a, const small_vector<T, N> &b);
+}
+
+template <typename T, const size_t N>
+util::small_vector<T, N>::small_vector(std::initializer_list<T> _items) :
+	small_vector(std::begin(_items), std::end(_items)) {}
+
+template <typename T, const size_t N>
+util::small_vector<T, N>::small_vector(const std::vector<T> &_items) :
+	small_vector(std::begin(_items), std::end(_items)) {}
+
+template <typename T, const size_t N>
+template <typename It>
+util::small_vector<T, N>::small_vector(It first, It last) {
+	for (; first != last; ++first) {
+		push_back(*first);
+	}
+}
+
+template <typename T, const size_t N>
+util::small_vector<T, N>::small_vector(const small_vector &other) {
+	reserve(other.count);
+	std::uninitialized_copy(std::begin(other), std::end(other), items);
+	count = other.count;
+}
+
+template <typename T, const size_t N>
+util::small_vector<T, N>::small_vector(small_vector &&other) noexcept(std::is_nothrow_move_constructible_v<T>) {
+	if (! other.is_inline()) {
+		items = std::exchange(other.items, reinterpret_cast<T *>(other.buf));
+		count = std::exchange(other.count, 0);
+		cap = std::exchange(other.cap, N);
+
+		return;
+	}
+
+	std::uninitialized_move(std::begin(other), std::end(other), items);
+	count = other.count;
+	other.clear();
+}
+
+template <typename T, const size_t N>
+util::small_vector<T, N>::~small_vector() {
+	clear();
+
+	if (! is_inline()) {
+		std::allocator<T>().deallocate(items, cap);
+	}
+}
+
+template <typename T, const size_t N>
+util::small_vector<T, N>& util::small_vector<T, N>::operator=(const small_vector &other) {
+	if (this == &other) {
+		return *this;
+	}
+
+	clear();
+	reserve(other.count);
+	std::uninitialized_copy(std::begin(other), std::end(other), items);
+	count = other.count;
+
+	return *this;
+}
+
+template <typename T, const size_t N>
+util::small_vector<T, N>& util::small_vector<T, N>::operator=(small_vector &&other) noexcept(std::is_nothrow_move_constructible_v<T>) {
+	if (this == &other) {
+		return *this;
+	}
+
+	clear();
+
+	if (! other.is_inline()) {
+		if (! is_inline()) {
+			std::allocator<T>().deallocate(items, cap);
+		}
+
+		items = std::exchange(other.items, reinterpret_cast<T *>(other.buf));
+		count = std::exchange(other.count, 0);
+		cap = std::exchange(other.cap, N);
+
+		return *this;
+	}
+
+	std::uninitialized_move(std::begin(other), std::end(other), items);
+	count = other.count;
+	other.clear();
+
+	return *this;
+}
+
+template <typename T, const size_t N>
+T& util::small_vector<T, N>::operator[](size_t i) {
+	assert(i < count);
+
+	return items[i];
+}
+
+template <typename T, const size_t N>
+const T& util::small_vector<T, N>::operator[](size_t i) const {
+	assert(i < count);
+
+	return items[i];
+}
+
+template <typename T, const size_t N>
+T * util::small_vector<T, N>::data() {
+	return items;
+}
+
+template <typename T, const size_t N>
+const T * util::small_vector<T, N>::data() const {
+	return items;
+}
+
+template <typename T, const size_t N>
+T * util::small_vector<T, N>::begin() {
+	return items;
+}
+
+template <typename T, const size_t N>
+T * util::small_vector<T, N>::end() {
+	return items + count;
+}
+
+template <typename T, const size_t N>
+const T * util::small_vector<T, N>::begin() const {
+	return items;
+}
+
+template <typename T, const size_t N>
+const T * util::small_vector<T, N>::end() const {
+	return items + count;
+}
+
+template <typename T, const size_t N>
+T& util::small_vector<T, N>::back() {
+	assert(count);
+
+	return items[count - 1];
+}
+
+template <typename T, const size_t N>
+const T& util::small_vector<T, N>::back() const {
+	assert(count);
+
+	return items[count - 1];
+}
+
+template <typename T, const size_t N>
+size_t util::small_vector<T, N>::size() const {
+	return count;
+}
+
+template <typename T, const size_t N>
+bool util::small_vector<T, N>::empty() const {
+	return count == 0;
+}
+
+template <typename T, const size_t N>
+size_t util::small_vector<T, N>::capacity() const {
+	return cap;
+}
+
+template <typename T, const size_t N>
+bool util::small_vector<T, N>::is_inline() const {
+	return items == reinterpret_cast<const T *>(buf);
+}
+
+template <typename T, const size_t N>
+void util::small_vector<T, N>::reserve(size_t new_capacity) {
+	if (new_capacity > cap) {
+		grow(new_capacity);
+	}
+}
+
+template <typename T, const size_t N>
+void util::small_vector<T, N>::push_back(const T &item) {
+	emplace_back(item);
+}
+
+template <typename T, const size_t N>
+void util::small_vector<T, N>::push_back(T &&item) {
+	emplace_back(std::move(item));
+}
+
+template <typename T, const size_t N>
+template <typename... Args>
+T& util::small_vector<T, N>::emplace_back(Args&&... args) {
+	if (count == cap) {
+		// `args` might refer to an element of this vector, so the new element is
+		// constructed before the old ones are moved
+		T item(std::forward<Args>(args)...);
+
+		grow(count + 1);
+
+		return *std::construct_at(items + count++, std::move(item));
+	}
+
+	return *std::construct_at(items + count++, std::forward<Args>(args)...);
+}
+
+template <typename T, const size_t N>
+void util::small_vector<T, N>::pop_back() {
+	assert(count);
+
+	std::destroy_at(items + --count);
+}
+
+template <typename T, const size_t N>
+T * util::small_vector<T, N>::erase(const_iterator pos) {
+	assert(pos >= begin() && pos < end());
+
+	T * out = items + (pos - items);
+
+	std::move(out + 1, end(), out);
+	std::destroy_at(items + --count);
+
+	return out;
+}
+
+template <typename T, const size_t N>
+void util::small_vector<T, N>::clear() {
+	std::destroy(begin(), end());
+	count = 0;
+}
+
+template <typename T, const size_t N>
+void util::small_vector<T, N>::grow(size_t min_capacity) {
+	const size_t new_cap = std::max(min_capacity, cap * 2);
+	T * new_items = std::allocator<T>().allocate(new_cap);
+
+	std::uninitialized_move(begin(), end(), new_items);
+	std::destroy(begin(), end());
+
+	if (! is_inline()) {
+		std::allocator<T>().deallocate(items, cap);
+	}
+
+	items = new_items;
+	cap = new_cap;
+}
+
+template <typename T, const size_t N>
+bool util::operator==(const small_vector<T, N> &a, const small_vector<T, N> &b) {
+	return std::equal(std::begin(a), std::end(a), std::begin(b), std::end(b));
+}
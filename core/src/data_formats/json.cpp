@@ -1,3 +1,6 @@
+#include <cmath>
+#include <iomanip>
+#include <limits>
 #include <sstream>
 #include "data_formats/json.h"
 #include "data_formats/parsing.h"
@@ -419,6 +422,104 @@ namespace {
 	}
 }
 
+namespace {
+	void write_string(std::wostream &out, const std::wstring &str) {
+		out << L'"';
+
+		for (wchar_t c : str) {
+			switch (c) {
+				case L'"': {
+					out << L"\\\"";
+					break;
+				}
+				case L'\\': {
+					out << L"\\\\";
+					break;
+				}
+				case L'\n': {
+					out << L"\\n";
+					break;
+				}
+				case L'\r': {
+					out << L"\\r";
+					break;
+				}
+				case L'\t': {
+					out << L"\\t";
+					break;
+				}
+				case L'\b': {
+					out << L"\\b";
+					break;
+				}
+				case L'\f': {
+					out << L"\\f";
+					break;
+				}
+				default: {
+					if (c < 0x20) {
+						out << L"\\u" << std::hex << std::setw(4) << std::setfill(L'0') << (unsigned int)c << std::dec;
+					} else {
+						out << c;
+					}
+				}
+			}
+		}
+
+		out << L'"';
+	}
+
+	void write_value(std::wostream &out, const json_value_or_descriptor &val, const std::vector<json_object> &objects, const std::vector<json_array> &arrays) {
+		if (const json_object_descriptor * desc = std::get_if<json_object_descriptor>(&val)) {
+			bool is_first = true;
+
+			out << L'{';
+
+			for (const auto &[key, elem] : objects.at(desc->obj_pos)) {
+				if (! is_first) {
+					out << L',';
+				}
+
+				is_first = false;
+				write_string(out, key);
+				out << L':';
+				write_value(out, elem, objects, arrays);
+			}
+
+			out << L'}';
+		} else if (const json_array_descriptor * desc = std::get_if<json_array_descriptor>(&val)) {
+			bool is_first = true;
+
+			out << L'[';
+
+			for (const json_value_or_descriptor &elem : arrays.at(desc->arr_pos)) {
+				if (! is_first) {
+					out << L',';
+				}
+
+				is_first = false;
+				write_value(out, elem, objects, arrays);
+			}
+
+			out << L']';
+		} else if (const std::wstring * str = std::get_if<std::wstring>(&val)) {
+			write_string(out, *str);
+		} else if (const long * l = std::get_if<long>(&val)) {
+			out << *l;
+		} else if (const double * d = std::get_if<double>(&val)) {
+			if (std::isfinite(*d)) {
+				out << std::setprecision(std::numeric_limits<double>::max_digits10) << *d;
+			} else {
+				out << L"null";
+			}
+		} else if (const bool * b = std::get_if<bool>(&val)) {
+			out << (*b ? L"true" : L"false");
+		} else {
+			out << L"null";
+		}
+	}
+}
+
 bool operator==(const json_object_descriptor &a, const json_object_descriptor &b) {
 	return a.obj_pos == b.obj_pos;
 }
@@ -447,6 +548,10 @@ json_value_or_descriptor json::get_root() const noexcept {
 	return root;
 }
 
+void json::set_root(json_value_or_descriptor _root) noexcept {
+	root = _root;
+}
+
 json_object_descriptor json::add(json_object obj) {
 	objects.push_back(obj);
 
@@ -490,4 +595,8 @@ json parse_json(std::wistream &_in) {
 	}
 
 	return out;
+}
+
+void write_json(std::wostream &out, const json &j) {
+	write_value(out, j.root, j.objects, j.arrays);
 }
\ No newline at end of file
@@ -1,7 +1,10 @@
 #include <algorithm>
 #include <array>
 #include "physics/collision/algorithms.h"
+#include "physics/collision/feature_cache.h"
+#include "physics/collision/gjk.h"
 #include "physics/collision/primitives.h"
+#include "small_vector.h"
 
 using namespace phys::literals;
 
@@ -21,24 +24,372 @@ namespace {
 			dist = dist_from_plane(pos, dir, dir_len);
 		}
 	};
-}
 
-phys::collision_algorithm_func phys::algorithms::sphere_sphere_collision;
-phys::collision_algorithm_func phys::algorithms::sphere_plane_collision;
-phys::collision_algorithm_func phys::algorithms::plane_plane_collision;
-phys::collision_algorithm_func phys::algorithms::plane_box_collision;
-phys::collision_algorithm_func phys::algorithms::sphere_box_collision;
-phys::collision_algorithm_func phys::algorithms::box_box_collision;
+	phys::vec3 point_on(const phys::line_segment &s, phys::real t) {
+		return s.a + (s.b - s.a) * t;
+	}
 
-void phys::algorithms::init_algorithms() {
-	if (initialized) {
-		return;
+	// The parameter of the point on `s` that is closest to `p`
+	phys::real closest_on_segment(const phys::vec3 &p, const phys::line_segment &s) {
+		const phys::vec3 d = s.b - s.a;
+		const phys::real len_sqr = phys::dot(d, d);
+
+		if (len_sqr == 0.0_r) {
+			return 0.0_r;
+		}
+
+		return std::clamp(phys::dot(p - s.a, d) / len_sqr, 0.0_r, 1.0_r);
 	}
 
-	initialized = true;
+	// Finds the parameters of the closest points between two line segments
+	// (Ericson, Real-Time Collision Detection, 5.1.9)
+	void closest_between_segments(
+		const phys::line_segment &s1,
+		const phys::line_segment &s2,
+		phys::real &t1,
+		phys::real &t2
+	) {
+		constexpr phys::real eps = 1e-12_r;
+
+		const phys::vec3 d1 = s1.b - s1.a;
+		const phys::vec3 d2 = s2.b - s2.a;
+		const phys::vec3 r = s1.a - s2.a;
+		const phys::real a = phys::dot(d1, d1);
+		const phys::real e = phys::dot(d2, d2);
+		const phys::real f = phys::dot(d2, r);
+
+		if (a <= eps && e <= eps) {
+			t1 = 0.0_r;
+			t2 = 0.0_r;
+			return;
+		}
+
+		if (a <= eps) {
+			t1 = 0.0_r;
+			t2 = std::clamp(f / e, 0.0_r, 1.0_r);
+			return;
+		}
+
+		const phys::real c = phys::dot(d1, r);
+
+		if (e <= eps) {
+			t1 = std::clamp(-c / a, 0.0_r, 1.0_r);
+			t2 = 0.0_r;
+			return;
+		}
+
+		const phys::real b = phys::dot(d1, d2);
+		const phys::real denom = a * e - b * b;
+
+		t1 = denom != 0.0_r ? std::clamp((b * f - c * e) / denom, 0.0_r, 1.0_r) : 0.0_r;
+		t2 = (b * t1 + f) / e;
+
+		if (t2 < 0.0_r) {
+			t2 = 0.0_r;
+			t1 = std::clamp(-c / a, 0.0_r, 1.0_r);
+		} else if (t2 > 1.0_r) {
+			t2 = 1.0_r;
+			t1 = std::clamp((b - c) / a, 0.0_r, 1.0_r);
+		}
+	}
+
+	phys::vec3 any_perpendicular(const phys::vec3 &v) {
+		const phys::vec3 axis = std::abs(v.x) < 0.6_r ?
+			phys::vec3(1.0_r, 0.0_r, 0.0_r) :
+			phys::vec3(0.0_r, 1.0_r, 0.0_r);
+
+		return phys::normalize(phys::cross(v, axis));
+	}
+
+	// V-Clip converges in a few steps for boxes. It only takes this many steps, plus
+	// one for each vertex of the two polyhedra, if it's cycling.
+	constexpr size_t min_vclip_steps = 48;
+	// V-Clip can finish on intersecting edges of boxes that penetrate, so features
+	// that are this close are treated as touching
+	constexpr phys::real touching_dist = 0.0001_r;
+	// A box face clipped against the four sides of another box face has at most
+	// eight vertices. Faces of convex hulls can have more.
+	constexpr size_t max_inline_clipped_points = 8;
+
+	using clipped_face = util::small_vector<phys::vec3, max_inline_clipped_points>;
+
+	// Sutherland-Hodgman: keeps the part of `in` behind the plane through `pos`
+	// with normal `dir`
+	void clip_face(const clipped_face &in, clipped_face &out, const phys::vec3 &pos, const phys::vec3 &dir) {
+		out.clear();
+
+		for (size_t i = 0; i < in.size(); i++) {
+			const phys::vec3 &p1 = in[i];
+			const phys::vec3 &p2 = in[(i + 1) % in.size()];
+			const phys::real d1 = phys::dot(p1 - pos, dir);
+			const phys::real d2 = phys::dot(p2 - pos, dir);
+
+			if (d1 <= 0.0_r) {
+				out.push_back(p1);
+			}
+
+			if ((d1 <= 0.0_r) != (d2 <= 0.0_r)) {
+				out.push_back(p1 + (p2 - p1) * (d1 / (d1 - d2)));
+			}
+		}
+	}
+
+	// Distance between two features that V-Clip reported as the closest features
+	// of two polyhedra. `p2_to_p1` transforms `p2` into the space of `p1`. V-Clip
+	// never finishes on an edge and a face without reporting penetration, so that
+	// case doesn't need to be handled.
+	phys::real feature_dist(
+		const phys::vclip::polyhedron &p1,
+		const phys::vclip::feature &f1,
+		const phys::vclip::polyhedron &p2,
+		const phys::vclip::feature &f2,
+		const phys::mat4 &p2_to_p1
+	) {
+		using namespace phys::vclip;
+
+		const auto to_p1 = [&](const phys::vec3 &v) {
+			return phys::truncate(p2_to_p1 * phys::vec4(v, 1.0_r));
+		};
+
+		if (const face * f = std::get_if<face>(&f1)) {
+			assert(std::holds_alternative<vertex>(f2));
+
+			const phys::vec3 v = to_p1(std::get<vertex>(f2).v);
+
+			return std::abs(phys::dot(v - p1.vertices[f->vert(0)].v, f->normal(p1)));
+		}
+
+		if (const face * f = std::get_if<face>(&f2)) {
+			assert(std::holds_alternative<vertex>(f1));
+
+			const phys::vec3 n = phys::truncate(p2_to_p1 * phys::vec4(f->normal(p2), 0.0_r));
+
+			return std::abs(phys::dot(std::get<vertex>(f1).v - to_p1(p2.vertices[f->vert(0)].v), n));
+		}
+
+		// A vertex is an edge that starts and ends at the same point
+		const auto as_segment = [](const polyhedron &p, const feature &f) {
+			if (std::holds_alternative<vertex>(f)) {
+				const phys::vec3 &v = std::get<vertex>(f).v;
+
+				return phys::line_segment{ v, v };
+			}
+
+			const edge &e = std::get<edge>(f);
+
+			return phys::line_segment{ e.t(p).v, e.h(p).v };
+		};
+
+		const phys::line_segment s1 = as_segment(p1, f1);
+		const phys::line_segment local_s2 = as_segment(p2, f2);
+		const phys::line_segment s2{ to_p1(local_s2.a), to_p1(local_s2.b) };
+		phys::real t1;
+		phys::real t2;
+
+		closest_between_segments(s1, s2, t1, t2);
+
+		const phys::vec3 diff = (s1.a + (s1.b - s1.a) * t1) - (s2.a + (s2.b - s2.a) * t2);
+
+		return std::sqrt(phys::dot(diff, diff));
+	}
+
+	// How far `p_inc` penetrates the plane of `f` on `p_ref`. Negative if every
+	// vertex of `p_inc` is in front of the face. `ref_to_inc` transforms `p_ref` into
+	// the space of `p_inc`, and only the plane is transformed.
+	phys::real face_overlap(
+		const phys::vclip::polyhedron &p_ref,
+		const phys::vclip::face &f,
+		const phys::mat4 &ref_to_inc,
+		const phys::vclip::polyhedron &p_inc
+	) {
+		const phys::vec3 n = phys::truncate(ref_to_inc * phys::vec4(f.normal(p_ref), 0.0_r));
+		const phys::vec3 pos = phys::truncate(ref_to_inc * phys::vec4(p_ref.vertices[f.vert(0)].v, 1.0_r));
+		const phys::real face_dist = phys::dot(n, pos);
+		phys::real min_dist = phys::infinity;
+
+		for (const phys::vclip::vertex &v : p_inc.vertices) {
+			min_dist = std::min(min_dist, phys::dot(n, v.v));
+		}
+
+		return face_dist - min_dist;
+	}
+
+	// Generates a contact for each vertex of the incident face (the face of
+	// `inc_p` that faces `ref_f` most directly) that is inside `ref_f`, after the
+	// incident face is clipped to the sides of `ref_f`. The polyhedra are in their
+	// own spaces: `inc_to_ref` and `ref_to_inc` transform between them, and
+	// `to_world` transforms `ref_p`'s space to world space. Clipping happens in
+	// `ref_p`'s space, so only the incident face's vertices are transformed.
+	void clip_to_reference_face(
+		const phys::vclip::polyhedron &ref_p,
+		const phys::vclip::face &ref_f,
+		const phys::vclip::polyhedron &inc_p,
+		const phys::mat4 &inc_to_ref,
+		const phys::mat4 &ref_to_inc,
+		bool is_ref_on_a,
+		const phys::mat4 &to_world,
+		phys::rigid_body * a,
+		phys::rigid_body * b,
+		phys::contact_container &contacts
+	) {
+		const phys::vec3 ref_n = ref_f.normal(ref_p);
+		const phys::vec3 ref_n_in_inc = phys::truncate(ref_to_inc * phys::vec4(ref_n, 0.0_r));
+		const phys::vclip::face * inc_f = &inc_p.faces[0];
+		phys::real min_alignment = phys::infinity;
+
+		for (const phys::vclip::face &f : inc_p.faces) {
+			const phys::real alignment = phys::dot(f.normal(inc_p), ref_n_in_inc);
+
+			if (alignment < min_alignment) {
+				min_alignment = alignment;
+				inc_f = &f;
+			}
+		}
+
+		clipped_face front{};
+		clipped_face back{};
 
-	sphere_sphere_collision =
-		[](primitive &_a, primitive &_b, contact_container &contacts) {
+		for (size_t v_i : inc_f->verts()) {
+			front.push_back(phys::truncate(inc_to_ref * phys::vec4(inc_p.vertices[v_i].v, 1.0_r)));
+		}
+
+		const size_t num_ref_verts = ref_f.num_verts();
+
+		for (size_t i = 0; i < num_ref_verts && ! front.empty(); i++) {
+			const phys::vec3 &t = ref_p.vertices[ref_f.vert(i)].v;
+			const phys::vec3 &h = ref_p.vertices[ref_f.vert((i + 1) % num_ref_verts)].v;
+
+			clip_face(front, back, t, phys::cross(h - t, ref_n));
+			std::swap(front, back);
+		}
+
+		const phys::vec3 ref_pos = ref_p.vertices[ref_f.vert(0)].v;
+		// Contact normals point from `a` to `b`
+		const phys::vec3 normal = phys::normalize(
+			phys::truncate(to_world * phys::vec4(is_ref_on_a ? ref_n : -ref_n, 0.0_r))
+		);
+
+		for (const phys::vec3 &p : front) {
+			const phys::real depth = phys::dot(ref_pos - p, ref_n);
+
+			if (depth < 0.0_r) {
+				continue;
+			}
+
+			// The contact is halfway between the incident point and the reference face
+			const phys::vec3 point = p + ref_n * (depth / 2.0_r);
+
+			contacts.insert(std::end(contacts), phys::contact(
+				a,
+				b,
+				phys::truncate(to_world * phys::vec4(point, 1.0_r)),
+				normal,
+				depth
+			));
+		}
+	}
+
+	// The polyhedron of a box or a convex hull in its own space
+	const phys::vclip::polyhedron& local_polyhedron(const phys::primitive &p) {
+		if (p.type == static_cast<int>(phys::shape_type::Box)) {
+			return static_cast<const phys::box&>(p).get_local_polyhedron();
+		}
+
+		return static_cast<const phys::convex_hull&>(p).get_local_polyhedron();
+	}
+
+	phys::gjk::shape_ref support_shape(const phys::primitive &p) {
+		switch (static_cast<phys::shape_type>(p.type)) {
+			case phys::shape_type::Sphere:
+				return static_cast<const phys::sphere&>(p);
+			case phys::shape_type::Box:
+				return static_cast<const phys::box&>(p);
+			case phys::shape_type::ConvexHull:
+				return static_cast<const phys::convex_hull&>(p);
+			case phys::shape_type::Capsule:
+				return static_cast<const phys::capsule&>(p);
+			case phys::shape_type::Cylinder:
+				return static_cast<const phys::cylinder&>(p);
+			default:
+				throw "No collision algorithm";
+		}
+	}
+
+	// Collides two convex polyhedra, `p_a` and `p_b`, which are the polyhedra of `a`
+	// and `b` in their own spaces. Neither polyhedron is copied or transformed, so
+	// V-Clip can use both adjacency tables. Points and planes are moved between the
+	// two spaces as they're needed instead.
+	//
+	// V-Clip tells us whether the polyhedra touch, but not how deeply they penetrate:
+	// it stops at the first face that a vertex or an edge is found to penetrate.
+	// The contacts come from the face that the other polyhedron penetrates the least.
+	void polyhedron_polyhedron(
+		phys::primitive &a,
+		const phys::vclip::polyhedron &p_a,
+		phys::primitive &b,
+		const phys::vclip::polyhedron &p_b,
+		phys::contact_container &contacts,
+		phys::feature_cache * cache
+	) {
+		const size_t max_steps = min_vclip_steps + p_a.vertices.size() + p_b.vertices.size();
+		const phys::mat4 a_to_world = a.body->get_transform() * a.offset;
+		const phys::mat4 b_to_world = b.body->get_transform() * b.offset;
+		const phys::mat4 b_to_a = a.get_inv_offset() * a.body->get_inv_transform() * b_to_world;
+		const phys::mat4 a_to_b = b.get_inv_offset() * b.body->get_inv_transform() * a_to_world;
+
+		const phys::vclip::algorithm_result result = cache ?
+			cache->closest_features(a, b, p_a, p_b, b_to_a, max_steps) :
+			phys::vclip::closest_features(p_a, p_b, b_to_a, p_a.vertices[0], p_b.vertices[0], max_steps);
+
+		if (
+			result.state.step == phys::vclip::algorithm_step::Done &&
+			feature_dist(p_a, result.state.f1, p_b, result.state.f2, b_to_a) > touching_dist
+		) {
+			return;
+		}
+
+		const phys::vclip::face * ref_f = nullptr;
+		bool is_ref_on_a = true;
+		phys::real min_overlap = phys::infinity;
+
+		for (const phys::vclip::face &f : p_a.faces) {
+			const phys::real overlap = face_overlap(p_a, f, a_to_b, p_b);
+
+			if (overlap < min_overlap) {
+				min_overlap = overlap;
+				ref_f = &f;
+			}
+		}
+
+		// Faces of `a` are preferred so that the reference face doesn't flip between
+		// the polyhedra from one frame to the next
+		const phys::real a_overlap = min_overlap;
+
+		for (const phys::vclip::face &f : p_b.faces) {
+			const phys::real overlap = face_overlap(p_b, f, b_to_a, p_a);
+
+			if (overlap < min_overlap && overlap < a_overlap * 0.98_r - 0.001_r) {
+				min_overlap = overlap;
+				ref_f = &f;
+				is_ref_on_a = false;
+			}
+		}
+
+		if (min_overlap < 0.0_r) {
+			return;
+		}
+
+		if (is_ref_on_a) {
+			clip_to_reference_face(p_a, *ref_f, p_b, b_to_a, a_to_b, true, a_to_world, a.body, b.body, contacts);
+		} else {
+			clip_to_reference_face(p_b, *ref_f, p_a, a_to_b, b_to_a, false, b_to_world, a.body, b.body, contacts);
+		}
+	}
+}
+
+namespace phys::algorithms {
+	namespace {
+		void sphere_sphere(primitive &_a, primitive &_b, contact_container &contacts) {
 			sphere &a = static_cast<sphere&>(_a);
 			sphere &b = static_cast<sphere&>(_b);
 
@@ -61,10 +412,9 @@ void phys::algorithms::init_algorithms() {
 			);
 
 			contacts.insert(std::end(contacts), c);
-		};
+		}
 
-	sphere_plane_collision =
-		[](primitive &_a, primitive &_b, contact_container &contacts) {
+		void sphere_plane(primitive &_a, primitive &_b, contact_container &contacts) {
 			sphere &s = static_cast<sphere&>(_a);
 			plane &p = static_cast<plane&>(_b);
 
@@ -76,29 +426,30 @@ void phys::algorithms::init_algorithms() {
 				return;
 			}
 
-			vec3 contact_pt = s_pos + p.normal * diff;
+			// The normal points from the sphere to the plane, so it depends on which
+			// side of the plane the sphere is on
+			vec3 normal = overlap < p.offset ? p.normal : -p.normal;
+			vec3 contact_pt = s_pos + normal * diff;
 
 			contact c(
 				s.body,
 				p.body,
 				contact_pt,
-				p.normal,
+				normal,
 				s.radius - diff
 			);
 
 			contacts.insert(std::end(contacts), c);
-		};
+		}
 
-	plane_plane_collision =
-		[](primitive&, primitive&, contact_container&) {
+		void plane_plane(primitive&, primitive&, contact_container&) {
 			// Infinite planes are always in contact unless they're perfectly
 			// parallel, so this type of collision probably isn't very useful
 			// and we can ignore it
-		};
+		}
 
-	plane_box_collision =
-		[](primitive &a, primitive &_b, contact_container &contacts) {
-			static std::array<pos_and_dist, 8> plane_dists{};
+		void plane_box(primitive &a, primitive &_b, contact_container &contacts) {
+			std::array<pos_and_dist, 8> plane_dists{};
 
 			plane &p = static_cast<plane&>(a);
 			box &b = static_cast<box&>(_b);
@@ -150,10 +501,47 @@ void phys::algorithms::init_algorithms() {
 
 				contacts.insert(std::end(contacts), c);
 			}
-		};
+		}
 
-	sphere_box_collision =
-		[](primitive &a, primitive &_b, contact_container &contacts) {
+		void plane_convex_hull(primitive &a, primitive &_b, contact_container &contacts) {
+			plane &p = static_cast<plane&>(a);
+			convex_hull &h = static_cast<convex_hull&>(_b);
+
+			const vclip::polyhedron &local = h.get_local_polyhedron();
+			const mat4 transform = h.body->get_transform() * h.offset;
+			vec3 centroid{};
+
+			for (const vclip::vertex &v : local.vertices) {
+				centroid += v.v;
+			}
+
+			centroid = truncate(transform * vec4(centroid / (real)local.vertices.size(), 1.0_r));
+
+			// As with boxes, the side of the plane that the hull's center is on is
+			// the side that it's colliding from
+			const bool center_diff_side = dist_from_plane(centroid, p.normal, p.offset) < 0.0_r;
+
+			for (const vclip::vertex &v : local.vertices) {
+				const vec3 pos = truncate(transform * vec4(v.v, 1.0_r));
+				const real dist = dist_from_plane(pos, p.normal, p.offset);
+
+				if ((dist < 0.0_r) == center_diff_side) {
+					continue;
+				}
+
+				contact c(
+					h.body,
+					p.body,
+					pos,
+					center_diff_side ? -p.normal : p.normal,
+					std::abs(dist)
+				);
+
+				contacts.insert(std::end(contacts), c);
+			}
+		}
+
+		void sphere_box(primitive &a, primitive &_b, contact_container &contacts) {
 			sphere &s = static_cast<sphere&>(a);
 			box &b = static_cast<box&>(_b);
 
@@ -196,10 +584,407 @@ void phys::algorithms::init_algorithms() {
 			);
 
 			contacts.insert(std::end(contacts), c);
-		};
+		}
 
-	box_box_collision =
-		[](primitive&, primitive&, contact_container&) {
-			// TODO: Implement this
-		};
+		void box_box(primitive &a, primitive &b, contact_container &contacts) {
+			polyhedron_polyhedron(a, local_polyhedron(a), b, local_polyhedron(b), contacts, nullptr);
+		}
+
+		void gjk_epa(primitive &a, primitive &b, contact_container &contacts) {
+			const gjk::penetration_result result = gjk::penetration(support_shape(a), support_shape(b));
+
+			if (! result.is_intersecting) {
+				return;
+			}
+
+			contact c(
+				a.body,
+				b.body,
+				(result.point_a + result.point_b) / 2.0_r,
+				result.normal,
+				result.depth
+			);
+
+			contacts.insert(std::end(contacts), c);
+		}
+
+		// Adds a contact between two spheres if they overlap. `fallback_normal` is
+		// used if the centers are in the same place.
+		void sphere_sphere_contact(
+			rigid_body * body_a,
+			const vec3 &center_a,
+			real radius_a,
+			rigid_body * body_b,
+			const vec3 &center_b,
+			real radius_b,
+			const vec3 &fallback_normal,
+			contact_container &contacts
+		) {
+			const vec3 d_vec = center_b - center_a;
+			const real d = std::sqrt(dot(d_vec, d_vec));
+			const real min_radius = radius_a + radius_b;
+
+			if (d >= min_radius) {
+				return;
+			}
+
+			const vec3 normal = d > 0.0_r ? d_vec / d : fallback_normal;
+			const real penetration = min_radius - d;
+
+			contact c(
+				body_a,
+				body_b,
+				center_a + normal * (radius_a - penetration / 2.0_r),
+				normal,
+				penetration
+			);
+
+			contacts.insert(std::end(contacts), c);
+		}
+
+		void sphere_capsule(primitive &_a, primitive &_b, contact_container &contacts) {
+			sphere &s = static_cast<sphere&>(_a);
+			capsule &c = static_cast<capsule&>(_b);
+
+			const vec3 s_pos = s.body->pos + truncate(s.offset[3]);
+			const line_segment seg = c.get_segment();
+			const vec3 closest = point_on(seg, closest_on_segment(s_pos, seg));
+
+			sphere_sphere_contact(
+				s.body,
+				s_pos,
+				s.radius,
+				c.body,
+				closest,
+				c.radius,
+				any_perpendicular(seg.b - seg.a),
+				contacts
+			);
+		}
+
+		void plane_capsule(primitive &a, primitive &_b, contact_container &contacts) {
+			plane &p = static_cast<plane&>(a);
+			capsule &c = static_cast<capsule&>(_b);
+
+			const line_segment seg = c.get_segment();
+			// As with boxes, the side of the plane that the capsule's center is on is
+			// the side that it's colliding from
+			const bool center_diff_side = dist_from_plane((seg.a + seg.b) / 2.0_r, p.normal, p.offset) < 0.0_r;
+			const vec3 normal = center_diff_side ? -p.normal : p.normal;
+
+			// A capsule resting on a plane touches it at both ends
+			for (const vec3 &end : { seg.a, seg.b }) {
+				const real dist = dist_from_plane(end, p.normal, p.offset);
+				const real height = center_diff_side ? -dist : dist;
+
+				if (height >= c.radius) {
+					continue;
+				}
+
+				contact ct(
+					c.body,
+					p.body,
+					end + normal * c.radius,
+					normal,
+					c.radius - height
+				);
+
+				contacts.insert(std::end(contacts), ct);
+			}
+		}
+
+		void capsule_capsule(primitive &_a, primitive &_b, contact_container &contacts) {
+			capsule &a = static_cast<capsule&>(_a);
+			capsule &b = static_cast<capsule&>(_b);
+
+			const line_segment seg_a = a.get_segment();
+			const line_segment seg_b = b.get_segment();
+			const vec3 d_a = seg_a.b - seg_a.a;
+			const vec3 d_b = seg_b.b - seg_b.a;
+			const real len_sqr_a = dot(d_a, d_a);
+			const real len_sqr_b = dot(d_b, d_b);
+			const vec3 axis_cross = cross(d_a, d_b);
+			const vec3 fallback_normal = dot(axis_cross, axis_cross) > 0.0_r ?
+				normalize(axis_cross) :
+				any_perpendicular(len_sqr_a > 0.0_r ? d_a : vec3(0.0_r, 1.0_r, 0.0_r));
+
+			// Capsules that lie side by side touch along a line, so they get a contact
+			// at each end of the part of `a` that is beside `b`
+			if (
+				len_sqr_a > 0.0_r &&
+				len_sqr_b > 0.0_r &&
+				dot(axis_cross, axis_cross) <= 0.000001_r * len_sqr_a * len_sqr_b
+			) {
+				const real t_1 = dot(seg_b.a - seg_a.a, d_a) / len_sqr_a;
+				const real t_2 = dot(seg_b.b - seg_a.a, d_a) / len_sqr_a;
+				const real lo = std::clamp(std::min(t_1, t_2), 0.0_r, 1.0_r);
+				const real hi = std::clamp(std::max(t_1, t_2), 0.0_r, 1.0_r);
+
+				if (hi - lo > 0.001_r) {
+					for (const real t : { lo, hi }) {
+						const vec3 p_a = point_on(seg_a, t);
+						const vec3 p_b = point_on(seg_b, closest_on_segment(p_a, seg_b));
+
+						sphere_sphere_contact(a.body, p_a, a.radius, b.body, p_b, b.radius, fallback_normal, contacts);
+					}
+
+					return;
+				}
+			}
+
+			real t_a{};
+			real t_b{};
+
+			closest_between_segments(seg_a, seg_b, t_a, t_b);
+			sphere_sphere_contact(
+				a.body,
+				point_on(seg_a, t_a),
+				a.radius,
+				b.body,
+				point_on(seg_b, t_b),
+				b.radius,
+				fallback_normal,
+				contacts
+			);
+		}
+
+		void box_capsule(primitive &a, primitive &_b, contact_container &contacts) {
+			box &bx = static_cast<box&>(a);
+			capsule &c = static_cast<capsule&>(_b);
+
+			const mat4 to_world = bx.body->get_transform() * bx.offset;
+			const mat4 to_box = bx.get_inv_offset() * bx.body->get_inv_transform();
+			const line_segment world_seg = c.get_segment();
+			const line_segment seg{
+				truncate(to_box * vec4(world_seg.a, 1.0_r)),
+				truncate(to_box * vec4(world_seg.b, 1.0_r))
+			};
+			const vec3 &h = bx.half_size;
+
+			// The point of the segment closest to the box is at one of its ends, or
+			// at the point closest to one of the box's edges
+			std::array<real, 14> candidates{ 0.0_r, 1.0_r };
+			size_t num_candidates = 2;
+
+			for (int axis = 0; axis < 3; axis++) {
+				const int u = (axis + 1) % 3;
+				const int v = (axis + 2) % 3;
+
+				for (const real sign_u : { -1.0_r, 1.0_r }) {
+					for (const real sign_v : { -1.0_r, 1.0_r }) {
+						line_segment edge{};
+						real t_seg{};
+						real t_edge{};
+
+						edge.a[axis] = -h[axis];
+						edge.b[axis] = h[axis];
+						edge.a[u] = edge.b[u] = sign_u * h[u];
+						edge.a[v] = edge.b[v] = sign_v * h[v];
+
+						closest_between_segments(seg, edge, t_seg, t_edge);
+						candidates[num_candidates++] = t_seg;
+					}
+				}
+			}
+
+			const auto dist_to_box = [&](real t, vec3 &closest) {
+				const vec3 p = point_on(seg, t);
+
+				closest = clamp(p, -h, h);
+
+				return std::sqrt(dot(p - closest, p - closest));
+			};
+
+			size_t best = 0;
+			real best_dist = infinity;
+			vec3 closest{};
+
+			for (size_t i = 0; i < num_candidates; i++) {
+				const real dist = dist_to_box(candidates[i], closest);
+
+				if (dist < best_dist) {
+					best_dist = dist;
+					best = i;
+				}
+			}
+
+			if (best_dist >= c.radius) {
+				return;
+			}
+
+			// The segment is inside the box, so the penetration can't be found from
+			// the closest points
+			if (best_dist <= 0.000001_r) {
+				gjk_epa(a, _b, contacts);
+				return;
+			}
+
+			std::swap(candidates[0], candidates[best]);
+
+			// A capsule lying on a face touches it in more than one place, so every
+			// candidate that is close enough gets a contact unless it's next to one
+			// that already has one
+			for (size_t i = 0; i < num_candidates; i++) {
+				const bool is_duplicate = std::any_of(std::begin(candidates), std::begin(candidates) + i, [&](real t) {
+					return std::abs(t - candidates[i]) < 0.01_r;
+				});
+
+				if (is_duplicate) {
+					continue;
+				}
+
+				const real dist = dist_to_box(candidates[i], closest);
+
+				if (dist >= c.radius) {
+					continue;
+				}
+
+				const vec3 local_normal = (point_on(seg, candidates[i]) - closest) / dist;
+
+				contact ct(
+					bx.body,
+					c.body,
+					truncate(to_world * vec4(closest, 1.0_r)),
+					normalize(truncate(to_world * vec4(local_normal, 0.0_r))),
+					c.radius - dist
+				);
+
+				contacts.insert(std::end(contacts), ct);
+			}
+		}
+
+		void plane_cylinder(primitive &a, primitive &_b, contact_container &contacts) {
+			plane &p = static_cast<plane&>(a);
+			cylinder &c = static_cast<cylinder&>(_b);
+
+			const line_segment axis = c.get_axis();
+			const vec3 u = normalize(truncate((c.body->get_transform() * c.offset)[1]));
+			const bool center_diff_side = dist_from_plane((axis.a + axis.b) / 2.0_r, p.normal, p.offset) < 0.0_r;
+			const vec3 normal = center_diff_side ? -p.normal : p.normal;
+			// The point of each cap's rim that is deepest in the plane is in the
+			// direction of the normal, away from the axis. The points a quarter turn
+			// around the rim keep a cylinder standing on its cap from tipping.
+			const vec3 radial = normal - u * dot(normal, u);
+			const vec3 w_1 = dot(radial, radial) > 0.00000001_r ? normalize(radial) : any_perpendicular(u);
+			const vec3 w_2 = cross(u, w_1);
+
+			for (const vec3 &cap : { axis.a, axis.b }) {
+				for (const vec3 &dir : { w_1, -w_1, w_2, -w_2 }) {
+					const vec3 pos = cap + dir * c.radius;
+					const real dist = dist_from_plane(pos, p.normal, p.offset);
+
+					if ((dist < 0.0_r) == center_diff_side) {
+						continue;
+					}
+
+					contact ct(
+						c.body,
+						p.body,
+						pos,
+						normal,
+						std::abs(dist)
+					);
+
+					contacts.insert(std::end(contacts), ct);
+				}
+			}
+		}
+
+		// Runs a collision algorithm for every pair in a batch. The algorithm is
+		// called directly, so it can be inlined.
+		template <void (*Func)(primitive&, primitive&, contact_container&)>
+		void run_batch(void *, std::span<const collision_pair> pairs, contact_container &contacts, std::span<size_t> ends) {
+			for (size_t i = 0; i < pairs.size(); i++) {
+				Func(*pairs[i].a, *pairs[i].b, contacts);
+				ends[i] = contacts.size();
+			}
+		}
+
+		// `ctx` is a `feature_cache`
+		void run_cached_batch(void * ctx, std::span<const collision_pair> pairs, contact_container &contacts, std::span<size_t> ends) {
+			feature_cache * cache = static_cast<feature_cache *>(ctx);
+
+			for (size_t i = 0; i < pairs.size(); i++) {
+				primitive &a = *pairs[i].a;
+				primitive &b = *pairs[i].b;
+
+				polyhedron_polyhedron(a, local_polyhedron(a), b, local_polyhedron(b), contacts, cache);
+				ends[i] = contacts.size();
+			}
+		}
+	}
+}
+
+phys::collision_algorithm_func phys::algorithms::sphere_sphere_collision;
+phys::collision_algorithm_func phys::algorithms::sphere_plane_collision;
+phys::collision_algorithm_func phys::algorithms::plane_plane_collision;
+phys::collision_algorithm_func phys::algorithms::plane_box_collision;
+phys::collision_algorithm_func phys::algorithms::sphere_box_collision;
+phys::collision_algorithm_func phys::algorithms::box_box_collision;
+phys::collision_algorithm_func phys::algorithms::plane_convex_hull_collision;
+phys::collision_algorithm_func phys::algorithms::box_convex_hull_collision;
+phys::collision_algorithm_func phys::algorithms::convex_hull_convex_hull_collision;
+phys::collision_algorithm_func phys::algorithms::sphere_capsule_collision;
+phys::collision_algorithm_func phys::algorithms::plane_capsule_collision;
+phys::collision_algorithm_func phys::algorithms::box_capsule_collision;
+phys::collision_algorithm_func phys::algorithms::capsule_capsule_collision;
+phys::collision_algorithm_func phys::algorithms::plane_cylinder_collision;
+phys::collision_algorithm_func phys::algorithms::gjk_collision;
+
+const phys::batch_collision_algorithm phys::algorithms::sphere_sphere_batch{ run_batch<sphere_sphere> };
+const phys::batch_collision_algorithm phys::algorithms::sphere_plane_batch{ run_batch<sphere_plane> };
+const phys::batch_collision_algorithm phys::algorithms::plane_plane_batch{ run_batch<plane_plane> };
+const phys::batch_collision_algorithm phys::algorithms::plane_box_batch{ run_batch<plane_box> };
+const phys::batch_collision_algorithm phys::algorithms::sphere_box_batch{ run_batch<sphere_box> };
+const phys::batch_collision_algorithm phys::algorithms::box_box_batch{ run_batch<box_box> };
+const phys::batch_collision_algorithm phys::algorithms::plane_convex_hull_batch{ run_batch<plane_convex_hull> };
+const phys::batch_collision_algorithm phys::algorithms::box_convex_hull_batch{ run_batch<box_box> };
+const phys::batch_collision_algorithm phys::algorithms::convex_hull_convex_hull_batch{ run_batch<box_box> };
+const phys::batch_collision_algorithm phys::algorithms::sphere_capsule_batch{ run_batch<sphere_capsule> };
+const phys::batch_collision_algorithm phys::algorithms::plane_capsule_batch{ run_batch<plane_capsule> };
+const phys::batch_collision_algorithm phys::algorithms::box_capsule_batch{ run_batch<box_capsule> };
+const phys::batch_collision_algorithm phys::algorithms::capsule_capsule_batch{ run_batch<capsule_capsule> };
+const phys::batch_collision_algorithm phys::algorithms::plane_cylinder_batch{ run_batch<plane_cylinder> };
+const phys::batch_collision_algorithm phys::algorithms::gjk_batch{ run_batch<gjk_epa> };
+
+void phys::algorithms::init_algorithms() {
+	if (initialized) {
+		return;
+	}
+
+	initialized = true;
+
+	sphere_sphere_collision = sphere_sphere;
+	sphere_plane_collision = sphere_plane;
+	plane_plane_collision = plane_plane;
+	plane_box_collision = plane_box;
+	sphere_box_collision = sphere_box;
+	box_box_collision = box_box;
+	plane_convex_hull_collision = plane_convex_hull;
+	box_convex_hull_collision = box_box;
+	convex_hull_convex_hull_collision = box_box;
+	sphere_capsule_collision = sphere_capsule;
+	plane_capsule_collision = plane_capsule;
+	box_capsule_collision = box_capsule;
+	capsule_capsule_collision = capsule_capsule;
+	plane_cylinder_collision = plane_cylinder;
+	gjk_collision = gjk_epa;
+}
+
+phys::collision_algorithm_func phys::algorithms::cached_box_box_collision(feature_cache &cache) {
+	return [&cache](primitive &a, primitive &b, contact_container &contacts) {
+		polyhedron_polyhedron(a, local_polyhedron(a), b, local_polyhedron(b), contacts, &cache);
+	};
+}
+
+phys::collision_algorithm_func phys::algorithms::cached_convex_hull_collision(feature_cache &cache) {
+	return cached_box_box_collision(cache);
+}
+
+phys::batch_collision_algorithm phys::algorithms::cached_box_box_batch(feature_cache &cache) {
+	return batch_collision_algorithm{ run_cached_batch, &cache };
+}
+
+phys::batch_collision_algorithm phys::algorithms::cached_convex_hull_batch(feature_cache &cache) {
+	return cached_box_box_batch(cache);
 }
\ No newline at end of file
@@ -14,6 +14,19 @@ phys::bounding_sphere::bounding_sphere(const bounding_sphere &a, const bounding_
 	vec3 d_vec = b.center - a.center;
 	real d_len = std::sqrt(dot(d_vec, d_vec));
 
+	// If one sphere contains the other, then the larger sphere is already the
+	// smallest enclosing sphere. This also covers the case where both spheres have
+	// the same center, where `d_vec` can't be normalized.
+	if (d_len + b.radius <= a.radius) {
+		center = a.center;
+		radius = a.radius;
+		return;
+	} else if (d_len + a.radius <= b.radius) {
+		center = b.center;
+		radius = b.radius;
+		return;
+	}
+
 	real c = ((d_len + a.radius + b.radius) / 2.0_r) - a.radius;
 
 	d_vec /= d_len;
@@ -29,16 +42,88 @@ bool phys::bounding_sphere::overlaps(const bounding_sphere &other) const {
 	return dsqr <= (other.radius + radius) * (other.radius + radius);
 }
 
+bool phys::bounding_sphere::contains(const bounding_sphere &other) const {
+	vec3 d_vec = other.center - center;
+	real d_len = std::sqrt(dot(d_vec, d_vec));
+
+	return d_len + other.radius <= radius;
+}
+
 phys::real phys::bounding_sphere::growth(const bounding_sphere &other) const {
 	const bounding_sphere overlap(*this, other);
 
 	return overlap.volume() - volume();
 }
 
+phys::bounding_sphere phys::bounding_sphere::enlarged(real margin) const {
+	return bounding_sphere(center, radius + margin);
+}
+
+phys::vec3 phys::bounding_sphere::centroid() const {
+	return center;
+}
+
+phys::real phys::bounding_sphere::surface_area() const {
+	return 4.0_r * (real)M_PI * radius * radius;
+}
+
 phys::real phys::bounding_sphere::volume() const {
 	return 4.0_r * (real)M_PI * radius * radius * radius / 3.0_r;
 }
 
 bool phys::operator==(const bounding_sphere &a, const bounding_sphere &b) {
 	return std::tie(a.center, a.radius) == std::tie(b.center, b.radius);
-}
\ No newline at end of file
+}
+
+phys::aabb::aabb(const vec3 &_min, const vec3 &_max) :
+	min(_min),
+	max(_max)
+{}
+
+phys::aabb::aabb(const aabb &a, const aabb &b) :
+	min(glm::min(a.min, b.min)),
+	max(glm::max(a.max, b.max))
+{}
+
+phys::aabb::aabb(const bounding_sphere &sphere) :
+	min(sphere.center - vec3(sphere.radius)),
+	max(sphere.center + vec3(sphere.radius))
+{}
+
+bool phys::aabb::overlaps(const aabb &other) const {
+	// Non-short-circuiting `&` so that all six comparisons are done without
+	// branching
+	return (min.x <= other.max.x) & (other.min.x <= max.x) &
+		(min.y <= other.max.y) & (other.min.y <= max.y) &
+		(min.z <= other.max.z) & (other.min.z <= max.z);
+}
+
+bool phys::aabb::contains(const aabb &other) const {
+	return (min.x <= other.min.x) & (other.max.x <= max.x) &
+		(min.y <= other.min.y) & (other.max.y <= max.y) &
+		(min.z <= other.min.z) & (other.max.z <= max.z);
+}
+
+phys::real phys::aabb::growth(const aabb &other) const {
+	const aabb merged(*this, other);
+
+	return merged.surface_area() - surface_area();
+}
+
+phys::aabb phys::aabb::enlarged(real margin) const {
+	return aabb(min - vec3(margin), max + vec3(margin));
+}
+
+phys::vec3 phys::aabb::centroid() const {
+	return (min + max) * 0.5_r;
+}
+
+phys::real phys::aabb::surface_area() const {
+	const vec3 d = max - min;
+
+	return 2.0_r * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+bool phys::operator==(const aabb &a, const aabb &b) {
+	return std::tie(a.min, a.max) == std::tie(b.min, b.max);
+}
@@ -0,0 +1,90 @@
+#include <algorithm>
+#include "physics/collision/contact_cache.h"
+
+using namespace phys::literals;
+
+phys::contact_cache::contact_cache(real _matching_distance) :
+	matching_distance(_matching_distance)
+{}
+
+void phys::contact_cache::begin_frame() {
+	frame++;
+}
+
+void phys::contact_cache::warm_start(const primitive &a, const primitive &b, std::span<contact> contacts) {
+	manifold &m = manifolds[make_pair(a, b)];
+	const real max_dist_sqr = matching_distance * matching_distance;
+
+	m.last_frame = frame;
+
+	for (contact &c : contacts) {
+		const vec3 local_point = to_local(c);
+		const cached_contact * closest = nullptr;
+		real closest_dist_sqr = max_dist_sqr;
+
+		for (size_t i = 0; i < m.num_contacts; i++) {
+			const vec3 diff = m.contacts[i].local_point - local_point;
+			const real dist_sqr = dot(diff, diff);
+
+			if (dist_sqr < closest_dist_sqr) {
+				closest = &m.contacts[i];
+				closest_dist_sqr = dist_sqr;
+			}
+		}
+
+		if (closest) {
+			c.normal_impulse = closest->normal_impulse;
+			c.tangent_impulse = closest->tangent_impulse;
+		}
+	}
+}
+
+void phys::contact_cache::store(const primitive &a, const primitive &b, std::span<const contact> contacts) {
+	auto it = manifolds.find(make_pair(a, b));
+
+	if (it == std::end(manifolds)) {
+		return;
+	}
+
+	manifold &m = it->second;
+
+	m.num_contacts = std::min(contacts.size(), max_contacts_per_pair);
+
+	for (size_t i = 0; i < m.num_contacts; i++) {
+		m.contacts[i] = cached_contact{
+			to_local(contacts[i]),
+			contacts[i].normal_impulse,
+			contacts[i].tangent_impulse
+		};
+	}
+}
+
+void phys::contact_cache::end_frame() {
+	std::erase_if(manifolds, [&](const auto &entry) {
+		return entry.second.last_frame != frame;
+	});
+}
+
+void phys::contact_cache::clear() {
+	manifolds.clear();
+}
+
+size_t phys::contact_cache::size() const {
+	return manifolds.size();
+}
+
+phys::primitive_pair phys::contact_cache::make_pair(const primitive &a, const primitive &b) {
+	if (&a < &b) {
+		return primitive_pair{ &a, &b };
+	}
+
+	return primitive_pair{ &b, &a };
+}
+
+phys::vec3 phys::contact_cache::to_local(const contact &c) {
+	if (! c.a) {
+		return c.point;
+	}
+
+	return truncate(c.a->get_inv_transform() * vec4(c.point, 1.0_r));
+}
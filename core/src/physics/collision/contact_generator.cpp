@@ -1,5 +1,8 @@
+#include <array>
+#include <stdexcept>
 #include "physics/collision/algorithms.h"
 #include "physics/collision/contact_generator.h"
+#include "physics/thread_pool.h"
 
 phys::collision_algorithm::collision_algorithm(
 	int _shape_type_1,
@@ -11,6 +14,16 @@ phys::collision_algorithm::collision_algorithm(
 	algorithm(_algorithm)
 {}
 
+phys::collision_algorithm::collision_algorithm(
+	int _shape_type_1,
+	int _shape_type_2,
+	const batch_collision_algorithm &_batch
+) :
+	shape_type_1(_shape_type_1),
+	shape_type_2(_shape_type_2),
+	batch(_batch)
+{}
+
 phys::contact_generator::contact_generator() {
 	// TODO: Move this somewhere else
 	phys::algorithms::init_algorithms();
@@ -18,32 +31,102 @@ phys::contact_generator::contact_generator() {
 	register_collision_algorithm(
 		shape_type::Sphere,
 		shape_type::Sphere,
-		phys::algorithms::sphere_sphere_collision
+		phys::algorithms::sphere_sphere_batch
 	);
 	register_collision_algorithm(
 		shape_type::Sphere,
 		shape_type::Plane,
-		phys::algorithms::sphere_plane_collision
+		phys::algorithms::sphere_plane_batch
 	);
 	register_collision_algorithm(
 		shape_type::Plane,
 		shape_type::Plane,
-		phys::algorithms::plane_plane_collision
+		phys::algorithms::plane_plane_batch
 	);
 	register_collision_algorithm(
 		shape_type::Plane,
 		shape_type::Box,
-		phys::algorithms::plane_box_collision
+		phys::algorithms::plane_box_batch
 	);
 	register_collision_algorithm(
 		shape_type::Sphere,
 		shape_type::Box,
-		phys::algorithms::sphere_box_collision
+		phys::algorithms::sphere_box_batch
+	);
+	register_collision_algorithm(
+		shape_type::Box,
+		shape_type::Box,
+		phys::algorithms::box_box_batch
+	);
+	register_collision_algorithm(
+		shape_type::Plane,
+		shape_type::ConvexHull,
+		phys::algorithms::plane_convex_hull_batch
+	);
+	register_collision_algorithm(
+		shape_type::Box,
+		shape_type::ConvexHull,
+		phys::algorithms::box_convex_hull_batch
+	);
+	register_collision_algorithm(
+		shape_type::ConvexHull,
+		shape_type::ConvexHull,
+		phys::algorithms::convex_hull_convex_hull_batch
+	);
+	register_collision_algorithm(
+		shape_type::Sphere,
+		shape_type::Capsule,
+		phys::algorithms::sphere_capsule_batch
+	);
+	register_collision_algorithm(
+		shape_type::Plane,
+		shape_type::Capsule,
+		phys::algorithms::plane_capsule_batch
 	);
 	register_collision_algorithm(
 		shape_type::Box,
+		shape_type::Capsule,
+		phys::algorithms::box_capsule_batch
+	);
+	register_collision_algorithm(
+		shape_type::ConvexHull,
+		shape_type::Capsule,
+		phys::algorithms::gjk_batch
+	);
+	register_collision_algorithm(
+		shape_type::Capsule,
+		shape_type::Capsule,
+		phys::algorithms::capsule_capsule_batch
+	);
+	register_collision_algorithm(
+		shape_type::Sphere,
+		shape_type::Cylinder,
+		phys::algorithms::gjk_batch
+	);
+	register_collision_algorithm(
+		shape_type::Plane,
+		shape_type::Cylinder,
+		phys::algorithms::plane_cylinder_batch
+	);
+	register_collision_algorithm(
 		shape_type::Box,
-		phys::algorithms::box_box_collision
+		shape_type::Cylinder,
+		phys::algorithms::gjk_batch
+	);
+	register_collision_algorithm(
+		shape_type::ConvexHull,
+		shape_type::Cylinder,
+		phys::algorithms::gjk_batch
+	);
+	register_collision_algorithm(
+		shape_type::Capsule,
+		shape_type::Cylinder,
+		phys::algorithms::gjk_batch
+	);
+	register_collision_algorithm(
+		shape_type::Cylinder,
+		shape_type::Cylinder,
+		phys::algorithms::gjk_batch
 	);
 }
 
@@ -52,27 +135,124 @@ void phys::contact_generator::generate_contacts(
 	primitive &b,
 	contact_container &contacts
 ) const {
-	if (a.type >= max_shapes || b.type >= max_shapes) {
-		// TODO: Errors
-		throw "Invalid shape type";
-	}
+	const collision_algorithm &alg = find_algorithm(a, b);
 
 	int shape_type_1 = std::min(a.type, b.type);
 	int shape_type_2 = std::max(a.type, b.type);
 	primitive &shape_1 = a.type == shape_type_1 ? a : b;
 	primitive &shape_2 = b.type == shape_type_2 ? b : a;
 
-	assert(shape_type_1 < max_shapes);
-	assert(shape_type_2 < max_shapes);
+	if (alg.algorithm) {
+		alg.algorithm(shape_1, shape_2, contacts);
+	} else {
+		const collision_pair pair{ &shape_1, &shape_2 };
+		size_t end{};
+
+		alg.batch.run(alg.batch.ctx, std::span(&pair, 1), contacts, std::span(&end, 1));
+	}
+}
+
+void phys::contact_generator::generate_contacts(
+	std::span<const collision_pair> pairs,
+	contact_container &contacts,
+	std::vector<contact_range> &ranges
+) const {
+	// These are kept for each thread so that they aren't reallocated for every
+	// batch
+	thread_local std::vector<collision_pair> sorted_pairs{};
+	thread_local std::vector<size_t> ends{};
+
+	const bucket_offsets offsets = sort_pairs(pairs, sorted_pairs);
+
+	ends.resize(pairs.size());
+	ranges.reserve(ranges.size() + pairs.size());
+
+	for (size_t bucket = 0; bucket < num_buckets; bucket++) {
+		const size_t begin = offsets[bucket];
+		const size_t end = offsets[bucket + 1];
+
+		if (begin == end) {
+			continue;
+		}
 
-	const collision_algorithm &alg = algs[shape_type_1][shape_type_2];
+		const collision_algorithm &alg = algs[bucket / max_shapes][bucket % max_shapes];
+		const std::span<const collision_pair> batch(std::begin(sorted_pairs) + begin, std::begin(sorted_pairs) + end);
+		const std::span<size_t> batch_ends(std::begin(ends) + begin, std::begin(ends) + end);
+		size_t range_begin = contacts.size();
 
-	if (! alg.algorithm) {
-		// TODO: Errors
-		throw "No collision algorithm";
+		if (alg.batch.run) {
+			alg.batch.run(alg.batch.ctx, batch, contacts, batch_ends);
+		} else {
+			for (size_t i = 0; i < batch.size(); i++) {
+				alg.algorithm(*batch[i].a, *batch[i].b, contacts);
+				batch_ends[i] = contacts.size();
+			}
+		}
+
+		for (size_t i = 0; i < batch.size(); i++) {
+			ranges.push_back(contact_range{ batch[i].a, batch[i].b, range_begin, batch_ends[i] });
+			range_begin = batch_ends[i];
+		}
 	}
+}
+
+void phys::contact_generator::generate_contacts(
+	thread_pool &pool,
+	std::span<const collision_pair> pairs,
+	contact_container &contacts,
+	std::vector<contact_range> &ranges,
+	size_t grain
+) const {
+	struct chunk_output {
+		contact_container contacts{};
+		std::vector<contact_range> ranges{};
+	};
+
+	// These belong to the thread that calls this function. The workers use them
+	// through the spans below, because a worker that named them would get its own.
+	thread_local std::vector<collision_pair> sorted_pairs{};
+	thread_local std::vector<chunk_output> chunks{};
+
+	assert(grain);
+
+	// Sorting the pairs first means that the chunks are collided in the same order
+	// as they would be on one thread. It also throws here for pairs without an
+	// algorithm, instead of on a worker.
+	sort_pairs(pairs, sorted_pairs);
 
-	alg.algorithm(shape_1, shape_2, contacts);
+	const size_t num_chunks = (pairs.size() + grain - 1) / grain;
+
+	if (chunks.size() < num_chunks) {
+		chunks.resize(num_chunks);
+	}
+
+	const std::span<const collision_pair> sorted(sorted_pairs);
+	const std::span<chunk_output> outputs(std::begin(chunks), num_chunks);
+
+	pool.parallel_for(num_chunks, 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			const size_t first = i * grain;
+			chunk_output &out = outputs[i];
+
+			out.contacts.clear();
+			out.ranges.clear();
+			generate_contacts(sorted.subspan(first, std::min(grain, sorted.size() - first)), out.contacts, out.ranges);
+		}
+	});
+
+	// The chunks are joined in order, so the contacts don't depend on which thread
+	// collided which chunk
+	ranges.reserve(ranges.size() + pairs.size());
+
+	for (const chunk_output &out : outputs) {
+		const size_t offset = contacts.size();
+
+		contacts.insert(std::end(contacts), std::begin(out.contacts), std::end(out.contacts));
+
+		for (const contact_range &r : out.ranges) {
+			ranges.push_back(contact_range{ r.a, r.b, r.begin + offset, r.end + offset });
+		}
+	}
 }
 
 void phys::contact_generator::register_collision_algorithm(
@@ -108,4 +288,91 @@ void phys::contact_generator::register_collision_algorithm(
 	int type_2 = std::max(shape_type_1, shape_type_2);
 
 	algs[type_1][type_2] = collision_algorithm(type_1, type_2, algorithm);
+}
+
+void phys::contact_generator::register_collision_algorithm(
+	shape_type shape_type_1,
+	shape_type shape_type_2,
+	const batch_collision_algorithm &batch
+) {
+	register_collision_algorithm(
+		static_cast<int>(shape_type_1),
+		static_cast<int>(shape_type_2),
+		batch
+	);
+}
+
+void phys::contact_generator::register_collision_algorithm(
+	shape_type shape_type_1,
+	int shape_type_2,
+	const batch_collision_algorithm &batch
+) {
+	register_collision_algorithm(
+		static_cast<int>(shape_type_1),
+		static_cast<int>(shape_type_2),
+		batch
+	);
+}
+
+void phys::contact_generator::register_collision_algorithm(
+	int shape_type_1,
+	int shape_type_2,
+	const batch_collision_algorithm &batch
+) {
+	int type_1 = std::min(shape_type_1, shape_type_2);
+	int type_2 = std::max(shape_type_1, shape_type_2);
+
+	algs[type_1][type_2] = collision_algorithm(type_1, type_2, batch);
+}
+
+const phys::collision_algorithm &phys::contact_generator::find_algorithm(
+	const primitive &a,
+	const primitive &b
+) const {
+	if (a.type >= max_shapes || b.type >= max_shapes) {
+		throw std::invalid_argument("Invalid shape type");
+	}
+
+	const collision_algorithm &alg = algs[std::min(a.type, b.type)][std::max(a.type, b.type)];
+
+	if (! alg.algorithm && ! alg.batch.run) {
+		throw std::invalid_argument("No collision algorithm for this pair of shape types");
+	}
+
+	return alg;
+}
+
+phys::contact_generator::bucket_offsets phys::contact_generator::sort_pairs(
+	std::span<const collision_pair> pairs,
+	std::vector<collision_pair> &out
+) const {
+	bucket_offsets offsets{};
+
+	for (const collision_pair &pair : pairs) {
+		find_algorithm(*pair.a, *pair.b);
+
+		const int shape_type_1 = std::min(pair.a->type, pair.b->type);
+		const int shape_type_2 = std::max(pair.a->type, pair.b->type);
+
+		offsets[shape_type_1 * max_shapes + shape_type_2 + 1]++;
+	}
+
+	for (size_t i = 1; i < offsets.size(); i++) {
+		offsets[i] += offsets[i - 1];
+	}
+
+	std::array<size_t, num_buckets> next{};
+
+	std::copy(std::begin(offsets), std::end(offsets) - 1, std::begin(next));
+	out.resize(pairs.size());
+
+	// Pairs stay in the same order within a bucket
+	for (const collision_pair &pair : pairs) {
+		const bool is_sorted = pair.a->type <= pair.b->type;
+		const collision_pair sorted = is_sorted ? pair : collision_pair{ pair.b, pair.a };
+
+		out[next[sorted.a->type * max_shapes + sorted.b->type]++] = sorted;
+	}
+
+	return offsets;
 }
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include <algorithm>
+#include "physics/collision/feature_cache.h"
+
+size_t phys::feature_cache::statistics::queries() const {
+	return hits + misses;
+}
+
+phys::real phys::feature_cache::statistics::steps_per_query() const {
+	if (! queries()) {
+		return (real)0;
+	}
+
+	return (real)steps / (real)queries();
+}
+
+void phys::feature_cache::begin_frame() {
+	frame++;
+}
+
+phys::vclip::algorithm_result phys::feature_cache::closest_features(
+	const primitive &a,
+	const primitive &b,
+	const vclip::polyhedron &p_a,
+	const vclip::polyhedron &p_b,
+	size_t max_steps
+) {
+	return query(a, b, p_a, p_b, nullptr, max_steps);
+}
+
+phys::vclip::algorithm_result phys::feature_cache::closest_features(
+	const primitive &a,
+	const primitive &b,
+	const vclip::polyhedron &p_a,
+	const vclip::polyhedron &p_b,
+	const mat4 &b_to_a,
+	size_t max_steps
+) {
+	return query(a, b, p_a, p_b, &b_to_a, max_steps);
+}
+
+phys::vclip::algorithm_result phys::feature_cache::query(
+	const primitive &a,
+	const primitive &b,
+	const vclip::polyhedron &p_a,
+	const vclip::polyhedron &p_b,
+	const mat4 * b_to_a,
+	size_t max_steps
+) {
+	assert(! p_a.vertices.empty());
+	assert(! p_b.vertices.empty());
+
+	// The same pair can be given in either order
+	const bool swapped = &b < &a;
+	const primitive_pair key = swapped ? primitive_pair{ &b, &a } : primitive_pair{ &a, &b };
+	std::optional<vclip::feature> f1{};
+	std::optional<vclip::feature> f2{};
+	bool is_hit = false;
+
+	// The lock isn't held while V-Clip runs, so that other threads can use the cache
+	// in the meantime. Each pair is only given once per frame, so no other thread
+	// changes this pair's entry.
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto [it, inserted] = entries.try_emplace(key);
+		const entry &e = it->second;
+
+		if (! inserted) {
+			f1 = (swapped ? e.f2 : e.f1).get(p_a);
+			f2 = (swapped ? e.f1 : e.f2).get(p_b);
+		}
+
+		if (f1 && f2) {
+			stats.hits++;
+			is_hit = true;
+		} else {
+			stats.misses++;
+			f1 = p_a.vertices[0];
+			f2 = p_b.vertices[0];
+		}
+	}
+
+	const auto run = [&](const vclip::feature &start_a, const vclip::feature &start_b) {
+		return b_to_a ?
+			vclip::closest_features(p_a, p_b, *b_to_a, start_a, start_b, max_steps) :
+			vclip::closest_features(p_a, p_b, start_a, start_b, max_steps);
+	};
+	const vclip::algorithm_result seeded = run(*f1, *f2);
+	const bool is_restart = is_hit && seeded.state.step == vclip::algorithm_step::Continue;
+	const vclip::algorithm_result result = is_restart ?
+		run(p_a.vertices[0], p_b.vertices[0]) :
+		seeded;
+	const size_t steps = seeded.steps + (is_restart ? result.steps : 0);
+
+	std::optional<feature_ref> r1 = feature_ref::find(p_a, result.state.f1);
+	std::optional<feature_ref> r2 = feature_ref::find(p_b, result.state.f2);
+	std::lock_guard<std::mutex> lock(mutex);
+
+	stats.restarts += is_restart;
+	stats.steps += steps;
+	stats.max_steps = std::max(stats.max_steps, steps);
+
+	if (! r1 || ! r2) {
+		entries.erase(key);
+
+		return result;
+	}
+
+	entry &e = entries[key];
+
+	e.f1 = swapped ? *r2 : *r1;
+	e.f2 = swapped ? *r1 : *r2;
+	e.last_frame = frame;
+
+	return result;
+}
+
+void phys::feature_cache::end_frame() {
+	std::erase_if(entries, [&](const auto &entry) {
+		return entry.second.last_frame != frame;
+	});
+}
+
+void phys::feature_cache::clear() {
+	entries.clear();
+}
+
+size_t phys::feature_cache::size() const {
+	return entries.size();
+}
+
+const phys::feature_cache::statistics& phys::feature_cache::get_stats() const {
+	return stats;
+}
+
+void phys::feature_cache::reset_stats() {
+	stats = {};
+}
+
+std::optional<phys::feature_cache::feature_ref> phys::feature_cache::feature_ref::find(
+	const vclip::polyhedron &p,
+	const vclip::feature &f
+) {
+	if (std::holds_alternative<vclip::vertex>(f)) {
+		const size_t i = std::get<vclip::vertex>(f).i;
+
+		if (i >= p.vertices.size()) {
+			return std::nullopt;
+		}
+
+		return feature_ref{ feature_type::Vertex, i };
+	} else if (std::holds_alternative<vclip::edge>(f)) {
+		const vclip::edge &e = std::get<vclip::edge>(f);
+
+		if (p.adjacency_table) {
+			const size_t i = p.adjacency_table->edge_index(p, e);
+
+			if (i != SIZE_MAX) {
+				return feature_ref{ feature_type::Edge, i };
+			}
+		}
+
+		auto it = std::find(std::begin(p.edges), std::end(p.edges), e);
+
+		if (it == std::end(p.edges)) {
+			return std::nullopt;
+		}
+
+		return feature_ref{ feature_type::Edge, (size_t)(it - std::begin(p.edges)) };
+	}
+
+	const vclip::face &face = std::get<vclip::face>(f);
+
+	if (p.adjacency_table) {
+		const size_t i = p.adjacency_table->face_index(p, face);
+
+		if (i != SIZE_MAX) {
+			return feature_ref{ feature_type::Face, i };
+		}
+	}
+
+	auto it = std::find(std::begin(p.faces), std::end(p.faces), face);
+
+	if (it == std::end(p.faces)) {
+		return std::nullopt;
+	}
+
+	return feature_ref{ feature_type::Face, (size_t)(it - std::begin(p.faces)) };
+}
+
+std::optional<phys::vclip::feature> phys::feature_cache::feature_ref::get(const vclip::polyhedron &p) const {
+	switch (type) {
+		case feature_type::Vertex:
+			if (index < p.vertices.size()) {
+				return p.vertices[index];
+			}
+
+			break;
+		case feature_type::Edge:
+			if (index < p.edges.size()) {
+				return p.edges[index];
+			}
+
+			break;
+		case feature_type::Face:
+			if (index < p.faces.size()) {
+				return p.faces[index];
+			}
+
+			break;
+	}
+
+	return std::nullopt;
+}
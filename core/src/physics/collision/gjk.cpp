@@ -0,0 +1,564 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "physics/collision/gjk.h"
+
+using namespace phys::literals;
+
+namespace {
+	// GJK stops when a new support point brings it less than this much (relative to
+	// the distance) closer to the origin
+	constexpr phys::real gjk_rel_tolerance = 100.0_r * std::numeric_limits<phys::real>::epsilon();
+	// EPA stops when the closest face of the polytope is this close to the boundary
+	// of the Minkowski difference
+	constexpr phys::real epa_tolerance = 0.0001_r;
+	constexpr size_t max_epa_iterations = 64;
+
+	// A point of the Minkowski difference `a - b`, and the points of `a` and `b`
+	// that it came from
+	struct support_point {
+		phys::vec3 w{};
+		phys::vec3 a{};
+		phys::vec3 b{};
+	};
+
+	support_point support(const phys::gjk::shape_ref &a, const phys::gjk::shape_ref &b, const phys::vec3 &dir) {
+		const phys::vec3 p_a = a.support(dir);
+		const phys::vec3 p_b = b.support(-dir);
+
+		return support_point{ p_a - p_b, p_a, p_b };
+	}
+
+	phys::real length_sqr(const phys::vec3 &v) {
+		return phys::dot(v, v);
+	}
+
+	// Up to four points, and the weights that give the point of their hull that is
+	// closest to the origin
+	struct simplex {
+		std::array<support_point, 4> points{};
+		std::array<phys::real, 4> weights{};
+		size_t size{};
+
+		void add(const support_point &p) {
+			points[size++] = p;
+		}
+
+		phys::vec3 closest() const {
+			phys::vec3 out{};
+
+			for (size_t i = 0; i < size; i++) {
+				out += points[i].w * weights[i];
+			}
+
+			return out;
+		}
+
+		void closest_points(phys::vec3 &out_a, phys::vec3 &out_b) const {
+			out_a = phys::vec3(0.0_r);
+			out_b = phys::vec3(0.0_r);
+
+			for (size_t i = 0; i < size; i++) {
+				out_a += points[i].a * weights[i];
+				out_b += points[i].b * weights[i];
+			}
+		}
+
+		// Keeps the points in `indices`, with the given weights
+		template <size_t N>
+		void keep(const std::array<size_t, N> &indices, const std::array<phys::real, N> &new_weights) {
+			std::array<support_point, N> kept{};
+
+			for (size_t i = 0; i < N; i++) {
+				kept[i] = points[indices[i]];
+			}
+
+			for (size_t i = 0; i < N; i++) {
+				points[i] = kept[i];
+				weights[i] = new_weights[i];
+			}
+
+			size = N;
+		}
+
+		// Finds the point of the simplex closest to the origin, and reduces the
+		// simplex to the fewest points whose hull contains that point. Returns false
+		// if the origin is inside a tetrahedron.
+		bool reduce() {
+			switch (size) {
+				case 1:
+					weights[0] = 1.0_r;
+					return true;
+				case 2:
+					reduce_segment(0, 1);
+					return true;
+				case 3:
+					reduce_triangle(0, 1, 2);
+					return true;
+				default:
+					return reduce_tetrahedron();
+			}
+		}
+
+		void reduce_segment(size_t i_a, size_t i_b) {
+			const phys::vec3 &a = points[i_a].w;
+			const phys::vec3 ab = points[i_b].w - a;
+			const phys::real len_sqr = length_sqr(ab);
+			const phys::real t = len_sqr > 0.0_r ? -phys::dot(a, ab) / len_sqr : 0.0_r;
+
+			if (t <= 0.0_r) {
+				keep<1>({ i_a }, { 1.0_r });
+			} else if (t >= 1.0_r) {
+				keep<1>({ i_b }, { 1.0_r });
+			} else {
+				keep<2>({ i_a, i_b }, { 1.0_r - t, t });
+			}
+		}
+
+		// The closest point on a triangle to the origin, by the regions of the
+		// triangle's vertices, edges and face (Ericson, Real-Time Collision
+		// Detection, 5.1.5)
+		void reduce_triangle(size_t i_a, size_t i_b, size_t i_c) {
+			const phys::vec3 &a = points[i_a].w;
+			const phys::vec3 &b = points[i_b].w;
+			const phys::vec3 &c = points[i_c].w;
+			const phys::vec3 ab = b - a;
+			const phys::vec3 ac = c - a;
+			const phys::real d1 = -phys::dot(ab, a);
+			const phys::real d2 = -phys::dot(ac, a);
+
+			if (d1 <= 0.0_r && d2 <= 0.0_r) {
+				keep<1>({ i_a }, { 1.0_r });
+				return;
+			}
+
+			const phys::real d3 = -phys::dot(ab, b);
+			const phys::real d4 = -phys::dot(ac, b);
+
+			if (d3 >= 0.0_r && d4 <= d3) {
+				keep<1>({ i_b }, { 1.0_r });
+				return;
+			}
+
+			const phys::real vc = d1 * d4 - d3 * d2;
+
+			if (vc <= 0.0_r && d1 >= 0.0_r && d3 <= 0.0_r) {
+				const phys::real v = d1 / (d1 - d3);
+
+				keep<2>({ i_a, i_b }, { 1.0_r - v, v });
+				return;
+			}
+
+			const phys::real d5 = -phys::dot(ab, c);
+			const phys::real d6 = -phys::dot(ac, c);
+
+			if (d6 >= 0.0_r && d5 <= d6) {
+				keep<1>({ i_c }, { 1.0_r });
+				return;
+			}
+
+			const phys::real vb = d5 * d2 - d1 * d6;
+
+			if (vb <= 0.0_r && d2 >= 0.0_r && d6 <= 0.0_r) {
+				const phys::real w = d2 / (d2 - d6);
+
+				keep<2>({ i_a, i_c }, { 1.0_r - w, w });
+				return;
+			}
+
+			const phys::real va = d3 * d6 - d5 * d4;
+
+			if (va <= 0.0_r && (d4 - d3) >= 0.0_r && (d5 - d6) >= 0.0_r) {
+				const phys::real w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+
+				keep<2>({ i_b, i_c }, { 1.0_r - w, w });
+				return;
+			}
+
+			const phys::real denom = 1.0_r / (va + vb + vc);
+			const phys::real v = vb * denom;
+			const phys::real w = vc * denom;
+
+			keep<3>({ i_a, i_b, i_c }, { 1.0_r - v - w, v, w });
+		}
+
+		bool reduce_tetrahedron() {
+			// Each face, and the vertex opposite it
+			constexpr std::array<std::array<size_t, 4>, 4> faces{ {
+				{ 0, 1, 2, 3 },
+				{ 0, 2, 3, 1 },
+				{ 0, 3, 1, 2 },
+				{ 1, 3, 2, 0 }
+			} };
+
+			const simplex tetrahedron = *this;
+			simplex best{};
+			phys::real best_dist = phys::infinity;
+			bool is_outside = false;
+
+			for (const std::array<size_t, 4> &f : faces) {
+				const phys::vec3 &a = tetrahedron.points[f[0]].w;
+				const phys::vec3 n = phys::cross(tetrahedron.points[f[1]].w - a, tetrahedron.points[f[2]].w - a);
+				const phys::real origin_side = -phys::dot(a, n);
+				const phys::real opposite_side = phys::dot(tetrahedron.points[f[3]].w - a, n);
+
+				// The origin is only closest to this face if it's on the other side
+				// of it from the opposite vertex
+				if (origin_side * opposite_side >= 0.0_r) {
+					continue;
+				}
+
+				simplex face = tetrahedron;
+
+				is_outside = true;
+				face.reduce_triangle(f[0], f[1], f[2]);
+
+				const phys::real dist = length_sqr(face.closest());
+
+				if (dist < best_dist) {
+					best_dist = dist;
+					best = face;
+				}
+			}
+
+			if (! is_outside) {
+				return false;
+			}
+
+			*this = best;
+
+			return true;
+		}
+	};
+
+	// The result of GJK, with the simplex that it ended on
+	struct gjk_state {
+		phys::gjk::distance_result result{};
+		simplex s{};
+	};
+
+	gjk_state run_gjk(const phys::gjk::shape_ref &a, const phys::gjk::shape_ref &b, size_t max_iterations) {
+		gjk_state out{};
+		simplex &s = out.s;
+		phys::gjk::distance_result &result = out.result;
+
+		s.add(support(a, b, phys::vec3(1.0_r, 0.0_r, 0.0_r)));
+		s.reduce();
+
+		phys::vec3 v = s.closest();
+		phys::real scale = length_sqr(v);
+
+		for (result.iterations = 0; result.iterations < max_iterations; result.iterations++) {
+			const phys::real v_len_sqr = length_sqr(v);
+
+			// The origin is on the simplex
+			if (v_len_sqr <= 1e-10_r * std::max(scale, 1.0_r)) {
+				result.is_intersecting = true;
+				return out;
+			}
+
+			const support_point w = support(a, b, -v);
+
+			scale = std::max(scale, length_sqr(w.w));
+
+			if (v_len_sqr - phys::dot(v, w.w) <= gjk_rel_tolerance * v_len_sqr) {
+				break;
+			}
+
+			s.add(w);
+
+			if (! s.reduce()) {
+				result.is_intersecting = true;
+				return out;
+			}
+
+			const phys::vec3 new_v = s.closest();
+
+			// Rounding errors can keep GJK from getting any closer
+			if (length_sqr(new_v) >= v_len_sqr) {
+				break;
+			}
+
+			v = new_v;
+		}
+
+		result.dist = std::sqrt(length_sqr(v));
+		s.closest_points(result.point_a, result.point_b);
+
+		return out;
+	}
+
+	struct epa_face {
+		std::array<uint32_t, 3> v{};
+		phys::vec3 normal{};
+		// Distance from the origin to the face's plane
+		phys::real dist{};
+	};
+
+	struct epa_edge {
+		uint32_t a{};
+		uint32_t b{};
+	};
+
+	// The polytope that EPA expands, kept for each thread so that it isn't
+	// reallocated for every query
+	struct epa_polytope {
+		std::vector<support_point> vertices{};
+		std::vector<epa_face> faces{};
+		std::vector<epa_edge> horizon{};
+
+		// Adds a face that faces away from `inside`. Returns false if it's
+		// degenerate.
+		bool add_face(uint32_t a, uint32_t b, uint32_t c, const phys::vec3 &inside) {
+			const phys::vec3 &p = vertices[a].w;
+			phys::vec3 n = phys::cross(vertices[b].w - p, vertices[c].w - p);
+			const phys::real len_sqr = length_sqr(n);
+
+			if (len_sqr <= 0.0_r) {
+				return false;
+			}
+
+			n /= std::sqrt(len_sqr);
+
+			if (phys::dot(n, inside - p) > 0.0_r) {
+				n = -n;
+				std::swap(b, c);
+			}
+
+			faces.push_back(epa_face{ { a, b, c }, n, phys::dot(n, p) });
+
+			return true;
+		}
+
+		void add_horizon_edge(uint32_t a, uint32_t b) {
+			for (size_t i = 0; i < horizon.size(); i++) {
+				// The edge is shared with another removed face
+				if (horizon[i].a == b && horizon[i].b == a) {
+					horizon[i] = horizon.back();
+					horizon.pop_back();
+					return;
+				}
+			}
+
+			horizon.push_back(epa_edge{ a, b });
+		}
+	};
+
+	// GJK can stop on a point, a segment or a triangle if the origin is on it. EPA
+	// needs a tetrahedron, so this adds support points in directions away from the
+	// simplex until it has one. Returns false if the Minkowski difference is flat.
+	bool grow_to_tetrahedron(const phys::gjk::shape_ref &a, const phys::gjk::shape_ref &b, simplex &s) {
+		constexpr phys::real min_dist = 0.00001_r;
+		constexpr std::array<phys::vec3, 6> axes{
+			phys::vec3(1.0_r, 0.0_r, 0.0_r),
+			phys::vec3(-1.0_r, 0.0_r, 0.0_r),
+			phys::vec3(0.0_r, 1.0_r, 0.0_r),
+			phys::vec3(0.0_r, -1.0_r, 0.0_r),
+			phys::vec3(0.0_r, 0.0_r, 1.0_r),
+			phys::vec3(0.0_r, 0.0_r, -1.0_r)
+		};
+
+		if (s.size == 1) {
+			for (const phys::vec3 &axis : axes) {
+				const support_point p = support(a, b, axis);
+
+				if (length_sqr(p.w - s.points[0].w) > min_dist * min_dist) {
+					s.add(p);
+					break;
+				}
+			}
+
+			if (s.size == 1) {
+				return false;
+			}
+		}
+
+		if (s.size == 2) {
+			const phys::vec3 d = phys::normalize(s.points[1].w - s.points[0].w);
+			size_t axis = 0;
+
+			// The axis that is most perpendicular to the segment
+			for (size_t i = 1; i < 3; i++) {
+				if (std::abs(d[(int)i]) < std::abs(d[(int)axis])) {
+					axis = i;
+				}
+			}
+
+			const phys::vec3 perp_1 = phys::normalize(phys::cross(d, axes[2 * axis]));
+			const phys::vec3 perp_2 = phys::cross(d, perp_1);
+
+			for (const phys::vec3 &dir : { perp_1, -perp_1, perp_2, -perp_2 }) {
+				const support_point p = support(a, b, dir);
+
+				if (phys::dot(p.w - s.points[0].w, dir) > min_dist) {
+					s.add(p);
+					break;
+				}
+			}
+
+			if (s.size == 2) {
+				return false;
+			}
+		}
+
+		if (s.size == 3) {
+			const phys::vec3 n = phys::normalize(phys::cross(
+				s.points[1].w - s.points[0].w,
+				s.points[2].w - s.points[0].w
+			));
+
+			for (const phys::vec3 &dir : { n, -n }) {
+				const support_point p = support(a, b, dir);
+
+				if (phys::dot(p.w - s.points[0].w, dir) > min_dist) {
+					s.add(p);
+					break;
+				}
+			}
+
+			if (s.size == 3) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Barycentric coordinates of `p` in the triangle `a`, `b`, `c`
+	phys::vec3 barycentric(const phys::vec3 &p, const phys::vec3 &a, const phys::vec3 &b, const phys::vec3 &c) {
+		const phys::vec3 v0 = b - a;
+		const phys::vec3 v1 = c - a;
+		const phys::vec3 v2 = p - a;
+		const phys::real d00 = phys::dot(v0, v0);
+		const phys::real d01 = phys::dot(v0, v1);
+		const phys::real d11 = phys::dot(v1, v1);
+		const phys::real d20 = phys::dot(v2, v0);
+		const phys::real d21 = phys::dot(v2, v1);
+		const phys::real denom = d00 * d11 - d01 * d01;
+
+		if (denom == 0.0_r) {
+			return phys::vec3(1.0_r, 0.0_r, 0.0_r);
+		}
+
+		const phys::real v = (d11 * d20 - d01 * d21) / denom;
+		const phys::real w = (d00 * d21 - d01 * d20) / denom;
+
+		return phys::vec3(1.0_r - v - w, v, w);
+	}
+
+	void run_epa(
+		const phys::gjk::shape_ref &a,
+		const phys::gjk::shape_ref &b,
+		const simplex &s,
+		phys::gjk::penetration_result &result
+	) {
+		thread_local epa_polytope polytope{};
+
+		polytope.vertices.assign(std::begin(s.points), std::begin(s.points) + 4);
+		polytope.faces.clear();
+
+		phys::vec3 inside{};
+
+		for (const support_point &p : polytope.vertices) {
+			inside += p.w / 4.0_r;
+		}
+
+		const bool is_valid =
+			polytope.add_face(0, 1, 2, inside) &&
+			polytope.add_face(0, 3, 1, inside) &&
+			polytope.add_face(0, 2, 3, inside) &&
+			polytope.add_face(1, 3, 2, inside);
+
+		if (! is_valid) {
+			return;
+		}
+
+		size_t closest = 0;
+
+		for (size_t iteration = 0; iteration < max_epa_iterations; iteration++) {
+			closest = 0;
+
+			for (size_t i = 1; i < polytope.faces.size(); i++) {
+				if (polytope.faces[i].dist < polytope.faces[closest].dist) {
+					closest = i;
+				}
+			}
+
+			const epa_face f = polytope.faces[closest];
+			const support_point w = support(a, b, f.normal);
+
+			if (phys::dot(w.w, f.normal) - f.dist <= epa_tolerance) {
+				break;
+			}
+
+			const uint32_t w_i = (uint32_t)polytope.vertices.size();
+
+			polytope.vertices.push_back(w);
+			polytope.horizon.clear();
+
+			for (size_t i = polytope.faces.size(); i-- > 0;) {
+				const epa_face &visible = polytope.faces[i];
+
+				if (phys::dot(visible.normal, w.w - polytope.vertices[visible.v[0]].w) <= 0.0_r) {
+					continue;
+				}
+
+				polytope.add_horizon_edge(visible.v[0], visible.v[1]);
+				polytope.add_horizon_edge(visible.v[1], visible.v[2]);
+				polytope.add_horizon_edge(visible.v[2], visible.v[0]);
+				polytope.faces[i] = polytope.faces.back();
+				polytope.faces.pop_back();
+			}
+
+			for (const epa_edge &e : polytope.horizon) {
+				polytope.add_face(e.a, e.b, w_i, inside);
+			}
+
+			if (polytope.faces.empty()) {
+				return;
+			}
+
+			closest = 0;
+		}
+
+		for (size_t i = 1; i < polytope.faces.size(); i++) {
+			if (polytope.faces[i].dist < polytope.faces[closest].dist) {
+				closest = i;
+			}
+		}
+
+		const epa_face &f = polytope.faces[closest];
+		const support_point &p0 = polytope.vertices[f.v[0]];
+		const support_point &p1 = polytope.vertices[f.v[1]];
+		const support_point &p2 = polytope.vertices[f.v[2]];
+		const phys::vec3 weights = barycentric(f.normal * f.dist, p0.w, p1.w, p2.w);
+
+		result.is_intersecting = true;
+		result.normal = f.normal;
+		result.depth = std::max(f.dist, 0.0_r);
+		result.point_a = p0.a * weights.x + p1.a * weights.y + p2.a * weights.z;
+		result.point_b = p0.b * weights.x + p1.b * weights.y + p2.b * weights.z;
+	}
+}
+
+phys::gjk::distance_result phys::gjk::distance(shape_ref a, shape_ref b, size_t max_iterations) {
+	return run_gjk(a, b, max_iterations).result;
+}
+
+phys::gjk::penetration_result phys::gjk::penetration(shape_ref a, shape_ref b, size_t max_iterations) {
+	gjk_state state = run_gjk(a, b, max_iterations);
+	penetration_result out{};
+
+	out.iterations = state.result.iterations;
+
+	if (! state.result.is_intersecting || ! grow_to_tetrahedron(a, b, state.s)) {
+		return out;
+	}
+
+	run_epa(a, b, state.s, out);
+
+	return out;
+}
@@ -0,0 +1,9 @@
+#include <functional>
+#include "physics/collision/primitive_pair.h"
+
+size_t phys::primitive_pair_hash::operator()(const primitive_pair &p) const {
+	const size_t h1 = std::hash<const primitive *>{}(p.a);
+	const size_t h2 = std::hash<const primitive *>{}(p.b);
+
+	return h1 ^ (h2 + 0x9e3779b9 + (h1 << 6) + (h1 >> 2));
+}
\ No newline at end of file
@@ -1,4 +1,7 @@
+#include <algorithm>
+#include <cmath>
 #include "physics/collision/primitives.h"
+#include "physics/collision/quickhull.h"
 
 using namespace phys::literals;
 
@@ -11,6 +14,23 @@ phys::sphere::sphere(
 	radius(_radius)
 {}
 
+phys::aabb phys::sphere::get_bounds() const {
+	const vec3 center = body->pos + truncate(offset[3]);
+
+	return aabb(center - vec3(radius), center + vec3(radius));
+}
+
+phys::vec3 phys::sphere::support(const vec3 &dir) const {
+	const vec3 center = body->pos + truncate(offset[3]);
+	const real len = std::sqrt(dot(dir, dir));
+
+	if (len == 0.0_r) {
+		return center;
+	}
+
+	return center + dir * (radius / len);
+}
+
 phys::plane::plane(
 	rigid_body * _body,
 	const vec3 &_normal,
@@ -21,6 +41,10 @@ phys::plane::plane(
 	offset(_offset)
 {}
 
+phys::aabb phys::plane::get_bounds() const {
+	return aabb(vec3(-infinity), vec3(infinity));
+}
+
 phys::box::box(
 	rigid_body * _body,
 	const mat4 &_offset,
@@ -28,21 +52,74 @@ phys::box::box(
 ) :
 	primitive(shape_type::Box, _body, _offset),
 	half_size(_half_size)
-{}
+{
+	// Built up front so that boxes can be collided from multiple threads
+	get_local_polyhedron();
+}
+
+phys::aabb phys::box::get_bounds() const {
+	const mat4 transform = body->get_transform() * offset;
+	const vec3 center = truncate(transform[3]);
+	// The extent of the box along each world axis is the sum of the extents of
+	// its local axes along that axis
+	vec3 extent{};
+
+	for (int i = 0; i < 3; i++) {
+		const vec3 axis = truncate(transform[i]) * half_size[i];
+
+		extent += vec3(std::abs(axis.x), std::abs(axis.y), std::abs(axis.z));
+	}
+
+	return aabb(center - extent, center + extent);
+}
+
+phys::vec3 phys::box::support(const vec3 &dir) const {
+	const mat4 transform = body->get_transform() * offset;
+	vec3 local{};
+
+	// `dir` is taken into the box's space by the transpose of its transform, so
+	// that this also works for boxes that are scaled
+	for (int i = 0; i < 3; i++) {
+		local[i] = dot(truncate(transform[i]), dir) < 0.0_r ? -half_size[i] : half_size[i];
+	}
+
+	return truncate(transform * vec4(local, 1.0_r));
+}
 
 phys::vclip::polyhedron phys::box::to_polyhedron() const {
-	mat4 transform = body->get_transform() * offset;
+	const mat4 transform = body->get_transform() * offset;
+	vclip::polyhedron p = get_local_polyhedron();
+
+	// The directions of the Voronoi planes change when the box is rotated
+	p.invalidate_adjacency();
+
+	for (vclip::vertex &v : p.vertices) {
+		v.v = truncate(transform * vec4(v.v, 1.0_r));
+	}
+
+	for (vclip::face &f : p.faces) {
+		f.invalidate_normal();
+	}
+
+	return p;
+}
+
+const phys::vclip::polyhedron& phys::box::get_local_polyhedron() const {
+	if (! local_polyhedron.vertices.empty() && local_half_size == half_size) {
+		return local_polyhedron;
+	}
 
-	vclip::polyhedron p(
+	local_half_size = half_size;
+	local_polyhedron = vclip::polyhedron(
 		{
-			vclip::vertex(truncate(transform * vec4(half_size, 1.0_r)), 0),
-			vclip::vertex(truncate(transform * vec4(half_size.x, half_size.y, -half_size.z, 1.0_r)), 1),
-			vclip::vertex(truncate(transform * vec4(half_size.x, -half_size.y, half_size.z, 1.0_r)), 2),
-			vclip::vertex(truncate(transform * vec4(half_size.x, -half_size.y, -half_size.z, 1.0_r)), 3),
-			vclip::vertex(truncate(transform * vec4(-half_size.x, half_size.y, half_size.z, 1.0_r)), 4),
-			vclip::vertex(truncate(transform * vec4(-half_size.x, half_size.y, -half_size.z, 1.0_r)), 5),
-			vclip::vertex(truncate(transform * vec4(-half_size.x, -half_size.y, half_size.z, 1.0_r)), 6),
-			vclip::vertex(truncate(transform * vec4(-half_size.x, -half_size.y, -half_size.z, 1.0_r)), 7)
+			vclip::vertex(half_size, 0),
+			vclip::vertex(vec3(half_size.x, half_size.y, -half_size.z), 1),
+			vclip::vertex(vec3(half_size.x, -half_size.y, half_size.z), 2),
+			vclip::vertex(vec3(half_size.x, -half_size.y, -half_size.z), 3),
+			vclip::vertex(vec3(-half_size.x, half_size.y, half_size.z), 4),
+			vclip::vertex(vec3(-half_size.x, half_size.y, -half_size.z), 5),
+			vclip::vertex(vec3(-half_size.x, -half_size.y, half_size.z), 6),
+			vclip::vertex(-half_size, 7)
 		},
 		{
 			vclip::edge(0, 1),
@@ -67,6 +144,177 @@ phys::vclip::polyhedron phys::box::to_polyhedron() const {
 			vclip::face({ 7, 5, 1, 3 })
 		}
 	);
+	local_polyhedron.compile_adjacency();
+
+	return local_polyhedron;
+}
+
+phys::convex_hull::convex_hull(
+	rigid_body * _body,
+	const mat4 &_offset,
+	vclip::polyhedron _polyhedron
+) :
+	primitive(shape_type::ConvexHull, _body, _offset),
+	local_polyhedron(std::move(_polyhedron))
+{
+	local_polyhedron.compile_adjacency();
+	local_polyhedron.validate();
+}
+
+phys::convex_hull::convex_hull(
+	rigid_body * _body,
+	const mat4 &_offset,
+	std::span<const vec3> points,
+	thread_pool * pool
+) :
+	primitive(shape_type::ConvexHull, _body, _offset),
+	local_polyhedron(quickhull(points, pool))
+{}
+
+phys::aabb phys::convex_hull::get_bounds() const {
+	const mat4 transform = body->get_transform() * offset;
+	vec3 min(infinity);
+	vec3 max(-infinity);
+
+	for (const vclip::vertex &v : local_polyhedron.vertices) {
+		const vec3 p = truncate(transform * vec4(v.v, 1.0_r));
+
+		min = glm::min(min, p);
+		max = glm::max(max, p);
+	}
+
+	return aabb(min, max);
+}
+
+phys::vec3 phys::convex_hull::support(const vec3 &dir) const {
+	const mat4 transform = body->get_transform() * offset;
+	const vec3 local_dir(
+		dot(truncate(transform[0]), dir),
+		dot(truncate(transform[1]), dir),
+		dot(truncate(transform[2]), dir)
+	);
+	const vclip::vertex * best = &local_polyhedron.vertices[0];
+	real best_dist = dot(best->v, local_dir);
+
+	for (const vclip::vertex &v : local_polyhedron.vertices) {
+		const real dist = dot(v.v, local_dir);
+
+		if (dist > best_dist) {
+			best = &v;
+			best_dist = dist;
+		}
+	}
+
+	return truncate(transform * vec4(best->v, 1.0_r));
+}
+
+phys::vclip::polyhedron phys::convex_hull::to_polyhedron() const {
+	const mat4 transform = body->get_transform() * offset;
+	vclip::polyhedron p = local_polyhedron;
+
+	p.invalidate_adjacency();
+
+	for (vclip::vertex &v : p.vertices) {
+		v.v = truncate(transform * vec4(v.v, 1.0_r));
+	}
+
+	for (vclip::face &f : p.faces) {
+		f.invalidate_normal();
+	}
 
 	return p;
-}
\ No newline at end of file
+}
+
+const phys::vclip::polyhedron& phys::convex_hull::get_local_polyhedron() const {
+	return local_polyhedron;
+}
+
+phys::capsule::capsule(
+	rigid_body * _body,
+	const mat4 &_offset,
+	real _radius,
+	real _half_height
+) :
+	primitive(shape_type::Capsule, _body, _offset),
+	radius(_radius),
+	half_height(_half_height)
+{}
+
+phys::aabb phys::capsule::get_bounds() const {
+	const line_segment s = get_segment();
+
+	return aabb(glm::min(s.a, s.b) - vec3(radius), glm::max(s.a, s.b) + vec3(radius));
+}
+
+phys::vec3 phys::capsule::support(const vec3 &dir) const {
+	const line_segment s = get_segment();
+	const vec3 &end = dot(s.b - s.a, dir) < 0.0_r ? s.a : s.b;
+	const real len = std::sqrt(dot(dir, dir));
+
+	if (len == 0.0_r) {
+		return end;
+	}
+
+	return end + dir * (radius / len);
+}
+
+phys::line_segment phys::capsule::get_segment() const {
+	const mat4 transform = body->get_transform() * offset;
+
+	return line_segment{
+		truncate(transform * vec4(0.0_r, -half_height, 0.0_r, 1.0_r)),
+		truncate(transform * vec4(0.0_r, half_height, 0.0_r, 1.0_r))
+	};
+}
+
+phys::cylinder::cylinder(
+	rigid_body * _body,
+	const mat4 &_offset,
+	real _radius,
+	real _half_height
+) :
+	primitive(shape_type::Cylinder, _body, _offset),
+	radius(_radius),
+	half_height(_half_height)
+{}
+
+phys::aabb phys::cylinder::get_bounds() const {
+	const line_segment s = get_axis();
+	const vec3 axis = normalize(truncate((body->get_transform() * offset)[1]));
+	vec3 extent{};
+
+	// A cap reaches out from its center by `radius` times the sine of the angle
+	// between the axis and each world axis
+	for (int i = 0; i < 3; i++) {
+		extent[i] = radius * std::sqrt(std::max(1.0_r - axis[i] * axis[i], 0.0_r));
+	}
+
+	return aabb(glm::min(s.a, s.b) - extent, glm::max(s.a, s.b) + extent);
+}
+
+phys::vec3 phys::cylinder::support(const vec3 &dir) const {
+	const mat4 transform = body->get_transform() * offset;
+	const vec3 local_dir(
+		dot(truncate(transform[0]), dir),
+		dot(truncate(transform[1]), dir),
+		dot(truncate(transform[2]), dir)
+	);
+	const real radial_len = std::sqrt(local_dir.x * local_dir.x + local_dir.z * local_dir.z);
+	vec3 local(0.0_r, local_dir.y < 0.0_r ? -half_height : half_height, 0.0_r);
+
+	if (radial_len > 0.0_r) {
+		local.x = local_dir.x * (radius / radial_len);
+		local.z = local_dir.z * (radius / radial_len);
+	}
+
+	return truncate(transform * vec4(local, 1.0_r));
+}
+
+phys::line_segment phys::cylinder::get_axis() const {
+	const mat4 transform = body->get_transform() * offset;
+
+	return line_segment{
+		truncate(transform * vec4(0.0_r, -half_height, 0.0_r, 1.0_r)),
+		truncate(transform * vec4(0.0_r, half_height, 0.0_r, 1.0_r))
+	};
+}
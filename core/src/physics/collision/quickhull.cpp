@@ -0,0 +1,629 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+#include "physics/collision/quickhull.h"
+#include "physics/thread_pool.h"
+
+namespace {
+	// The hull is built in double precision so that rounding errors don't make it
+	// concave. The vertices of the polyhedron are the input points, unchanged.
+	using dvec3 = glm::vec<3, double, qual>;
+
+	constexpr uint32_t no_index = UINT32_MAX;
+	// Each thread builds the hulls of a few chunks so that a thread that finishes
+	// early can take another chunk
+	constexpr size_t chunks_per_thread = 4;
+
+	dvec3 to_dvec3(const phys::vec3 &v) {
+		return dvec3(v.x, v.y, v.z);
+	}
+
+	struct half_edge {
+		// The vertex that the edge starts at. The edge ends at `next`'s tail.
+		uint32_t tail{};
+		uint32_t twin{};
+		uint32_t next{};
+		uint32_t face{};
+	};
+
+	// A triangle of the hull being built
+	struct hull_face {
+		// One of the face's three half-edges
+		uint32_t edge{};
+		dvec3 normal{};
+		double offset{};
+		double area{};
+		// The points in front of the face that aren't in front of any face before it
+		std::vector<uint32_t> outside{};
+		uint32_t furthest{ no_index };
+		double furthest_dist{};
+		// The last point that the face was visible from
+		uint32_t seen_from{ no_index };
+		bool is_dead{};
+	};
+
+	class hull_builder {
+	public:
+		explicit hull_builder(std::span<const phys::vec3> _points);
+
+		// Builds the hull as a mesh of triangles. Returns false if the points are
+		// all in the same plane.
+		bool build();
+		// Appends the hull's vertices to `out`
+		void append_vertices(std::vector<phys::vec3> &out) const;
+		// Merges triangles in the same plane into polygons and removes the vertices
+		// that are left in the middle of edges
+		phys::vclip::polyhedron to_polyhedron() const;
+
+	private:
+		std::span<const phys::vec3> points;
+		// Points that are closer than this to the hull are treated as being on it,
+		// and they don't become vertices
+		double tolerance{};
+		std::vector<half_edge> edges{};
+		std::vector<hull_face> faces{};
+		// Faces that may have points in front of them
+		std::vector<uint32_t> pending{};
+		std::vector<uint32_t> visible{};
+		std::vector<uint32_t> horizon{};
+		std::vector<uint32_t> new_faces{};
+
+		dvec3 point(uint32_t i) const;
+		uint32_t head(uint32_t e) const;
+		double dist(const hull_face &f, uint32_t p) const;
+
+		bool build_simplex();
+		uint32_t add_face(uint32_t a, uint32_t b, uint32_t c);
+		void assign(uint32_t p, std::span<const uint32_t> candidates);
+		void add_point(uint32_t eye, uint32_t f);
+		void find_horizon(uint32_t eye, uint32_t f);
+	};
+
+	hull_builder::hull_builder(std::span<const phys::vec3> _points) : points(_points) {
+		dvec3 max_abs(0.0);
+
+		for (const phys::vec3 &p : points) {
+			max_abs = dvec3(
+				std::max(max_abs.x, std::abs((double)p.x)),
+				std::max(max_abs.y, std::abs((double)p.y)),
+				std::max(max_abs.z, std::abs((double)p.z))
+			);
+		}
+
+		// The points can only be trusted to the precision of `real`
+		tolerance = 3.0 * std::numeric_limits<phys::real>::epsilon() * (max_abs.x + max_abs.y + max_abs.z);
+	}
+
+	dvec3 hull_builder::point(uint32_t i) const {
+		return to_dvec3(points[i]);
+	}
+
+	uint32_t hull_builder::head(uint32_t e) const {
+		return edges[edges[e].next].tail;
+	}
+
+	double hull_builder::dist(const hull_face &f, uint32_t p) const {
+		return glm::dot(f.normal, point(p)) - f.offset;
+	}
+
+	bool hull_builder::build() {
+		if (points.size() < 4 || points.size() >= no_index || ! build_simplex()) {
+			return false;
+		}
+
+		while (! pending.empty()) {
+			const uint32_t f = pending.back();
+
+			pending.pop_back();
+
+			if (! faces[f].is_dead && ! faces[f].outside.empty()) {
+				add_point(faces[f].furthest, f);
+			}
+		}
+
+		return true;
+	}
+
+	bool hull_builder::build_simplex() {
+		std::array<uint32_t, 6> extremes{};
+
+		for (uint32_t i = 0; i < (uint32_t)points.size(); i++) {
+			for (int axis = 0; axis < 3; axis++) {
+				if (points[i][axis] < points[extremes[2 * axis]][axis]) {
+					extremes[2 * axis] = i;
+				}
+
+				if (points[i][axis] > points[extremes[2 * axis + 1]][axis]) {
+					extremes[2 * axis + 1] = i;
+				}
+			}
+		}
+
+		// The two extreme points that are furthest apart
+		uint32_t a = 0;
+		uint32_t b = 0;
+		double max_dist = 0.0;
+
+		for (size_t i = 0; i < extremes.size(); i++) {
+			for (size_t j = i + 1; j < extremes.size(); j++) {
+				const dvec3 diff = point(extremes[j]) - point(extremes[i]);
+				const double d = glm::dot(diff, diff);
+
+				if (d > max_dist) {
+					max_dist = d;
+					a = extremes[i];
+					b = extremes[j];
+				}
+			}
+		}
+
+		if (std::sqrt(max_dist) <= tolerance) {
+			return false;
+		}
+
+		// The point furthest from the line through `a` and `b`
+		const dvec3 ab = glm::normalize(point(b) - point(a));
+		uint32_t c = 0;
+
+		max_dist = 0.0;
+
+		for (uint32_t i = 0; i < (uint32_t)points.size(); i++) {
+			const dvec3 perp = glm::cross(point(i) - point(a), ab);
+			const double d = glm::dot(perp, perp);
+
+			if (d > max_dist) {
+				max_dist = d;
+				c = i;
+			}
+		}
+
+		if (std::sqrt(max_dist) <= tolerance) {
+			return false;
+		}
+
+		// The point furthest from the plane through `a`, `b` and `c`
+		const dvec3 n = glm::normalize(glm::cross(point(b) - point(a), point(c) - point(a)));
+		uint32_t d = 0;
+
+		max_dist = 0.0;
+
+		for (uint32_t i = 0; i < (uint32_t)points.size(); i++) {
+			const double dist = std::abs(glm::dot(point(i) - point(a), n));
+
+			if (dist > max_dist) {
+				max_dist = dist;
+				d = i;
+			}
+		}
+
+		if (max_dist <= tolerance) {
+			return false;
+		}
+
+		// `d` has to be behind the first face
+		if (glm::dot(point(d) - point(a), n) > 0.0) {
+			std::swap(b, c);
+		}
+
+		add_face(a, b, c);
+		add_face(b, a, d);
+		add_face(c, b, d);
+		add_face(a, c, d);
+
+		for (uint32_t e = 0; e < (uint32_t)edges.size(); e++) {
+			for (uint32_t other = 0; other < (uint32_t)edges.size(); other++) {
+				if (edges[other].tail == head(e) && head(other) == edges[e].tail) {
+					edges[e].twin = other;
+				}
+			}
+		}
+
+		const std::array<uint32_t, 4> simplex_faces{ 0, 1, 2, 3 };
+
+		for (uint32_t i = 0; i < (uint32_t)points.size(); i++) {
+			if (i != a && i != b && i != c && i != d) {
+				assign(i, simplex_faces);
+			}
+		}
+
+		pending.assign(std::begin(simplex_faces), std::end(simplex_faces));
+
+		return true;
+	}
+
+	uint32_t hull_builder::add_face(uint32_t a, uint32_t b, uint32_t c) {
+		const uint32_t f = (uint32_t)faces.size();
+		const uint32_t e = (uint32_t)edges.size();
+		const dvec3 pa = point(a);
+		const dvec3 n = glm::cross(point(b) - pa, point(c) - pa);
+		const double len = std::sqrt(glm::dot(n, n));
+		hull_face &out = faces.emplace_back();
+
+		out.edge = e;
+		out.normal = len > 0.0 ? n / len : dvec3(0.0);
+		out.offset = glm::dot(out.normal, (pa + point(b) + point(c)) / 3.0);
+		out.area = len / 2.0;
+
+		edges.push_back(half_edge{ a, no_index, e + 1, f });
+		edges.push_back(half_edge{ b, no_index, e + 2, f });
+		edges.push_back(half_edge{ c, no_index, e, f });
+
+		return f;
+	}
+
+	// Gives `p` to the first candidate face that it's in front of. Points that aren't
+	// in front of any face are inside the hull and are dropped.
+	void hull_builder::assign(uint32_t p, std::span<const uint32_t> candidates) {
+		for (uint32_t f_i : candidates) {
+			hull_face &f = faces[f_i];
+			const double d = dist(f, p);
+
+			if (d > tolerance) {
+				f.outside.push_back(p);
+
+				if (d > f.furthest_dist) {
+					f.furthest_dist = d;
+					f.furthest = p;
+				}
+
+				return;
+			}
+		}
+	}
+
+	void hull_builder::add_point(uint32_t eye, uint32_t f) {
+		find_horizon(eye, f);
+
+		// The horizon edges go around the visible faces in CCW order, so each new
+		// face shares its second edge with the next new face's third edge
+		new_faces.clear();
+
+		for (uint32_t h : horizon) {
+			const uint32_t new_f = add_face(edges[h].tail, head(h), eye);
+			const uint32_t e = faces[new_f].edge;
+			const uint32_t outer = edges[h].twin;
+
+			edges[e].twin = outer;
+			edges[outer].twin = e;
+			new_faces.push_back(new_f);
+		}
+
+		for (size_t i = 0; i < new_faces.size(); i++) {
+			const uint32_t e1 = faces[new_faces[i]].edge + 1;
+			const uint32_t e2 = faces[new_faces[(i + 1) % new_faces.size()]].edge + 2;
+
+			edges[e1].twin = e2;
+			edges[e2].twin = e1;
+		}
+
+		for (uint32_t v : visible) {
+			hull_face &dead = faces[v];
+
+			dead.is_dead = true;
+
+			for (uint32_t p : dead.outside) {
+				if (p != eye) {
+					assign(p, new_faces);
+				}
+			}
+
+			std::vector<uint32_t>().swap(dead.outside);
+		}
+
+		for (uint32_t new_f : new_faces) {
+			if (! faces[new_f].outside.empty()) {
+				pending.push_back(new_f);
+			}
+		}
+	}
+
+	// Finds the faces that can be seen from `eye`, starting at `f`, and the edges
+	// around them. This is a depth-first search with an explicit stack, which finds
+	// the horizon edges in CCW order as seen from `eye`.
+	void hull_builder::find_horizon(uint32_t eye, uint32_t f) {
+		struct search_frame {
+			uint32_t face{};
+			uint32_t edge{};
+			uint32_t num_edges{};
+		};
+
+		std::vector<search_frame> stack{};
+
+		visible.clear();
+		horizon.clear();
+
+		faces[f].seen_from = eye;
+		visible.push_back(f);
+		stack.push_back(search_frame{ f, faces[f].edge, 3 });
+
+		while (! stack.empty()) {
+			search_frame &top = stack.back();
+
+			if (! top.num_edges) {
+				stack.pop_back();
+				continue;
+			}
+
+			const uint32_t e = top.edge;
+
+			top.edge = edges[e].next;
+			top.num_edges--;
+
+			const uint32_t twin = edges[e].twin;
+			const uint32_t neighbor = edges[twin].face;
+
+			if (faces[neighbor].seen_from == eye) {
+				continue;
+			}
+
+			// Faces that `eye` is only just in front of have to be replaced too, or
+			// the new faces next to them would make the hull concave
+			if (dist(faces[neighbor], eye) > 0.0) {
+				faces[neighbor].seen_from = eye;
+				visible.push_back(neighbor);
+				// The edge that was crossed leads back to a visible face
+				stack.push_back(search_frame{ neighbor, edges[twin].next, 2 });
+			} else {
+				horizon.push_back(e);
+			}
+		}
+	}
+
+	void hull_builder::append_vertices(std::vector<phys::vec3> &out) const {
+		std::vector<bool> is_vertex(points.size());
+
+		for (const hull_face &f : faces) {
+			if (f.is_dead) {
+				continue;
+			}
+
+			for (uint32_t e = f.edge; e < f.edge + 3; e++) {
+				is_vertex[edges[e].tail] = true;
+			}
+		}
+
+		for (size_t i = 0; i < points.size(); i++) {
+			if (is_vertex[i]) {
+				out.push_back(points[i]);
+			}
+		}
+	}
+
+	phys::vclip::polyhedron hull_builder::to_polyhedron() const {
+		std::vector<uint32_t> live_faces{};
+
+		for (uint32_t f = 0; f < (uint32_t)faces.size(); f++) {
+			if (! faces[f].is_dead) {
+				live_faces.push_back(f);
+			}
+		}
+
+		// Each polygon is grown from its biggest triangle, whose normal is the most
+		// accurate. A triangle joins the polygon if all of its vertices are in the
+		// plane of the first triangle, so polygons can't curve slowly around the hull.
+		std::sort(std::begin(live_faces), std::end(live_faces), [&](uint32_t f1, uint32_t f2) {
+			return faces[f1].area > faces[f2].area;
+		});
+
+		std::vector<uint32_t> polygon_of(faces.size(), no_index);
+		std::vector<uint32_t> queue{};
+		uint32_t num_polygons = 0;
+
+		for (uint32_t seed : live_faces) {
+			if (polygon_of[seed] != no_index) {
+				continue;
+			}
+
+			const hull_face &plane = faces[seed];
+
+			polygon_of[seed] = num_polygons;
+			queue.assign(1, seed);
+
+			while (! queue.empty()) {
+				const uint32_t f = queue.back();
+
+				queue.pop_back();
+
+				for (uint32_t e = faces[f].edge; e < faces[f].edge + 3; e++) {
+					const uint32_t neighbor = edges[edges[e].twin].face;
+
+					if (
+						polygon_of[neighbor] != no_index ||
+						glm::dot(faces[neighbor].normal, plane.normal) <= 0.0
+					) {
+						continue;
+					}
+
+					bool is_in_plane = true;
+
+					for (uint32_t n_e = faces[neighbor].edge; n_e < faces[neighbor].edge + 3; n_e++) {
+						is_in_plane = is_in_plane && std::abs(dist(plane, edges[n_e].tail)) <= tolerance;
+					}
+
+					if (is_in_plane) {
+						polygon_of[neighbor] = num_polygons;
+						queue.push_back(neighbor);
+					}
+				}
+			}
+
+			num_polygons++;
+		}
+
+		// Walks around the edge of each polygon
+		std::vector<std::vector<uint32_t>> polygons(num_polygons);
+
+		for (uint32_t f : live_faces) {
+			const uint32_t polygon = polygon_of[f];
+
+			if (! polygons[polygon].empty()) {
+				continue;
+			}
+
+			for (uint32_t start = faces[f].edge; start < faces[f].edge + 3; start++) {
+				if (polygon_of[edges[edges[start].twin].face] == polygon) {
+					continue;
+				}
+
+				uint32_t e = start;
+
+				do {
+					polygons[polygon].push_back(edges[e].tail);
+
+					// Turn around the edge's head until another boundary edge is found
+					uint32_t next = edges[e].next;
+
+					while (polygon_of[edges[edges[next].twin].face] == polygon) {
+						next = edges[edges[next].twin].next;
+					}
+
+					e = next;
+				} while (e != start);
+
+				break;
+			}
+		}
+
+		// A vertex on only two polygons is in the middle of an edge between them
+		std::vector<uint32_t> num_polygons_at(points.size(), 0);
+
+		for (const std::vector<uint32_t> &polygon : polygons) {
+			for (uint32_t v : polygon) {
+				num_polygons_at[v]++;
+			}
+		}
+
+		for (std::vector<uint32_t> &polygon : polygons) {
+			std::erase_if(polygon, [&](uint32_t v) {
+				return num_polygons_at[v] <= 2;
+			});
+
+			if (polygon.size() < 3) {
+				continue;
+			}
+
+			// `vclip::face` computes the normal of a convex face from its first three
+			// vertices, so the sharpest corner goes second
+			size_t best_corner = 0;
+			double best_area = -1.0;
+
+			for (size_t i = 0; i < polygon.size(); i++) {
+				const dvec3 prev = point(polygon[(i + polygon.size() - 1) % polygon.size()]);
+				const dvec3 curr = point(polygon[i]);
+				const dvec3 next = point(polygon[(i + 1) % polygon.size()]);
+				const dvec3 n = glm::cross(curr - prev, next - curr);
+				const double area = glm::dot(n, n);
+
+				if (area > best_area) {
+					best_area = area;
+					best_corner = i;
+				}
+			}
+
+			std::rotate(
+				std::begin(polygon),
+				std::begin(polygon) + ((best_corner + polygon.size() - 1) % polygon.size()),
+				std::end(polygon)
+			);
+		}
+
+		// Vertices are numbered in the order that they appear in the input
+		std::vector<uint32_t> vertex_index(points.size(), no_index);
+		std::vector<phys::vclip::vertex> vertices{};
+
+		for (uint32_t v = 0; v < (uint32_t)points.size(); v++) {
+			if (num_polygons_at[v] > 2) {
+				vertex_index[v] = (uint32_t)vertices.size();
+				vertices.push_back(phys::vclip::vertex(points[v], vertices.size()));
+			}
+		}
+
+		std::vector<phys::vclip::edge> out_edges{};
+		std::vector<phys::vclip::face> out_faces{};
+
+		for (const std::vector<uint32_t> &polygon : polygons) {
+			std::vector<size_t> vs{};
+
+			for (uint32_t v : polygon) {
+				vs.push_back(vertex_index[v]);
+			}
+
+			// Every edge is on two faces, once in each direction
+			for (size_t i = 0; i < vs.size(); i++) {
+				const size_t t = vs[i];
+				const size_t h = vs[(i + 1) % vs.size()];
+
+				if (t < h) {
+					out_edges.push_back(phys::vclip::edge(t, h));
+				}
+			}
+
+			out_faces.push_back(phys::vclip::face(vs));
+		}
+
+		phys::vclip::polyhedron out(std::move(vertices), std::move(out_edges), std::move(out_faces));
+
+		out.compile_adjacency();
+		out.validate();
+
+		return out;
+	}
+
+	std::vector<phys::vec3> parallel_hull_vertices(std::span<const phys::vec3> points, phys::thread_pool &pool) {
+		const size_t num_chunks = std::min(
+			(pool.num_threads() + 1) * chunks_per_thread,
+			points.size() / (phys::min_parallel_hull_points / chunks_per_thread)
+		);
+		std::vector<std::vector<phys::vec3>> chunk_vertices(num_chunks);
+
+		pool.parallel_for(num_chunks, 1, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				const size_t first = (i * points.size()) / num_chunks;
+				const size_t last = ((i + 1) * points.size()) / num_chunks;
+				const std::span<const phys::vec3> chunk = points.subspan(first, last - first);
+				hull_builder builder(chunk);
+
+				// The points in a flat chunk might still be on the hull
+				if (builder.build()) {
+					builder.append_vertices(chunk_vertices[i]);
+				} else {
+					chunk_vertices[i].assign(std::begin(chunk), std::end(chunk));
+				}
+			}
+		});
+
+		std::vector<phys::vec3> out{};
+
+		for (const std::vector<phys::vec3> &vertices : chunk_vertices) {
+			out.insert(std::end(out), std::begin(vertices), std::end(vertices));
+		}
+
+		return out;
+	}
+}
+
+phys::vclip::polyhedron phys::quickhull(std::span<const vec3> points, thread_pool * pool) {
+	if (points.size() < 4) {
+		throw std::invalid_argument("A convex hull needs at least four points");
+	}
+
+	std::vector<vec3> candidates{};
+
+	// Points inside the hull of a chunk are inside the hull of every point
+	if (pool && points.size() >= min_parallel_hull_points) {
+		candidates = parallel_hull_vertices(points, *pool);
+		points = candidates;
+	}
+
+	hull_builder builder(points);
+
+	if (! builder.build()) {
+		throw std::invalid_argument("Points must not all be in the same plane");
+	}
+
+	return builder.to_polyhedron();
+}
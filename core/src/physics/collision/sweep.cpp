@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include "physics/collision/sweep.h"
+
+using namespace phys::literals;
+
+namespace {
+	// Normalizes `v`, or returns `fallback` if `v` is zero
+	phys::vec3 normalize_or(const phys::vec3 &v, const phys::vec3 &fallback) {
+		const phys::real len_sqr = phys::dot(v, v);
+
+		if (len_sqr == 0.0_r) {
+			return fallback;
+		}
+
+		return v / std::sqrt(len_sqr);
+	}
+
+	// The first time at which a ray from `start` along `d` enters a sphere. The ray
+	// must start outside of the sphere. Returns infinity if the ray misses.
+	phys::real ray_sphere(
+		const phys::vec3 &start,
+		const phys::vec3 &d,
+		const phys::vec3 &center,
+		phys::real radius
+	) {
+		const phys::vec3 m = start - center;
+		const phys::real a = phys::dot(d, d);
+		const phys::real b = phys::dot(m, d);
+		const phys::real c = phys::dot(m, m) - radius * radius;
+
+		if (b >= 0.0_r || a == 0.0_r) {
+			return phys::infinity;
+		}
+
+		const phys::real disc = b * b - a * c;
+
+		if (disc < 0.0_r) {
+			return phys::infinity;
+		}
+
+		return (-b - std::sqrt(disc)) / a;
+	}
+
+	// The first time at which a ray from `start` along `d` enters the side of a
+	// capsule around the segment from `p` to `q`. The ends of the capsule are left
+	// to `ray_sphere`. Returns infinity if the ray misses the side.
+	phys::real ray_capsule_side(
+		const phys::vec3 &start,
+		const phys::vec3 &d,
+		const phys::vec3 &p,
+		const phys::vec3 &q,
+		phys::real radius
+	) {
+		const phys::vec3 e = q - p;
+		const phys::vec3 m = start - p;
+		const phys::real ee = phys::dot(e, e);
+		const phys::real md = phys::dot(m, e);
+		const phys::real nd = phys::dot(d, e);
+
+		// The ray and the segment are both projected onto the plane perpendicular to
+		// the segment, and the ray is intersected with the circle that the capsule
+		// projects to. Everything is scaled by `ee` so that nothing is divided.
+		const phys::real a = ee * phys::dot(d, d) - nd * nd;
+		const phys::real b = ee * phys::dot(m, d) - nd * md;
+		const phys::real c = ee * (phys::dot(m, m) - radius * radius) - md * md;
+
+		// Rays that are parallel to the segment or that start inside of the infinite
+		// cylinder can only hit the capsule at its ends
+		if (a <= 0.0_r || c < 0.0_r || b >= 0.0_r) {
+			return phys::infinity;
+		}
+
+		const phys::real disc = b * b - a * c;
+
+		if (disc < 0.0_r) {
+			return phys::infinity;
+		}
+
+		const phys::real t = (-b - std::sqrt(disc)) / a;
+		const phys::real s = md + t * nd;
+
+		if (s < 0.0_r || s > ee) {
+			return phys::infinity;
+		}
+
+		return t;
+	}
+}
+
+phys::aabb phys::triangle::get_bounds() const {
+	return aabb(glm::min(glm::min(a, b), c), glm::max(glm::max(a, b), c));
+}
+
+phys::aabb phys::swept_bounds(const vec3 &start, const vec3 &end, real radius) {
+	return aabb(glm::min(start, end) - vec3(radius), glm::max(start, end) + vec3(radius));
+}
+
+// Ericson, Real-Time Collision Detection, section 5.1.5
+phys::vec3 phys::closest_point_on_triangle(const vec3 &p, const triangle &tri) {
+	const vec3 ab = tri.b - tri.a;
+	const vec3 ac = tri.c - tri.a;
+	const vec3 ap = p - tri.a;
+	const real d1 = dot(ab, ap);
+	const real d2 = dot(ac, ap);
+
+	if (d1 <= 0.0_r && d2 <= 0.0_r) {
+		return tri.a;
+	}
+
+	const vec3 bp = p - tri.b;
+	const real d3 = dot(ab, bp);
+	const real d4 = dot(ac, bp);
+
+	if (d3 >= 0.0_r && d4 <= d3) {
+		return tri.b;
+	}
+
+	const real vc = d1 * d4 - d3 * d2;
+
+	if (vc <= 0.0_r && d1 >= 0.0_r && d3 <= 0.0_r) {
+		return tri.a + (d1 / (d1 - d3)) * ab;
+	}
+
+	const vec3 cp = p - tri.c;
+	const real d5 = dot(ab, cp);
+	const real d6 = dot(ac, cp);
+
+	if (d6 >= 0.0_r && d5 <= d6) {
+		return tri.c;
+	}
+
+	const real vb = d5 * d2 - d1 * d6;
+
+	if (vb <= 0.0_r && d2 >= 0.0_r && d6 <= 0.0_r) {
+		return tri.a + (d2 / (d2 - d6)) * ac;
+	}
+
+	const real va = d3 * d6 - d5 * d4;
+
+	if (va <= 0.0_r && (d4 - d3) >= 0.0_r && (d5 - d6) >= 0.0_r) {
+		return tri.b + ((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (tri.c - tri.b);
+	}
+
+	const real denom = 1.0_r / (va + vb + vc);
+
+	return tri.a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// The sphere touches the triangle when its center enters the triangle's Minkowski
+// sum with the sphere: a slab around the face, capsules around the edges, and
+// spheres around the vertices. The ray from `start` to `end` is tested against
+// each of those, and the first hit wins.
+std::optional<phys::sweep_hit> phys::sweep_sphere_triangle(
+	const vec3 &start,
+	const vec3 &end,
+	real radius,
+	const triangle &tri
+) {
+	const vec3 d = end - start;
+	const vec3 n = cross(tri.b - tri.a, tri.c - tri.a);
+	const real n_len_sqr = dot(n, n);
+	const real dist = (n_len_sqr == 0.0_r) ? 0.0_r : dot(start - tri.a, n) / std::sqrt(n_len_sqr);
+	// The face normal on the side of the triangle that the sphere starts on
+	const vec3 side_normal = normalize_or((dist < 0.0_r) ? -n : n, normalize_or(-d, vec3(0.0_r, 1.0_r, 0.0_r)));
+	const vec3 start_diff = start - closest_point_on_triangle(start, tri);
+
+	if (dot(start_diff, start_diff) < radius * radius) {
+		const vec3 normal = normalize_or(start_diff, side_normal);
+
+		if (dot(d, normal) >= 0.0_r) {
+			return std::nullopt;
+		}
+
+		return sweep_hit{ 0.0_r, start, normal };
+	}
+
+	real t = infinity;
+	const real speed = dot(d, side_normal);
+
+	if (n_len_sqr != 0.0_r && std::abs(dist) >= radius && speed < 0.0_r) {
+		const real face_t = (radius - std::abs(dist)) / speed;
+		const vec3 touch = start + face_t * d - radius * side_normal;
+
+		// The point where the sphere touches the triangle's plane has to be inside
+		// of the triangle
+		const bool inside =
+			dot(cross(tri.b - tri.a, touch - tri.a), n) >= 0.0_r &&
+			dot(cross(tri.c - tri.b, touch - tri.b), n) >= 0.0_r &&
+			dot(cross(tri.a - tri.c, touch - tri.c), n) >= 0.0_r;
+
+		if (inside) {
+			t = face_t;
+		}
+	}
+
+	const std::array<vec3, 3> verts{ tri.a, tri.b, tri.c };
+
+	for (size_t i = 0; i < verts.size(); i++) {
+		const vec3 &p = verts[i];
+		const vec3 &q = verts[(i + 1) % verts.size()];
+
+		t = std::min(t, ray_capsule_side(start, d, p, q, radius));
+		t = std::min(t, ray_sphere(start, d, p, radius));
+	}
+
+	if (t > 1.0_r) {
+		return std::nullopt;
+	}
+
+	t = std::max(t, 0.0_r);
+
+	const vec3 center = start + t * d;
+
+	return sweep_hit{ t, center, normalize_or(center - closest_point_on_triangle(center, tri), side_normal) };
+}
+
+std::optional<phys::sweep_hit> phys::sweep_spheres(
+	const vec3 &a_start,
+	const vec3 &a_end,
+	real a_radius,
+	const vec3 &b_start,
+	const vec3 &b_end,
+	real b_radius
+) {
+	// `a` moves relative to `b`, which is treated as if it were standing still
+	const vec3 m = a_start - b_start;
+	const vec3 d = (a_end - a_start) - (b_end - b_start);
+	const real radius = a_radius + b_radius;
+	const real c = dot(m, m) - radius * radius;
+	const real b = dot(m, d);
+
+	if (c < 0.0_r) {
+		if (b >= 0.0_r) {
+			return std::nullopt;
+		}
+
+		return sweep_hit{ 0.0_r, a_start, normalize_or(m, normalize_or(-d, vec3(0.0_r, 1.0_r, 0.0_r))) };
+	}
+
+	const real t = ray_sphere(m, d, vec3(0.0_r), radius);
+
+	if (t > 1.0_r) {
+		return std::nullopt;
+	}
+
+	const vec3 center = a_start + t * (a_end - a_start);
+
+	return sweep_hit{ t, center, normalize_or(m + t * d, normalize_or(-d, vec3(0.0_r, 1.0_r, 0.0_r))) };
+}
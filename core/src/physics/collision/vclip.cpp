@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <array>
 #include <stack>
 #include "logging.h"
 #include "physics/collision/vclip.h"
@@ -18,11 +19,107 @@ namespace phys {
 			return dot(v - p_pos, p_dir);
 		}
 
+		// The point at `l` along the segment from `t` to `h`, like `edge::at`
+		vec3 segment_at(const vec3 &t, const vec3 &h, real l) {
+			assert(l >= 0);
+			assert(l <= 1);
+
+			return (1 - l) * t + l * h;
+		}
+
+		// One of the two polyhedra that the algorithm is running on. The polyhedra
+		// don't have to be in the same space: `to_other` transforms points from this
+		// polyhedron's space to the other one's, or is null if they're in the same
+		// space. A feature is only ever tested against the Voronoi planes of the other
+		// polyhedron, so the feature's points are moved into the planes' space and the
+		// planes themselves are used as they are.
+		struct frame {
+			const polyhedron &p;
+			const mat4 * to_other{};
+
+			vec3 in_other(const vec3 &v) const {
+				if (! to_other) {
+					return v;
+				}
+
+				return truncate(*to_other * vec4(v, 1.0_r));
+			}
+		};
+
+		// Returns the first edge around `v` that satisfies `pred`, in the same order
+		// as `vertex::edges`
+		template <typename Pred>
+		std::optional<edge> find_neighbor_edge(const polyhedron &p, const vertex &v, Pred pred) {
+			if (const adjacency * adj = p.adjacency_table.get()) {
+				for (size_t j = adj->vertex_edge_offsets[v.i]; j < adj->vertex_edge_offsets[v.i + 1]; j++) {
+					const edge &e = p.edges[adj->vertex_edges[j]];
+
+					if (pred(e)) {
+						return e;
+					}
+				}
+
+				return {};
+			}
+
+			for (const edge &e : v.edges(p)) {
+				if (pred(e)) {
+					return e;
+				}
+			}
+
+			return {};
+		}
+
+		// The longest loop of states that `closest_features` will notice
+		constexpr size_t max_cycle_length = 6;
+
+		// Identifies a feature without copying it. A face is identified by its first
+		// two vertices, because no other face has the same edge in the same direction.
+		struct feature_key {
+			size_t type{};
+			size_t i{};
+			size_t j{};
+
+			friend bool operator==(const feature_key &a, const feature_key &b) = default;
+		};
+
+		feature_key key_of(const feature &f) {
+			if (const vertex * v = std::get_if<vertex>(&f)) {
+				return feature_key{ f.index(), v->i, 0 };
+			} else if (const edge * e = std::get_if<edge>(&f)) {
+				return feature_key{ f.index(), std::min(e->v_is[0], e->v_is[1]), std::max(e->v_is[0], e->v_is[1]) };
+			}
+
+			const face &fc = std::get<face>(f);
+
+			return feature_key{ f.index(), fc.vert(0), fc.vert(1) };
+		}
+
+		bool has_visited(
+			const std::array<std::pair<feature_key, feature_key>, max_cycle_length> &history,
+			size_t steps,
+			const algorithm_state &state
+		) {
+			const std::pair<feature_key, feature_key> key{ key_of(state.f1), key_of(state.f2) };
+
+			for (size_t i = 0; i < std::min(steps, max_cycle_length); i++) {
+				if (history[i] == key) {
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		// Like the `clip_edge` below, but `t` and `h` are the tail and head of `e` in
+		// the space of `vps`
 		clip_result clip_edge(
-			const polyhedron &p_e,
 			const edge &e,
+			const vec3 &t,
+			const vec3 &h,
 			const feature &f,
-			const std::vector<vplane> &vps,
+			std::span<const vplane> vps,
 			std::optional<clip_result> prev_result
 		) {
 			clip_result out(e, f);
@@ -35,8 +132,8 @@ namespace phys {
 
 			for (const vplane &vp : vps) {
 				const feature &n = vp.other(f);
-				real dt = -dp(e.t(p_e).v, vp.pos, vp.dir);
-				real dh = -dp(e.h(p_e).v, vp.pos, vp.dir);
+				real dt = -dp(t, vp.pos, vp.dir);
+				real dh = -dp(h, vp.pos, vp.dir);
 
 				if (dt < 0 && dh < 0) {
 					out.n1 = n;
@@ -74,12 +171,25 @@ namespace phys {
 			return out;
 		}
 
-		std::optional<feature> deriv_check(
+		clip_result clip_edge(
 			const polyhedron &p_e,
+			const edge &e,
+			const feature &f,
+			std::span<const vplane> vps,
+			std::optional<clip_result> prev_result
+		) {
+			return clip_edge(e, e.t(p_e).v, e.h(p_e).v, f, vps, prev_result);
+		}
+
+		// Like the `deriv_check` below, but `t` and `h` are the tail and head of `cr.e`
+		// in the space of `p_f`
+		std::optional<feature> deriv_check(
+			const vec3 &t,
+			const vec3 &h,
 			const polyhedron &p_f,
 			const clip_result &cr
 		) {
-			vec3 u = cr.e.t(p_e).v - cr.e.h(p_e).v;
+			vec3 u = t - h;
 			const feature * f = &cr.f;
 
 			if (std::holds_alternative<edge>(*f)) {
@@ -96,25 +206,25 @@ namespace phys {
 					if (std::holds_alternative<vertex>(*cr.n1)) {
 						const vertex &v = std::get<vertex>(*cr.n1);
 
-						d1 = dot(u, cr.e.at(p_e, cr.l1) - v.v);
+						d1 = dot(u, segment_at(t, h, cr.l1) - v.v);
 					} else {
 						assert(std::holds_alternative<face>(*cr.n1));
 
 						const face &f1 = std::get<face>(*cr.n1);
 						vec3 f_pos = f_e.t(p_f).v;
-						d1 = dp(cr.e.at(p_e, cr.l1), f_pos, f1.normal(p_f));
+						d1 = dp(segment_at(t, h, cr.l1), f_pos, f1.normal(p_f));
 					}
 
 					if (std::holds_alternative<vertex>(*cr.n2)) {
 						const vertex &v = std::get<vertex>(*cr.n2);
 
-						d2 = dot(u, cr.e.at(p_e, cr.l2) - v.v);
+						d2 = dot(u, segment_at(t, h, cr.l2) - v.v);
 					} else {
 						assert(std::holds_alternative<face>(*cr.n2));
 
 						const face &f2 = std::get<face>(*cr.n2);
 						vec3 f_pos = f_e.t(p_f).v;
-						d2 = dp(cr.e.at(p_e, cr.l2), f_pos, f2.normal(p_f));
+						d2 = dp(segment_at(t, h, cr.l2), f_pos, f2.normal(p_f));
 					}
 
 					if (d1 < d2) {
@@ -134,8 +244,8 @@ namespace phys {
 			if (std::holds_alternative<vertex>(*f)) {
 				const vertex &v = std::get<vertex>(*f);
 
-				real d1 = dot(u, cr.e.at(p_e, cr.l1) - v.v);
-				real d2 = dot(u, cr.e.at(p_e, cr.l2) - v.v);
+				real d1 = dot(u, segment_at(t, h, cr.l1) - v.v);
+				real d2 = dot(u, segment_at(t, h, cr.l2) - v.v);
 
 				if (cr.n1 && d1 > 0) {
 					return cr.n1;
@@ -159,18 +269,26 @@ namespace phys {
 			return std::nullopt;
 		}
 
+		std::optional<feature> deriv_check(
+			const polyhedron &p_e,
+			const polyhedron &p_f,
+			const clip_result &cr
+		) {
+			return deriv_check(cr.e.t(p_e).v, cr.e.h(p_e).v, p_f, cr);
+		}
+
 		// Algorithm 3 in the paper
 		local_min_result handle_local_min(
 			const polyhedron &p_f,
 			const face &f,
-			const vertex &v
+			const vec3 &v
 		) {
 			real d_max = -infinity;
 			const face * f_out = &f;
 
 			for (const face &fp : p_f.faces) {
 				vec3 n = fp.normal(p_f);
-				real d = dp(v.v, p_f.vertices[fp.verts()[0]].v, n);
+				real d = dp(v, p_f.vertices[fp.verts()[0]].v, n);
 
 				if (d > d_max) {
 					d_max = d;
@@ -233,8 +351,18 @@ namespace phys {
 				}
 			}
 
-			for (const edge &e : edges) {
-				std::vector<face> neighbors = e.faces(*this) | std::ranges::to<std::vector>();
+			for (size_t e_i = 0; e_i < edges.size(); e_i++) {
+				const edge &e = edges[e_i];
+				std::vector<face> neighbors{};
+
+				// Searching every face for each edge is slow for big polyhedra
+				if (adjacency_table) {
+					for (size_t f_i : adjacency_table->edge_neighbors[e_i].faces) {
+						neighbors.push_back(faces[f_i]);
+					}
+				} else {
+					neighbors = e.faces(*this) | std::ranges::to<std::vector>();
+				}
 
 				if (neighbors.size() != 2) {
 					throw geometry_error(e,
@@ -267,20 +395,24 @@ namespace phys {
 		}
 
 		size_t polyhedron::add_vertex(const vec3 &v) {
+			invalidate_adjacency();
 			vertices.push_back(vertex(v, vertices.size()));
 
 			return vertices.size() - 1;
 		}
 
 		void polyhedron::add_edge(const edge &e) {
+			invalidate_adjacency();
 			edges.push_back(e);
 		}
 
 		void polyhedron::add_face(const face &f) {
+			invalidate_adjacency();
 			faces.push_back(f);
 		}
 
 		void polyhedron::add_face_and_new_edges(const face &f) {
+			invalidate_adjacency();
 			faces.push_back(f);
 
 			// TODO: Sort edges, reduce time complexity from O(nm) to O(n + m)
@@ -300,6 +432,8 @@ namespace phys {
 		std::vector<face> polyhedron::remove_vertex(size_t vertex_idx) {
 			assert(is_possible_vertex(vertex_idx));
 
+			invalidate_adjacency();
+
 			std::vector<edge> edges_to_remove{};
 
 			auto pred = [=](const edge &e) {
@@ -331,6 +465,8 @@ namespace phys {
 		std::vector<face> polyhedron::remove_edge(const edge &e) {
 			assert(is_possible_edge(e));
 
+			invalidate_adjacency();
+
 			auto it = std::partition(std::begin(faces), std::end(faces), [&](const face &f) {
 				return ! f.has_edge(e);
 			});
@@ -346,6 +482,8 @@ namespace phys {
 		std::vector<face> polyhedron::remove_face(const face &f) {
 			assert(is_possible_face(f));
 
+			invalidate_adjacency();
+
 			if (std::erase(faces, f)) {
 				return { f };
 			}
@@ -356,6 +494,8 @@ namespace phys {
 		void polyhedron::remove_face_and_dead_edges(const face &f) {
 			assert(is_possible_face(f));
 
+			invalidate_adjacency();
+
 			face old_f = f;
 			std::erase(faces, f);
 
@@ -618,6 +758,7 @@ namespace phys {
 		}
 
 		void polyhedron::clear() {
+			invalidate_adjacency();
 			faces.clear();
 			edges.clear();
 			vertices.clear();
@@ -647,6 +788,8 @@ namespace phys {
 		}
 
 		void polyhedron::move_vertex(size_t from, size_t to) {
+			invalidate_adjacency();
+
 			for (edge &e : edges) {
 				if (e.v_is[0] == from) {
 					e.v_is[0] = to;
@@ -669,6 +812,137 @@ namespace phys {
 			return (int)(vertices.size() + faces.size()) - (int)edges.size();
 		}
 
+		void polyhedron::compile_adjacency() {
+			validate_references();
+
+			std::shared_ptr<adjacency> table = std::make_shared<adjacency>();
+			std::vector<size_t> &v_offsets = table->vertex_edge_offsets;
+
+			v_offsets.assign(vertices.size() + 1, 0);
+
+			for (const edge &e : edges) {
+				v_offsets[e.v_is[0] + 1]++;
+				v_offsets[e.v_is[1] + 1]++;
+			}
+
+			for (size_t i = 1; i < v_offsets.size(); i++) {
+				v_offsets[i] += v_offsets[i - 1];
+			}
+
+			table->vertex_edges.resize(v_offsets.back());
+			table->vertex_plane_dirs.resize(v_offsets.back());
+
+			std::vector<size_t> next_slot(std::begin(v_offsets), std::end(v_offsets) - 1);
+
+			// Edges are added in order, so the edges around each vertex are in the same
+			// order as `vertex::edges` would give them
+			for (size_t e_i = 0; e_i < edges.size(); e_i++) {
+				const edge &e = edges[e_i];
+
+				for (size_t end = 0; end < 2; end++) {
+					const size_t v_i = e.v_is[end];
+					const size_t other_i = e.v_is[1 - end];
+					const size_t slot = next_slot[v_i]++;
+
+					table->vertex_edges[slot] = e_i;
+					table->vertex_plane_dirs[slot] = normalize(vertices[other_i].v - vertices[v_i].v);
+				}
+			}
+
+			std::vector<size_t> num_faces(edges.size(), 0);
+
+			table->edge_neighbors.resize(edges.size());
+			table->face_edge_offsets.reserve(faces.size() + 1);
+			table->face_edge_offsets.push_back(0);
+
+			for (size_t f_i = 0; f_i < faces.size(); f_i++) {
+				const face &f = faces[f_i];
+				const vec3 n = f.normal(*this);
+
+				for (const edge &e : f.edges()) {
+					const size_t e_i = table->edge_index(*this, e);
+
+					if (e_i == SIZE_MAX) {
+						throw geometry_error(f, "Face refers to an edge that doesn't exist: " + traits::to_string(e));
+					}
+
+					if (num_faces[e_i] == 2) {
+						throw geometry_error(edges[e_i], "Edge has more than two neighboring faces");
+					}
+
+					const vec3 d = normalize(e.h(*this).v - e.t(*this).v);
+					adjacency::edge_faces &neighbors = table->edge_neighbors[e_i];
+					const size_t slot = num_faces[e_i]++;
+
+					neighbors.faces[slot] = f_i;
+					neighbors.ccw_edges[slot] = e;
+					neighbors.plane_dirs[slot] = cross(n, d);
+
+					table->face_edges.push_back(e);
+					table->face_plane_dirs.push_back(cross(d, n));
+				}
+
+				table->face_edge_offsets.push_back(table->face_edges.size());
+			}
+
+			for (size_t e_i = 0; e_i < edges.size(); e_i++) {
+				if (num_faces[e_i] != 2) {
+					throw geometry_error(edges[e_i],
+						"Edge does not have two neighboring faces: " + traits::to_string(num_faces[e_i])
+					);
+				}
+			}
+
+			adjacency_table = std::move(table);
+		}
+
+		void polyhedron::invalidate_adjacency() {
+			adjacency_table.reset();
+		}
+
+		size_t adjacency::edge_index(const polyhedron &p, const edge &e) const {
+			const size_t v_i = e.v_is[0];
+
+			if (v_i + 1 >= vertex_edge_offsets.size()) {
+				return SIZE_MAX;
+			}
+
+			for (size_t j = vertex_edge_offsets[v_i]; j < vertex_edge_offsets[v_i + 1]; j++) {
+				if (p.edges[vertex_edges[j]] == e) {
+					return vertex_edges[j];
+				}
+			}
+
+			return SIZE_MAX;
+		}
+
+		size_t adjacency::face_index(const polyhedron &p, const face &f) const {
+			if (f.num_verts() < 2) {
+				return SIZE_MAX;
+			}
+
+			const size_t e_i = edge_index(p, edge(f.vert(0), f.vert(1)));
+
+			if (e_i == SIZE_MAX) {
+				return SIZE_MAX;
+			}
+
+			// Only one face can have this edge in this direction. The face in the table
+			// must also start at the same vertex, or its edges would be in a different
+			// order than `face::edges` would give them.
+			const edge_faces &neighbors = edge_neighbors[e_i];
+
+			for (size_t i = 0; i < 2; i++) {
+				const face &candidate = p.faces[neighbors.faces[i]];
+
+				if (neighbors.ccw_edges[i].v_is[0] == f.vert(0) && std::ranges::equal(candidate.verts(), f.verts())) {
+					return neighbors.faces[i];
+				}
+			}
+
+			return SIZE_MAX;
+		}
+
 		polyhedron add(const polyhedron &p1, const polyhedron &p2) {
 			polyhedron out{};
 
@@ -766,7 +1040,33 @@ namespace phys {
 		}
 
 		std::vector<vplane> vertex::ve_planes(const polyhedron &p) const {
-			std::vector<vplane> out{};
+			vplane_set out{};
+
+			ve_planes(p, out);
+
+			return std::vector<vplane>(std::begin(out), std::end(out));
+		}
+
+		void vertex::ve_planes(const polyhedron &p, vplane_set &out) const {
+			out.clear();
+
+			if (const adjacency * adj = p.adjacency_table.get()) {
+				const size_t begin = adj->vertex_edge_offsets[i];
+				const size_t end = adj->vertex_edge_offsets[i + 1];
+
+				out.reserve(end - begin);
+
+				for (size_t j = begin; j < end; j++) {
+					out.emplace_back(
+						*this,
+						p.edges[adj->vertex_edges[j]],
+						v,
+						adj->vertex_plane_dirs[j]
+					);
+				}
+
+				return;
+			}
 
 			for (const edge &e : edges(p)) {
 				vec3 norm;
@@ -777,41 +1077,74 @@ namespace phys {
 					norm = e.t(p).v - e.h(p).v;
 				}
 
-				out.push_back(vplane(
+				out.emplace_back(
 					*this,
 					e,
 					v,
 					normalize(norm)
-				));
+				);
 			}
-
-			return out;
 		}
 
 		std::vector<vplane> edge::ve_planes(const polyhedron &p) const {
-			std::vector<vplane> out{};
+			vplane_set out{};
+
+			ve_planes(p, out);
+
+			return std::vector<vplane>(std::begin(out), std::end(out));
+		}
+
+		std::vector<vplane> edge::fe_planes(const polyhedron &p) const {
+			vplane_set out{};
+
+			fe_planes(p, out);
+
+			return std::vector<vplane>(std::begin(out), std::end(out));
+		}
+
+		void edge::ve_planes(const polyhedron &p, vplane_set &out) const {
 			const vertex &v1 = p.vertices[v_is[0]];
 			const vertex &v2 = p.vertices[v_is[1]];
 			vec3 normal = normalize(v1.v - v2.v);
 
-			out.push_back(vplane(
+			out.clear();
+			out.emplace_back(
 				v1,
 				*this,
 				v1.v,
 				normal
-			));
-			out.push_back(vplane(
+			);
+			out.emplace_back(
 				v2,
 				*this,
 				v2.v,
 				-normal
-			));
-
-			return out;
+			);
 		}
 
-		std::vector<vplane> edge::fe_planes(const polyhedron &p) const {
-			std::vector<vplane> out{};
+		void edge::fe_planes(const polyhedron &p, vplane_set &out) const {
+			out.clear();
+
+			if (const adjacency * adj = p.adjacency_table.get()) {
+				const size_t e_i = adj->edge_index(p, *this);
+
+				if (e_i != SIZE_MAX) {
+					const adjacency::edge_faces &neighbors = adj->edge_neighbors[e_i];
+
+					for (size_t i = 0; i < 2; i++) {
+						const edge &ccw = neighbors.ccw_edges[i];
+
+						out.emplace_back(
+							p.faces[neighbors.faces[i]],
+							ccw,
+							ccw.t(p).v,
+							neighbors.plane_dirs[i]
+						);
+					}
+
+					return;
+				}
+			}
 			auto fs = faces(p);
 			auto it = std::begin(fs);
 
@@ -829,20 +1162,18 @@ namespace phys {
 
 			assert(it == std::end(fs));
 
-			out.push_back(vplane(
+			out.emplace_back(
 				f1,
 				e1,
 				e1.t(p).v,
 				cross(f1.normal(p), e1_d)
-			));
-			out.push_back(vplane(
+			);
+			out.emplace_back(
 				f2,
 				e2,
 				e2.t(p).v,
 				cross(f2.normal(p), e2_d)
-			));
-
-			return out;
+			);
 		}
 
 		bool edge::has_vertex(size_t i) const {
@@ -872,35 +1203,65 @@ namespace phys {
 			vs(_vs), convexity_hint(_convexity_hint) {}
 
 		std::vector<vplane> face::fe_planes(const polyhedron &p) const {
-			std::vector<vplane> out{};
+			vplane_set out{};
+
+			fe_planes(p, out);
+
+			return std::vector<vplane>(std::begin(out), std::end(out));
+		}
+
+		void face::fe_planes(const polyhedron &p, vplane_set &out) const {
+			out.clear();
+
+			if (const adjacency * adj = p.adjacency_table.get()) {
+				const size_t f_i = adj->face_index(p, *this);
+
+				if (f_i != SIZE_MAX) {
+					const size_t begin = adj->face_edge_offsets[f_i];
+					const size_t end = adj->face_edge_offsets[f_i + 1];
+
+					out.reserve(end - begin);
+
+					for (size_t j = begin; j < end; j++) {
+						const edge &e = adj->face_edges[j];
+
+						out.emplace_back(
+							*this,
+							e,
+							e.t(p).v,
+							adj->face_plane_dirs[j]
+						);
+					}
+
+					return;
+				}
+			}
 			vec3 n = normal(p);
 
 			for (const edge &e : edges()) {
 				vec3 d = normalize(e.h(p).v - e.t(p).v);
 
-				out.push_back(vplane(
+				out.emplace_back(
 					*this,
 					e,
 					e.t(p).v,
 					cross(d, n)
-				));
+				);
 			}
-
-			return out;
 		}
 
 		bool face::has_edge(const edge &e) const {
 			auto all_edges = edges();
 
-			return std::find(std::begin(all_edges), std::end(all_edges), e) != std::end(all_edges);
+			return std::ranges::find(all_edges, e) != std::end(all_edges);
 		}
 
 		bool face::has_vertex(size_t i) const {
 			return std::find(std::begin(vs), std::end(vs), i) != std::end(vs);
 		}
 
-		const std::vector<size_t>& face::verts() const {
-			return vs;
+		std::span<const size_t> face::verts() const {
+			return std::span<const size_t>(vs.data(), vs.size());
 		}
 
 		size_t face::num_verts() const {
@@ -1066,7 +1427,9 @@ namespace phys {
 			vec3 dir = cross(e1.h(p).v - e1.t(p).v, e2.h(p).v - e2.t(p).v);
 
 			for (it; it != std::end(all_edges); it++) {
-				if (std::abs(dot(dir, it->h(p).v - it->t(p).v)) > 1e-6f) {
+				const edge e = *it;
+
+				if (std::abs(dot(dir, e.h(p).v - e.t(p).v)) > 1e-6f) {
 					return false;
 				}
 			}
@@ -1291,36 +1654,51 @@ namespace phys {
 			std::unreachable();
 		}
 
-		std::vector<vplane> vplanes(const polyhedron &p, const feature &_f) {
+		std::vector<vplane> vplanes(const polyhedron &p, const feature &f) {
+			vplane_set out{};
+
+			vplanes(p, f, out);
+
+			return std::vector<vplane>(std::begin(out), std::end(out));
+		}
+
+		void vplanes(const polyhedron &p, const feature &_f, vplane_set &out) {
 			if (std::holds_alternative<vertex>(_f)) {
 				const vertex &v = std::get<vertex>(_f);
 
-				return v.ve_planes(p);
+				v.ve_planes(p, out);
+				return;
 			} else if (std::holds_alternative<face>(_f)) {
 				const face &f = std::get<face>(_f);
 
-				return f.fe_planes(p);
+				f.fe_planes(p, out);
+				return;
 			}
 
 			const edge &e = std::get<edge>(_f);
-			std::vector<vplane> out = e.ve_planes(p);
-			std::vector<vplane> fe_planes = e.fe_planes(p);
+			vplane_set fe_planes{};
 
-			out.insert(std::end(out), std::begin(fe_planes), std::end(fe_planes));
+			e.ve_planes(p, out);
+			e.fe_planes(p, fe_planes);
 
-			return out;
+			for (const vplane &vp : fe_planes) {
+				out.push_back(vp);
+			}
 		}
 
 		algorithm_state vv_state(
-			const polyhedron &p1,
-			const polyhedron &p2,
+			const frame &s1,
+			const frame &s2,
 			const vertex &v1,
 			const vertex &v2
 		) {
-			std::vector<vplane> vps = v1.ve_planes(p1); 
+			vplane_set vps{};
+			const vec3 v2_in_1 = s2.in_other(v2.v);
+
+			v1.ve_planes(s1.p, vps);
 
 			for (const auto &vp : vps) {
-				vec3 v_dir = v2.v - vp.pos;
+				vec3 v_dir = v2_in_1 - vp.pos;
 
 				if (dot(v_dir, vp.dir) >= 0) {
 					return algorithm_state{
@@ -1331,10 +1709,12 @@ namespace phys {
 				}
 			}
 
-			vps = v2.ve_planes(p2);
+			const vec3 v1_in_2 = s1.in_other(v1.v);
+
+			v2.ve_planes(s2.p, vps);
 
 			for (const auto &vp : vps) {
-				vec3 v_dir = v1.v - vp.pos;
+				vec3 v_dir = v1_in_2 - vp.pos;
 
 				if (dot(v_dir, vp.dir) >= 0) {
 					return algorithm_state{
@@ -1353,14 +1733,18 @@ namespace phys {
 		}
 
 		algorithm_state ve_state(
-			const polyhedron &p_v,
-			const polyhedron &p_e,
+			const frame &s_v,
+			const frame &s_e,
 			const vertex &v,
 			const edge &e
 		) {
-			std::vector<vplane> ve_vps = e.ve_planes(p_e);
-			for (const auto &vp : ve_vps) {
-				vec3 v_dir = v.v - vp.pos;
+			vplane_set vps{};
+			const vec3 v_in_e = s_v.in_other(v.v);
+
+			e.ve_planes(s_e.p, vps);
+
+			for (const auto &vp : vps) {
+				vec3 v_dir = v_in_e - vp.pos;
 
 				if (dot(v_dir, vp.dir) > 0) {
 					return algorithm_state{
@@ -1371,9 +1755,10 @@ namespace phys {
 				}
 			}
 
-			std::vector<vplane> fe_vps = e.fe_planes(p_e);
-			for (const auto &vp : fe_vps) {
-				vec3 v_dir = v.v - vp.pos;
+			e.fe_planes(s_e.p, vps);
+
+			for (const auto &vp : vps) {
+				vec3 v_dir = v_in_e - vp.pos;
 
 				if (dot(v_dir, vp.dir) > 0) {
 					return algorithm_state{
@@ -1384,7 +1769,11 @@ namespace phys {
 				}
 			}
 
-			clip_result cr = clip_edge(p_e, e, v, vplanes(p_v, v));
+			vplanes(s_v.p, v, vps);
+
+			const vec3 t = s_e.in_other(e.t(s_e.p).v);
+			const vec3 h = s_e.in_other(e.h(s_e.p).v);
+			clip_result cr = clip_edge(e, t, h, v, vps, std::nullopt);
 			algorithm_state out{
 				.f1 = v,
 				.f2 = e,
@@ -1396,7 +1785,7 @@ namespace phys {
 				out.f1 = *cr.n2;
 				was_updated = true;
 			} else {
-				std::optional<feature> f_opt = deriv_check(p_e, p_v, cr);
+				std::optional<feature> f_opt = deriv_check(t, h, s_v.p, cr);
 
 				if (f_opt) {
 					out.f1 = *f_opt;
@@ -1412,17 +1801,23 @@ namespace phys {
 		}
 
 		algorithm_state vf_state(
-			const polyhedron &p_v,
-			const polyhedron &p_f,
+			const frame &s_v,
+			const frame &s_f,
 			const vertex &v,
 			const face &f
 		) {
-			std::vector<vplane> vps = f.fe_planes(p_f);
+			const polyhedron &p_v = s_v.p;
+			const polyhedron &p_f = s_f.p;
+			vplane_set vps{};
 			real violation = 0;
+			const vec3 v_in_f = s_v.in_other(v.v);
+
+			f.fe_planes(p_f, vps);
+
 			std::optional<edge> max_edge{};
 
 			for (const vplane &vp : vps) {
-				real vp_violation = dp(v.v, vp.pos, vp.dir);
+				real vp_violation = dp(v_in_f, vp.pos, vp.dir);
 
 				if (vp_violation > violation) {
 					violation = vp_violation;
@@ -1439,10 +1834,10 @@ namespace phys {
 			}
 
 			vec3 f_norm = f.normal(p_f);
-			real dpv = dp(v.v, p_f.vertices[f.vert(0)].v, f_norm);
+			real dpv = dp(v_in_f, p_f.vertices[f.vert(0)].v, f_norm);
 
-			for (const edge &e : v.edges(p_v)) {
-				vec3 vp = e.v_is[0] == v.i ? e.h(p_v).v : e.t(p_v).v;
+			std::optional<edge> next_edge = find_neighbor_edge(p_v, v, [&](const edge &e) {
+				vec3 vp = s_v.in_other(e.v_is[0] == v.i ? e.h(p_v).v : e.t(p_v).v);
 				real dpvp = dp(vp, p_f.vertices[f.vert(0)].v, f_norm);
 
 				// The algorithm as described in the paper compares the magnitudes of Dp(v)
@@ -1450,15 +1845,16 @@ namespace phys {
 				// penetrate the face, but the other vertex penetrates the face and
 				// is further from the face than this vertex. In that case, we might
 				// not detect the penetration and falsely terminate.
-				bool should_update_to_vp = std::signbit(dpv) == std::signbit(dpvp) ?
+				return std::signbit(dpv) == std::signbit(dpvp) ?
 					std::abs(dpv) > std::abs(dpvp) : dpv > dpvp;
-				if (should_update_to_vp) {
-					return algorithm_state{
-						.f1 = e,
-						.f2 = f,
-						.step = algorithm_step::Continue
-					};
-				}
+			});
+
+			if (next_edge) {
+				return algorithm_state{
+					.f1 = *next_edge,
+					.f2 = f,
+					.step = algorithm_step::Continue
+				};
 			}
 
 			if (dpv > 0) {
@@ -1469,7 +1865,7 @@ namespace phys {
 				};
 			}
 
-			local_min_result lmr = handle_local_min(p_f, f, v);
+			local_min_result lmr = handle_local_min(p_f, f, v_in_f);
 			// TODO: Rename this to "distance" and always report it
 			real penetration =
 				lmr.step == algorithm_step::Penetration ? lmr.d : 0.0_r;
@@ -1483,24 +1879,31 @@ namespace phys {
 		}
 
 		algorithm_state ee_state(
-			const polyhedron &p_e1,
-			const polyhedron &p_e2,
+			const frame &s1,
+			const frame &s2,
 			const edge &e1,
 			const edge &e2
 		) {
+			const polyhedron &p_e1 = s1.p;
+			const polyhedron &p_e2 = s2.p;
+			const vec3 t2 = s2.in_other(e2.t(p_e2).v);
+			const vec3 h2 = s2.in_other(e2.h(p_e2).v);
 			algorithm_state out{
 				.f1 = e1,
 				.f2 = e2,
 				.step = algorithm_step::Continue
 			};
 
-			std::vector<vplane> vps = e1.ve_planes(p_e1);
-			clip_result cr = clip_edge(p_e2, e2, e1, vps);
+			vplane_set vps{};
+
+			e1.ve_planes(p_e1, vps);
+
+			clip_result cr = clip_edge(e2, t2, h2, e1, vps, std::nullopt);
 
 			if (! cr.is_clipped && cr.n1 == cr.n2 && cr.n1) {
 				out.f1 = *cr.n1;
 			} else {
-				std::optional<feature> f_opt = deriv_check(p_e2, p_e1, cr);
+				std::optional<feature> f_opt = deriv_check(t2, h2, p_e1, cr);
 
 				if (f_opt) {
 					out.f1 = *f_opt;
@@ -1511,13 +1914,13 @@ namespace phys {
 				return out;
 			}
 
-			vps = e1.fe_planes(p_e1);
-			cr = clip_edge(p_e2, e2, e1, vps, cr);
+			e1.fe_planes(p_e1, vps);
+			cr = clip_edge(e2, t2, h2, e1, vps, cr);
 
 			if (! cr.is_clipped && cr.n1 == cr.n2 && cr.n1) {
 				out.f1 = *cr.n1;
 			} else {
-				std::optional<feature> f_opt = deriv_check(p_e2, p_e1, cr);
+				std::optional<feature> f_opt = deriv_check(t2, h2, p_e1, cr);
 
 				if (f_opt) {
 					out.f1 = *f_opt;
@@ -1528,13 +1931,16 @@ namespace phys {
 				return out;
 			}
 
-			vps = e2.ve_planes(p_e2);
-			cr = clip_edge(p_e1, e1, e2, vps);
+			const vec3 t1 = s1.in_other(e1.t(p_e1).v);
+			const vec3 h1 = s1.in_other(e1.h(p_e1).v);
+
+			e2.ve_planes(p_e2, vps);
+			cr = clip_edge(e1, t1, h1, e2, vps, std::nullopt);
 
 			if (! cr.is_clipped && cr.n1 == cr.n2 && cr.n1) {
 				out.f2 = *cr.n1;
 			} else {
-				std::optional<feature> f_opt = deriv_check(p_e1, p_e2, cr);
+				std::optional<feature> f_opt = deriv_check(t1, h1, p_e2, cr);
 
 				if (f_opt) {
 					out.f2 = *f_opt;
@@ -1545,13 +1951,13 @@ namespace phys {
 				return out;
 			}
 
-			vps = e2.fe_planes(p_e2);
-			cr = clip_edge(p_e1, e1, e2, vps, cr);
+			e2.fe_planes(p_e2, vps);
+			cr = clip_edge(e1, t1, h1, e2, vps, cr);
 
 			if (! cr.is_clipped && cr.n1 == cr.n2 && cr.n1) {
 				out.f2 = *cr.n1;
 			} else {
-				std::optional<feature> f_opt = deriv_check(p_e1, p_e2, cr);
+				std::optional<feature> f_opt = deriv_check(t1, h1, p_e2, cr);
 
 				if (f_opt) {
 					out.f2 = *f_opt;
@@ -1567,29 +1973,49 @@ namespace phys {
 		}
 
 		algorithm_state ef_state(
-			const polyhedron &p_e,
-			const polyhedron &p_f,
+			const frame &s_e,
+			const frame &s_f,
 			const edge &e,
 			const face &f
 		) {
-			std::vector<vplane> vps = f.fe_planes(p_f);
-			clip_result cr = clip_edge(p_e, e, f, vps);
+			const polyhedron &p_e = s_e.p;
+			const polyhedron &p_f = s_f.p;
+			vplane_set vps{};
+			const vec3 t = s_e.in_other(e.t(p_e).v);
+			const vec3 h = s_e.in_other(e.h(p_e).v);
+
+			f.fe_planes(p_f, vps);
+
+			clip_result cr = clip_edge(e, t, h, f, vps, std::nullopt);
 
 			if (! cr.is_clipped) {
 				std::optional<feature> min_f = cr.n1;
 
 				assert(min_f);
 
-				vps = std::get<edge>(*min_f).ve_planes(p_f);
-				cr = clip_edge(p_e, e, *min_f, vps);
-				std::optional<feature> next_f = deriv_check(p_e, p_f, cr);
-
-				while (next_f) {
-					assert(std::holds_alternative<vertex>(*next_f));
+				std::get<edge>(*min_f).ve_planes(p_f, vps);
+				cr = clip_edge(e, t, h, *min_f, vps, std::nullopt);
+				std::optional<feature> next_f = deriv_check(t, h, p_f, cr);
+				// The walk along the boundary of the face goes from an edge to a vertex
+				// to an edge, and so on. The distance gets smaller with every step, so it
+				// can't visit more than every edge and vertex of the face unless rounding
+				// error sends it back and forth.
+				size_t steps_left = 2 * f.num_verts();
 
+				while (next_f && steps_left--) {
 					min_f = next_f;
-					std::vector<vplane> all_vps = std::get<vertex>(*min_f).ve_planes(p_f);
 
+					if (std::holds_alternative<edge>(*min_f)) {
+						std::get<edge>(*min_f).ve_planes(p_f, vps);
+						cr = clip_edge(e, t, h, *min_f, vps, std::nullopt);
+						next_f = deriv_check(t, h, p_f, cr);
+
+						continue;
+					}
+
+					vplane_set all_vps{};
+
+					std::get<vertex>(*min_f).ve_planes(p_f, all_vps);
 					vps.clear();
 
 					for (const vplane &vp : all_vps) {
@@ -1602,8 +2028,8 @@ namespace phys {
 
 					assert(! vps.empty());
 
-					cr = clip_edge(p_e, e, *min_f, vps);
-					next_f = deriv_check(p_e, p_f, cr);
+					cr = clip_edge(e, t, h, *min_f, vps, std::nullopt);
+					next_f = deriv_check(t, h, p_f, cr);
 				}
 
 				return algorithm_state{
@@ -1614,8 +2040,8 @@ namespace phys {
 			}
 
 			vec3 n = f.normal(p_f);
-			vec3 e_v1 = e.at(p_e, cr.l1);
-			vec3 e_v2 = e.at(p_e, cr.l2);
+			vec3 e_v1 = segment_at(t, h, cr.l1);
+			vec3 e_v2 = segment_at(t, h, cr.l2);
 			real d1 = dot(e_v1 - p_f.vertices[f.vert(0)].v, n);
 			real d2 = dot(e_v2 - p_f.vertices[f.vert(0)].v, n);
 
@@ -1628,7 +2054,7 @@ namespace phys {
 				};
 			}
 
-			vec3 u = e.t(p_e).v - e.h(p_e).v;
+			vec3 u = t - h;
 			real un = dot(u, n);
 			bool below_support = d1 < 0 && d2 < 0;
 
@@ -1703,43 +2129,43 @@ namespace phys {
 		{}
 
 		algorithm_state update_state(
-			const polyhedron &p1,
-			const polyhedron &p2,
+			const frame &s1,
+			const frame &s2,
 			const algorithm_state &old
 		) {
 			if (std::holds_alternative<vertex>(old.f1)) {
 				const vertex &v1 = std::get<vertex>(old.f1);
 
 				if (std::holds_alternative<vertex>(old.f2)) {
-					return vv_state(p1, p2, v1, std::get<vertex>(old.f2));
+					return vv_state(s1, s2, v1, std::get<vertex>(old.f2));
 				} else if (std::holds_alternative<edge>(old.f2)) {
-					return ve_state(p1, p2, v1, std::get<edge>(old.f2));
+					return ve_state(s1, s2, v1, std::get<edge>(old.f2));
 				} else {
-					return vf_state(p1, p2, v1, std::get<face>(old.f2));
+					return vf_state(s1, s2, v1, std::get<face>(old.f2));
 				}
 			} else if (std::holds_alternative<edge>(old.f1)) {
 				const edge &e1 = std::get<edge>(old.f1);
 
 				if (std::holds_alternative<vertex>(old.f2)) {
-					algorithm_state state = ve_state(p2, p1, std::get<vertex>(old.f2), e1);
+					algorithm_state state = ve_state(s2, s1, std::get<vertex>(old.f2), e1);
 					std::swap(state.f1, state.f2);
 
 					return state;
 				} else if (std::holds_alternative<edge>(old.f2)) {
-					return ee_state(p1, p2, e1, std::get<edge>(old.f2));
+					return ee_state(s1, s2, e1, std::get<edge>(old.f2));
 				} else {
-					return ef_state(p1, p2, e1, std::get<face>(old.f2));
+					return ef_state(s1, s2, e1, std::get<face>(old.f2));
 				}
 			} else {
 				const face &f1 = std::get<face>(old.f1);
 
 				if (std::holds_alternative<vertex>(old.f2)) {
-					algorithm_state state = vf_state(p2, p1, std::get<vertex>(old.f2), f1);
+					algorithm_state state = vf_state(s2, s1, std::get<vertex>(old.f2), f1);
 					std::swap(state.f1, state.f2);
 
 					return state;
 				} else if (std::holds_alternative<edge>(old.f2)) {
-					algorithm_state state = ef_state(p2, p1, std::get<edge>(old.f2), f1);
+					algorithm_state state = ef_state(s2, s1, std::get<edge>(old.f2), f1);
 					std::swap(state.f1, state.f2);
 
 					return state;
@@ -1750,8 +2176,8 @@ namespace phys {
 		}
 
 		algorithm_result closest_features(
-			const polyhedron &p1,
-			const polyhedron &p2,
+			const frame &s1,
+			const frame &s2,
 			const feature &_f1,
 			const feature &_f2,
 			size_t max_steps
@@ -1762,6 +2188,8 @@ namespace phys {
 				.step = algorithm_step::Continue,
 				.penetration = 0.0_r
 			};
+			// The last few pairs of features that the algorithm visited
+			std::array<std::pair<feature_key, feature_key>, max_cycle_length> history{};
 			size_t steps = 0;
 
 			while (state.step == algorithm_step::Continue) {
@@ -1769,11 +2197,92 @@ namespace phys {
 					break;
 				}
 
-				state = update_state(p1, p2, state);
+				history[steps % max_cycle_length] = { key_of(state.f1), key_of(state.f2) };
+				state = update_state(s1, s2, state);
 				steps++;
+
+				// The distance between the features gets smaller with every step, so the
+				// algorithm can only come back to features that it already visited
+				// because of rounding error. This happens when a feature lies almost
+				// exactly on the boundary of a Voronoi region. The algorithm would go
+				// around in a loop, so it stops instead.
+				if (state.step == algorithm_step::Continue && has_visited(history, steps, state)) {
+					break;
+				}
 			}
 
-			return algorithm_result(p1, p2, state);
+			algorithm_result out(s1.p, s2.p, state);
+			out.steps = steps;
+
+			return out;
+		}
+
+		algorithm_state vv_state(
+			const polyhedron &p1,
+			const polyhedron &p2,
+			const vertex &v1,
+			const vertex &v2
+		) {
+			return vv_state(frame{ p1 }, frame{ p2 }, v1, v2);
+		}
+
+		algorithm_state ve_state(
+			const polyhedron &p_v,
+			const polyhedron &p_e,
+			const vertex &v,
+			const edge &e
+		) {
+			return ve_state(frame{ p_v }, frame{ p_e }, v, e);
+		}
+
+		algorithm_state vf_state(
+			const polyhedron &p_v,
+			const polyhedron &p_f,
+			const vertex &v,
+			const face &f
+		) {
+			return vf_state(frame{ p_v }, frame{ p_f }, v, f);
+		}
+
+		algorithm_state ee_state(
+			const polyhedron &p_e1,
+			const polyhedron &p_e2,
+			const edge &e1,
+			const edge &e2
+		) {
+			return ee_state(frame{ p_e1 }, frame{ p_e2 }, e1, e2);
+		}
+
+		algorithm_state ef_state(
+			const polyhedron &p_e,
+			const polyhedron &p_f,
+			const edge &e,
+			const face &f
+		) {
+			return ef_state(frame{ p_e }, frame{ p_f }, e, f);
+		}
+
+		algorithm_result closest_features(
+			const polyhedron &p1,
+			const polyhedron &p2,
+			const feature &_f1,
+			const feature &_f2,
+			size_t max_steps
+		) {
+			return closest_features(frame{ p1 }, frame{ p2 }, _f1, _f2, max_steps);
+		}
+
+		algorithm_result closest_features(
+			const polyhedron &p1,
+			const polyhedron &p2,
+			const mat4 &p2_to_p1,
+			const feature &_f1,
+			const feature &_f2,
+			size_t max_steps
+		) {
+			const mat4 p1_to_p2 = inverse(p2_to_p1);
+
+			return closest_features(frame{ p1, &p1_to_p2 }, frame{ p2, &p2_to_p1 }, _f1, _f2, max_steps);
 		}
 
 		bool operator==(const vertex &v1, const vertex &v2) {
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include "physics/constraint.h"
 
 phys::constraint::constraint(real _stiffness, constraint_type _type) :
@@ -5,6 +7,30 @@ phys::constraint::constraint(real _stiffness, constraint_type _type) :
 	type(_type)
 {}
 
+void phys::constraint::project_xpbd(real) {
+	using namespace phys::literals;
+
+	project(1.0_r);
+}
+
+void phys::constraint::reset_lambda() {}
+
+phys::real phys::constraint::get_error() const {
+	using namespace phys::literals;
+
+	const real c = eval_constraint();
+
+	switch (type) {
+		case constraint_type::Equality:
+			return std::abs(c);
+		case constraint_type::Inequality:
+			// Written so that NaN counts as an error, like in `is_satisfied`
+			return (c >= 0.0_r) ? 0.0_r : -c;
+	}
+
+	__assume(false);
+}
+
 bool phys::constraint::is_satisfied() const {
 	using namespace phys::literals;
 
@@ -16,4 +42,89 @@ bool phys::constraint::is_satisfied() const {
 	}
 
 	__assume(false);
-}
\ No newline at end of file
+}
+
+phys::real phys::constraint::get_xpbd_alpha(real dt, real w) const {
+	using namespace phys::literals;
+
+	// Scaling the compliance by the timestep is what makes the constraint behave
+	// like a spring with stiffness `1 / compliance` at any timestep
+	if (compliance) {
+		return *compliance / (dt * dt);
+	}
+
+	if (stiffness <= 0.0_r) {
+		return infinity;
+	}
+
+	// One iteration from a zero multiplier corrects `w / (w + alpha)` of the error
+	return w * (1.0_r - std::min(stiffness, 1.0_r)) / stiffness;
+}
+
+phys::constraint_arena::constraint_arena(size_t _block_size) :
+	block_size(_block_size)
+{}
+
+phys::constraint_arena::~constraint_arena() {
+	clear();
+}
+
+void phys::constraint_arena::clear() {
+	for (constraint * c : constraints) {
+		c->~constraint();
+	}
+
+	constraints.clear();
+	current_block = 0;
+	offset = 0;
+}
+
+size_t phys::constraint_arena::size() const {
+	return constraints.size();
+}
+
+bool phys::constraint_arena::empty() const {
+	return constraints.empty();
+}
+
+phys::constraint_arena::iterator phys::constraint_arena::begin() const {
+	return std::begin(constraints);
+}
+
+phys::constraint_arena::iterator phys::constraint_arena::end() const {
+	return std::end(constraints);
+}
+
+phys::constraint * phys::constraint_arena::operator[](size_t i) const {
+	return constraints[i];
+}
+
+void * phys::constraint_arena::allocate(size_t size, size_t align) {
+	while (current_block < blocks.size()) {
+		block &b = blocks[current_block];
+		const size_t start = (offset + align - 1) & ~(align - 1);
+
+		if (start + size <= b.size) {
+			offset = start + size;
+
+			return b.data.get() + start;
+		}
+
+		current_block++;
+		offset = 0;
+	}
+
+	// `new[]` aligns the block for any fundamental type, so the first constraint in
+	// the block is always aligned
+	const size_t new_block_size = std::max(block_size, size);
+
+	blocks.push_back(block{ std::make_unique<std::byte[]>(new_block_size), new_block_size });
+	current_block = blocks.size() - 1;
+	offset = size;
+
+	return blocks.back().data.get();
+}
+
+void phys::constraint_generator::begin_frame(real) {}
+
+void phys::constraint_generator::end_frame() {}
\ No newline at end of file
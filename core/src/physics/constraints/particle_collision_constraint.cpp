@@ -17,18 +17,34 @@ phys::particle_collision_constraint::particle_collision_constraint(
 	b_old_pos(_b->p)
 {}
 
+phys::particle_collision_constraint::particle_collision_constraint(
+	particle * _a,
+	particle * _b,
+	vec3 _normal,
+	real _restitution,
+	real _friction
+) :
+	particle_collision_constraint(_a, _b, _restitution, _friction)
+{
+	normal = _normal;
+}
+
 phys::real phys::particle_collision_constraint::eval_constraint() const {
 	vec3 diff = a()->p - b()->p;
 
+	if (normal) {
+		return phys::dot(diff, *normal) - (a()->radius + b()->radius);
+	}
+
 	return std::sqrt(phys::dot(diff, diff)) - (a()->radius + b()->radius);
 }
 
 phys::vec3 phys::particle_collision_constraint::eval_gradient(const particle &p) const {
-	if (a()->p == b()->p) {
+	if (! normal && a()->p == b()->p) {
 		return vec3(0.0_r);
 	}
 
-	vec3 n = phys::normalize(a()->p - b()->p);
+	vec3 n = normal ? *normal : phys::normalize(a()->p - b()->p);
 
 	if (&p == a()) {
 		return n;
@@ -40,7 +56,7 @@ phys::vec3 phys::particle_collision_constraint::eval_gradient(const particle &p)
 }
 
 void phys::particle_collision_constraint::update_velocities(real dt) {
-	if (a_old_pos == b_old_pos) {
+	if (! normal && a_old_pos == b_old_pos) {
 		return;
 	}
 
@@ -53,7 +69,7 @@ void phys::particle_collision_constraint::update_velocities(real dt) {
 		return;
 	}
 
-	vec3 n = phys::normalize(b_old_pos - a_old_pos);
+	vec3 n = normal ? -*normal : phys::normalize(b_old_pos - a_old_pos);
 	decomposed_vec3 a_old_parts = decompose_vec3(a_old_vel, n);
 	decomposed_vec3 b_old_parts = decompose_vec3(b_old_vel, n);
 	decomposed_vec3 a_new_parts = decompose_vec3(a()->vel, n);
@@ -75,4 +91,8 @@ void phys::particle_collision_constraint::update_velocities(real dt) {
 
 	a()->vel = va + f * a_new_parts.perp;
 	b()->vel = vb + f * b_new_parts.perp;
+}
+
+bool phys::all_particles::operator()(size_t) const {
+	return true;
 }
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <cmath>
+#include "physics/contact_solver.h"
+
+using namespace phys::literals;
+
+namespace {
+	void make_tangents(const phys::vec3 &n, phys::vec3 &t1, phys::vec3 &t2) {
+		if (std::abs(n.x) >= 0.57735_r) {
+			t1 = phys::normalize(phys::vec3(n.y, -n.x, 0.0_r));
+		} else {
+			t1 = phys::normalize(phys::vec3(0.0_r, n.z, -n.y));
+		}
+
+		t2 = phys::cross(n, t1);
+	}
+}
+
+phys::contact_solver::contact_solver(size_t _iterations) :
+	iterations(_iterations)
+{}
+
+void phys::contact_solver::solve(std::span<contact> contacts, real dt) {
+	if (contacts.empty() || dt == 0.0_r) {
+		return;
+	}
+
+	prepare(contacts, dt);
+
+	if (warm_starting) {
+		apply_warm_start();
+	}
+
+	for (size_t i = 0; i < iterations; i++) {
+		solve_velocities();
+	}
+
+	for (contact_state &s : states) {
+		s.c->normal_impulse = s.axes[0].impulse;
+		s.c->tangent_impulse = s.axes[1].dir * s.axes[1].impulse + s.axes[2].dir * s.axes[2].impulse;
+	}
+}
+
+void phys::contact_solver::prepare(std::span<contact> contacts, real dt) {
+	static_velocity = vec3(0.0_r);
+	states.resize(contacts.size());
+
+	for (size_t i = 0; i < contacts.size(); i++) {
+		contact &c = contacts[i];
+		contact_state &s = states[i];
+		const bool a_moves = c.a && c.a->has_finite_mass();
+		const bool b_moves = c.b && c.b->has_finite_mass();
+		const vec3 ra = c.a ? c.point - c.a->pos : vec3(0.0_r);
+		const vec3 rb = c.b ? c.point - c.b->pos : vec3(0.0_r);
+		const mat3 inv_inertia_a = a_moves ? c.a->get_inv_inertia_tensor_world() : mat3(0.0_r);
+		const mat3 inv_inertia_b = b_moves ? c.b->get_inv_inertia_tensor_world() : mat3(0.0_r);
+
+		s.c = &c;
+		s.vel_a = c.a ? &c.a->vel : &static_velocity;
+		s.ang_vel_a = c.a ? &c.a->ang_vel : &static_velocity;
+		s.vel_b = c.b ? &c.b->vel : &static_velocity;
+		s.ang_vel_b = c.b ? &c.b->ang_vel : &static_velocity;
+		s.inv_mass_a = a_moves ? c.a->get_inv_mass() : 0.0_r;
+		s.inv_mass_b = b_moves ? c.b->get_inv_mass() : 0.0_r;
+
+		s.axes[0].dir = c.normal;
+		make_tangents(c.normal, s.axes[1].dir, s.axes[2].dir);
+
+		for (impulse_axis &axis : s.axes) {
+			axis.ang_a = cross(ra, axis.dir);
+			axis.ang_b = cross(rb, axis.dir);
+			axis.inv_ang_a = inv_inertia_a * axis.ang_a;
+			axis.inv_ang_b = inv_inertia_b * axis.ang_b;
+
+			const real k = s.inv_mass_a + s.inv_mass_b + dot(axis.ang_a, axis.inv_ang_a) + dot(axis.ang_b, axis.inv_ang_b);
+
+			axis.mass = k > 0.0_r ? 1.0_r / k : 0.0_r;
+		}
+
+		// The normal points from `a` to `b`, so the bodies are approaching when the
+		// relative velocity along it is negative
+		const real approach_vel = velocity_along(s, s.axes[0]);
+		const real correction_vel = (baumgarte / dt) * std::max(c.penetration - slop, 0.0_r);
+		const real bounce_vel = approach_vel < -restitution_threshold ? -restitution * approach_vel : 0.0_r;
+
+		s.target_velocity = std::max(correction_vel, bounce_vel);
+
+		if (warm_starting) {
+			// The tangents may have changed since the impulse was stored
+			s.axes[0].impulse = c.normal_impulse;
+			s.axes[1].impulse = dot(c.tangent_impulse, s.axes[1].dir);
+			s.axes[2].impulse = dot(c.tangent_impulse, s.axes[2].dir);
+		} else {
+			s.axes[0].impulse = 0.0_r;
+			s.axes[1].impulse = 0.0_r;
+			s.axes[2].impulse = 0.0_r;
+		}
+	}
+}
+
+void phys::contact_solver::apply_warm_start() {
+	for (contact_state &s : states) {
+		for (const impulse_axis &axis : s.axes) {
+			apply_impulse(s, axis, axis.impulse);
+		}
+	}
+}
+
+void phys::contact_solver::solve_velocities() {
+	for (contact_state &s : states) {
+		// Friction is solved first because it's limited by the normal impulse, and
+		// the normal impulse is more important to get right
+		const real max_friction = friction * s.axes[0].impulse;
+
+		for (size_t i = 1; i < 3; i++) {
+			impulse_axis &axis = s.axes[i];
+			const real prev = axis.impulse;
+
+			axis.impulse = std::clamp(prev - velocity_along(s, axis) * axis.mass, -max_friction, max_friction);
+			apply_impulse(s, axis, axis.impulse - prev);
+		}
+
+		impulse_axis &normal = s.axes[0];
+		const real prev = normal.impulse;
+
+		normal.impulse = std::max(prev + (s.target_velocity - velocity_along(s, normal)) * normal.mass, 0.0_r);
+		apply_impulse(s, normal, normal.impulse - prev);
+	}
+}
+
+phys::real phys::contact_solver::velocity_along(const contact_state &s, const impulse_axis &axis) {
+	return dot(axis.dir, *s.vel_b - *s.vel_a) + dot(axis.ang_b, *s.ang_vel_b) - dot(axis.ang_a, *s.ang_vel_a);
+}
+
+void phys::contact_solver::apply_impulse(contact_state &s, const impulse_axis &axis, real impulse) {
+	*s.vel_a -= axis.dir * (impulse * s.inv_mass_a);
+	*s.ang_vel_a -= axis.inv_ang_a * impulse;
+	*s.vel_b += axis.dir * (impulse * s.inv_mass_b);
+	*s.ang_vel_b += axis.inv_ang_b * impulse;
+}
@@ -1,6 +1,9 @@
+#include <cmath>
 #include "physics/particle_force_generators.h"
 #include "math.h"
 
+using namespace phys::literals;
+
 phys::particle_drag::particle_drag(real _k1, real _k2) :
 	particle_force_generator(),
 	k1(_k1),
@@ -8,11 +11,20 @@ phys::particle_drag::particle_drag(real _k1, real _k2) :
 {}
 
 void phys::particle_drag::update_force(particle &p, real) {
-	vec3 norm_vel = normalize(p.vel);
-	real speed_sqr = dot(p.vel, p.vel);
-	real speed = sqrt(speed_sqr);
+	// The normalized velocity times the speed is just the velocity, which also
+	// gives no force instead of NaN when the particle is still
+	real speed = sqrt(dot(p.vel, p.vel));
 
-	vec3 f = -norm_vel * (k1 * speed + k2 * speed_sqr);
+	vec3 f = -p.vel * (k1 + k2 * speed);
 
 	p.force += f;
+}
+
+void phys::particle_drag::update_forces(std::span<particle * const> particles, real) {
+	for (particle * p : particles) {
+		const real speed = std::sqrt(dot(p->vel, p->vel));
+		const real k = p->is_asleep() ? 0.0_r : (k1 + k2 * speed);
+
+		p->force -= p->vel * k;
+	}
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "physics/particle_force_generators.h"
 
+using namespace phys::literals;
+
 phys::particle_gravity::particle_gravity(const vec3 &_gravity) :
 	particle_force_generator(),
 	gravity(_gravity)
@@ -11,4 +13,14 @@ void phys::particle_gravity::update_force(particle &p, real) {
 	}
 
 	p.force += gravity * p.get_mass();
+}
+
+void phys::particle_gravity::update_forces(std::span<particle * const> particles, real) {
+	for (particle * p : particles) {
+		// Sleeping particles are treated like particles with infinite mass, which get
+		// no force
+		const real mass = (p->is_asleep() || ! p->has_finite_mass()) ? 0.0_r : p->get_mass();
+
+		p->force += gravity * mass;
+	}
 }
\ No newline at end of file
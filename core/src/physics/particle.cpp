@@ -17,6 +17,15 @@ void phys::particle::integrate(real dt) {
 	vel *= pow(damping, dt);
 }
 
+phys::real phys::particle::max_travel(real dt) const {
+	// The force is applied to the velocity before the particle moves, so the
+	// acceleration is counted over the whole step instead of half of it
+	const real speed = std::sqrt(phys::dot(vel, vel));
+	const real accel = std::sqrt(phys::dot(force, force)) * inv_mass;
+
+	return (speed + accel * dt) * dt;
+}
+
 void phys::particle::set_mass(real mass) {
 	if (mass == infinity) {
 		inv_mass = 0.0_r;
@@ -44,4 +53,8 @@ phys::real phys::particle::get_inv_mass() const {
 bool phys::particle::has_finite_mass() const {
 	// TODO: epsilon
 	return inv_mass != 0.0_r;
+}
+
+bool phys::particle::is_asleep() const {
+	return asleep;
 }
\ No newline at end of file
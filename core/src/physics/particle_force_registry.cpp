@@ -1,29 +1,95 @@
+#include <cassert>
 #include "physics/particle_force_registry.h"
 
-bool phys::operator==(const phys::particle_force_registration &a, const phys::particle_force_registration &b) {
-	return (a.p == b.p && a.fg == b.fg);
+phys::particle_force_handle phys::particle_force_registry::add(phys::particle * p, phys::particle_force_generator * fg) {
+	uint32_t handle;
+
+	if (free_handles.empty()) {
+		assert(slots.size() < UINT32_MAX);
+
+		handle = (uint32_t)slots.size();
+		slots.push_back({});
+		generations.push_back(0);
+	} else {
+		handle = free_handles.back();
+		free_handles.pop_back();
+	}
+
+	const auto [it, is_new] = group_indices.try_emplace(fg, (uint32_t)groups.size());
+
+	if (is_new) {
+		groups.push_back(group{ .fg = fg });
+	}
+
+	group &g = groups[it->second];
+
+	slots[handle] = slot{ it->second, (uint32_t)g.particles.size() };
+	g.particles.push_back(p);
+	g.handles.push_back(handle);
+
+	return particle_force_handle{ handle, generations[handle] };
 }
 
-void phys::particle_force_registry::add(phys::particle * p, phys::particle_force_generator * fg) {
-	registrations.push_back({
-		.p = p,
-		.fg = fg
-		});
+bool phys::particle_force_registry::remove(phys::particle_force_handle h) {
+	if (h.index >= generations.size() || generations[h.index] != h.generation) {
+		return false;
+	}
+
+	remove_at(slots[h.index].group, slots[h.index].index);
+
+	return true;
 }
 
 void phys::particle_force_registry::remove(phys::particle * p, phys::particle_force_generator * fg) {
-	std::erase(registrations, phys::particle_force_registration{
-		.p = p,
-		.fg = fg
-		});
+	const auto it = group_indices.find(fg);
+
+	if (it == std::end(group_indices)) {
+		return;
+	}
+
+	const group &g = groups[it->second];
+
+	// Backwards, because removing a particle moves the last particle into its place
+	for (size_t i = g.particles.size(); i > 0; i--) {
+		if (g.particles[i - 1] == p) {
+			remove_at(it->second, (uint32_t)(i - 1));
+		}
+	}
 }
 
 void phys::particle_force_registry::clear() {
-	registrations.clear();
+	for (const group &g : groups) {
+		for (uint32_t handle : g.handles) {
+			generations[handle]++;
+			free_handles.push_back(handle);
+		}
+	}
+
+	groups.clear();
+	group_indices.clear();
 }
 
 void phys::particle_force_registry::update_forces(phys::real duration) {
-	for (auto &[p, fg] : registrations) {
-		fg->update_force(*p, duration);
+	for (group &g : groups) {
+		// Generators skip sleeping particles, so their forces are ignored until they
+		// wake up
+		if (! g.particles.empty()) {
+			g.fg->update_forces(g.particles, duration);
+		}
 	}
 }
+
+void phys::particle_force_registry::remove_at(uint32_t group_index, uint32_t index) {
+	group &g = groups[group_index];
+	const uint32_t handle = g.handles[index];
+
+	g.particles[index] = g.particles.back();
+	g.handles[index] = g.handles.back();
+	slots[g.handles[index]].index = index;
+
+	g.particles.pop_back();
+	g.handles.pop_back();
+
+	generations[handle]++;
+	free_handles.push_back(handle);
+}
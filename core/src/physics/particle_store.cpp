@@ -0,0 +1,134 @@
+#include <cassert>
+#include <utility>
+#include "physics/particle_store.h"
+
+phys::particle_handle phys::particle_store::add(particle * p) {
+	assert(particles.size() < UINT32_MAX);
+
+	uint32_t handle;
+
+	if (free_handles.empty()) {
+		handle = (uint32_t)handle_slots.size();
+		handle_slots.push_back(0);
+		generations.push_back(0);
+	} else {
+		handle = free_handles.back();
+		free_handles.pop_back();
+	}
+
+	handle_slots[handle] = (uint32_t)particles.size();
+	particles.push_back(p);
+	slot_handles.push_back(handle);
+	p->store_handle = handle;
+
+	// New particles are awake, so they're moved in front of the sleeping particles
+	swap_slots((uint32_t)(particles.size() - 1), (uint32_t)num_awake);
+	num_awake++;
+
+	return particle_handle{ handle, generations[handle] };
+}
+
+bool phys::particle_store::remove(particle_handle h) {
+	if (! get(h)) {
+		return false;
+	}
+
+	uint32_t slot = handle_slots[h.index];
+	const uint32_t last = (uint32_t)(particles.size() - 1);
+
+	if (slot < num_awake) {
+		num_awake--;
+		swap_slots(slot, (uint32_t)num_awake);
+		slot = (uint32_t)num_awake;
+	}
+
+	particles[slot]->store_handle = UINT32_MAX;
+
+	particles[slot] = particles[last];
+	slot_handles[slot] = slot_handles[last];
+	handle_slots[slot_handles[slot]] = slot;
+
+	particles.pop_back();
+	slot_handles.pop_back();
+
+	generations[h.index]++;
+	free_handles.push_back(h.index);
+
+	return true;
+}
+
+bool phys::particle_store::remove(particle * p) {
+	if (find_slot(p) == UINT32_MAX) {
+		return false;
+	}
+
+	return remove(particle_handle{ p->store_handle, generations[p->store_handle] });
+}
+
+phys::particle * phys::particle_store::get(particle_handle h) const {
+	if (h.index >= generations.size() || generations[h.index] != h.generation) {
+		return nullptr;
+	}
+
+	return particles[handle_slots[h.index]];
+}
+
+size_t phys::particle_store::size() const {
+	return particles.size();
+}
+
+size_t phys::particle_store::awake_size() const {
+	return num_awake;
+}
+
+void phys::particle_store::sleep(particle * p) {
+	const uint32_t slot = find_slot(p);
+
+	assert(slot != UINT32_MAX);
+
+	if (slot >= num_awake) {
+		return;
+	}
+
+	num_awake--;
+	swap_slots(slot, (uint32_t)num_awake);
+}
+
+void phys::particle_store::wake(particle * p) {
+	const uint32_t slot = find_slot(p);
+
+	assert(slot != UINT32_MAX);
+
+	if (slot < num_awake) {
+		return;
+	}
+
+	swap_slots(slot, (uint32_t)num_awake);
+	num_awake++;
+}
+
+void phys::particle_store::swap_slots(uint32_t a, uint32_t b) {
+	if (a == b) {
+		return;
+	}
+
+	std::swap(particles[a], particles[b]);
+	std::swap(slot_handles[a], slot_handles[b]);
+	handle_slots[slot_handles[a]] = a;
+	handle_slots[slot_handles[b]] = b;
+}
+
+uint32_t phys::particle_store::find_slot(const particle * p) const {
+	if (p->store_handle >= handle_slots.size()) {
+		return UINT32_MAX;
+	}
+
+	const uint32_t slot = handle_slots[p->store_handle];
+
+	// The particle's handle could be left over from another store
+	if (slot >= particles.size() || particles[slot] != p) {
+		return UINT32_MAX;
+	}
+
+	return slot;
+}
@@ -1,9 +1,23 @@
 #include <algorithm>
+#include <bit>
+#include <mutex>
 #include <ranges>
 #include "physics/particle_world.h"
 
 using namespace phys::literals;
 
+namespace {
+	// Runs `f` and adds the time that it took to `total`
+	template <typename F>
+	void timed(std::chrono::nanoseconds &total, F &&f) {
+		const auto start = std::chrono::steady_clock::now();
+
+		f();
+
+		total += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+	}
+}
+
 phys::particle_world::particle_world(
 	uint64_t _solver_iterations,
 	real _min_pos_change
@@ -11,13 +25,15 @@ phys::particle_world::particle_world(
 	solver_iterations(_solver_iterations),
 	inv_solver_iterations(1.0_r / (real)_solver_iterations),
 	min_pos_change_sqr(_min_pos_change * _min_pos_change)
-{}
+{
+	stats.clear(0);
+}
 
 void phys::particle_world::prepare_frame() {
-	for (particle * p : particles) {
-		p->force = phys::vec3(0.0_r);
-		p->acc = phys::vec3(0.0_r);
-	}
+	particles.for_each_awake([](particle &p) {
+		p.force = phys::vec3(0.0_r);
+		p.acc = phys::vec3(0.0_r);
+	});
 
 	collision_constraints.clear();
 }
@@ -27,77 +43,285 @@ void phys::particle_world::run_physics(real dt) {
 		return;
 	}
 
-	force_registry.update_forces(dt);
+	begin_stats();
 
-	for (particle * p : particles) {
-		p->vel += (dt * p->get_inv_mass() * p->force * p->damping);
-	}
+	timed(stats.timings.forces, [&]() {
+		force_registry.update_forces(dt);
+	});
 
-	for (particle * p : particles) {
-		p->p = p->pos + dt * p->vel;
+	run_substep(dt);
+}
+
+void phys::particle_world::step(real frame_dt, size_t num_substeps) {
+	if (frame_dt == 0.0_r || ! num_substeps) {
+		return;
 	}
 
-	generate_collision_constraints(dt);
-	solve_constraints(dt);
+	const real dt = frame_dt / (real)num_substeps;
+
+	begin_stats();
 
-	for (particle * p : particles) {
-		const vec3 dp = p->pos - p->p;
+	timed(stats.timings.forces, [&]() {
+		prepare_frame();
+		force_registry.update_forces(frame_dt);
+	});
 
-		if (phys::dot(dp, dp) <= min_pos_change_sqr) {
-			p->p = p->pos;
+	timed(stats.timings.candidates, [&]() {
+		for (constraint_generator * cg : constraint_generators) {
+			cg->begin_frame(frame_dt);
 		}
+	});
 
-		p->vel = (p->p - p->pos) / dt;
-		p->pos = p->p;
+	for (size_t i = 0; i < num_substeps; i++) {
+		collision_constraints.clear();
+		run_substep(dt);
 	}
 
-	for (constraint * c : fixed_constraints) {
-		c->update_velocities(dt);
+	for (constraint_generator * cg : constraint_generators) {
+		cg->end_frame();
 	}
+}
 
-	for (std::unique_ptr<constraint> &c : collision_constraints) {
-		c->update_velocities(dt);
-	}
+const phys::step_timings& phys::particle_world::get_step_timings() const {
+	return stats.timings;
+}
+
+const phys::solver_stats& phys::particle_world::get_solver_stats() const {
+	return stats;
+}
+
+void phys::particle_world::set_error_sample_interval(size_t interval) {
+	error_sample_interval = interval;
+	steps_since_error_sample = 0;
+}
+
+void phys::particle_world::begin_stats() {
+	stats.clear(constraint_generators.size());
+
+	measure_errors = error_sample_interval && (steps_since_error_sample % error_sample_interval) == 0;
+	steps_since_error_sample = measure_errors ? 1 : (steps_since_error_sample + 1);
+}
+
+void phys::particle_world::run_substep(real dt) {
+	timed(stats.timings.integration, [&]() {
+		particles.for_each_awake([dt](particle &p) {
+			p.vel += (dt * p.get_inv_mass() * p.force * p.damping);
+			p.p = p.pos + dt * p.vel;
+		});
+	});
+
+	timed(stats.timings.constraint_generation, [&]() {
+		generate_collision_constraints(dt);
+		wake_touched_islands();
+	});
+
+	timed(stats.timings.projection, [&]() {
+		solve_constraints(dt);
+	});
+
+	timed(stats.timings.integration, [&]() {
+		particles.for_each_awake([this, dt](particle &p) {
+			const vec3 dp = p.pos - p.p;
+
+			if (phys::dot(dp, dp) <= min_pos_change_sqr) {
+				p.p = p.pos;
+			}
+
+			p.vel = (p.p - p.pos) / dt;
+			p.pos = p.p;
+		});
+	});
+
+	timed(stats.timings.velocity_update, [&]() {
+		for (constraint * c : fixed_constraints) {
+			c->update_velocities(dt);
+		}
+
+		for (constraint * c : collision_constraints) {
+			c->update_velocities(dt);
+		}
+	});
+
+	timed(stats.timings.islands, [&]() {
+		update_islands(dt);
+	});
 }
 
 void phys::particle_world::generate_collision_constraints(real dt) {
-	for (constraint_generator * cg : constraint_generators) {
-		cg->generate_constraints(dt, collision_constraints);
+	for (size_t i = 0; i < constraint_generators.size(); i++) {
+		const size_t first = collision_constraints.size();
+
+		constraint_generators[i]->generate_constraints(dt, collision_constraints);
+
+		for (size_t j = first; j < collision_constraints.size(); j++) {
+			collision_constraints[j]->source = (uint32_t)(i + 1);
+		}
 	}
 }
 
-void phys::particle_world::solve_constraints(real) {
+void phys::particle_world::solve_constraints(real dt) {
+	if (mode == solver_mode::XPBD) {
+		for (constraint * c : fixed_constraints) {
+			c->reset_lambda();
+		}
+
+		for (constraint * c : collision_constraints) {
+			c->reset_lambda();
+		}
+	}
+
+	if (pool) {
+		solve_constraints_in_parallel(dt);
+		return;
+	}
+
+	measure_error(0);
+
 	for (size_t i = 0; i < solver_iterations; i++) {
 		size_t num_projected = 0;
 
 		if (solve_forward) {
 			for (constraint * c : fixed_constraints) {
-				if (! c->is_satisfied()) {
-					c->project(inv_solver_iterations);
-					num_projected++;
-				}
+				num_projected += solve_constraint(c, dt, stats.projections);
 			}
 
-			for (std::unique_ptr<constraint> &c : collision_constraints) {
-				if (! c->is_satisfied()) {
-					c->project(inv_solver_iterations);
-					num_projected++;
-				}
+			for (constraint * c : collision_constraints) {
+				num_projected += solve_constraint(c, dt, stats.projections);
 			}
 		} else {
-			for (std::unique_ptr<constraint> &c : std::ranges::reverse_view(collision_constraints)) {
-				if (! c->is_satisfied()) {
-					c->project(inv_solver_iterations);
-					num_projected++;
-				}
+			for (constraint * c : std::ranges::reverse_view(collision_constraints)) {
+				num_projected += solve_constraint(c, dt, stats.projections);
 			}
 
 			for (constraint * c : std::ranges::reverse_view(fixed_constraints)) {
-				if (! c->is_satisfied()) {
-					c->project(inv_solver_iterations);
-					num_projected++;
+				num_projected += solve_constraint(c, dt, stats.projections);
+			}
+		}
+
+		solve_forward = ! solve_forward;
+
+		if (! num_projected) {
+			return;
+		}
+
+		stats.iterations++;
+		measure_error(i + 1);
+	}
+}
+
+void phys::particle_world::color_constraints() {
+	particle_colors.clear();
+	constraint_colors.clear();
+	constraint_colors.reserve(fixed_constraints.size() + collision_constraints.size());
+
+	// Greedy coloring: each constraint gets the lowest color that isn't used by any
+	// other constraint on its particles
+	const auto assign_color = [&](constraint * c) {
+		uint64_t used = 0;
+
+		for (const particle * p : c->get_particles()) {
+			used |= particle_colors[p];
+		}
+
+		const size_t color = (size_t)std::countr_one(used);
+
+		if (color < max_colors) {
+			for (const particle * p : c->get_particles()) {
+				particle_colors[p] |= (1ull << color);
+			}
+		}
+
+		constraint_colors.push_back((uint8_t)color);
+	};
+
+	for (constraint * c : fixed_constraints) {
+		assign_color(c);
+	}
+
+	for (constraint * c : collision_constraints) {
+		assign_color(c);
+	}
+
+	// Counting sort by color, which keeps the constraints of each color in the same
+	// order as they would be solved serially
+	color_offsets.assign(max_colors + 2, 0);
+
+	for (uint8_t c : constraint_colors) {
+		color_offsets[c + 1]++;
+	}
+
+	for (size_t i = 1; i < color_offsets.size(); i++) {
+		color_offsets[i] += color_offsets[i - 1];
+	}
+
+	colored_constraints.resize(constraint_colors.size());
+
+	size_t i = 0;
+
+	for (constraint * c : fixed_constraints) {
+		colored_constraints[color_offsets[constraint_colors[i++]]++] = c;
+	}
+
+	for (constraint * c : collision_constraints) {
+		colored_constraints[color_offsets[constraint_colors[i++]]++] = c;
+	}
+
+	// Filling each color advanced its offset to the start of the next color, so
+	// shift the offsets back
+	for (size_t c = color_offsets.size() - 1; c > 0; c--) {
+		color_offsets[c] = color_offsets[c - 1];
+	}
+
+	color_offsets[0] = 0;
+}
+
+void phys::particle_world::solve_constraints_in_parallel(real dt) {
+	color_constraints();
+
+	const size_t num_colors = max_colors + 1;
+
+	measure_error(0);
+
+	for (size_t i = 0; i < solver_iterations; i++) {
+		size_t num_projected = 0;
+		std::mutex stats_mutex{};
+
+		for (size_t k = 0; k < num_colors; k++) {
+			const size_t color = solve_forward ? k : (num_colors - 1 - k);
+			const size_t begin = color_offsets[color];
+			const size_t end = color_offsets[color + 1];
+
+			if (color == max_colors) {
+				// Uncolored constraints may share particles, so they're solved serially
+				for (size_t j = 0; j < (end - begin); j++) {
+					constraint * c = colored_constraints[solve_forward ? (begin + j) : (end - 1 - j)];
+
+					num_projected += solve_constraint(c, dt, stats.projections);
 				}
+
+				continue;
 			}
+
+			pool->parallel_for(end - begin, parallel_grain, [&](size_t task_begin, size_t task_end) {
+				// Kept between tasks so that counting doesn't allocate
+				thread_local std::vector<size_t> task_projections{};
+				size_t task_projected = 0;
+
+				task_projections.assign(stats.projections.size(), 0);
+
+				for (size_t j = begin + task_begin; j < begin + task_end; j++) {
+					task_projected += solve_constraint(colored_constraints[j], dt, task_projections);
+				}
+
+				// Each task only locks once, after all of its constraints are solved
+				std::scoped_lock lock(stats_mutex);
+
+				for (size_t s = 0; s < task_projections.size(); s++) {
+					stats.projections[s] += task_projections[s];
+				}
+
+				num_projected += task_projected;
+			});
 		}
 
 		solve_forward = ! solve_forward;
@@ -105,15 +329,296 @@ void phys::particle_world::solve_constraints(real) {
 		if (! num_projected) {
 			return;
 		}
+
+		stats.iterations++;
+		measure_error(i + 1);
+	}
+}
+
+void phys::particle_world::project_constraint(constraint * c, real dt) {
+	if (mode == solver_mode::XPBD) {
+		c->project_xpbd(dt);
+	} else {
+		c->project(inv_solver_iterations);
+	}
+}
+
+void phys::particle_world::wake_island(uint32_t i) {
+	island &isl = sleeping_islands[i];
+
+	for (particle * p : isl.particles) {
+		p->asleep = false;
+		p->sleep_time = 0.0_r;
+		particles.wake(p);
+	}
+
+	fixed_constraints.insert(std::end(fixed_constraints), std::begin(isl.constraints), std::end(isl.constraints));
+
+	isl.particles.clear();
+	isl.constraints.clear();
+	free_islands.push_back(i);
+}
+
+void phys::particle_world::wake_touched_islands() {
+	if (free_islands.size() == sleeping_islands.size()) {
+		return;
+	}
+
+	const auto has_awake_particle = [](const constraint * c) {
+		return std::ranges::any_of(c->get_particles(), [](const particle * p) {
+			return ! p->asleep;
+		});
+	};
+
+	// Waking an island can make it touch another sleeping island
+	bool woke_island;
+
+	do {
+		woke_island = false;
+
+		for (constraint * c : collision_constraints) {
+			if (! has_awake_particle(c)) {
+				continue;
+			}
+
+			for (particle * p : c->get_particles()) {
+				if (p->asleep && p->has_finite_mass()) {
+					wake_island(p->island);
+					woke_island = true;
+				}
+			}
+		}
+	} while (woke_island);
+
+	collision_constraints.erase_if([&](constraint * c) {
+		return ! has_awake_particle(c);
+	});
+}
+
+void phys::particle_world::update_islands(real dt) {
+	if (sleep_speed_sqr == 0.0_r) {
+		return;
+	}
+
+	awake_particles.clear();
+	island_parents.clear();
+
+	particles.for_each_awake([&](particle &p) {
+		const bool is_slow = phys::dot(p.vel, p.vel) <= sleep_speed_sqr;
+
+		p.island = (uint32_t)awake_particles.size();
+		p.sleep_time = is_slow ? (p.sleep_time + dt) : 0.0_r;
+		island_parents.push_back(p.island);
+		awake_particles.push_back(&p);
+	});
+
+	// Each constraint is owned by the island of its first awake particle with
+	// finite mass. Particles with infinite mass aren't moved by constraints, so
+	// they don't join the islands of the particles that they touch.
+	const auto find_owner = [&](const constraint * c) -> uint32_t {
+		for (const particle * p : c->get_particles()) {
+			if (! p->asleep && p->has_finite_mass()) {
+				return find_island_root(p->island);
+			}
+		}
+
+		return UINT32_MAX;
+	};
+
+	const auto unite = [&](const constraint * c) {
+		const uint32_t owner = find_owner(c);
+
+		if (owner == UINT32_MAX) {
+			return;
+		}
+
+		for (const particle * p : c->get_particles()) {
+			if (! p->asleep && p->has_finite_mass()) {
+				island_parents[find_island_root(p->island)] = owner;
+			}
+		}
+	};
+
+	for (const constraint * c : fixed_constraints) {
+		unite(c);
+	}
+
+	for (const constraint * c : collision_constraints) {
+		unite(c);
+	}
+
+	// An island can sleep once its most recently moving particle has been still for
+	// long enough
+	island_sleep_times.assign(awake_particles.size(), infinity);
+
+	for (const particle * p : awake_particles) {
+		real &t = island_sleep_times[find_island_root(p->island)];
+
+		t = std::min(t, p->sleep_time);
+	}
+
+	new_islands.assign(awake_particles.size(), UINT32_MAX);
+
+	bool has_new_island = false;
+
+	for (particle * p : awake_particles) {
+		const uint32_t root = find_island_root(p->island);
+
+		if (island_sleep_times[root] < time_to_sleep) {
+			continue;
+		}
+
+		if (new_islands[root] == UINT32_MAX) {
+			if (free_islands.empty()) {
+				new_islands[root] = (uint32_t)sleeping_islands.size();
+				sleeping_islands.emplace_back();
+			} else {
+				new_islands[root] = free_islands.back();
+				free_islands.pop_back();
+			}
+		}
+
+		sleeping_islands[new_islands[root]].particles.push_back(p);
+		has_new_island = true;
+	}
+
+	if (! has_new_island) {
+		return;
+	}
+
+	std::erase_if(fixed_constraints, [&](constraint * c) {
+		const uint32_t owner = find_owner(c);
+
+		if (owner == UINT32_MAX || new_islands[owner] == UINT32_MAX) {
+			return false;
+		}
+
+		sleeping_islands[new_islands[owner]].constraints.push_back(c);
+
+		return true;
+	});
+
+	for (particle * p : awake_particles) {
+		const uint32_t i = new_islands[find_island_root(p->island)];
+
+		if (i == UINT32_MAX) {
+			continue;
+		}
+
+		p->island = i;
+		p->asleep = true;
+		p->vel = vec3(0.0_r);
+		particles.sleep(p);
 	}
 }
 
-void phys::particle_world::add_particle(particle * p) {
-	particles.push_back(p);
+uint32_t phys::particle_world::find_island_root(uint32_t i) {
+	while (island_parents[i] != i) {
+		// Path halving
+		island_parents[i] = island_parents[island_parents[i]];
+		i = island_parents[i];
+	}
+
+	return i;
+}
+
+bool phys::particle_world::solve_constraint(
+	constraint * c,
+	real dt,
+	std::span<size_t> projections
+) {
+	if (c->is_satisfied()) {
+		return false;
+	}
+
+	project_constraint(c, dt);
+	projections[c->source]++;
+
+	return true;
+}
+
+void phys::particle_world::measure_error(size_t iteration) {
+	if (! measure_errors) {
+		return;
+	}
+
+	solver_error &error = stats.error_after(iteration);
+
+	if (! pool) {
+		for (const constraint * c : fixed_constraints) {
+			error.add(c->get_error());
+		}
+
+		for (const constraint * c : collision_constraints) {
+			error.add(c->get_error());
+		}
+
+		return;
+	}
+
+	std::mutex error_mutex{};
+
+	pool->parallel_for(colored_constraints.size(), parallel_grain, [&](size_t task_begin, size_t task_end) {
+		solver_error task_error{};
+
+		for (size_t j = task_begin; j < task_end; j++) {
+			task_error.add(colored_constraints[j]->get_error());
+		}
+
+		std::scoped_lock lock(error_mutex);
+
+		error.merge(task_error);
+	});
+}
+
+phys::particle_handle phys::particle_world::add_particle(particle * p) {
+	return particles.add(p);
 }
 
 void phys::particle_world::remove_particle(particle *p) {
-	std::erase(particles, p);
+	wake_particle(p);
+	particles.remove(p);
+}
+
+void phys::particle_world::remove_particle(particle_handle h) {
+	if (particle * p = particles.get(h)) {
+		wake_particle(p);
+	}
+
+	particles.remove(h);
+}
+
+phys::particle * phys::particle_world::get_particle(particle_handle h) const {
+	return particles.get(h);
+}
+
+void phys::particle_world::set_thread_pool(thread_pool * _pool) {
+	pool = _pool;
+}
+
+void phys::particle_world::set_solver_mode(solver_mode _mode) {
+	mode = _mode;
+}
+
+void phys::particle_world::set_sleep_thresholds(real max_speed, real _time_to_sleep) {
+	sleep_speed_sqr = max_speed * max_speed;
+	time_to_sleep = _time_to_sleep;
+
+	if (max_speed != 0.0_r) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < (uint32_t)sleeping_islands.size(); i++) {
+		if (! sleeping_islands[i].particles.empty()) {
+			wake_island(i);
+		}
+	}
+}
+
+void phys::particle_world::wake_particle(particle * p) {
+	if (p->asleep) {
+		wake_island(p->island);
+	}
 }
 
 void phys::particle_world::add_constraint_generator(constraint_generator * generator) {
@@ -125,9 +630,20 @@ void phys::particle_world::remove_constraint_generator(constraint_generator * ge
 }
 
 void phys::particle_world::add_fixed_constraint(constraint * c) {
+	for (particle * p : c->get_particles()) {
+		wake_particle(p);
+	}
+
+	c->source = 0;
 	fixed_constraints.push_back(c);
 }
 
 void phys::particle_world::remove_fixed_constraint(constraint * c) {
+	// A sleeping constraint is kept by its island, which puts it back into
+	// `fixed_constraints` when it wakes up
+	for (particle * p : c->get_particles()) {
+		wake_particle(p);
+	}
+
 	std::erase(fixed_constraints, c);
 }
\ No newline at end of file
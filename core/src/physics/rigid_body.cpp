@@ -39,7 +39,16 @@ phys::real phys::rigid_body::get_inv_mass() const {
 }
 
 bool phys::rigid_body::has_finite_mass() const {
-	return inv_mass == 0.0_r;
+	return inv_mass != 0.0_r;
+}
+
+void phys::rigid_body::set_inertia_tensor(const mat3 &inertia_tensor) {
+	inv_inertia_tensor = inverse(inertia_tensor);
+	calculate_inv_inertia_tensor_world();
+}
+
+const phys::mat3& phys::rigid_body::get_inv_inertia_tensor_world() const {
+	return inv_inertia_tensor_world;
 }
 
 void phys::rigid_body::setup() {
@@ -106,6 +115,14 @@ void phys::rigid_body::integrate(real dt) {
 	setup();
 }
 
+void phys::rigid_body::integrate_position(real dt) {
+	pos += vel * dt;
+	rot += quat(0.0_r, ang_vel * (dt / 2.0_r)) * rot;
+	rot = normalize(rot);
+
+	calculate_derived_data();
+}
+
 const phys::mat4& phys::rigid_body::get_transform() const {
 	return local_to_world;
 }
@@ -113,3 +130,53 @@ const phys::mat4& phys::rigid_body::get_transform() const {
 const phys::mat4& phys::rigid_body::get_inv_transform() const {
 	return world_to_local;
 }
+
+phys::mat3 phys::cuboid_inertia_tensor(real mass, const vec3 &half_size) {
+	const vec3 sqr = half_size * half_size;
+	const real k = mass / 3.0_r;
+
+	return mat3(
+		vec3(k * (sqr.y + sqr.z), 0.0_r, 0.0_r),
+		vec3(0.0_r, k * (sqr.x + sqr.z), 0.0_r),
+		vec3(0.0_r, 0.0_r, k * (sqr.x + sqr.y))
+	);
+}
+
+phys::mat3 phys::sphere_inertia_tensor(real mass, real radius) {
+	return mat3(0.4_r * mass * radius * radius);
+}
+
+phys::mat3 phys::capsule_inertia_tensor(real mass, real radius, real half_height) {
+	// The mass is split between the cylinder and the hemispheres by volume. Both
+	// volumes have a factor of pi * radius^2, which is left out.
+	const real r_sqr = radius * radius;
+	const real cylinder_volume = 2.0_r * half_height;
+	const real sphere_volume = (4.0_r / 3.0_r) * radius;
+	const real cylinder_mass = mass * cylinder_volume / (cylinder_volume + sphere_volume);
+	const real sphere_mass = mass - cylinder_mass;
+	// Each hemisphere's center of mass is `3 * radius / 8` from the flat side, so
+	// moving it out to the end of the cylinder adds to the inertia about the
+	// other two axes
+	const real axial = 0.5_r * cylinder_mass * r_sqr + 0.4_r * sphere_mass * r_sqr;
+	const real transverse =
+		cylinder_mass * (3.0_r * r_sqr + 4.0_r * half_height * half_height) / 12.0_r +
+		sphere_mass * (0.4_r * r_sqr + half_height * half_height + 0.75_r * half_height * radius);
+
+	return mat3(
+		vec3(transverse, 0.0_r, 0.0_r),
+		vec3(0.0_r, axial, 0.0_r),
+		vec3(0.0_r, 0.0_r, transverse)
+	);
+}
+
+phys::mat3 phys::cylinder_inertia_tensor(real mass, real radius, real half_height) {
+	const real r_sqr = radius * radius;
+	const real axial = 0.5_r * mass * r_sqr;
+	const real transverse = mass * (3.0_r * r_sqr + 4.0_r * half_height * half_height) / 12.0_r;
+
+	return mat3(
+		vec3(transverse, 0.0_r, 0.0_r),
+		vec3(0.0_r, axial, 0.0_r),
+		vec3(0.0_r, 0.0_r, transverse)
+	);
+}
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cmath>
+#include "physics/collision/algorithms.h"
+#include "physics/rigid_body_world.h"
+#include "physics/thread_pool.h"
+
+using namespace phys::literals;
+
+namespace {
+	bool is_unbounded(const phys::aabb &bounds) {
+		return std::isinf(bounds.min.x) || std::isinf(bounds.min.y) || std::isinf(bounds.min.z) ||
+			std::isinf(bounds.max.x) || std::isinf(bounds.max.y) || std::isinf(bounds.max.z);
+	}
+}
+
+phys::rigid_body_world::rigid_body_world(size_t _solver_iterations, real _bvh_margin, thread_pool * _pool) :
+	solver(_solver_iterations),
+	broadphase(_bvh_margin),
+	pool(_pool)
+{
+	collider.register_collision_algorithm(
+		shape_type::Box,
+		shape_type::Box,
+		algorithms::cached_box_box_batch(persistent_features)
+	);
+	collider.register_collision_algorithm(
+		shape_type::Box,
+		shape_type::ConvexHull,
+		algorithms::cached_convex_hull_batch(persistent_features)
+	);
+	collider.register_collision_algorithm(
+		shape_type::ConvexHull,
+		shape_type::ConvexHull,
+		algorithms::cached_convex_hull_batch(persistent_features)
+	);
+}
+
+void phys::rigid_body_world::run_physics(real dt) {
+	if (dt == 0.0_r) {
+		return;
+	}
+
+	for (const auto &[body, fg] : force_registrations) {
+		fg->update_force(*body, dt);
+	}
+
+	for (rigid_body * body : bodies) {
+		body->integrate(dt);
+	}
+
+	update_broadphase();
+	generate_contacts();
+
+	solver.solve(contacts, dt);
+	store_contacts();
+
+	for (rigid_body * body : bodies) {
+		if (body->has_finite_mass()) {
+			body->integrate_position(dt);
+		}
+	}
+}
+
+void phys::rigid_body_world::add_body(rigid_body * body) {
+	body->calculate_derived_data();
+	bodies.push_back(body);
+}
+
+void phys::rigid_body_world::remove_body(rigid_body * body) {
+	std::erase(bodies, body);
+	std::erase_if(force_registrations, [=](const force_registration &r) {
+		return r.body == body;
+	});
+}
+
+void phys::rigid_body_world::add_primitive(primitive * prim) {
+	const aabb bounds = prim->get_bounds();
+
+	if (is_unbounded(bounds)) {
+		unbounded_primitives.push_back(prim);
+	} else {
+		bounded_primitives.push_back(prim);
+		broadphase.insert(prim, bounds);
+	}
+}
+
+void phys::rigid_body_world::remove_primitive(primitive * prim) {
+	if (broadphase.remove(prim)) {
+		std::erase(bounded_primitives, prim);
+	} else {
+		std::erase(unbounded_primitives, prim);
+	}
+}
+
+void phys::rigid_body_world::add_force_generator(rigid_body * body, rigid_body_force_generator * fg) {
+	force_registrations.push_back(force_registration{ body, fg });
+}
+
+void phys::rigid_body_world::remove_force_generator(rigid_body * body, rigid_body_force_generator * fg) {
+	std::erase(force_registrations, force_registration{ body, fg });
+}
+
+const phys::contact_container& phys::rigid_body_world::get_contacts() const {
+	return contacts;
+}
+
+void phys::rigid_body_world::update_broadphase() {
+	for (primitive * prim : bounded_primitives) {
+		broadphase.update(prim, prim->get_bounds());
+	}
+}
+
+void phys::rigid_body_world::generate_contacts() {
+	coarse_pairs.clear();
+	collision_pairs.clear();
+	contacts.clear();
+	contact_ranges.clear();
+
+	broadphase.generate_coarse_collisions(coarse_pairs);
+
+	for (const auto &pair : coarse_pairs) {
+		if (can_collide(*pair.id1, *pair.id2)) {
+			collision_pairs.push_back(collision_pair{ pair.id1, pair.id2 });
+		}
+	}
+
+	for (primitive * a : unbounded_primitives) {
+		for (primitive * b : bounded_primitives) {
+			if (can_collide(*a, *b)) {
+				collision_pairs.push_back(collision_pair{ a, b });
+			}
+		}
+	}
+
+	persistent_features.begin_frame();
+
+	if (pool && collision_pairs.size() >= min_parallel_narrowphase_pairs) {
+		collider.generate_contacts(*pool, collision_pairs, contacts, contact_ranges);
+	} else {
+		collider.generate_contacts(collision_pairs, contacts, contact_ranges);
+	}
+
+	persistent_features.end_frame();
+
+	if (! solver.warm_starting) {
+		return;
+	}
+
+	// Contacts can only be warm started once they're all generated, because the
+	// container may be reallocated along the way
+	persistent_contacts.begin_frame();
+
+	for (const contact_range &r : contact_ranges) {
+		persistent_contacts.warm_start(
+			*r.a,
+			*r.b,
+			std::span(std::begin(contacts) + r.begin, std::begin(contacts) + r.end)
+		);
+	}
+}
+
+void phys::rigid_body_world::store_contacts() {
+	if (! solver.warm_starting) {
+		return;
+	}
+
+	for (const contact_range &r : contact_ranges) {
+		persistent_contacts.store(
+			*r.a,
+			*r.b,
+			std::span(std::cbegin(contacts) + r.begin, std::cbegin(contacts) + r.end)
+		);
+	}
+
+	persistent_contacts.end_frame();
+}
+
+bool phys::rigid_body_world::can_collide(const primitive &a, const primitive &b) const {
+	if (a.body == b.body) {
+		return false;
+	}
+
+	const bool a_moves = a.body && a.body->has_finite_mass();
+	const bool b_moves = b.body && b.body->has_finite_mass();
+
+	return a_moves || b_moves;
+}
@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <cmath>
+#include "physics/solver_stats.h"
+
+using namespace phys::literals;
+
+void phys::solver_error::add(real error) {
+	max = std::max(max, error);
+	sum_sqr += error * error;
+	num_constraints++;
+}
+
+void phys::solver_error::merge(const solver_error &other) {
+	max = std::max(max, other.max);
+	sum_sqr += other.sum_sqr;
+	num_constraints += other.num_constraints;
+}
+
+phys::real phys::solver_error::rms() const {
+	if (! num_constraints) {
+		return 0.0_r;
+	}
+
+	return std::sqrt(sum_sqr / (real)num_constraints);
+}
+
+void phys::solver_stats::clear(size_t num_generators) {
+	iterations = 0;
+	errors.clear();
+	projections.assign(num_generators + 1, 0);
+	timings = {};
+}
+
+phys::solver_error& phys::solver_stats::error_after(size_t iteration) {
+	if (iteration >= errors.size()) {
+		errors.resize(iteration + 1);
+	}
+
+	return errors[iteration];
+}
+
+size_t phys::solver_stats::get_fixed_projections() const {
+	return projections[0];
+}
+
+size_t phys::solver_stats::get_generator_projections(size_t i) const {
+	return projections[i + 1];
+}
+
+json phys::to_json(const solver_stats &stats) {
+	json out{};
+	json_array errors{};
+
+	for (const solver_error &e : stats.errors) {
+		errors.push_back(out.add(json_object{
+			{ L"max", (double)e.max },
+			{ L"rms", (double)e.rms() },
+			{ L"constraints", (long)e.num_constraints }
+		}));
+	}
+
+	json_array generator_projections{};
+
+	for (size_t i = 1; i < stats.projections.size(); i++) {
+		generator_projections.push_back((long)stats.projections[i]);
+	}
+
+	const json_object_descriptor projections = out.add(json_object{
+		{ L"fixed", (long)stats.get_fixed_projections() },
+		{ L"generators", out.add(generator_projections) }
+	});
+
+	const step_timings &t = stats.timings;
+	const json_object_descriptor timings = out.add(json_object{
+		{ L"forces", (long)t.forces.count() },
+		{ L"candidates", (long)t.candidates.count() },
+		{ L"integration", (long)t.integration.count() },
+		{ L"constraint_generation", (long)t.constraint_generation.count() },
+		{ L"projection", (long)t.projection.count() },
+		{ L"velocity_update", (long)t.velocity_update.count() },
+		{ L"islands", (long)t.islands.count() }
+	});
+
+	out.set_root(out.add(json_object{
+		{ L"iterations", (long)stats.iterations },
+		{ L"errors", out.add(errors) },
+		{ L"projections", projections },
+		{ L"timings", timings }
+	}));
+
+	return out;
+}
@@ -0,0 +1,119 @@
+#include "physics/thread_pool.h"
+
+phys::thread_pool::thread_pool(size_t num_threads) {
+	for (size_t i = 0; i < num_threads; i++) {
+		queues.push_back(std::make_unique<task_queue>());
+	}
+
+	for (size_t i = 0; i < num_threads; i++) {
+		workers.emplace_back(&thread_pool::worker_main, this, i);
+	}
+}
+
+phys::thread_pool::~thread_pool() {
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		stopping = true;
+	}
+
+	wake.notify_all();
+
+	for (std::thread &worker : workers) {
+		worker.join();
+	}
+}
+
+size_t phys::thread_pool::num_threads() const {
+	return workers.size();
+}
+
+size_t phys::thread_pool::default_num_threads() {
+	size_t hw_threads = std::thread::hardware_concurrency();
+
+	return hw_threads > 1 ? hw_threads - 1 : 0;
+}
+
+void phys::thread_pool::submit(job &j, size_t count, size_t grain) {
+	const size_t num_tasks = (count + grain - 1) / grain;
+	const size_t first_queue = next_queue.fetch_add(1, std::memory_order_relaxed);
+
+	// The count has to be set before any task can run and decrement it
+	j.remaining.store(num_tasks, std::memory_order_relaxed);
+	num_queued.fetch_add(num_tasks, std::memory_order_release);
+
+	for (size_t i = 0; i < num_tasks; i++) {
+		task_queue &q = *queues[(first_queue + i) % queues.size()];
+		const size_t begin = i * grain;
+		const size_t end = std::min(begin + grain, count);
+
+		std::lock_guard<std::mutex> lock(q.mutex);
+		q.tasks.push_back(task{ &j, begin, end });
+	}
+
+	{
+		// Taking the lock makes sure that a worker can't check for work and then go
+		// to sleep in between the tasks being queued and the notification
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+	}
+
+	wake.notify_all();
+}
+
+void phys::thread_pool::help_until_done(job &j) {
+	const size_t first_queue = next_queue.load(std::memory_order_relaxed);
+
+	while (j.remaining.load(std::memory_order_acquire)) {
+		if (! try_run_task(first_queue % queues.size(), false)) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+bool phys::thread_pool::try_run_task(size_t first_queue, bool is_owner) {
+	for (size_t i = 0; i < queues.size(); i++) {
+		task_queue &q = *queues[(first_queue + i) % queues.size()];
+		task t{};
+
+		{
+			std::lock_guard<std::mutex> lock(q.mutex);
+
+			if (q.tasks.empty()) {
+				continue;
+			}
+
+			if (is_owner && i == 0) {
+				t = q.tasks.back();
+				q.tasks.pop_back();
+			} else {
+				t = q.tasks.front();
+				q.tasks.pop_front();
+			}
+		}
+
+		num_queued.fetch_sub(1, std::memory_order_relaxed);
+		t.j->run(t.j->ctx, t.begin, t.end);
+		t.j->remaining.fetch_sub(1, std::memory_order_acq_rel);
+
+		return true;
+	}
+
+	return false;
+}
+
+void phys::thread_pool::worker_main(size_t index) {
+	while (true) {
+		if (try_run_task(index, true)) {
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+
+		wake.wait(lock, [&]() {
+			return stopping || num_queued.load(std::memory_order_acquire);
+		});
+
+		if (stopping && ! num_queued.load(std::memory_order_acquire)) {
+			return;
+		}
+	}
+}
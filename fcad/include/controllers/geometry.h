@@ -1,4 +1,5 @@
 #pragma once
+#include <experimental/generator>
 #include <draw2d.h>
 #include <mesh.h>
 #include <world.h>
@@ -451,7 +451,9 @@ object_world<N>::object_world(
 	)),
 	particle_collision_generator(std::make_unique<particle_collision_constraint_generator<N>>(
 		state->particles,
-		state->active
+		0.9_r,
+		0.1_r,
+		active_particle_filter<N>(state->active)
 	)),
 	gravity_generator(std::make_unique<phys::particle_gravity>(
 		phys::vec3(0.0_r, -9.8_r, 0.0_r)
@@ -499,6 +501,8 @@ object_world<N>::object_world(
 
 	mesh_world.add_mesh(floor.get());
 
+	particle_collision_generator->continuous = true;
+
 	phys_world.add_constraint_generator(floor_constraint_generator.get());
 	phys_world.add_constraint_generator(particle_collision_generator.get());
 }
@@ -527,9 +531,8 @@ int object_world<N>::handle(pre_render_pass_event&) {
 			prev_update += (num_iters * timestep_ms);
 		}
 
-		for (long long i = 0; i < num_iters; i++) {
-			phys_world.prepare_frame();
-			phys_world.run_physics(timestep_s);
+		if (num_iters) {
+			phys_world.step((phys::real)num_iters * timestep_s, (size_t)num_iters);
 		}
 	}
 
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+
+namespace test {
+	// The global `operator new` and `operator delete` are replaced for the whole test
+	// binary in allocation_counter.cpp. Allocations are only counted between these two
+	// calls, and only on the thread that made them.
+	void begin_counting_allocations();
+	size_t end_counting_allocations();
+
+	// Returns the number of heap allocations made by `func` on this thread
+	template <typename Func>
+	size_t count_allocations(Func func) {
+		begin_counting_allocations();
+		func();
+
+		return end_counting_allocations();
+	}
+}
\ No newline at end of file
@@ -8,6 +8,9 @@ extern void setup_uri_tests();
 extern void setup_bvh_tests();
 extern void setup_collision_tests();
 extern void setup_geometry_tests();
+extern void setup_constraint_tests();
+extern void setup_particle_world_tests();
+extern void setup_rigid_body_world_tests();
 
 int main(int, const char * const * const) {
 #pragma warning(push)
@@ -22,6 +25,9 @@ int main(int, const char * const * const) {
 	setup_bvh_tests();
 	setup_collision_tests();
 	setup_geometry_tests();
+	setup_constraint_tests();
+	setup_particle_world_tests();
+	setup_rigid_body_world_tests();
 
 	test::run();
 
@@ -0,0 +1,78 @@
+#include <cstdlib>
+#include <new>
+#include "allocation_counter.h"
+
+namespace {
+	thread_local bool is_counting_allocations{};
+	thread_local size_t num_allocations{};
+
+	void * allocate(size_t size) noexcept {
+		if (is_counting_allocations) {
+			num_allocations++;
+		}
+
+		return std::malloc(size ? size : 1);
+	}
+}
+
+void test::begin_counting_allocations() {
+	num_allocations = 0;
+	is_counting_allocations = true;
+}
+
+size_t test::end_counting_allocations() {
+	is_counting_allocations = false;
+
+	return num_allocations;
+}
+
+// Every form of `operator new` and `operator delete` that isn't over-aligned is
+// replaced so that they all agree on `malloc` and `free`
+
+void * operator new(size_t size) {
+	if (void * out = allocate(size)) {
+		return out;
+	}
+
+	throw std::bad_alloc();
+}
+
+void * operator new[](size_t size) {
+	if (void * out = allocate(size)) {
+		return out;
+	}
+
+	throw std::bad_alloc();
+}
+
+void * operator new(size_t size, const std::nothrow_t&) noexcept {
+	return allocate(size);
+}
+
+void * operator new[](size_t size, const std::nothrow_t&) noexcept {
+	return allocate(size);
+}
+
+void operator delete(void * ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void * ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void * ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void * ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void * ptr, const std::nothrow_t&) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void * ptr, const std::nothrow_t&) noexcept {
+	std::free(ptr);
+}
\ No newline at end of file
@@ -1,12 +1,16 @@
 #define DEBUG
+#include <algorithm>
 #include <random>
 #include <stack>
 #include "physics/collision/bvh.h"
+#include "physics/collision/flat_bvh.h"
 #include "test.h"
 
 using namespace test;
 
 using sphere_bvh = phys::bvh<phys::bounding_sphere, int>;
+using sphere_flat_bvh = phys::flat_bvh<phys::bounding_sphere, int>;
+using aabb_bvh = phys::bvh<phys::aabb, int>;
 
 namespace {
 	using namespace phys::literals;
@@ -118,6 +122,128 @@ namespace {
 		}
 	}
 
+	template <phys::bounding_volume Volume, typename Identifier>
+	void flat_bvh_checks(const phys::flat_bvh<Volume, Identifier> &objects) {
+		using bvh_t = phys::flat_bvh<Volume, Identifier>;
+		using node_index = typename bvh_t::node_index;
+
+		if (objects.root == bvh_t::null_node) {
+			expect(objects.size()).to_be(0);
+			return;
+		}
+
+		expect(objects.nodes[objects.root].parent).to_be(bvh_t::null_node);
+
+		std::stack<node_index> nodes{};
+		size_t obj_count = 0;
+		size_t node_count = 0;
+
+		nodes.push(objects.root);
+
+		while (! nodes.empty()) {
+			node_index i = nodes.top();
+			nodes.pop();
+			node_count++;
+
+			const auto &n = objects.nodes[i];
+
+			if ((n.left == bvh_t::null_node) != (n.right == bvh_t::null_node)) {
+				fail("expected node " + std::to_string(i) + " to have two children or none at all");
+			}
+
+			if (n.is_leaf()) {
+				if (! objects.has(n.id)) {
+					fail("expected leaf node with id " + std::to_string(n.id) + " to be in the id list");
+				}
+
+				obj_count++;
+				continue;
+			}
+
+			if (objects.nodes[n.left].parent != i || objects.nodes[n.right].parent != i) {
+				fail("expected the children of node " + std::to_string(i) + " to point back to it");
+			}
+
+			if (n.vol != Volume(objects.nodes[n.left].vol, objects.nodes[n.right].vol)) {
+				fail("expected node " + std::to_string(i) + " to have a volume enclosing its children");
+			}
+
+			nodes.push(n.left);
+			nodes.push(n.right);
+		}
+
+		expect(obj_count).to_be(objects.size());
+		expect(node_count).to_be((2 * objects.size()) - 1);
+
+		for (size_t i = 0; i < objects.ids.size(); i++) {
+			if (i > 0 && objects.ids[i].id < objects.ids[i - 1].id) {
+				fail("expected ids to be sorted in ascending order");
+			}
+
+			if (objects.nodes[objects.ids[i].n].id != objects.ids[i].id) {
+				fail("expected id " + std::to_string(objects.ids[i].id) + " to refer to its leaf node");
+			}
+		}
+	}
+
+	template <phys::bounding_volume Volume, typename Identifier>
+	size_t flat_bvh_depth(const phys::flat_bvh<Volume, Identifier> &objects) {
+		using bvh_t = phys::flat_bvh<Volume, Identifier>;
+		using node_index = typename bvh_t::node_index;
+
+		if (objects.root == bvh_t::null_node) {
+			return 0;
+		}
+
+		std::stack<std::pair<node_index, size_t>> nodes{};
+		size_t max_depth = 0;
+
+		nodes.push({ objects.root, 1 });
+
+		while (! nodes.empty()) {
+			auto [i, depth] = nodes.top();
+			nodes.pop();
+
+			const auto &n = objects.nodes[i];
+			max_depth = std::max(max_depth, depth);
+
+			if (! n.is_leaf()) {
+				nodes.push({ n.left, depth + 1 });
+				nodes.push({ n.right, depth + 1 });
+			}
+		}
+
+		return max_depth;
+	}
+
+	template <phys::bounding_volume Volume, typename Identifier>
+	size_t bvh_depth(const phys::bvh<Volume, Identifier> &objects) {
+		using node_t = typename phys::bvh<Volume, Identifier>::node;
+
+		if (! objects.root.get()) {
+			return 0;
+		}
+
+		std::stack<std::pair<const node_t *, size_t>> nodes{};
+		size_t max_depth = 0;
+
+		nodes.push({ objects.root.get(), 1 });
+
+		while (! nodes.empty()) {
+			auto [n, depth] = nodes.top();
+			nodes.pop();
+
+			max_depth = std::max(max_depth, depth);
+
+			if (! n->is_leaf()) {
+				nodes.push({ n->left.get(), depth + 1 });
+				nodes.push({ n->right.get(), depth + 1 });
+			}
+		}
+
+		return max_depth;
+	}
+
 	phys::bounding_sphere random_sphere(
 		std::uniform_real_distribution<phys::real> &coord_distrib,
 		std::uniform_real_distribution<phys::real> &radius_distrib
@@ -132,6 +258,183 @@ namespace {
 		return phys::bounding_sphere(phys::vec3(x, y, z), r);
 	}
 
+	// Generates the same scene every time, so that different BVHs can be compared
+	// against each other
+	std::vector<phys::bounding_sphere> seeded_spheres(
+		size_t num_spheres,
+		phys::real extent,
+		phys::real max_radius,
+		unsigned int seed
+	) {
+		std::mt19937 gen(seed);
+		std::uniform_real_distribution<phys::real> coord_distrib(-extent, extent);
+		std::uniform_real_distribution<phys::real> radius_distrib(0.1_r, max_radius);
+		std::vector<phys::bounding_sphere> out{};
+
+		for (size_t i = 0; i < num_spheres; i++) {
+			phys::real x = coord_distrib(gen);
+			phys::real y = coord_distrib(gen);
+			phys::real z = coord_distrib(gen);
+			phys::real r = radius_distrib(gen);
+
+			out.push_back(phys::bounding_sphere(phys::vec3(x, y, z), r));
+		}
+
+		return out;
+	}
+
+	template <typename Volume>
+	std::vector<std::pair<int, Volume>> with_ids(const std::vector<Volume> &volumes) {
+		std::vector<std::pair<int, Volume>> out{};
+
+		for (size_t i = 0; i < volumes.size(); i++) {
+			out.push_back({ (int)i + 1, volumes[i] });
+		}
+
+		return out;
+	}
+
+	std::vector<phys::aabb> seeded_boxes(size_t num_boxes, phys::real extent, unsigned int seed) {
+		std::vector<phys::aabb> out{};
+
+		for (const phys::bounding_sphere &sphere : seeded_spheres(num_boxes, extent, 2.0_r, seed)) {
+			out.push_back(phys::aabb(sphere));
+		}
+
+		return out;
+	}
+
+	template <typename Container>
+	std::vector<std::pair<int, int>> sorted_id_pairs(const Container &c) {
+		std::vector<std::pair<int, int>> out{};
+
+		for (const auto &pair : c) {
+			out.push_back(std::minmax(pair.id1, pair.id2));
+		}
+
+		std::sort(std::begin(out), std::end(out));
+
+		return out;
+	}
+
+	// Moves every object a little bit and regenerates coarse collisions, like a
+	// physics step would
+	template <typename BVH>
+	size_t simulate_frames(BVH &objects, std::vector<phys::bounding_sphere> &spheres, size_t num_frames) {
+		std::vector<typename BVH::coarse_collision_pair> pairs{};
+		size_t total_pairs = 0;
+
+		for (size_t i = 0; i < spheres.size(); i++) {
+			objects.insert((int)i + 1, spheres[i]);
+		}
+
+		for (size_t frame = 0; frame < num_frames; frame++) {
+			phys::real dx = (frame % 2) ? 0.01_r : -0.01_r;
+
+			for (size_t i = 0; i < spheres.size(); i++) {
+				spheres[i].center.x += dx;
+				objects.update((int)i + 1, spheres[i]);
+			}
+
+			pairs.clear();
+			objects.generate_coarse_collisions(pairs);
+			total_pairs += pairs.size();
+		}
+
+		return total_pairs;
+	}
+
+	// Long, thin rods lying along the x, y, and z axes, like a pile of sticks
+	std::vector<phys::aabb> rod_scene(size_t num_rods, unsigned int seed) {
+		std::mt19937 gen(seed);
+		std::uniform_real_distribution<phys::real> coord_distrib(-20.0_r, 20.0_r);
+		std::uniform_int_distribution<int> axis_distrib(0, 2);
+		std::vector<phys::aabb> out{};
+
+		for (size_t i = 0; i < num_rods; i++) {
+			phys::real x = coord_distrib(gen);
+			phys::real y = coord_distrib(gen);
+			phys::real z = coord_distrib(gen);
+			phys::vec3 half_size(0.1_r);
+
+			half_size[axis_distrib(gen)] = 4.0_r;
+
+			phys::vec3 center(x, y, z);
+
+			out.push_back(phys::aabb(center - half_size, center + half_size));
+		}
+
+		return out;
+	}
+
+	// Unit crates stacked in a grid with a small gap between each crate
+	std::vector<phys::aabb> crate_scene(int crates_per_side) {
+		std::vector<phys::aabb> out{};
+
+		for (int x = 0; x < crates_per_side; x++) {
+			for (int y = 0; y < crates_per_side; y++) {
+				for (int z = 0; z < crates_per_side; z++) {
+					phys::vec3 min(x * 1.1_r, y * 1.1_r, z * 1.1_r);
+
+					out.push_back(phys::aabb(min, min + phys::vec3(1.0_r)));
+				}
+			}
+		}
+
+		return out;
+	}
+
+	phys::bounding_sphere enclosing_sphere(const phys::aabb &box) {
+		phys::vec3 half_size = (box.max - box.min) * 0.5_r;
+
+		return phys::bounding_sphere(box.centroid(), std::sqrt(phys::dot(half_size, half_size)));
+	}
+
+	// Inserts boxes into an AABB BVH and their enclosing spheres into a sphere BVH,
+	// and checks that the AABB BVH reports exactly the pairs that overlap while the
+	// sphere BVH reports all of those and more
+	void check_false_positives(const std::vector<phys::aabb> &boxes) {
+		aabb_bvh box_objects{};
+		sphere_bvh sphere_objects{};
+
+		for (size_t i = 0; i < boxes.size(); i++) {
+			box_objects.insert((int)i + 1, boxes[i]);
+			sphere_objects.insert((int)i + 1, enclosing_sphere(boxes[i]));
+		}
+
+		std::vector<std::pair<int, int>> expected{};
+
+		for (size_t i = 0; i < boxes.size(); i++) {
+			for (size_t j = i + 1; j < boxes.size(); j++) {
+				if (boxes[i].overlaps(boxes[j])) {
+					expected.push_back({ (int)i + 1, (int)j + 1 });
+				}
+			}
+		}
+
+		std::vector<aabb_bvh::coarse_collision_pair> box_pairs{};
+		std::vector<sphere_bvh::coarse_collision_pair> sphere_pairs{};
+
+		box_objects.generate_coarse_collisions(box_pairs);
+		sphere_objects.generate_coarse_collisions(sphere_pairs);
+
+		std::vector<std::pair<int, int>> sorted_box_pairs = sorted_id_pairs(box_pairs);
+		std::vector<std::pair<int, int>> sorted_sphere_pairs = sorted_id_pairs(sphere_pairs);
+
+		if (sorted_box_pairs != expected) {
+			fail("expected the AABB BVH to report exactly the overlapping pairs");
+		}
+
+		if (! std::includes(
+			std::begin(sorted_sphere_pairs), std::end(sorted_sphere_pairs),
+			std::begin(expected), std::end(expected)
+		)) {
+			fail("expected the sphere BVH to report every overlapping pair");
+		}
+
+		expect(box_pairs.size()).to_be_less_than(sphere_pairs.size() / 2);
+	}
+
 	template <typename Container>
 	bool contains_collision(const Container &c, int id1, int id2) {
 		for (const auto &pair : c) {
@@ -299,6 +602,87 @@ void setup_bvh_tests() {
 				expect(objects.root->right->right->id).to_be(2);
 			});
 
+			it("does not restructure the tree for updates within the margin", []() {
+				sphere_bvh objects(0.5_r);
+
+				objects.insert(1, s1);
+				objects.insert(2, s2);
+				objects.insert(3, s3);
+
+				auto * leaf = objects.ids[0].n;
+
+				expect(leaf->vol).to_be(s1.enlarged(0.5_r));
+
+				objects.update(1, phys::bounding_sphere(s1.center + phys::vec3(0.25_r), s1.radius));
+
+				expect(objects.ids[0].n).to_be(leaf);
+				expect(leaf->vol).to_be(s1.enlarged(0.5_r));
+
+				phys::bounding_sphere moved(s1.center + phys::vec3(1.0_r), s1.radius);
+
+				objects.update(1, moved);
+
+				expect(objects.size()).to_be(3);
+				expect(objects.ids[0].n->vol).to_be(moved.enlarged(0.5_r));
+				volume_check(objects);
+			});
+
+			it("stays balanced when objects are inserted in order", []() {
+				sphere_bvh objects{};
+
+				for (int i = 1; i <= 1024; i++) {
+					objects.insert(i, phys::bounding_sphere(phys::vec3((phys::real)i, 0.0_r, 0.0_r), 0.4_r));
+				}
+
+				bvh_checks(objects);
+				volume_check(objects);
+				expect(bvh_depth(objects)).to_be_less_than(24);
+
+				for (int i = 1; i <= 1024; i += 2) {
+					objects.remove(i);
+				}
+
+				bvh_checks(objects);
+				volume_check(objects);
+				expect(bvh_depth(objects)).to_be_less_than(24);
+			});
+
+			it("builds a tree from a set of objects", []() {
+				std::vector<phys::bounding_sphere> spheres = seeded_spheres(2000, 50.0_r, 2.0_r, 99);
+				sphere_bvh objects{};
+				sphere_bvh inserted_objects{};
+
+				objects.insert(5000, s1);
+				objects.build(with_ids(spheres));
+
+				for (size_t i = 0; i < spheres.size(); i++) {
+					inserted_objects.insert((int)i + 1, spheres[i]);
+				}
+
+				expect(objects.size()).to_be(2000);
+				expect(objects.has(5000)).to_be(false);
+				bvh_checks(objects);
+				volume_check(objects);
+
+				std::vector<sphere_bvh::coarse_collision_pair> pairs{};
+				std::vector<sphere_bvh::coarse_collision_pair> inserted_pairs{};
+
+				objects.generate_coarse_collisions(pairs);
+				inserted_objects.generate_coarse_collisions(inserted_pairs);
+
+				if (sorted_id_pairs(pairs) != sorted_id_pairs(inserted_pairs)) {
+					fail("expected the built BVH to generate the same coarse collision pairs");
+				}
+
+				objects.remove(1);
+				objects.insert(1, s1);
+				objects.update(2, s2);
+
+				expect(objects.size()).to_be(2000);
+				bvh_checks(objects);
+				volume_check(objects);
+			});
+
 			it("does not delete objects that don't exist", []() {
 				sphere_bvh objects{};
 
@@ -367,5 +751,464 @@ void setup_bvh_tests() {
 				expect(contains_collision(collision_pairs, 11, 13)).to_be(true);
 			});
 		});
+
+		describe("with an axis-aligned volume", []() {
+			it("encloses, contains, and overlaps boxes", []() {
+				phys::aabb a(phys::vec3(0.0_r), phys::vec3(1.0_r));
+				phys::aabb b(phys::vec3(2.0_r, 0.0_r, 0.0_r), phys::vec3(3.0_r, 1.0_r, 1.0_r));
+				phys::aabb c(phys::vec3(0.25_r), phys::vec3(0.75_r));
+				phys::aabb ab(a, b);
+
+				expect(ab).to_be(phys::aabb(phys::vec3(0.0_r), phys::vec3(3.0_r, 1.0_r, 1.0_r)));
+				expect(ab.contains(a)).to_be(true);
+				expect(ab.contains(b)).to_be(true);
+				expect(a.contains(ab)).to_be(false);
+				expect(a.contains(c)).to_be(true);
+				expect(phys::aabb(a, c)).to_be(a);
+
+				expect(a.overlaps(b)).to_be(false);
+				expect(a.overlaps(c)).to_be(true);
+				expect(ab.overlaps(b)).to_be(true);
+				expect(a.overlaps(phys::aabb(phys::vec3(1.0_r), phys::vec3(2.0_r)))).to_be(true);
+
+				expect(a.surface_area()).to_be(6.0_r);
+				expect(a.growth(c)).to_be(0.0_r);
+				expect(a.growth(b)).to_be(ab.surface_area() - 6.0_r);
+				expect(a.centroid()).to_be(phys::vec3(0.5_r));
+				expect(a.enlarged(0.5_r)).to_be(phys::aabb(phys::vec3(-0.5_r), phys::vec3(1.5_r)));
+				expect(phys::aabb(s1)).to_be(phys::aabb(phys::vec3(1.0_r), phys::vec3(3.0_r)));
+			});
+
+			it("builds a tree that reports exactly the overlapping pairs", []() {
+				std::vector<phys::aabb> boxes = rod_scene(1000, 4321);
+				aabb_bvh objects{};
+
+				objects.build(with_ids(boxes));
+
+				bvh_checks(objects);
+				volume_check(objects);
+
+				std::vector<std::pair<int, int>> expected{};
+
+				for (size_t i = 0; i < boxes.size(); i++) {
+					for (size_t j = i + 1; j < boxes.size(); j++) {
+						if (boxes[i].overlaps(boxes[j])) {
+							expected.push_back({ (int)i + 1, (int)j + 1 });
+						}
+					}
+				}
+
+				std::vector<aabb_bvh::coarse_collision_pair> pairs{};
+
+				objects.generate_coarse_collisions(pairs);
+
+				if (sorted_id_pairs(pairs) != expected) {
+					fail("expected the built BVH to report exactly the overlapping pairs");
+				}
+			});
+
+			it("inserts and deletes many objects", []() {
+				std::vector<phys::aabb> boxes = rod_scene(1000, 7);
+				aabb_bvh objects{};
+
+				for (size_t i = 0; i < boxes.size(); i++) {
+					objects.insert((int)i + 1, boxes[i]);
+				}
+
+				bvh_checks(objects);
+				volume_check(objects);
+
+				for (size_t i = 0; i < boxes.size(); i += 2) {
+					if (! objects.remove((int)i + 1)) {
+						fail("object " + std::to_string(i + 1) + " was not present");
+					}
+				}
+
+				expect(objects.size()).to_be(500);
+				bvh_checks(objects);
+				volume_check(objects);
+			});
+
+			it("reports fewer false-positive pairs than spheres on a scene of rods", []() {
+				check_false_positives(rod_scene(1000, 1234));
+			});
+
+			it("reports fewer false-positive pairs than spheres on a scene of stacked crates", []() {
+				check_false_positives(crate_scene(8));
+			});
+		});
+
+		describe("with flat node storage", []() {
+			it("inserts and groups objects", []() {
+				sphere_flat_bvh objects{};
+
+				objects.insert(1, s1);
+				objects.insert(2, s2);
+				objects.insert(3, s3);
+				objects.insert(4, s4);
+
+				expect(objects.size()).to_be(4);
+				flat_bvh_checks(objects);
+
+				const auto &root = objects.nodes[objects.root];
+				const auto &left = objects.nodes[root.left];
+				const auto &right = objects.nodes[root.right];
+
+				expect(root.is_leaf()).to_be(false);
+				expect(left.is_leaf()).to_be(false);
+				expect(right.is_leaf()).to_be(false);
+
+				expect(objects.nodes[left.left].id).to_be(1);
+				expect(objects.nodes[left.left].vol).to_be(s1);
+				expect(objects.nodes[left.right].id).to_be(3);
+				expect(objects.nodes[left.right].vol).to_be(s3);
+				expect(objects.nodes[right.left].id).to_be(2);
+				expect(objects.nodes[right.left].vol).to_be(s2);
+				expect(objects.nodes[right.right].id).to_be(4);
+				expect(objects.nodes[right.right].vol).to_be(s4);
+			});
+
+			it("deletes objects", []() {
+				sphere_flat_bvh objects{};
+
+				objects.insert(1, s1);
+				objects.insert(2, s2);
+				objects.insert(3, s3);
+				objects.insert(4, s4);
+
+				expect(objects.remove(2)).to_be(true);
+				expect(objects.size()).to_be(3);
+				flat_bvh_checks(objects);
+
+				expect(objects.remove(4)).to_be(true);
+				expect(objects.size()).to_be(2);
+				flat_bvh_checks(objects);
+
+				expect(objects.remove(1)).to_be(true);
+				expect(objects.size()).to_be(1);
+				flat_bvh_checks(objects);
+
+				expect(objects.remove(3)).to_be(true);
+				expect(objects.size()).to_be(0);
+				flat_bvh_checks(objects);
+
+				expect(objects.remove(3)).to_be(false);
+			});
+
+			it("reuses freed nodes", []() {
+				sphere_flat_bvh objects{};
+
+				objects.insert(1, s1);
+				objects.insert(2, s2);
+				objects.insert(3, s3);
+				objects.insert(4, s4);
+
+				size_t num_nodes = objects.nodes.size();
+
+				objects.remove(2);
+				objects.remove(3);
+				objects.insert(5, s2);
+				objects.insert(6, s3);
+				objects.update(1, phys::bounding_sphere(phys::vec3(3.0_r), 1.0_r));
+
+				expect(objects.nodes.size()).to_be(num_nodes);
+				flat_bvh_checks(objects);
+			});
+
+			it("indicates whether objects are present or not", []() {
+				sphere_flat_bvh objects{};
+
+				objects.insert(1, s1);
+				objects.insert(2, s2);
+				objects.insert(4, s4);
+
+				expect(objects.has(1)).to_be(true);
+				expect(objects.has(2)).to_be(true);
+				expect(objects.has(4)).to_be(true);
+				expect(objects.has(3)).to_be(false);
+				expect(objects.has(1000)).to_be(false);
+			});
+
+			it("updates objects", []() {
+				sphere_flat_bvh objects{};
+
+				objects.insert(1, s1);
+				objects.insert(2, s2);
+				objects.insert(4, s4);
+
+				objects.update(2, s3);
+				objects.update(3, s3);
+
+				expect(objects.size()).to_be(3);
+				expect(objects.has(3)).to_be(false);
+				expect(objects.nodes[objects.ids[1].n].vol).to_be(s3);
+				flat_bvh_checks(objects);
+			});
+
+			it("does not restructure the tree for updates within the margin", []() {
+				sphere_flat_bvh objects(0.5_r);
+
+				objects.insert(1, s1);
+				objects.insert(2, s2);
+				objects.insert(3, s3);
+
+				const auto nodes = objects.nodes;
+				const auto leaf = objects.ids[0].n;
+
+				expect(objects.nodes[leaf].vol).to_be(s1.enlarged(0.5_r));
+
+				objects.update(1, phys::bounding_sphere(s1.center + phys::vec3(0.25_r), s1.radius));
+
+				for (size_t i = 0; i < nodes.size(); i++) {
+					if (nodes[i].vol != objects.nodes[i].vol ||
+						nodes[i].parent != objects.nodes[i].parent ||
+						nodes[i].left != objects.nodes[i].left ||
+						nodes[i].right != objects.nodes[i].right) {
+						fail("expected node " + std::to_string(i) + " to be unchanged");
+					}
+				}
+
+				phys::bounding_sphere moved(s1.center + phys::vec3(1.0_r), s1.radius);
+
+				objects.update(1, moved);
+
+				expect(objects.ids[0].n).to_be(leaf);
+				expect(objects.nodes[leaf].vol).to_be(moved.enlarged(0.5_r));
+				flat_bvh_checks(objects);
+			});
+
+			it("stays balanced when objects are inserted in order", []() {
+				sphere_flat_bvh objects{};
+
+				for (int i = 1; i <= 1024; i++) {
+					objects.insert(i, phys::bounding_sphere(phys::vec3((phys::real)i, 0.0_r, 0.0_r), 0.4_r));
+				}
+
+				flat_bvh_checks(objects);
+				expect(flat_bvh_depth(objects)).to_be_less_than(24);
+
+				for (int i = 1; i <= 1024; i += 2) {
+					objects.remove(i);
+				}
+
+				flat_bvh_checks(objects);
+				expect(flat_bvh_depth(objects)).to_be_less_than(24);
+			});
+
+			it("builds a tree from a set of objects", []() {
+				std::vector<phys::bounding_sphere> spheres = seeded_spheres(2000, 50.0_r, 2.0_r, 99);
+				sphere_flat_bvh objects{};
+
+				objects.insert(5000, s1);
+				objects.remove(5000);
+				objects.build(with_ids(spheres));
+
+				expect(objects.size()).to_be(2000);
+				expect(objects.free_list).to_be(sphere_flat_bvh::null_node);
+				flat_bvh_checks(objects);
+
+				for (int i = 1; i <= 1000; i++) {
+					objects.remove(i);
+				}
+
+				for (int i = 1; i <= 1000; i++) {
+					objects.insert(i, spheres[i - 1]);
+				}
+
+				expect(objects.nodes.size()).to_be(3999);
+				flat_bvh_checks(objects);
+			});
+
+			it("builds the same tree in parallel as on one thread", []() {
+				std::vector<std::pair<int, phys::aabb>> boxes = with_ids(seeded_boxes(10000, 100.0_r, 5));
+				phys::flat_bvh<phys::aabb, int> objects{};
+				phys::flat_bvh<phys::aabb, int> parallel_objects{};
+
+				objects.build(boxes, 0);
+				parallel_objects.build(boxes, 256);
+
+				flat_bvh_checks(parallel_objects);
+				expect(parallel_objects.nodes.size()).to_be(objects.nodes.size());
+
+				for (size_t i = 0; i < objects.nodes.size(); i++) {
+					const auto &a = objects.nodes[i];
+					const auto &b = parallel_objects.nodes[i];
+
+					if (a.vol != b.vol || a.id != b.id || a.left != b.left || a.right != b.right) {
+						fail("expected node " + std::to_string(i) + " to be the same in both trees");
+					}
+				}
+			});
+
+			it("builds a balanced tree from sorted objects", []() {
+				std::vector<std::pair<int, phys::aabb>> boxes{};
+
+				for (int i = 1; i <= 1024; i++) {
+					phys::vec3 center((phys::real)i, 0.0_r, 0.0_r);
+
+					boxes.push_back({ i, phys::aabb(center - phys::vec3(0.4_r), center + phys::vec3(0.4_r)) });
+				}
+
+				phys::flat_bvh<phys::aabb, int> objects{};
+
+				objects.build(boxes);
+
+				flat_bvh_checks(objects);
+				expect(flat_bvh_depth(objects)).to_be(11);
+			});
+
+			it("inserts and deletes many objects", []() {
+				std::uniform_real_distribution<phys::real> coord_distrib(-100.0_r, 100.0_r);
+				std::uniform_real_distribution<phys::real> radius_distrib(0.1_r, 2.0_r);
+				sphere_flat_bvh objects{};
+
+				for (int i = 1; i < 2000; i++) {
+					objects.insert(i, random_sphere(coord_distrib, radius_distrib));
+				}
+
+				flat_bvh_checks(objects);
+
+				for (int i = 1999; i > 1000; i--) {
+					if (! objects.remove(i)) {
+						fail("object " + std::to_string(i) + " was not present");
+					}
+				}
+
+				flat_bvh_checks(objects);
+
+				for (int i = 3000; i > 2000; i--) {
+					objects.insert(i, random_sphere(coord_distrib, radius_distrib));
+				}
+
+				flat_bvh_checks(objects);
+
+				for (int i = 1000; i > 0; i--) {
+					if (! objects.remove(i)) {
+						fail("object " + std::to_string(i) + " was not present");
+					}
+				}
+
+				flat_bvh_checks(objects);
+
+				for (int i = 3000; i > 2000; i--) {
+					if (! objects.remove(i)) {
+						fail("object " + std::to_string(i) + " was not present");
+					}
+				}
+
+				flat_bvh_checks(objects);
+			});
+
+			it("generates the same coarse collision pairs as the pointer-based BVH", []() {
+				std::vector<phys::bounding_sphere> spheres = seeded_spheres(2000, 50.0_r, 2.0_r, 1234);
+				sphere_bvh objects{};
+				sphere_flat_bvh flat_objects{};
+
+				for (size_t i = 0; i < spheres.size(); i++) {
+					objects.insert((int)i + 1, spheres[i]);
+					flat_objects.insert((int)i + 1, spheres[i]);
+				}
+
+				std::vector<sphere_bvh::coarse_collision_pair> pairs{};
+				std::vector<sphere_flat_bvh::coarse_collision_pair> flat_pairs{};
+
+				objects.generate_coarse_collisions(pairs);
+				flat_objects.generate_coarse_collisions(flat_pairs);
+
+				expect(flat_pairs.size()).to_be(pairs.size());
+
+				if (sorted_id_pairs(pairs) != sorted_id_pairs(flat_pairs)) {
+					fail("expected both BVHs to generate the same coarse collision pairs");
+				}
+			});
+
+			it("finds every object that overlaps a volume", []() {
+				std::vector<phys::bounding_sphere> spheres = seeded_spheres(2000, 50.0_r, 2.0_r, 4321);
+				std::vector<phys::bounding_sphere> queries = seeded_spheres(100, 50.0_r, 8.0_r, 8765);
+				sphere_flat_bvh objects{};
+
+				objects.build(with_ids(spheres));
+
+				for (const phys::bounding_sphere &q : queries) {
+					std::vector<int> expected{};
+					std::vector<int> found{};
+
+					for (size_t i = 0; i < spheres.size(); i++) {
+						if (spheres[i].overlaps(q)) {
+							expected.push_back((int)i + 1);
+						}
+					}
+
+					objects.query(q, [&](int id) {
+						found.push_back(id);
+					});
+
+					std::sort(std::begin(found), std::end(found));
+
+					if (found != expected) {
+						fail("expected the query to find exactly the overlapping objects");
+					}
+				}
+			});
+		});
+
+		// These compare the pointer-based BVH and the flat BVH on the same scene. The
+		// test runner prints the time taken by each test.
+		describe("benchmark (2000 objects, 20 frames)", []() {
+			it("pointer-based BVH", []() {
+				std::vector<phys::bounding_sphere> spheres = seeded_spheres(2000, 50.0_r, 2.0_r, 42);
+				sphere_bvh objects{};
+
+				expect(simulate_frames(objects, spheres, 20)).naht().to_be(0);
+			});
+
+			it("flat BVH", []() {
+				std::vector<phys::bounding_sphere> spheres = seeded_spheres(2000, 50.0_r, 2.0_r, 42);
+				sphere_flat_bvh objects{};
+
+				objects.reserve(spheres.size());
+
+				expect(simulate_frames(objects, spheres, 20)).naht().to_be(0);
+			});
+
+			it("flat BVH with a margin", []() {
+				std::vector<phys::bounding_sphere> spheres = seeded_spheres(2000, 50.0_r, 2.0_r, 42);
+				sphere_flat_bvh objects(0.05_r);
+
+				objects.reserve(spheres.size());
+
+				expect(simulate_frames(objects, spheres, 20)).naht().to_be(0);
+			});
+		});
+
+		// Loads a scene and generates coarse collisions for the first frame
+		describe("benchmark (50000 boxes, scene load)", []() {
+			it("inserting objects one at a time", []() {
+				std::vector<phys::aabb> boxes = seeded_boxes(50000, 200.0_r, 42);
+				phys::flat_bvh<phys::aabb, int> objects{};
+				std::vector<phys::flat_bvh<phys::aabb, int>::coarse_collision_pair> pairs{};
+
+				objects.reserve(boxes.size());
+
+				for (size_t i = 0; i < boxes.size(); i++) {
+					objects.insert((int)i + 1, boxes[i]);
+				}
+
+				objects.generate_coarse_collisions(pairs);
+
+				expect(pairs.size()).naht().to_be(0);
+			});
+
+			it("building with the surface area heuristic", []() {
+				std::vector<std::pair<int, phys::aabb>> boxes = with_ids(seeded_boxes(50000, 200.0_r, 42));
+				phys::flat_bvh<phys::aabb, int> objects{};
+				std::vector<phys::flat_bvh<phys::aabb, int>::coarse_collision_pair> pairs{};
+
+				objects.build(boxes);
+				objects.generate_coarse_collisions(pairs);
+
+				expect(pairs.size()).naht().to_be(0);
+			});
+		});
 	});
 }
\ No newline at end of file
@@ -1,9 +1,20 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <tuple>
+#include "allocation_counter.h"
 #include "logging.h"
+#include "physics/collision/algorithms.h"
 #include "physics/collision/contact_generator.h"
+#include "physics/collision/feature_cache.h"
+#include "physics/collision/gjk.h"
 #include "physics/collision/primitives.h"
+#include "physics/collision/quickhull.h"
 #include "physics/collision/vclip.h"
+#include "physics/thread_pool.h"
 #include "platform/platform.h"
 #include "test.h"
 
@@ -24,6 +35,383 @@ namespace {
 	phys::quat make_rot(phys::real angle, const phys::vec3 &axis) {
 		return phys::quat(std::cos(angle / 2.0_r), std::sin(angle / 2.0_r) * axis);
 	}
+
+	// A prism with regular `n`-gon ends, tilted about the Z axis by `tilt` and then
+	// moved to `center`
+	phys::vclip::polyhedron make_prism(size_t n, phys::real tilt, const phys::vec3 &center) {
+		phys::vclip::polyhedron out{};
+		std::vector<size_t> bottom{};
+		std::vector<size_t> top{};
+
+		for (size_t y = 0; y < 2; y++) {
+			for (size_t i = 0; i < n; i++) {
+				const phys::real angle = 2.0_r * (phys::real)M_PI * (phys::real)i / (phys::real)n;
+				const phys::vec3 v(std::cos(angle), y ? 1.0_r : -1.0_r, std::sin(angle));
+				const phys::vec3 tilted(
+					v.x * std::cos(tilt) - v.y * std::sin(tilt),
+					v.x * std::sin(tilt) + v.y * std::cos(tilt),
+					v.z
+				);
+
+				out.add_vertex(tilted + center);
+			}
+		}
+
+		for (size_t i = 0; i < n; i++) {
+			const size_t next = (i + 1) % n;
+
+			bottom.push_back(i);
+			top.push_back(n + (n - 1 - i));
+			out.add_face_and_new_edges(phys::vclip::face({ i, n + i, n + next, next }));
+		}
+
+		out.add_face_and_new_edges(phys::vclip::face(bottom));
+		out.add_face_and_new_edges(phys::vclip::face(top));
+
+		return out;
+	}
+
+	bool same_vplanes(
+		const phys::vclip::polyhedron &compiled,
+		const phys::vclip::polyhedron &searched
+	) {
+		for (const phys::vclip::feature &f : searched.features()) {
+			if (phys::vclip::vplanes(compiled, f) != phys::vclip::vplanes(searched, f)) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Runs V-Clip from every pair of vertices and returns the number of runs that
+	// terminated
+	size_t num_terminated(const phys::vclip::polyhedron &p1, const phys::vclip::polyhedron &p2) {
+		size_t out = 0;
+
+		for (const phys::vclip::vertex &v1 : p1.vertices) {
+			for (const phys::vclip::vertex &v2 : p2.vertices) {
+				phys::vclip::algorithm_result result = phys::vclip::closest_features(p1, p2, v1, v2, 64);
+
+				out += result.state.step == phys::vclip::algorithm_step::Continue ? 0 : 1;
+			}
+		}
+
+		return out;
+	}
+
+	struct box_frame {
+		phys::vec3 center{};
+		phys::vec3 axes[3]{};
+		phys::vec3 half_size{};
+
+		box_frame(const phys::box &b) :
+			half_size(b.half_size)
+		{
+			const phys::mat4 transform = b.body->get_transform() * b.offset;
+
+			center = phys::truncate(transform[3]);
+
+			for (int i = 0; i < 3; i++) {
+				axes[i] = phys::normalize(phys::truncate(transform[i]));
+			}
+		}
+
+		phys::real radius(const phys::vec3 &axis) const {
+			return half_size.x * std::abs(phys::dot(axes[0], axis)) +
+				half_size.y * std::abs(phys::dot(axes[1], axis)) +
+				half_size.z * std::abs(phys::dot(axes[2], axis));
+		}
+	};
+
+	// Clips `points` to the half space `dot(p - pos, dir) <= 0`
+	std::vector<phys::vec3> clip_points(const std::vector<phys::vec3> &points, const phys::vec3 &pos, const phys::vec3 &dir) {
+		std::vector<phys::vec3> out{};
+
+		for (size_t i = 0; i < points.size(); i++) {
+			const phys::vec3 &p = points[i];
+			const phys::vec3 &q = points[(i + 1) % points.size()];
+			const phys::real dp = phys::dot(p - pos, dir);
+			const phys::real dq = phys::dot(q - pos, dir);
+
+			if (dp <= 0.0_r) {
+				out.push_back(p);
+			}
+
+			if ((dp < 0.0_r && dq > 0.0_r) || (dp > 0.0_r && dq < 0.0_r)) {
+				out.push_back(p + (q - p) * (dp / (dp - dq)));
+			}
+		}
+
+		return out;
+	}
+
+	// Box-box collision with the separating axis test, to compare with the V-Clip
+	// version. The boxes are tested on their 6 face axes and on the 9 axes
+	// perpendicular to an edge of each box. Face contacts are found by clipping the
+	// incident face to the reference face, and edge contacts are found between the
+	// closest points on the two edges.
+	void sat_box_box(const phys::box &a, const phys::box &b, std::vector<phys::contact> &out) {
+		const box_frame fa(a);
+		const box_frame fb(b);
+		const phys::vec3 between = fb.center - fa.center;
+
+		phys::real min_overlap = phys::infinity;
+		phys::vec3 best_axis{};
+		int best_i = -1;
+		int best_j = -1;
+
+		const auto test_axis = [&](phys::vec3 axis, int i, int j, phys::real bias) {
+			const phys::real len = std::sqrt(phys::dot(axis, axis));
+
+			if (len < 0.0001_r) {
+				return true;
+			}
+
+			axis /= len;
+
+			const phys::real dist = phys::dot(between, axis);
+			const phys::real overlap = fa.radius(axis) + fb.radius(axis) - std::abs(dist);
+
+			if (overlap < 0.0_r) {
+				return false;
+			}
+
+			if (overlap * bias < min_overlap) {
+				min_overlap = overlap * bias;
+				best_axis = dist < 0.0_r ? -axis : axis;
+				best_i = i;
+				best_j = j;
+			}
+
+			return true;
+		};
+
+		for (int i = 0; i < 3; i++) {
+			if (! test_axis(fa.axes[i], i, -1, 1.0_r)) {
+				return;
+			}
+		}
+
+		for (int j = 0; j < 3; j++) {
+			if (! test_axis(fb.axes[j], -1, j, 1.0_r)) {
+				return;
+			}
+		}
+
+		// Edge axes are only used when they're clearly better than a face axis
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++) {
+				if (! test_axis(phys::cross(fa.axes[i], fb.axes[j]), i, j, 1.05_r)) {
+					return;
+				}
+			}
+		}
+
+		// `best_axis` points from `a` to `b`
+		const phys::vec3 &n = best_axis;
+
+		if (best_i >= 0 && best_j >= 0) {
+			phys::vec3 pa = fa.center;
+			phys::vec3 pb = fb.center;
+
+			for (int k = 0; k < 3; k++) {
+				if (k != best_i) {
+					pa += fa.axes[k] * (fa.half_size[k] * (phys::dot(fa.axes[k], n) > 0.0_r ? 1.0_r : -1.0_r));
+				}
+
+				if (k != best_j) {
+					pb -= fb.axes[k] * (fb.half_size[k] * (phys::dot(fb.axes[k], n) > 0.0_r ? 1.0_r : -1.0_r));
+				}
+			}
+
+			const phys::vec3 &da = fa.axes[best_i];
+			const phys::vec3 &db = fb.axes[best_j];
+			const phys::vec3 r = pa - pb;
+			const phys::real ab = phys::dot(da, db);
+			const phys::real denom = 1.0_r - ab * ab;
+			const phys::real s = (ab * phys::dot(db, r) - phys::dot(da, r)) / denom;
+			const phys::real t = (phys::dot(db, r) - ab * phys::dot(da, r)) / denom;
+			const phys::vec3 point = ((pa + da * s) + (pb + db * t)) / 2.0_r;
+
+			out.push_back(phys::contact(a.body, b.body, point, n, min_overlap / 1.05_r));
+			return;
+		}
+
+		const bool is_ref_on_a = best_i >= 0;
+		const box_frame &ref = is_ref_on_a ? fa : fb;
+		const box_frame &inc = is_ref_on_a ? fb : fa;
+		const int ref_axis = is_ref_on_a ? best_i : best_j;
+		// Points out of the reference face, towards the incident box
+		const phys::vec3 ref_n = is_ref_on_a ? n : -n;
+		const phys::real ref_sign = phys::dot(ref.axes[ref_axis], ref_n) > 0.0_r ? 1.0_r : -1.0_r;
+		const phys::vec3 ref_pos = ref.center + ref.axes[ref_axis] * (ref.half_size[ref_axis] * ref_sign);
+
+		int inc_axis = 0;
+
+		for (int k = 1; k < 3; k++) {
+			if (std::abs(phys::dot(inc.axes[k], ref_n)) > std::abs(phys::dot(inc.axes[inc_axis], ref_n))) {
+				inc_axis = k;
+			}
+		}
+
+		const phys::real inc_sign = phys::dot(inc.axes[inc_axis], ref_n) > 0.0_r ? -1.0_r : 1.0_r;
+		const phys::vec3 inc_pos = inc.center + inc.axes[inc_axis] * (inc.half_size[inc_axis] * inc_sign);
+		const phys::vec3 u = inc.axes[(inc_axis + 1) % 3] * inc.half_size[(inc_axis + 1) % 3];
+		const phys::vec3 v = inc.axes[(inc_axis + 2) % 3] * inc.half_size[(inc_axis + 2) % 3];
+		std::vector<phys::vec3> points{ inc_pos + u + v, inc_pos - u + v, inc_pos - u - v, inc_pos + u - v };
+
+		for (int k = 0; k < 3; k++) {
+			if (k == ref_axis) {
+				continue;
+			}
+
+			const phys::vec3 &side = ref.axes[k];
+
+			points = clip_points(points, ref.center + side * ref.half_size[k], side);
+			points = clip_points(points, ref.center - side * ref.half_size[k], -side);
+		}
+
+		for (const phys::vec3 &p : points) {
+			const phys::real depth = phys::dot(ref_pos - p, ref_n);
+
+			if (depth >= 0.0_r) {
+				out.push_back(phys::contact(a.body, b.body, p + ref_n * (depth / 2.0_r), n, depth));
+			}
+		}
+	}
+
+	// Pairs of boxes resting on top of each other, each turned a little differently
+	struct box_pair_scene {
+		std::vector<std::unique_ptr<phys::rigid_body>> bodies{};
+		std::vector<std::unique_ptr<phys::box>> boxes{};
+
+		explicit box_pair_scene(size_t num_pairs) {
+			for (size_t i = 0; i < num_pairs; i++) {
+				const phys::real x = (phys::real)i * 3.0_r;
+				const phys::real angle = (phys::real)i * 0.1_r;
+
+				add(phys::vec3(x, 0.0_r, 0.0_r), phys::identity<phys::quat>());
+				add(phys::vec3(x, 0.99_r, 0.0_r), make_rot(angle, phys::vec3(0.0_r, 1.0_r, 0.0_r)));
+			}
+		}
+
+		void add(const phys::vec3 &pos, const phys::quat &rot) {
+			bodies.push_back(std::make_unique<phys::rigid_body>());
+			bodies.back()->pos = pos;
+			bodies.back()->rot = rot;
+			bodies.back()->calculate_derived_data();
+			boxes.push_back(std::make_unique<phys::box>(bodies.back().get(), phys::identity<phys::mat4>(), phys::vec3(0.5_r)));
+		}
+
+		// Rocks the top boxes a little, as if they were settling
+		void step(size_t frame) {
+			for (size_t i = 1; i < bodies.size(); i += 2) {
+				const phys::real t = (phys::real)frame * 0.1_r + (phys::real)i;
+
+				bodies[i]->pos.x = bodies[i - 1]->pos.x + 0.01_r * std::sin(t);
+				bodies[i]->calculate_derived_data();
+			}
+		}
+
+		template <typename Func>
+		size_t run(size_t num_frames, Func collide) {
+			size_t num_contacts = 0;
+
+			for (size_t frame = 0; frame < num_frames; frame++) {
+				step(frame);
+
+				for (size_t i = 0; i < boxes.size(); i += 2) {
+					num_contacts += collide(*boxes[i], *boxes[i + 1]);
+				}
+			}
+
+			return num_contacts;
+		}
+	};
+
+	// Points scattered through a ball
+	std::vector<phys::vec3> points_in_ball(size_t num_points, phys::real radius, unsigned int seed) {
+		std::mt19937 gen(seed);
+		std::uniform_real_distribution<phys::real> distrib(-1.0_r, 1.0_r);
+		std::vector<phys::vec3> out{};
+
+		while (out.size() < num_points) {
+			const phys::vec3 p(distrib(gen), distrib(gen), distrib(gen));
+
+			if (phys::dot(p, p) <= 1.0_r) {
+				out.push_back(p * radius);
+			}
+		}
+
+		return out;
+	}
+
+	// Points scattered over a sphere. Many of them are almost in the same plane as
+	// their neighbors on the hull.
+	std::vector<phys::vec3> points_on_sphere(size_t num_points, phys::real radius, unsigned int seed) {
+		std::vector<phys::vec3> out = points_in_ball(num_points, 1.0_r, seed);
+
+		for (phys::vec3 &p : out) {
+			p = phys::normalize(p) * radius;
+		}
+
+		return out;
+	}
+
+	// A grid of `n` by `n` by `n` points that fills a box, in a random order. Many of
+	// the points are on the box's faces and edges.
+	std::vector<phys::vec3> box_grid_points(const phys::vec3 &half_size, size_t n, const phys::quat &rot) {
+		std::vector<phys::vec3> out{};
+
+		for (size_t x = 0; x < n; x++) {
+			for (size_t y = 0; y < n; y++) {
+				for (size_t z = 0; z < n; z++) {
+					const phys::vec3 t = phys::vec3((phys::real)x, (phys::real)y, (phys::real)z) / (phys::real)(n - 1);
+
+					out.push_back(rot * ((t * 2.0_r - phys::vec3(1.0_r)) * half_size));
+				}
+			}
+		}
+
+		std::shuffle(std::begin(out), std::end(out), std::mt19937(3));
+
+		return out;
+	}
+
+	// Furthest distance of any point in front of any face of `p`
+	phys::real distance_between(const phys::vec3 &a, const phys::vec3 &b) {
+		return std::sqrt(phys::dot(a - b, a - b));
+	}
+
+	phys::real max_dist_outside(const phys::vclip::polyhedron &p, const std::vector<phys::vec3> &points) {
+		phys::real out = -phys::infinity;
+
+		for (const phys::vclip::face &f : p.faces) {
+			const phys::vec3 n = f.normal(p);
+			const phys::vec3 &on_face = p.vertices[f.vert(0)].v;
+
+			for (const phys::vec3 &point : points) {
+				out = std::max(out, phys::dot(point - on_face, n));
+			}
+		}
+
+		return out;
+	}
+
+	std::vector<phys::vec3> sorted_vertices(const phys::vclip::polyhedron &p) {
+		std::vector<phys::vec3> out{};
+
+		for (const phys::vclip::vertex &v : p.vertices) {
+			out.push_back(v.v);
+		}
+
+		std::sort(std::begin(out), std::end(out), [](const phys::vec3 &a, const phys::vec3 &b) {
+			return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+		});
+
+		return out;
+	}
 }
 
 void setup_collision_tests() {
@@ -924,17 +1312,1062 @@ void setup_collision_tests() {
 						phys::vec3(1.0_r)
 					);
 
-					collider.generate_contacts(s, b, contacts);
+					collider.generate_contacts(s, b, contacts);
+
+					expect(contacts).to_have_size(1).annd()
+						.to_have_item(phys::contact(
+							&sphere_body_1,
+							&box_body_1,
+							phys::vec3(5.0_r, 5.0_r + std::sqrt(2.0_r) / 2.0_r, std::sqrt(2.0_r) / 2.0_r),
+							phys::normalize(phys::vec3(0.0_r, -1.0_r, -1.0_r)),
+							1.0_r + 1.5_r * (1.0_r - std::sqrt(2.0_r))
+						));
+				});
+			});
+		});
+
+		describe("between a box and a box", []() {
+			// The benchmarks call the algorithms directly, without a contact_generator to
+			// set them up
+			before_all([&]() {
+				phys::algorithms::init_algorithms();
+			});
+
+			after_each([&]() {
+				contacts.clear();
+				box_body_1 = {};
+				box_body_2 = {};
+			});
+
+			it("does not generate contacts for boxes that are apart", [&]() {
+				box_body_2.pos = phys::vec3(0.5_r, 2.5_r, 0.0_r);
+				box_body_2.rot = make_rot(0.3_r, phys::vec3(0.0_r, 0.0_r, 1.0_r));
+				box_body_1.calculate_derived_data();
+				box_body_2.calculate_derived_data();
+
+				collider.generate_contacts(box_1, box_2, contacts);
+
+				expect(contacts).to_have_size(0);
+			});
+
+			it("does not generate contacts for boxes whose closest features are a vertex and an edge", [&]() {
+				box_body_2.pos = phys::vec3(2.0_r, 2.5_r, 0.3_r);
+				box_body_2.rot = make_rot(0.3_r, phys::vec3(0.0_r, 1.0_r, 0.0_r)) *
+					make_rot(0.5_r, phys::vec3(0.0_r, 0.0_r, 1.0_r));
+				box_body_1.calculate_derived_data();
+				box_body_2.calculate_derived_data();
+
+				const phys::vclip::polyhedron p1 = box_1.to_polyhedron();
+				const phys::vclip::polyhedron p2 = box_2.to_polyhedron();
+				const phys::vclip::algorithm_result result = phys::vclip::closest_features(
+					p1,
+					p2,
+					p1.vertices[0],
+					p2.vertices[0]
+				);
+				const bool is_vertex_edge =
+					(std::holds_alternative<phys::vclip::vertex>(result.state.f1) && std::holds_alternative<phys::vclip::edge>(result.state.f2)) ||
+					(std::holds_alternative<phys::vclip::edge>(result.state.f1) && std::holds_alternative<phys::vclip::vertex>(result.state.f2));
+
+				expect(result.state.step).to_be(phys::vclip::algorithm_step::Done);
+				expect(is_vertex_edge).to_be(true);
+
+				collider.generate_contacts(box_1, box_2, contacts);
+				collider.generate_contacts(box_2, box_1, contacts);
+
+				expect(contacts).to_have_size(0);
+			});
+
+			it("generates a contact at each corner of a box resting on a box", [&]() {
+				box_body_2.pos.y = 1.75_r;
+				box_body_1.calculate_derived_data();
+				box_body_2.calculate_derived_data();
+
+				collider.generate_contacts(box_1, box_2, contacts);
+
+				const phys::vec3 up(0.0_r, 1.0_r, 0.0_r);
+
+				expect(contacts).to_have_size(4).annd()
+					.to_have_item(phys::contact(&box_body_1, &box_body_2, phys::vec3(1.0_r, 0.875_r, 1.0_r), up, 0.25_r)).annd()
+					.to_have_item(phys::contact(&box_body_1, &box_body_2, phys::vec3(1.0_r, 0.875_r, -1.0_r), up, 0.25_r)).annd()
+					.to_have_item(phys::contact(&box_body_1, &box_body_2, phys::vec3(-1.0_r, 0.875_r, 1.0_r), up, 0.25_r)).annd()
+					.to_have_item(phys::contact(&box_body_1, &box_body_2, phys::vec3(-1.0_r, 0.875_r, -1.0_r), up, 0.25_r));
+			});
+
+			it("points the normal from the first box to the second", [&]() {
+				box_body_2.pos.y = 1.75_r;
+				box_body_1.calculate_derived_data();
+				box_body_2.calculate_derived_data();
+
+				collider.generate_contacts(box_2, box_1, contacts);
+
+				expect(contacts).to_have_size(4);
+
+				for (const phys::contact &c : contacts) {
+					expect(c.a).to_be(&box_body_2);
+					expect(c.b).to_be(&box_body_1);
+					expect(c.normal).to_be(phys::vec3(0.0_r, -1.0_r, 0.0_r));
+					expect(c.penetration).to_be(0.25_r);
+				}
+			});
+
+			it("clips the incident face to the reference face", [&]() {
+				box_body_2.pos.y = 1.9_r;
+				box_body_2.rot = make_rot((phys::real)M_PI / 4.0_r, phys::vec3(0.0_r, 1.0_r, 0.0_r));
+				box_body_1.calculate_derived_data();
+				box_body_2.calculate_derived_data();
+
+				collider.generate_contacts(box_1, box_2, contacts);
+
+				expect(contacts).to_have_size(8);
+
+				for (const phys::contact &c : contacts) {
+					expect(c.normal).to_be(phys::vec3(0.0_r, 1.0_r, 0.0_r));
+					expect(std::abs(c.penetration - 0.1_r)).to_be_less_than(0.0001_r);
+					expect(std::abs(c.point.x)).to_be_less_than(1.0001_r);
+					expect(std::abs(c.point.z)).to_be_less_than(1.0001_r);
+				}
+			});
+
+			it("generates the same contacts as the separating axis test for resting boxes", [&]() {
+				box_pair_scene scene(20);
+				std::vector<phys::contact> expected{};
+
+				scene.step(3);
+
+				for (size_t i = 0; i < scene.boxes.size(); i += 2) {
+					phys::box &a = *scene.boxes[i];
+					phys::box &b = *scene.boxes[i + 1];
+
+					expected.clear();
+					collider.generate_contacts(a, b, contacts);
+					sat_box_box(a, b, expected);
+
+					expect(contacts.size()).to_be(expected.size());
+
+					for (const phys::contact &c : expected) {
+						const bool found = std::any_of(std::begin(contacts), std::end(contacts), [&](const phys::contact &d) {
+							return std::abs(phys::dot(d.point - c.point, d.point - c.point)) < 0.000001_r &&
+								std::abs(d.penetration - c.penetration) < 0.0001_r &&
+								phys::dot(d.normal, c.normal) > 0.9999_r;
+						});
+
+						if (! found) {
+							fail("expected a contact like the one found by the separating axis test for pair " + std::to_string(i / 2));
+						}
+					}
+
+					contacts.clear();
+				}
+			});
+
+			it("generates the same contacts when starting from last frame's features", [&]() {
+				box_body_2.pos = phys::vec3(0.2_r, 1.9_r, -0.1_r);
+				box_body_2.rot = make_rot(0.4_r, phys::vec3(0.0_r, 1.0_r, 0.0_r));
+				box_body_1.calculate_derived_data();
+				box_body_2.calculate_derived_data();
+
+				phys::feature_cache cache{};
+				phys::collision_algorithm_func cached = phys::algorithms::cached_box_box_collision(cache);
+				std::vector<phys::contact> cached_contacts{};
+
+				for (size_t frame = 0; frame < 3; frame++) {
+					contacts.clear();
+					cached_contacts.clear();
+
+					cache.begin_frame();
+					collider.generate_contacts(box_1, box_2, contacts);
+					cached(box_1, box_2, cached_contacts);
+					cache.end_frame();
+
+					expect(cached_contacts).to_have_size(contacts.size());
+
+					for (const phys::contact &c : contacts) {
+						expect(cached_contacts).to_have_item(c);
+					}
+				}
+
+				expect(cache.get_stats().hits).to_be(2);
+			});
+
+			// The test runner prints the time taken by each test
+			describe("benchmark (1000 pairs of resting boxes, 100 frames)", []() {
+				it("V-Clip", []() {
+					box_pair_scene scene(1000);
+					phys::contact_container out{};
+
+					size_t num_contacts = scene.run(100, [&](phys::box &a, phys::box &b) {
+						out.clear();
+						phys::algorithms::box_box_collision(a, b, out);
+
+						return out.size();
+					});
+
+					expect(num_contacts).naht().to_be(0);
+				});
+
+				it("V-Clip from last frame's features", []() {
+					box_pair_scene scene(1000);
+					phys::feature_cache cache{};
+					phys::collision_algorithm_func cached = phys::algorithms::cached_box_box_collision(cache);
+					phys::contact_container out{};
+
+					size_t num_contacts = scene.run(100, [&](phys::box &a, phys::box &b) {
+						// A new frame starts at the first pair
+						if (&a == scene.boxes[0].get()) {
+							cache.end_frame();
+							cache.begin_frame();
+						}
+
+						out.clear();
+						cached(a, b, out);
+
+						return out.size();
+					});
+
+					expect(num_contacts).naht().to_be(0);
+				});
+
+				it("separating axis test", []() {
+					box_pair_scene scene(1000);
+					phys::contact_container out{};
+
+					size_t num_contacts = scene.run(100, [&](phys::box &a, phys::box &b) {
+						out.clear();
+						sat_box_box(a, b, out);
+
+						return out.size();
+					});
+
+					expect(num_contacts).naht().to_be(0);
+				});
+
+				it("GJK and EPA", []() {
+					box_pair_scene scene(1000);
+					phys::contact_container out{};
+
+					size_t num_contacts = scene.run(100, [&](phys::box &a, phys::box &b) {
+						out.clear();
+						phys::algorithms::gjk_collision(a, b, out);
+
+						return out.size();
+					});
+
+					expect(num_contacts).naht().to_be(0);
+				});
+			});
+		});
+
+		describe("between a box and a convex hull", []() {
+			after_each([&]() {
+				contacts.clear();
+				box_body_1 = {};
+				box_body_2 = {};
+			});
+
+			it("generates the same contacts as two boxes", [&]() {
+				const std::vector<phys::vec3> corners = box_grid_points(phys::vec3(1.0_r), 2, phys::identity<phys::quat>());
+				phys::convex_hull hull(&box_body_2, phys::identity<phys::mat4>(), corners);
+				std::vector<phys::contact> hull_contacts{};
+
+				const phys::vec3 positions[] = {
+					phys::vec3(0.0_r, 1.75_r, 0.0_r),
+					phys::vec3(0.5_r, 1.9_r, -0.3_r),
+					phys::vec3(1.2_r, 1.5_r, 0.0_r)
+				};
+
+				for (const phys::vec3 &pos : positions) {
+					box_body_2.pos = pos;
+					box_body_2.rot = make_rot(0.4_r, phys::vec3(0.0_r, 1.0_r, 0.0_r));
+					box_body_1.calculate_derived_data();
+					box_body_2.calculate_derived_data();
+
+					contacts.clear();
+					hull_contacts.clear();
+					collider.generate_contacts(box_1, box_2, contacts);
+					collider.generate_contacts(box_1, hull, hull_contacts);
+
+					expect(contacts).naht().to_have_size(0);
+					expect(hull_contacts).to_have_size(contacts.size());
+
+					for (const phys::contact &c : contacts) {
+						expect(hull_contacts).to_have_item(c);
+					}
+				}
+			});
+
+			it("does not generate contacts for a hull that is apart from a box", [&]() {
+				phys::convex_hull hull(&box_body_2, phys::identity<phys::mat4>(), points_in_ball(200, 1.0_r, 5));
+
+				box_body_2.pos = phys::vec3(0.5_r, 2.1_r, 0.0_r);
+				box_body_1.calculate_derived_data();
+				box_body_2.calculate_derived_data();
+
+				collider.generate_contacts(box_1, hull, contacts);
+
+				expect(contacts).to_have_size(0);
+			});
+
+			it("generates contacts between a hull and a plane", [&]() {
+				const std::vector<phys::vec3> corners = box_grid_points(phys::vec3(1.0_r), 2, phys::identity<phys::quat>());
+				phys::convex_hull hull(&box_body_2, phys::identity<phys::mat4>(), corners);
+				phys::plane ground(&box_body_1, phys::vec3(0.0_r, 1.0_r, 0.0_r), 0.0_r);
+
+				box_body_2.pos.y = 0.9_r;
+				box_body_2.calculate_derived_data();
+
+				collider.generate_contacts(ground, hull, contacts);
+
+				expect(contacts).to_have_size(4);
+
+				for (const phys::contact &c : contacts) {
+					expect(c.penetration).to_be_less_than(0.1001_r);
+					expect(c.penetration).naht().to_be_less_than(0.0999_r);
+				}
+			});
+
+			it("has bounds around its vertices", [&]() {
+				phys::convex_hull hull(&box_body_2, phys::identity<phys::mat4>(), points_in_ball(500, 1.0_r, 9));
+
+				box_body_2.pos = phys::vec3(3.0_r, 0.0_r, 0.0_r);
+				box_body_2.rot = make_rot(0.7_r, phys::vec3(0.0_r, 0.0_r, 1.0_r));
+				box_body_2.calculate_derived_data();
+
+				const phys::aabb bounds = hull.get_bounds();
+
+				for (const phys::vclip::vertex &v : hull.to_polyhedron().vertices) {
+					expect(bounds.contains(phys::aabb(v.v, v.v))).to_be(true);
+				}
+
+				expect(bounds.min.x).naht().to_be_less_than(1.9_r);
+				expect(bounds.max.x).to_be_less_than(4.1_r);
+			});
+		});
+
+		describe("between a capsule and another shape", []() {
+			// Compared against gjk_collision, which is called directly
+			before_all([&]() {
+				phys::algorithms::init_algorithms();
+			});
+
+			after_each([&]() {
+				contacts.clear();
+				sphere_body_1 = {};
+				sphere_body_2 = {};
+				box_body_1 = {};
+				box_body_2 = {};
+			});
+
+			it("generates a contact for a sphere touching the side of a capsule", [&]() {
+				phys::capsule c(&box_body_1, phys::identity<phys::mat4>(), 0.5_r, 1.0_r);
+				phys::sphere s(&sphere_body_1, phys::identity<phys::mat4>(), 1.0_r);
+
+				sphere_body_1.pos = phys::vec3(1.2_r, 0.3_r, 0.0_r);
+				box_body_1.calculate_derived_data();
+
+				collider.generate_contacts(c, s, contacts);
+
+				expect(contacts).to_have_size(1);
+				expect(contacts[0].a).to_be(&sphere_body_1);
+				expect(contacts[0].b).to_be(&box_body_1);
+				expect(distance_between(contacts[0].normal, phys::vec3(-1.0_r, 0.0_r, 0.0_r))).to_be_less_than(0.0001_r);
+				expect(std::abs(contacts[0].penetration - 0.3_r)).to_be_less_than(0.0001_r);
+			});
+
+			it("generates a contact for a sphere touching the end of a capsule", [&]() {
+				phys::capsule c(&box_body_1, phys::identity<phys::mat4>(), 0.5_r, 1.0_r);
+				phys::sphere s(&sphere_body_1, phys::identity<phys::mat4>(), 1.0_r);
+
+				sphere_body_1.pos = phys::vec3(0.0_r, 2.3_r, 0.0_r);
+				box_body_1.calculate_derived_data();
+
+				collider.generate_contacts(s, c, contacts);
+
+				expect(contacts).to_have_size(1);
+				expect(distance_between(contacts[0].normal, phys::vec3(0.0_r, -1.0_r, 0.0_r))).to_be_less_than(0.0001_r);
+				expect(std::abs(contacts[0].penetration - 0.2_r)).to_be_less_than(0.0001_r);
+			});
+
+			it("generates a contact at each end of a capsule lying on a plane", [&]() {
+				phys::capsule c(&box_body_2, phys::identity<phys::mat4>(), 0.5_r, 1.0_r);
+				phys::plane ground(&box_body_1, phys::vec3(0.0_r, 1.0_r, 0.0_r), 0.0_r);
+
+				box_body_2.pos.y = 0.4_r;
+				box_body_2.rot = make_rot((phys::real)M_PI / 2.0_r, phys::vec3(0.0_r, 0.0_r, 1.0_r));
+				box_body_2.calculate_derived_data();
+
+				collider.generate_contacts(ground, c, contacts);
+
+				expect(contacts).to_have_size(2);
+
+				for (const phys::contact &ct : contacts) {
+					expect(ct.a).to_be(&box_body_2);
+					expect(distance_between(ct.normal, phys::vec3(0.0_r, -1.0_r, 0.0_r))).to_be_less_than(0.0001_r);
+					expect(std::abs(ct.penetration - 0.1_r)).to_be_less_than(0.0001_r);
+					expect(std::abs(std::abs(ct.point.x) - 1.0_r)).to_be_less_than(0.0001_r);
+				}
+			});
+
+			it("generates one contact for a capsule standing on a plane", [&]() {
+				phys::capsule c(&box_body_2, phys::identity<phys::mat4>(), 0.5_r, 1.0_r);
+				phys::plane ground(&box_body_1, phys::vec3(0.0_r, 1.0_r, 0.0_r), 0.0_r);
+
+				box_body_2.pos.y = 1.4_r;
+				box_body_2.calculate_derived_data();
+
+				collider.generate_contacts(c, ground, contacts);
+
+				expect(contacts).to_have_size(1);
+				expect(std::abs(contacts[0].penetration - 0.1_r)).to_be_less_than(0.0001_r);
+				expect(distance_between(contacts[0].point, phys::vec3(0.0_r, -0.1_r, 0.0_r))).to_be_less_than(0.0001_r);
+			});
+
+			it("generates a contact between crossed capsules", [&]() {
+				phys::capsule a(&box_body_1, phys::identity<phys::mat4>(), 0.5_r, 1.0_r);
+				phys::capsule b(&box_body_2, phys::identity<phys::mat4>(), 0.5_r, 1.0_r);
+
+				box_body_1.rot = make_rot((phys::real)M_PI / 2.0_r, phys::vec3(0.0_r, 0.0_r, 1.0_r));
+				box_body_2.rot = make_rot((phys::real)M_PI / 2.0_r, phys::vec3(1.0_r, 0.0_r, 0.0_r));
+				box_body_2.pos.y = 0.9_r;
+				box_body_1.calculate_derived_data();
+				box_body_2.calculate_derived_data();
+
+				collider.generate_contacts(a, b, contacts);
+
+				expect(contacts).to_have_size(1);
+				expect(distance_between(contacts[0].normal, phys::vec3(0.0_r, 1.0_r, 0.0_r))).to_be_less_than(0.0001_r);
+				expect(std::abs(contacts[0].penetration - 0.1_r)).to_be_less_than(0.0001_r);
+				expect(distance_between(contacts[0].point, phys::vec3(0.0_r, 0.45_r, 0.0_r))).to_be_less_than(0.0001_r);
+			});
+
+			it("generates two contacts for capsules lying side by side", [&]() {
+				phys::capsule a(&box_body_1, phys::identity<phys::mat4>(), 0.5_r, 1.0_r);
+				phys::capsule b(&box_body_2, phys::identity<phys::mat4>(), 0.5_r, 1.0_r);
+
+				box_body_1.rot = make_rot((phys::real)M_PI / 2.0_r, phys::vec3(0.0_r, 0.0_r, 1.0_r));
+				box_body_2.rot = box_body_1.rot;
+				box_body_2.pos = phys::vec3(0.5_r, 0.9_r, 0.0_r);
+				box_body_1.calculate_derived_data();
+				box_body_2.calculate_derived_data();
+
+				collider.generate_contacts(a, b, contacts);
+
+				expect(contacts).to_have_size(2);
+
+				for (const phys::contact &ct : contacts) {
+					expect(distance_between(ct.normal, phys::vec3(0.0_r, 1.0_r, 0.0_r))).to_be_less_than(0.0001_r);
+					expect(std::abs(ct.penetration - 0.1_r)).to_be_less_than(0.0001_r);
+				}
+
+				expect(std::abs(contacts[0].point.x - contacts[1].point.x)).naht().to_be_less_than(1.4999_r);
+			});
+
+			it("generates a contact at each end of a capsule lying on a box", [&]() {
+				phys::capsule c(&box_body_2, phys::identity<phys::mat4>(), 0.5_r, 0.5_r);
+
+				box_body_2.pos = phys::vec3(0.2_r, 1.4_r, 0.3_r);
+				box_body_2.rot = make_rot((phys::real)M_PI / 2.0_r, phys::vec3(0.0_r, 0.0_r, 1.0_r));
+				box_body_1.calculate_derived_data();
+				box_body_2.calculate_derived_data();
+
+				collider.generate_contacts(box_1, c, contacts);
+
+				expect(contacts).to_have_size(2);
+
+				for (const phys::contact &ct : contacts) {
+					expect(ct.a).to_be(&box_body_1);
+					expect(distance_between(ct.normal, phys::vec3(0.0_r, 1.0_r, 0.0_r))).to_be_less_than(0.0001_r);
+					expect(std::abs(ct.penetration - 0.1_r)).to_be_less_than(0.0001_r);
+					expect(std::abs(ct.point.y - 1.0_r)).to_be_less_than(0.0001_r);
+				}
+			});
+
+			it("generates a contact for a capsule across the edge of a box", [&]() {
+				phys::capsule c(&box_body_2, phys::identity<phys::mat4>(), 0.5_r, 1.0_r);
+
+				// Perpendicular to the edge and to the normal
+				box_body_2.pos = phys::vec3(1.2_r, 1.2_r, 0.0_r);
+				box_body_2.rot = make_rot((phys::real)M_PI / 4.0_r, phys::vec3(0.0_r, 0.0_r, 1.0_r));
+				box_body_1.calculate_derived_data();
+				box_body_2.calculate_derived_data();
+
+				collider.generate_contacts(box_1, c, contacts);
+
+				const phys::vec3 normal = phys::normalize(phys::vec3(1.0_r, 1.0_r, 0.0_r));
+
+				expect(contacts).to_have_size(1);
+				expect(distance_between(contacts[0].normal, normal)).to_be_less_than(0.0001_r);
+				expect(std::abs(contacts[0].penetration - (0.5_r - std::sqrt(0.08_r)))).to_be_less_than(0.0001_r);
+				expect(std::abs(contacts[0].point.x - 1.0_r)).to_be_less_than(0.0001_r);
+				expect(std::abs(contacts[0].point.y - 1.0_r)).to_be_less_than(0.0001_r);
+			});
+
+			it("finds the penetration of a capsule whose segment is inside a box", [&]() {
+				phys::capsule c(&box_body_2, phys::identity<phys::mat4>(), 0.5_r, 0.5_r);
+
+				box_body_2.pos = phys::vec3(0.0_r, 1.2_r, 0.0_r);
+				box_body_1.calculate_derived_data();
+				box_body_2.calculate_derived_data();
+
+				collider.generate_contacts(box_1, c, contacts);
+
+				expect(contacts).to_have_size(1);
+				expect(phys::dot(contacts[0].normal, phys::vec3(0.0_r, 1.0_r, 0.0_r))).naht().to_be_less_than(0.999_r);
+				expect(std::abs(contacts[0].penetration - 0.8_r)).to_be_less_than(0.001_r);
+			});
+
+			it("finds the same deepest contact as GJK and EPA", [&]() {
+				std::mt19937 gen(17);
+				std::uniform_real_distribution<phys::real> distrib(-1.0_r, 1.0_r);
+				phys::capsule a(&sphere_body_1, phys::identity<phys::mat4>(), 0.4_r, 0.8_r);
+				phys::capsule b(&sphere_body_2, phys::identity<phys::mat4>(), 0.3_r, 0.6_r);
+				phys::capsule c(&box_body_2, phys::identity<phys::mat4>(), 0.5_r, 0.7_r);
+				std::vector<phys::contact> expected{};
+				size_t num_compared = 0;
+
+				const auto random_rot = [&]() {
+					return make_rot(distrib(gen) * (phys::real)M_PI, phys::normalize(phys::vec3(distrib(gen), distrib(gen), distrib(gen))));
+				};
+
+				const auto compare = [&](phys::primitive &p_1, phys::primitive &p_2) {
+					contacts.clear();
+					expected.clear();
+					collider.generate_contacts(p_1, p_2, contacts);
+					phys::algorithms::gjk_collision(p_1, p_2, expected);
+
+					expect(contacts.empty()).to_be(expected.empty());
+
+					if (contacts.empty()) {
+						return;
+					}
+
+					const phys::contact &deepest = *std::max_element(std::begin(contacts), std::end(contacts), [](const phys::contact &x, const phys::contact &y) {
+						return x.penetration < y.penetration;
+					});
+
+					expect(std::abs(deepest.penetration - expected[0].penetration)).to_be_less_than(0.001_r);
+					expect(phys::dot(deepest.normal, expected[0].normal)).naht().to_be_less_than(0.999_r);
+					num_compared++;
+				};
+
+				for (size_t i = 0; i < 50; i++) {
+					sphere_body_1.pos = phys::vec3(distrib(gen), distrib(gen), distrib(gen)) * 0.5_r;
+					sphere_body_1.rot = random_rot();
+					sphere_body_2.pos = phys::vec3(distrib(gen), distrib(gen), distrib(gen)) * 0.5_r;
+					sphere_body_2.rot = random_rot();
+					sphere_body_1.calculate_derived_data();
+					sphere_body_2.calculate_derived_data();
+
+					compare(a, b);
+
+					box_body_2.pos = phys::vec3(distrib(gen), distrib(gen), distrib(gen)) * 2.0_r;
+					box_body_2.rot = random_rot();
+					box_body_1.calculate_derived_data();
+					box_body_2.calculate_derived_data();
+
+					compare(box_1, c);
+				}
+
+				expect(num_compared).naht().to_be_less_than(50);
+			});
+
+			// The test runner prints the time taken by each test
+			describe("benchmark (1000 pairs of crossed capsules, 100 frames)", []() {
+				const auto run = [](const phys::collision_algorithm_func &collide) {
+					std::vector<std::unique_ptr<phys::rigid_body>> bodies{};
+					std::vector<std::unique_ptr<phys::capsule>> capsules{};
+					phys::contact_container out{};
+					size_t num_contacts = 0;
+
+					for (size_t i = 0; i < 2000; i++) {
+						bodies.push_back(std::make_unique<phys::rigid_body>());
+						bodies.back()->pos = phys::vec3((phys::real)(i / 2) * 3.0_r, (phys::real)(i % 2) * 0.9_r, 0.0_r);
+						bodies.back()->rot = make_rot((phys::real)i * 0.1_r + 1.0_r, phys::vec3(1.0_r, 0.0_r, 0.0_r));
+						bodies.back()->calculate_derived_data();
+						capsules.push_back(std::make_unique<phys::capsule>(bodies.back().get(), phys::identity<phys::mat4>(), 0.5_r, 1.0_r));
+					}
+
+					for (size_t frame = 0; frame < 100; frame++) {
+						for (size_t i = 0; i < capsules.size(); i += 2) {
+							out.clear();
+							collide(*capsules[i], *capsules[i + 1], out);
+							num_contacts += out.size();
+						}
+					}
+
+					return num_contacts;
+				};
+
+				it("analytic", [&]() {
+					expect(run(phys::algorithms::capsule_capsule_collision)).naht().to_be(0);
+				});
+
+				it("GJK and EPA", [&]() {
+					expect(run(phys::algorithms::gjk_collision)).naht().to_be(0);
+				});
+			});
+
+			it("has bounds around its hemispheres", [&]() {
+				phys::capsule c(&box_body_2, phys::identity<phys::mat4>(), 0.5_r, 1.0_r);
+
+				box_body_2.pos = phys::vec3(3.0_r, 0.0_r, 0.0_r);
+				box_body_2.rot = make_rot((phys::real)M_PI / 2.0_r, phys::vec3(0.0_r, 0.0_r, 1.0_r));
+				box_body_2.calculate_derived_data();
+
+				const phys::aabb bounds = c.get_bounds();
+
+				expect(distance_between(bounds.min, phys::vec3(1.5_r, -0.5_r, -0.5_r))).to_be_less_than(0.0001_r);
+				expect(distance_between(bounds.max, phys::vec3(4.5_r, 0.5_r, 0.5_r))).to_be_less_than(0.0001_r);
+			});
+		});
+
+		describe("between a cylinder and another shape", []() {
+			after_each([&]() {
+				contacts.clear();
+				box_body_1 = {};
+				box_body_2 = {};
+			});
+
+			it("generates contacts around the rim of a cylinder standing on a plane", [&]() {
+				phys::cylinder c(&box_body_2, phys::identity<phys::mat4>(), 0.5_r, 1.0_r);
+				phys::plane ground(&box_body_1, phys::vec3(0.0_r, 1.0_r, 0.0_r), 0.0_r);
+
+				box_body_2.pos.y = 0.9_r;
+				box_body_2.calculate_derived_data();
+
+				collider.generate_contacts(ground, c, contacts);
+
+				expect(contacts).to_have_size(4);
+
+				for (const phys::contact &ct : contacts) {
+					expect(ct.a).to_be(&box_body_2);
+					expect(distance_between(ct.normal, phys::vec3(0.0_r, -1.0_r, 0.0_r))).to_be_less_than(0.0001_r);
+					expect(std::abs(ct.penetration - 0.1_r)).to_be_less_than(0.0001_r);
+					expect(std::abs(phys::dot(ct.point, ct.point) - (0.25_r + 0.01_r))).to_be_less_than(0.0001_r);
+				}
+			});
+
+			it("generates a contact at each end of a cylinder lying on a plane", [&]() {
+				phys::cylinder c(&box_body_2, phys::identity<phys::mat4>(), 0.5_r, 1.0_r);
+				phys::plane ground(&box_body_1, phys::vec3(0.0_r, 1.0_r, 0.0_r), 0.0_r);
+
+				box_body_2.pos.y = 0.4_r;
+				box_body_2.rot = make_rot((phys::real)M_PI / 2.0_r, phys::vec3(0.0_r, 0.0_r, 1.0_r));
+				box_body_2.calculate_derived_data();
+
+				collider.generate_contacts(c, ground, contacts);
+
+				expect(contacts).to_have_size(2);
+
+				for (const phys::contact &ct : contacts) {
+					expect(std::abs(ct.penetration - 0.1_r)).to_be_less_than(0.0001_r);
+					expect(std::abs(std::abs(ct.point.x) - 1.0_r)).to_be_less_than(0.0001_r);
+				}
+			});
+
+			it("collides with boxes, capsules, and other cylinders through GJK and EPA", [&]() {
+				phys::cylinder c(&box_body_2, phys::identity<phys::mat4>(), 0.5_r, 1.0_r);
+				phys::rigid_body other_body{};
+				phys::capsule cap(&other_body, phys::identity<phys::mat4>(), 0.5_r, 1.0_r);
+				phys::cylinder other(&other_body, phys::identity<phys::mat4>(), 0.5_r, 1.0_r);
+
+				box_body_2.pos.y = 1.9_r;
+				other_body.pos = phys::vec3(0.9_r, 1.9_r, 0.0_r);
+				box_body_1.calculate_derived_data();
+				box_body_2.calculate_derived_data();
+				other_body.calculate_derived_data();
+
+				collider.generate_contacts(box_1, c, contacts);
+				collider.generate_contacts(cap, c, contacts);
+				collider.generate_contacts(other, c, contacts);
+
+				expect(contacts).to_have_size(3);
+				expect(phys::dot(contacts[0].normal, phys::vec3(0.0_r, 1.0_r, 0.0_r))).naht().to_be_less_than(0.999_r);
+				expect(std::abs(contacts[0].penetration - 0.1_r)).to_be_less_than(0.001_r);
+
+				for (size_t i = 1; i < 3; i++) {
+					expect(phys::dot(contacts[i].normal, phys::vec3(-1.0_r, 0.0_r, 0.0_r))).naht().to_be_less_than(0.999_r);
+					expect(std::abs(contacts[i].penetration - 0.1_r)).to_be_less_than(0.001_r);
+				}
+			});
+
+			it("has bounds around its caps", [&]() {
+				phys::cylinder c(&box_body_2, phys::identity<phys::mat4>(), 0.5_r, 1.0_r);
+
+				box_body_2.rot = make_rot((phys::real)M_PI / 4.0_r, phys::vec3(0.0_r, 0.0_r, 1.0_r));
+				box_body_2.calculate_derived_data();
+
+				const phys::aabb bounds = c.get_bounds();
+				const phys::vec3 axes[] = {
+					phys::vec3(1.0_r, 0.0_r, 0.0_r),
+					phys::vec3(0.0_r, 1.0_r, 0.0_r),
+					phys::vec3(0.0_r, 0.0_r, 1.0_r)
+				};
+
+				for (const phys::vec3 &axis : axes) {
+					expect(std::abs(phys::dot(c.support(axis), axis) - phys::dot(bounds.max, axis))).to_be_less_than(0.0001_r);
+					expect(std::abs(phys::dot(c.support(-axis), axis) - phys::dot(bounds.min, axis))).to_be_less_than(0.0001_r);
+				}
+			});
+		});
+
+		describe("with GJK and EPA", []() {
+			// Some of these tests call the algorithms directly, without a contact_generator
+			// to set them up
+			before_all([&]() {
+				phys::algorithms::init_algorithms();
+			});
+
+			after_each([&]() {
+				contacts.clear();
+				sphere_body_1 = {};
+				sphere_body_2 = {};
+				box_body_1 = {};
+				box_body_2 = {};
+			});
+
+			it("finds the distance and closest points between two spheres", [&]() {
+				sphere_body_2.pos = phys::vec3(3.0_r, 0.0_r, 0.0_r);
+
+				phys::sphere a(&sphere_body_1, phys::identity<phys::mat4>(), 1.0_r);
+				phys::sphere b(&sphere_body_2, phys::identity<phys::mat4>(), 1.0_r);
+
+				const phys::gjk::distance_result result = phys::gjk::distance(a, b);
+
+				expect(result.is_intersecting).to_be(false);
+				expect(std::abs(result.dist - 1.0_r)).to_be_less_than(0.001_r);
+				expect(distance_between(result.point_a, phys::vec3(1.0_r, 0.0_r, 0.0_r))).to_be_less_than(0.01_r);
+				expect(distance_between(result.point_b, phys::vec3(2.0_r, 0.0_r, 0.0_r))).to_be_less_than(0.01_r);
+			});
+
+			it("finds the distance between two boxes that are apart", [&]() {
+				box_body_2.pos = phys::vec3(0.5_r, 2.5_r, 0.3_r);
+				box_body_1.calculate_derived_data();
+				box_body_2.calculate_derived_data();
+
+				const phys::gjk::distance_result result = phys::gjk::distance(box_1, box_2);
+
+				expect(result.is_intersecting).to_be(false);
+				expect(std::abs(result.dist - 0.5_r)).to_be_less_than(0.0001_r);
+				expect(std::abs(result.point_a.y - 1.0_r)).to_be_less_than(0.0001_r);
+				expect(std::abs(result.point_b.y - 1.5_r)).to_be_less_than(0.0001_r);
+			});
+
+			it("generates the same contact as sphere-sphere collision", [&]() {
+				sphere_body_2.pos = phys::vec3(1.2_r, 0.9_r, -0.4_r);
+
+				phys::sphere a(&sphere_body_1, phys::identity<phys::mat4>(), 1.0_r);
+				phys::sphere b(&sphere_body_2, phys::identity<phys::mat4>(), 0.7_r);
+				std::vector<phys::contact> expected{};
+
+				phys::algorithms::sphere_sphere_collision(a, b, expected);
+				phys::algorithms::gjk_collision(a, b, contacts);
+
+				expect(expected).to_have_size(1);
+				expect(contacts).to_have_size(1);
+				expect(contacts[0].a).to_be(&sphere_body_1);
+				expect(contacts[0].b).to_be(&sphere_body_2);
+				expect(phys::dot(contacts[0].normal, expected[0].normal)).naht().to_be_less_than(0.999_r);
+				expect(std::abs(contacts[0].penetration - expected[0].penetration)).to_be_less_than(0.01_r);
+				// Sphere-sphere collision puts the contact halfway between the centers, but
+				// GJK puts it halfway between the surfaces
+				const phys::vec3 surface_mid = expected[0].normal * (1.0_r - expected[0].penetration / 2.0_r);
+
+				expect(distance_between(contacts[0].point, surface_mid)).to_be_less_than(0.01_r);
+			});
+
+			it("generates the same contact as sphere-box collision", [&]() {
+				phys::sphere s(&sphere_body_1, phys::identity<phys::mat4>(), 1.0_r);
+				phys::box b(&box_body_1, phys::identity<phys::mat4>(), phys::vec3(2.0_r, 1.0_r, 2.0_r));
+				std::vector<phys::contact> expected{};
+
+				// Over a face, an edge, and a corner of the box
+				const phys::vec3 positions[] = {
+					phys::vec3(0.5_r, 1.8_r, -0.3_r),
+					phys::vec3(2.5_r, 1.5_r, 0.0_r),
+					phys::vec3(2.4_r, 1.4_r, -2.4_r)
+				};
+
+				for (const phys::vec3 &pos : positions) {
+					sphere_body_1.pos = pos;
+					expected.clear();
+					contacts.clear();
+
+					phys::algorithms::sphere_box_collision(s, b, expected);
+					phys::algorithms::gjk_collision(s, b, contacts);
+
+					expect(expected).to_have_size(1);
+					expect(contacts).to_have_size(1);
+					expect(phys::dot(contacts[0].normal, expected[0].normal)).naht().to_be_less_than(0.999_r);
+					expect(std::abs(contacts[0].penetration - expected[0].penetration)).to_be_less_than(0.001_r);
+				}
+			});
+
+			it("finds the normal and depth of a box resting on a box", [&]() {
+				box_body_2.pos = phys::vec3(0.2_r, 1.75_r, -0.1_r);
+				box_body_2.rot = make_rot(0.4_r, phys::vec3(0.0_r, 1.0_r, 0.0_r));
+				box_body_1.calculate_derived_data();
+				box_body_2.calculate_derived_data();
+
+				phys::algorithms::gjk_collision(box_1, box_2, contacts);
+
+				expect(contacts).to_have_size(1);
+				expect(phys::dot(contacts[0].normal, phys::vec3(0.0_r, 1.0_r, 0.0_r))).naht().to_be_less_than(0.9999_r);
+				expect(std::abs(contacts[0].penetration - 0.25_r)).to_be_less_than(0.0001_r);
+				expect(std::abs(contacts[0].point.y - 0.875_r)).to_be_less_than(0.0001_r);
+			});
+
+			it("does not generate a contact for shapes that are apart", [&]() {
+				phys::sphere s(&sphere_body_1, phys::identity<phys::mat4>(), 1.0_r);
+
+				sphere_body_1.pos = phys::vec3(2.2_r, 0.0_r, 0.0_r);
+				box_body_2.pos = phys::vec3(0.5_r, 2.1_r, 0.0_r);
+				box_body_1.calculate_derived_data();
+				box_body_2.calculate_derived_data();
+
+				phys::algorithms::gjk_collision(box_1, box_2, contacts);
+				phys::algorithms::gjk_collision(s, box_1, contacts);
+
+				expect(contacts).to_have_size(0);
+			});
+
+			it("can be registered for pairs that have no other algorithm", [&]() {
+				const std::vector<phys::vec3> corners = box_grid_points(phys::vec3(1.0_r), 2, phys::identity<phys::quat>());
+				phys::convex_hull hull(&box_body_1, phys::identity<phys::mat4>(), corners);
+				phys::sphere s(&sphere_body_1, phys::identity<phys::mat4>(), 1.0_r);
+				phys::contact_generator gjk_collider{};
+
+				gjk_collider.register_collision_algorithm(
+					phys::shape_type::Sphere,
+					phys::shape_type::ConvexHull,
+					phys::algorithms::gjk_collision
+				);
+
+				sphere_body_1.pos = phys::vec3(0.3_r, 1.8_r, 0.0_r);
+				box_body_1.calculate_derived_data();
+
+				gjk_collider.generate_contacts(hull, s, contacts);
+
+				expect(contacts).to_have_size(1);
+				expect(contacts[0].a).to_be(&sphere_body_1);
+				expect(phys::dot(contacts[0].normal, phys::vec3(0.0_r, -1.0_r, 0.0_r))).naht().to_be_less_than(0.9999_r);
+				expect(std::abs(contacts[0].penetration - 0.2_r)).to_be_less_than(0.0001_r);
+			});
+		});
+
+		describe("in batches", []() {
+			after_each([&]() {
+				contacts.clear();
+				sphere_body_1 = {};
+				sphere_body_2 = {};
+				box_body_1 = {};
+				box_body_2 = {};
+			});
+
+			it("generates the same contacts as colliding each pair", [&]() {
+				phys::rigid_body ground_body{};
+				phys::plane ground(&ground_body, phys::vec3(0.0_r, 1.0_r, 0.0_r), -0.5_r);
+				phys::sphere s_1(&sphere_body_1, phys::identity<phys::mat4>(), 1.0_r);
+				phys::sphere s_2(&sphere_body_2, phys::identity<phys::mat4>(), 0.5_r);
+				std::vector<phys::contact_range> ranges{};
+				std::vector<phys::contact> expected{};
+
+				sphere_body_1.pos = phys::vec3(0.5_r, 0.2_r, 1.5_r);
+				sphere_body_2.pos = phys::vec3(0.5_r, 0.2_r, 2.7_r);
+				box_body_2.pos = phys::vec3(0.3_r, 1.8_r, 0.0_r);
+				box_body_2.rot = make_rot(0.3_r, phys::vec3(0.0_r, 1.0_r, 0.0_r));
+				box_body_1.calculate_derived_data();
+				box_body_2.calculate_derived_data();
+
+				// Some pairs are in descending order of type
+				const phys::collision_pair pairs[] = {
+					{ &box_1, &ground },
+					{ &s_1, &s_2 },
+					{ &box_1, &box_2 },
+					{ &ground, &s_1 },
+					{ &box_1, &s_1 },
+					{ &s_2, &box_2 }
+				};
+
+				collider.generate_contacts(pairs, contacts, ranges);
+
+				expect(ranges).to_have_size(6);
+				expect(ranges.back().end).to_be(contacts.size());
+
+				size_t begin = 0;
+
+				for (const phys::contact_range &r : ranges) {
+					expect(r.begin).to_be(begin);
+					expect(r.b->type).naht().to_be_less_than(r.a->type);
+
+					begin = r.end;
+					expected.clear();
+					collider.generate_contacts(*r.a, *r.b, expected);
+
+					expect(r.end - r.begin).to_be(expected.size());
+
+					for (size_t i = 0; i < expected.size(); i++) {
+						expect(contacts[r.begin + i]).to_be(expected[i]);
+					}
+				}
+
+				expect(contacts.size()).naht().to_be(0);
+			});
+
+			it("calls each algorithm once with every pair of its shape types", [&]() {
+				struct batch_calls {
+					size_t num_calls{};
+					size_t num_pairs{};
+				};
+
+				phys::contact_generator counter{};
+				batch_calls calls{};
+				phys::sphere s_1(&sphere_body_1, phys::identity<phys::mat4>(), 1.0_r);
+				phys::sphere s_2(&sphere_body_2, phys::identity<phys::mat4>(), 1.0_r);
+				std::vector<phys::contact_range> ranges{};
+
+				// The boxes go through the real algorithms, so they're kept apart from each
+				// other and from the spheres
+				box_body_1.pos = phys::vec3(5.0_r, 0.0_r, 0.0_r);
+				box_body_2.pos = phys::vec3(5.0_r, 3.0_r, 0.0_r);
+				box_body_1.calculate_derived_data();
+				box_body_2.calculate_derived_data();
+
+				counter.register_collision_algorithm(
+					phys::shape_type::Sphere,
+					phys::shape_type::Sphere,
+					phys::batch_collision_algorithm{
+						[](void * ctx, std::span<const phys::collision_pair> pairs, phys::contact_container &out, std::span<size_t> ends) {
+							batch_calls * c = static_cast<batch_calls *>(ctx);
+
+							c->num_calls++;
+							c->num_pairs += pairs.size();
+
+							for (size_t &end : ends) {
+								end = out.size();
+							}
+						},
+						&calls
+					}
+				);
+
+				const phys::collision_pair pairs[] = {
+					{ &s_1, &s_2 },
+					{ &box_1, &box_2 },
+					{ &s_2, &s_1 },
+					{ &box_2, &s_1 },
+					{ &s_1, &s_2 }
+				};
+
+				counter.generate_contacts(pairs, contacts, ranges);
+
+				expect(calls.num_calls).to_be(1);
+				expect(calls.num_pairs).to_be(3);
+				expect(ranges).to_have_size(5);
+			});
+
+			it("throws for shape types that have no collision algorithm", [&]() {
+				struct custom_shape : public phys::primitive {
+					custom_shape(phys::rigid_body * _body) :
+						phys::primitive((int)phys::shape_type::Max, _body, phys::identity<phys::mat4>())
+					{}
+
+					phys::aabb get_bounds() const override {
+						return phys::aabb(body->pos, body->pos);
+					}
+				};
+
+				custom_shape custom(&sphere_body_1);
+				phys::sphere s(&sphere_body_2, phys::identity<phys::mat4>(), 1.0_r);
+				const phys::collision_pair pairs[] = {
+					{ &s, &custom }
+				};
+				std::vector<phys::contact> out{};
+				std::vector<phys::contact_range> ranges{};
+
+				try {
+					collider.generate_contacts(s, custom, out);
+					fail("Expected generate_contacts to throw");
+				} catch (const std::invalid_argument&) {}
+
+				try {
+					collider.generate_contacts(pairs, out, ranges);
+					fail("Expected generate_contacts to throw");
+				} catch (const std::invalid_argument&) {}
+
+				expect(out).to_have_size(0);
+			});
+
+			it("generates the same contacts when called from multiple threads", [&]() {
+				constexpr size_t num_batches = 8;
+
+				box_pair_scene scene(200);
+				phys::rigid_body ground_body{};
+				phys::plane ground(&ground_body, phys::vec3(0.0_r, 1.0_r, 0.0_r), 0.1_r);
+				std::vector<phys::collision_pair> pairs{};
+
+				for (size_t i = 0; i < scene.boxes.size(); i += 2) {
+					pairs.push_back(phys::collision_pair{ scene.boxes[i].get(), scene.boxes[i + 1].get() });
+					pairs.push_back(phys::collision_pair{ &ground, scene.boxes[i].get() });
+				}
+
+				const size_t batch_size = pairs.size() / num_batches;
+				std::vector<phys::contact_container> expected(num_batches);
+				std::vector<phys::contact_container> actual(num_batches);
+				std::vector<std::vector<phys::contact_range>> ranges(num_batches);
+
+				for (size_t i = 0; i < num_batches; i++) {
+					const std::span<const phys::collision_pair> batch(std::begin(pairs) + i * batch_size, batch_size);
 
-					expect(contacts).to_have_size(1).annd()
-						.to_have_item(phys::contact(
-							&sphere_body_1,
-							&box_body_1,
-							phys::vec3(5.0_r, 5.0_r + std::sqrt(2.0_r) / 2.0_r, std::sqrt(2.0_r) / 2.0_r),
-							phys::normalize(phys::vec3(0.0_r, -1.0_r, -1.0_r)),
-							1.0_r + 1.5_r * (1.0_r - std::sqrt(2.0_r))
-						));
+					collider.generate_contacts(batch, expected[i], ranges[i]);
+					ranges[i].clear();
+				}
+
+				phys::thread_pool pool(4);
+
+				pool.parallel_for(num_batches, 1, [&](size_t begin, size_t end) {
+					for (size_t i = begin; i < end; i++) {
+						const std::span<const phys::collision_pair> batch(std::begin(pairs) + i * batch_size, batch_size);
+
+						collider.generate_contacts(batch, actual[i], ranges[i]);
+					}
 				});
+
+				for (size_t i = 0; i < num_batches; i++) {
+					expect(expected[i].size()).naht().to_be(0);
+					expect(actual[i] == expected[i]).to_be(true);
+				}
+			});
+
+			it("generates the same contacts and ranges on a thread pool as on one thread", [&]() {
+				box_pair_scene scene(300);
+				phys::rigid_body ground_body{};
+				phys::plane ground(&ground_body, phys::vec3(0.0_r, 1.0_r, 0.0_r), 0.1_r);
+				phys::thread_pool pool(4);
+				std::vector<phys::collision_pair> pairs{};
+				std::vector<phys::contact_range> ranges{};
+				std::vector<phys::contact_range> parallel_ranges{};
+				phys::contact_container parallel_contacts{};
+
+				for (size_t i = 0; i < scene.boxes.size(); i += 2) {
+					pairs.push_back(phys::collision_pair{ scene.boxes[i].get(), scene.boxes[i + 1].get() });
+					pairs.push_back(phys::collision_pair{ scene.boxes[i].get(), &ground });
+				}
+
+				collider.generate_contacts(pairs, contacts, ranges);
+
+				// A grain that doesn't divide the buckets evenly
+				collider.generate_contacts(pool, pairs, parallel_contacts, parallel_ranges, 7);
+
+				expect(parallel_contacts == contacts).to_be(true);
+				expect(parallel_ranges).to_have_size(ranges.size());
+
+				for (size_t i = 0; i < ranges.size(); i++) {
+					expect(parallel_ranges[i].a).to_be(ranges[i].a);
+					expect(parallel_ranges[i].b).to_be(ranges[i].b);
+					expect(parallel_ranges[i].begin).to_be(ranges[i].begin);
+					expect(parallel_ranges[i].end).to_be(ranges[i].end);
+				}
 			});
 		});
 
@@ -3576,7 +5009,640 @@ void setup_collision_tests() {
 						}
 					}
 				});
+
+				it("stops when it goes around in a loop", [&]() {
+					// A box resting on another box, turned a little. One of the lower box's
+					// corners lies almost exactly on the boundary of a Voronoi region of the
+					// upper box, and rounding error sends V-Clip around a loop of four states.
+					const phys::vec3 upper[] = {
+						phys::vec3(0.542285979_r, 1.50085807_r, 0.447113335_r),
+						phys::vec3(0.443066508_r, 1.49955773_r, -0.54795146_r),
+						phys::vec3(0.546443939_r, 0.500867009_r, 0.448005378_r),
+						phys::vec3(0.447224468_r, 0.499566764_r, -0.547059417_r),
+						phys::vec3(-0.452770978_r, 1.49680901_r, 0.546337366_r),
+						phys::vec3(-0.551990509_r, 1.49550879_r, -0.448727429_r),
+						phys::vec3(-0.448613018_r, 0.496818006_r, 0.547229409_r),
+						phys::vec3(-0.547832549_r, 0.49551779_r, -0.447835386_r)
+					};
+
+					box_1.half_size = phys::vec3(0.5_r);
+					box_2.half_size = phys::vec3(0.5_r);
+					box_body_1.calculate_derived_data();
+					box_body_2.calculate_derived_data();
+
+					phys::vclip::polyhedron p1 = box_1.to_polyhedron();
+					phys::vclip::polyhedron p2 = box_2.to_polyhedron();
+
+					for (size_t i = 0; i < p2.vertices.size(); i++) {
+						p2.vertices[i].v = upper[i];
+					}
+
+					for (phys::vclip::face &f : p2.faces) {
+						f.invalidate_normal();
+					}
+
+					phys::vclip::algorithm_result result = phys::vclip::closest_features(
+						p1,
+						p2,
+						p1.vertices[1],
+						p2.faces[0]
+					);
+
+					expect(result.state.step).to_be(phys::vclip::algorithm_step::Continue);
+					expect(result.steps).to_be_less_than(10);
+				});
+			});
+
+			describe("compiled adjacency", []() {
+				after_each([&]() {
+					box_body_1 = {};
+					box_body_2 = {};
+					box_1.half_size = phys::vec3(1.0_r);
+					box_2.half_size = phys::vec3(1.0_r);
+				});
+
+				it("gives the same Voronoi planes as searching the polyhedron", [&]() {
+					box_body_1.rot = make_rot((phys::real)M_PI / 5.0_r, phys::vec3(0.0_r, 1.0_r, 0.0_r));
+					box_body_1.calculate_derived_data();
+					box_1.half_size = phys::vec3(1.0_r, 2.0_r, 3.0_r);
+
+					phys::vclip::polyhedron box = box_1.to_polyhedron();
+					phys::vclip::polyhedron prism = make_prism(7, 0.3_r, phys::vec3(1.0_r, 2.0_r, 3.0_r));
+					phys::vclip::polyhedron compiled_box = box;
+					phys::vclip::polyhedron compiled_prism = prism;
+
+					prism.validate();
+					compiled_box.compile_adjacency();
+					compiled_prism.compile_adjacency();
+
+					expect(box.adjacency_table == nullptr).to_be(true);
+					expect(compiled_box.adjacency_table == nullptr).to_be(false);
+					expect(same_vplanes(compiled_box, box)).to_be(true);
+					expect(same_vplanes(compiled_prism, prism)).to_be(true);
+
+					const phys::vclip::adjacency &adj = *compiled_prism.adjacency_table;
+
+					for (const phys::vclip::vertex &v : prism.vertices) {
+						std::vector<phys::vclip::edge> expected = v.edges(prism) | std::ranges::to<std::vector>();
+						std::vector<phys::vclip::edge> actual{};
+
+						for (size_t j = adj.vertex_edge_offsets[v.i]; j < adj.vertex_edge_offsets[v.i + 1]; j++) {
+							actual.push_back(prism.edges[adj.vertex_edges[j]]);
+						}
+
+						if (actual != expected) {
+							fail("expected the edges around vertex " + std::to_string(v.i) + " to be in the same order");
+						}
+					}
+
+					for (size_t f_i = 0; f_i < prism.faces.size(); f_i++) {
+						expect(adj.face_index(prism, prism.faces[f_i])).to_be(f_i);
+					}
+				});
+
+				it("is cleared when the polyhedron changes", [&]() {
+					phys::vclip::polyhedron p = box_1.to_polyhedron();
+
+					p.compile_adjacency();
+
+					phys::vclip::polyhedron translated = p.translated(phys::vec3(1.0_r, 0.0_r, 0.0_r));
+
+					expect(translated.adjacency_table == p.adjacency_table).to_be(true);
+					expect(same_vplanes(translated, box_1.to_polyhedron().translated(phys::vec3(1.0_r, 0.0_r, 0.0_r))))
+						.to_be(true);
+
+					p.add_vertex(phys::vec3(5.0_r));
+					expect(p.adjacency_table == nullptr).to_be(true);
+
+					p = box_1.to_polyhedron();
+					p.compile_adjacency();
+					p.remove_face(p.faces[0]);
+					expect(p.adjacency_table == nullptr).to_be(true);
+
+					p = box_1.to_polyhedron();
+					p.compile_adjacency();
+					p.move_vertex(7, 8);
+					expect(p.adjacency_table == nullptr).to_be(true);
+
+					p = box_1.to_polyhedron();
+					p.compile_adjacency();
+					p.clear();
+					expect(p.adjacency_table == nullptr).to_be(true);
+				});
+
+				it("fails to compile an open polyhedron", [&]() {
+					phys::vclip::polyhedron p = box_1.to_polyhedron();
+
+					p.faces.pop_back();
+
+					try {
+						p.compile_adjacency();
+						fail("Expected adjacency compilation to fail");
+					} catch (const phys::vclip::geometry_error &err) {
+						expect(std::holds_alternative<phys::vclip::edge>(err.offending_feature)).to_be(true);
+					}
+
+					expect(p.adjacency_table == nullptr).to_be(true);
+				});
+
+				it("finds the same closest features from every starting pair", [&]() {
+					box_body_2.pos = phys::vec3(0.0_r, 2.0_r, 1.0_r);
+					box_body_2.rot = make_rot(-(phys::real)M_PI / 16.0_r, phys::vec3(1.0_r, 0.0_r, 0.0_r)) *
+						make_rot((phys::real)M_PI / 4.0_r, phys::vec3(0.0_r, 0.0_r, 1.0_r));
+					box_body_2.calculate_derived_data();
+					box_body_1.calculate_derived_data();
+
+					phys::vclip::polyhedron penetrating = box_2.to_polyhedron();
+
+					box_body_2.pos = phys::vec3(-1.0_r, -4.0_r, 0.0_r);
+					box_body_2.calculate_derived_data();
+
+					const std::array<std::pair<phys::vclip::polyhedron, phys::vclip::polyhedron>, 2> scenes{
+						std::pair{ box_1.to_polyhedron(), penetrating },
+						std::pair{ box_1.to_polyhedron(), box_2.to_polyhedron() }
+					};
+
+					for (const auto &[p1, p2] : scenes) {
+						phys::vclip::polyhedron c1 = p1;
+						phys::vclip::polyhedron c2 = p2;
+
+						c1.compile_adjacency();
+						c2.compile_adjacency();
+
+						for (const phys::vclip::feature &f1 : p1.features()) {
+							for (const phys::vclip::feature &f2 : p2.features()) {
+								if (std::holds_alternative<phys::vclip::face>(f1) && std::holds_alternative<phys::vclip::face>(f2)) {
+									continue;
+								}
+
+								phys::vclip::algorithm_result expected = phys::vclip::closest_features(p1, p2, f1, f2, 52);
+								phys::vclip::algorithm_result actual = phys::vclip::closest_features(c1, c2, f1, f2, 52);
+
+								expect(actual.state).to_be(expected.state);
+							}
+						}
+					}
+				});
+
+				it("finds the same closest features between two prisms", [&]() {
+					phys::vclip::polyhedron p1 = make_prism(25, 0.0_r, phys::vec3(0.0_r));
+					phys::vclip::polyhedron p2 = make_prism(25, 0.7_r, phys::vec3(0.5_r, 3.0_r, 0.2_r));
+					phys::vclip::polyhedron c1 = p1;
+					phys::vclip::polyhedron c2 = p2;
+
+					c1.compile_adjacency();
+					c2.compile_adjacency();
+
+					for (const phys::vclip::vertex &v1 : p1.vertices) {
+						for (const phys::vclip::vertex &v2 : p2.vertices) {
+							phys::vclip::algorithm_result expected = phys::vclip::closest_features(p1, p2, v1, v2, 64);
+							phys::vclip::algorithm_result actual = phys::vclip::closest_features(c1, c2, v1, v2, 64);
+
+							expect(actual.state).to_be(expected.state);
+						}
+					}
+				});
+
+				it("finds the same closest features when a prism is in its own space", [&]() {
+					phys::vclip::polyhedron p1 = make_prism(25, 0.0_r, phys::vec3(0.0_r));
+					phys::vclip::polyhedron p2 = make_prism(25, 0.7_r, phys::vec3(0.5_r, 3.0_r, 0.2_r));
+					phys::vclip::polyhedron local_p2 = make_prism(25, 0.0_r, phys::vec3(0.0_r));
+					const phys::mat4 p2_to_p1 = phys::translate(phys::vec3(0.5_r, 3.0_r, 0.2_r)) *
+						phys::quat_to_mat4(make_rot(0.7_r, phys::vec3(0.0_r, 0.0_r, 1.0_r)));
+
+					p1.compile_adjacency();
+					local_p2.compile_adjacency();
+
+					for (const phys::vclip::vertex &v1 : p1.vertices) {
+						for (const phys::vclip::vertex &v2 : p2.vertices) {
+							phys::vclip::algorithm_result expected = phys::vclip::closest_features(p1, p2, v1, v2, 64);
+							phys::vclip::algorithm_result actual = phys::vclip::closest_features(
+								p1,
+								local_p2,
+								p2_to_p1,
+								v1,
+								local_p2.vertices[v2.i],
+								64
+							);
+
+							expect(actual.state).to_be(expected.state);
+						}
+					}
+				});
+
+				// The test runner prints the time taken by each test
+				describe("benchmark (50-vertex prisms, every pair of starting vertices)", []() {
+					it("searching the polyhedra", []() {
+						phys::vclip::polyhedron p1 = make_prism(25, 0.0_r, phys::vec3(0.0_r));
+						phys::vclip::polyhedron p2 = make_prism(25, 0.7_r, phys::vec3(0.5_r, 3.0_r, 0.2_r));
+
+						expect(num_terminated(p1, p2)).naht().to_be(0);
+					});
+
+					it("compiled adjacency", []() {
+						phys::vclip::polyhedron p1 = make_prism(25, 0.0_r, phys::vec3(0.0_r));
+						phys::vclip::polyhedron p2 = make_prism(25, 0.7_r, phys::vec3(0.5_r, 3.0_r, 0.2_r));
+
+						p1.compile_adjacency();
+						p2.compile_adjacency();
+
+						expect(num_terminated(p1, p2)).naht().to_be(0);
+					});
+				});
+			});
+
+			describe("feature cache", []() {
+				before_each([&]() {
+					box_body_2.pos = phys::vec3(0.3_r, 2.1_r, 0.2_r);
+					box_body_2.rot = make_rot(0.2_r, phys::vec3(0.0_r, 1.0_r, 0.0_r));
+					box_body_2.calculate_derived_data();
+					box_body_1.calculate_derived_data();
+				});
+
+				after_each([&]() {
+					box_body_1 = {};
+					box_body_2 = {};
+				});
+
+				it("starts from the features that were found last frame", [&]() {
+					phys::feature_cache cache{};
+					phys::vclip::polyhedron p1 = box_1.to_polyhedron();
+					phys::vclip::polyhedron p2 = box_2.to_polyhedron();
+
+					cache.begin_frame();
+					phys::vclip::algorithm_result first = cache.closest_features(box_1, box_2, p1, p2);
+					cache.end_frame();
+
+					expect(first.state.step).to_be(phys::vclip::algorithm_step::Done);
+					expect(cache.get_stats().misses).to_be(1);
+					expect(cache.get_stats().hits).to_be(0);
+					expect(cache.get_stats().steps).to_be(first.steps);
+
+					box_body_2.pos += phys::vec3(0.01_r, -0.01_r, 0.0_r);
+					box_body_2.calculate_derived_data();
+					p2 = box_2.to_polyhedron();
+
+					cache.reset_stats();
+					cache.begin_frame();
+					phys::vclip::algorithm_result second = cache.closest_features(box_1, box_2, p1, p2);
+					cache.end_frame();
+
+					phys::vclip::algorithm_result cold = phys::vclip::closest_features(p1, p2, p1.vertices[0], p2.vertices[0]);
+
+					expect(second.state).to_be(cold.state);
+					expect(cache.get_stats().hits).to_be(1);
+					expect(cache.get_stats().misses).to_be(0);
+					expect(second.steps).to_be_less_than(3);
+					expect(second.steps).to_be_less_than(cold.steps);
+				});
+
+				it("finds a pair given in either order", [&]() {
+					phys::feature_cache cache{};
+					phys::vclip::polyhedron p1 = box_1.to_polyhedron();
+					phys::vclip::polyhedron p2 = box_2.to_polyhedron();
+
+					cache.begin_frame();
+					phys::vclip::algorithm_result forward = cache.closest_features(box_1, box_2, p1, p2);
+					cache.end_frame();
+
+					cache.begin_frame();
+					phys::vclip::algorithm_result reverse = cache.closest_features(box_2, box_1, p2, p1);
+					cache.end_frame();
+
+					expect(cache.size()).to_be(1);
+					expect(cache.get_stats().hits).to_be(1);
+					expect(reverse.steps).to_be(1);
+					expect(reverse.state.f1).to_be(forward.state.f2);
+					expect(reverse.state.f2).to_be(forward.state.f1);
+				});
+
+				it("starts from edges and faces between two prisms", [&]() {
+					phys::feature_cache cache{};
+					phys::vclip::polyhedron p1 = make_prism(25, 0.0_r, phys::vec3(0.0_r));
+					size_t num_non_vertex_starts = 0;
+					size_t num_converged = 0;
+
+					// The tilted prism slides across the top of the other prism and past
+					// its rim, so the closest features change from frame to frame
+					for (size_t frame = 0; frame < 40; frame++) {
+						const phys::vclip::polyhedron p2 = make_prism(
+							25,
+							0.7_r,
+							phys::vec3(0.5_r + 0.05_r * (phys::real)frame, 3.0_r, 0.2_r)
+						);
+
+						cache.begin_frame();
+						phys::vclip::algorithm_result cached = cache.closest_features(box_1, box_2, p1, p2, 64);
+						cache.end_frame();
+
+						phys::vclip::algorithm_result cold = phys::vclip::closest_features(
+							p1,
+							p2,
+							p1.vertices[0],
+							p2.vertices[0],
+							64
+						);
+
+						// V-Clip doesn't converge for every pose of these prisms, even from
+						// a cold start, but the cache should never do worse than a cold start
+						if (cold.state.step != phys::vclip::algorithm_step::Done) {
+							continue;
+						}
+
+						// Some of the closest features are tied, so this checks that V-Clip
+						// stops right away on the features that it found instead of checking
+						// that they're the same as from a cold start
+						phys::vclip::algorithm_result again = phys::vclip::closest_features(
+							p1,
+							p2,
+							cached.state.f1,
+							cached.state.f2,
+							64
+						);
+
+						num_converged++;
+						expect(cached.state.step).to_be(phys::vclip::algorithm_step::Done);
+						expect(again.steps).to_be(1);
+						expect(again.state).to_be(cached.state);
+
+						if (
+							! std::holds_alternative<phys::vclip::vertex>(cached.state.f1) ||
+							! std::holds_alternative<phys::vclip::vertex>(cached.state.f2)
+						) {
+							num_non_vertex_starts++;
+						}
+					}
+
+					expect(cache.get_stats().hits).to_be(39);
+					expect(num_non_vertex_starts).naht().to_be(0);
+					expect(num_converged).naht().to_be(0);
+				});
+
+				it("forgets pairs that weren't seen in a frame", [&]() {
+					phys::feature_cache cache{};
+					phys::vclip::polyhedron p1 = box_1.to_polyhedron();
+					phys::vclip::polyhedron p2 = box_2.to_polyhedron();
+
+					cache.begin_frame();
+					cache.closest_features(box_1, box_2, p1, p2);
+					cache.end_frame();
+
+					expect(cache.size()).to_be(1);
+
+					cache.begin_frame();
+					cache.end_frame();
+
+					expect(cache.size()).to_be(0);
+
+					cache.begin_frame();
+					cache.closest_features(box_1, box_2, p1, p2);
+					cache.end_frame();
+
+					expect(cache.get_stats().misses).to_be(2);
+					expect(cache.get_stats().hits).to_be(0);
+				});
+			});
+
+			describe("heap allocations", []() {
+				before_each([&]() {
+					box_body_2.pos = phys::vec3(0.3_r, 2.1_r, 0.2_r);
+					box_body_2.rot = make_rot(0.2_r, phys::vec3(0.0_r, 1.0_r, 0.0_r));
+					box_body_2.calculate_derived_data();
+					box_body_1.calculate_derived_data();
+				});
+
+				after_each([&]() {
+					box_body_1 = {};
+					box_body_2 = {};
+				});
+
+				it("finds the closest features between two boxes without allocating", [&]() {
+					phys::vclip::polyhedron p1 = box_1.to_polyhedron();
+					phys::vclip::polyhedron p2 = box_2.to_polyhedron();
+					size_t num_planes = 0;
+
+					// The vector that this returns is allocated, so it should be counted
+					expect(count_allocations([&]() {
+						num_planes = phys::vclip::vplanes(p1, p1.vertices[0]).size();
+					})).naht().to_be(0);
+					expect(num_planes).to_be(3);
+
+					for (size_t compiled = 0; compiled < 2; compiled++) {
+						if (compiled) {
+							p1.compile_adjacency();
+							p2.compile_adjacency();
+						}
+
+						for (const phys::vclip::vertex &v1 : p1.vertices) {
+							for (const phys::vclip::vertex &v2 : p2.vertices) {
+								size_t steps = 0;
+								size_t num = count_allocations([&]() {
+									steps = phys::vclip::closest_features(p1, p2, v1, v2).steps;
+								});
+
+								expect(steps).naht().to_be(0);
+								expect(num).to_be(0);
+							}
+						}
+					}
+				});
+
+				it("iterates over features without allocating", [&]() {
+					phys::vclip::polyhedron p = box_1.to_polyhedron();
+					size_t num_features = 0;
+					size_t num_edges = 0;
+
+					size_t num = count_allocations([&]() {
+						for (const phys::vclip::feature &f : p.features()) {
+							num_features++;
+
+							if (const phys::vclip::face * face = std::get_if<phys::vclip::face>(&f)) {
+								for (const phys::vclip::edge &e : face->edges()) {
+									num_edges += face->has_edge(e) ? 1 : 0;
+								}
+							}
+						}
+					});
+
+					expect(num_features).to_be(8 + 12 + 6);
+					expect(num_edges).to_be(24);
+					expect(num).to_be(0);
+				});
+
+				it("generates box-box contacts from last frame's features without allocating", [&]() {
+					phys::feature_cache cache{};
+					phys::collision_algorithm_func cached = phys::algorithms::cached_box_box_collision(cache);
+					phys::contact_container out{};
+
+					out.reserve(16);
+
+					// The first frame adds the pair to the cache
+					cache.begin_frame();
+					cached(box_1, box_2, out);
+					cache.end_frame();
+
+					box_body_2.pos.y = 1.95_r;
+					box_body_2.calculate_derived_data();
+					out.clear();
+
+					size_t num = count_allocations([&]() {
+						cache.begin_frame();
+						cached(box_1, box_2, out);
+						cache.end_frame();
+					});
+
+					expect(out.size()).naht().to_be(0);
+					expect(cache.get_stats().hits).to_be(1);
+					expect(num).to_be(0);
+				});
+			});
+		});
+	});
+	describe("Quickhull", []() {
+		it("builds a tetrahedron from four points", []() {
+			const std::vector<phys::vec3> points{
+				phys::vec3(0.0_r, 0.0_r, 0.0_r),
+				phys::vec3(1.0_r, 0.0_r, 0.0_r),
+				phys::vec3(0.0_r, 1.0_r, 0.0_r),
+				phys::vec3(0.0_r, 0.0_r, 1.0_r)
+			};
+			phys::vclip::polyhedron p = phys::quickhull(points);
+
+			expect(p.vertices).to_have_size(4);
+			expect(p.edges).to_have_size(6);
+			expect(p.faces).to_have_size(4);
+			expect(max_dist_outside(p, points)).to_be_less_than(0.00001_r);
+		});
+
+		it("merges faces in the same plane and leaves out points on faces and edges", []() {
+			const std::vector<phys::vec3> points = box_grid_points(
+				phys::vec3(1.0_r, 2.0_r, 3.0_r),
+				5,
+				phys::identity<phys::quat>()
+			);
+			phys::vclip::polyhedron p = phys::quickhull(points);
+
+			expect(p.vertices).to_have_size(8);
+			expect(p.edges).to_have_size(12);
+			expect(p.faces).to_have_size(6);
+
+			for (const phys::vclip::face &f : p.faces) {
+				expect(f.num_verts()).to_be(4);
+			}
+
+			for (const phys::vclip::vertex &v : p.vertices) {
+				expect(std::abs(v.v.x)).to_be(1.0_r);
+				expect(std::abs(v.v.y)).to_be(2.0_r);
+				expect(std::abs(v.v.z)).to_be(3.0_r);
+			}
+		});
+
+		it("merges faces in the same plane when the points are rotated", []() {
+			const phys::quat rot = phys::normalize(make_rot(0.6_r, phys::normalize(phys::vec3(1.0_r, 2.0_r, -0.5_r))));
+			const std::vector<phys::vec3> points = box_grid_points(phys::vec3(1.0_r, 0.5_r, 2.0_r), 7, rot);
+			phys::vclip::polyhedron p = phys::quickhull(points);
+
+			expect(p.vertices).to_have_size(8);
+			expect(p.faces).to_have_size(6);
+			expect(max_dist_outside(p, points)).to_be_less_than(0.0001_r);
+		});
+
+		it("builds a closed convex hull around every point", []() {
+			const std::vector<phys::vec3> points = points_in_ball(5000, 10.0_r, 42);
+			phys::vclip::polyhedron p = phys::quickhull(points);
+
+			expect(p.euler_characteristic()).to_be(2);
+			expect(p.vertices.size()).to_be_less_than(points.size());
+			expect(max_dist_outside(p, points)).to_be_less_than(0.0001_r);
+
+			for (const phys::vclip::vertex &v : p.vertices) {
+				if (std::find(std::begin(points), std::end(points), v.v) == std::end(points)) {
+					fail("expected every vertex of the hull to be one of the points");
+				}
+			}
+		});
+
+		it("stays convex when points are almost in the same plane as a face", []() {
+			const std::vector<phys::vec3> points = points_on_sphere(5000, 1.0_r, 1);
+			phys::vclip::polyhedron p = phys::quickhull(points);
+
+			expect(p.euler_characteristic()).to_be(2);
+			expect(max_dist_outside(p, points)).to_be_less_than(0.000002_r);
+		});
+
+		it("rejects points that are all in the same plane", []() {
+			std::vector<phys::vec3> points{};
+
+			for (size_t i = 0; i < 20; i++) {
+				const phys::real angle = (phys::real)i * 0.3_r;
+
+				points.push_back(phys::vec3(std::cos(angle), 0.5_r * std::sin(angle), 1.0_r));
+			}
+
+			try {
+				phys::quickhull(points);
+				fail("Expected quickhull to fail");
+			} catch (const std::invalid_argument&) {}
+
+			try {
+				phys::quickhull(std::span(points).subspan(0, 3));
+				fail("Expected quickhull to fail");
+			} catch (const std::invalid_argument&) {}
+		});
+
+		it("builds the same hull on a thread pool", []() {
+			const std::vector<phys::vec3> points = points_in_ball(200000, 1.0_r, 11);
+			phys::thread_pool pool(4);
+			phys::vclip::polyhedron serial = phys::quickhull(points);
+			phys::vclip::polyhedron parallel = phys::quickhull(points, &pool);
+
+			expect(parallel.faces).to_have_size(serial.faces.size());
+			expect(parallel.edges).to_have_size(serial.edges.size());
+
+			if (sorted_vertices(parallel) != sorted_vertices(serial)) {
+				fail("expected the hulls to have the same vertices");
+			}
+		});
+
+		// The test runner prints the time taken by each test
+		describe("benchmark (points in a ball)", []() {
+			it("1000 points", []() {
+				const std::vector<phys::vec3> points = points_in_ball(1000, 1.0_r, 1);
+
+				expect(phys::quickhull(points).faces).naht().to_have_size(0);
+			});
+
+			it("10000 points", []() {
+				const std::vector<phys::vec3> points = points_in_ball(10000, 1.0_r, 1);
+
+				expect(phys::quickhull(points).faces).naht().to_have_size(0);
+			});
+
+			it("100000 points", []() {
+				const std::vector<phys::vec3> points = points_in_ball(100000, 1.0_r, 1);
+
+				expect(phys::quickhull(points).faces).naht().to_have_size(0);
+			});
+
+			it("100000 points on a thread pool", []() {
+				const std::vector<phys::vec3> points = points_in_ball(100000, 1.0_r, 1);
+				phys::thread_pool pool{};
+
+				expect(phys::quickhull(points, &pool).faces).naht().to_have_size(0);
+			});
+
+			it("1000000 points", []() {
+				const std::vector<phys::vec3> points = points_in_ball(1000000, 1.0_r, 1);
+
+				expect(phys::quickhull(points).faces).naht().to_have_size(0);
+			});
+
+			it("1000000 points on a thread pool", []() {
+				const std::vector<phys::vec3> points = points_in_ball(1000000, 1.0_r, 1);
+				phys::thread_pool pool{};
+
+				expect(phys::quickhull(points, &pool).faces).naht().to_have_size(0);
 			});
 		});
 	});
-}
\ No newline at end of file
+}
@@ -0,0 +1,641 @@
+#define DEBUG
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <physics/constraints.h>
+#include "test.h"
+
+using namespace test;
+using namespace phys::literals;
+
+namespace {
+	struct even_particles {
+		bool operator()(size_t i) const {
+			return (i % 2) == 0;
+		}
+	};
+
+	// Counts how many instances are alive, to check that the arena destroys them
+	struct counted_constraint : public phys::constraint {
+		static inline size_t num_alive = 0;
+
+		std::array<char, 40> padding{};
+
+		counted_constraint() : phys::constraint(1.0_r, phys::constraint_type::Equality) {
+			num_alive++;
+		}
+
+		~counted_constraint() {
+			num_alive--;
+		}
+
+		phys::real eval_constraint() const override {
+			return 0.0_r;
+		}
+
+		void project(phys::real) override {}
+		void update_velocities(phys::real) override {}
+
+		std::span<phys::particle * const> get_particles() const override {
+			return {};
+		}
+	};
+
+	// A big constraint, to check that the arena can hold constraints that are
+	// bigger than its blocks
+	struct big_constraint : public counted_constraint {
+		std::array<phys::real, 256> data{};
+	};
+
+	// Particles scattered in a cube, with their predicted positions set as if they
+	// were about to be tested for collisions
+	std::vector<phys::particle> seeded_particles(
+		size_t num_particles,
+		phys::real extent,
+		phys::real max_radius,
+		unsigned int seed
+	) {
+		std::mt19937 gen(seed);
+		std::uniform_real_distribution<phys::real> coord_distrib(-extent, extent);
+		std::uniform_real_distribution<phys::real> radius_distrib(0.1_r, max_radius);
+		std::vector<phys::particle> out(num_particles);
+
+		for (phys::particle &p : out) {
+			phys::real x = coord_distrib(gen);
+			phys::real y = coord_distrib(gen);
+			phys::real z = coord_distrib(gen);
+
+			p.pos = phys::vec3(x, y, z);
+			p.p = p.pos;
+			p.radius = radius_distrib(gen);
+		}
+
+		return out;
+	}
+
+	// The pairs that an exhaustive test of every pair of particles would find
+	template <typename particle_filter>
+	std::vector<std::pair<size_t, size_t>> brute_force_pairs(
+		const std::vector<phys::particle> &particles,
+		particle_filter filter
+	) {
+		std::vector<std::pair<size_t, size_t>> out{};
+
+		for (size_t i = 0; i < particles.size(); i++) {
+			for (size_t j = i + 1; j < particles.size(); j++) {
+				if (! filter(i) || ! filter(j)) {
+					continue;
+				}
+
+				phys::vec3 diff = particles[i].p - particles[j].p;
+				phys::real min_dist = particles[i].radius + particles[j].radius;
+
+				if (phys::dot(diff, diff) < min_dist * min_dist) {
+					out.push_back({ i, j });
+				}
+			}
+		}
+
+		return out;
+	}
+
+	// A 20x20 square floor at y = 0, made of two triangles
+	std::vector<phys::triangle> floor_triangles() {
+		const phys::vec3 a(-10.0_r, 0.0_r, -10.0_r);
+		const phys::vec3 b(10.0_r, 0.0_r, -10.0_r);
+		const phys::vec3 c(10.0_r, 0.0_r, 10.0_r);
+		const phys::vec3 d(-10.0_r, 0.0_r, 10.0_r);
+
+		return { phys::triangle{ a, c, b }, phys::triangle{ a, d, c } };
+	}
+
+	bool nearly_equal(const phys::vec3 &a, const phys::vec3 &b) {
+		const phys::vec3 diff = a - b;
+
+		return phys::dot(diff, diff) < 1e-8_r;
+	}
+
+	template <typename Generator>
+	std::vector<std::pair<size_t, size_t>> generated_pairs(
+		Generator &gen,
+		const std::vector<phys::particle> &particles
+	) {
+		std::vector<std::pair<size_t, size_t>> out{};
+
+		gen.for_each_overlapping_pair([&](phys::particle &a, phys::particle &b) {
+			size_t i = (size_t)(&a - particles.data());
+			size_t j = (size_t)(&b - particles.data());
+
+			if (i >= j) {
+				fail("expected the first particle in a pair to come first in the container");
+			}
+
+			out.push_back({ i, j });
+		});
+
+		std::sort(std::begin(out), std::end(out));
+
+		return out;
+	}
+}
+
+void setup_constraint_tests() {
+	describe("Constraint arena", []() {
+		it("destroys constraints when it's cleared", []() {
+			phys::constraint_arena arena(256);
+
+			for (size_t i = 0; i < 100; i++) {
+				arena.emplace<counted_constraint>();
+			}
+
+			expect(counted_constraint::num_alive).to_be(100);
+			expect(arena.size()).to_be(100);
+
+			arena.clear();
+
+			expect(counted_constraint::num_alive).to_be(0);
+			expect(arena.empty()).to_be(true);
+
+			{
+				phys::constraint_arena scoped(256);
+
+				scoped.emplace<counted_constraint>();
+				scoped.emplace<big_constraint>();
+
+				expect(counted_constraint::num_alive).to_be(2);
+			}
+
+			expect(counted_constraint::num_alive).to_be(0);
+		});
+
+		it("reuses its blocks after it's cleared", []() {
+			phys::constraint_arena arena(1024);
+			std::vector<phys::constraint *> first_frame{};
+
+			for (size_t i = 0; i < 200; i++) {
+				first_frame.push_back(arena.emplace<counted_constraint>());
+			}
+
+			const size_t num_blocks = arena.blocks.size();
+
+			expect(num_blocks).naht().to_be_less_than(2);
+
+			arena.clear();
+
+			for (size_t i = 0; i < 200; i++) {
+				if (arena.emplace<counted_constraint>() != first_frame[i]) {
+					fail("expected constraint " + std::to_string(i) + " to be constructed in the same place");
+				}
+			}
+
+			expect(arena.blocks.size()).to_be(num_blocks);
+
+			arena.clear();
+		});
+
+		it("holds constraints that are bigger than a block", []() {
+			phys::constraint_arena arena(64);
+
+			counted_constraint * small = arena.emplace<counted_constraint>();
+			big_constraint * big = arena.emplace<big_constraint>();
+
+			big->data[255] = 3.0_r;
+
+			expect(arena.size()).to_be(2);
+			expect(arena[0]).to_be(static_cast<phys::constraint *>(small));
+			expect(arena[1]).to_be(static_cast<phys::constraint *>(big));
+			expect(big->data[255]).to_be(3.0_r);
+			expect((size_t)((uintptr_t)big % alignof(big_constraint))).to_be(0);
+
+			arena.clear();
+		});
+
+		// The test runner prints the time taken by each test
+		describe("benchmark (20000 constraints, 100 frames)", []() {
+			it("individually allocated constraints", []() {
+				phys::particle a{};
+				phys::particle b{};
+				std::vector<std::unique_ptr<phys::constraint>> constraints{};
+
+				for (size_t frame = 0; frame < 100; frame++) {
+					constraints.clear();
+
+					for (size_t i = 0; i < 20000; i++) {
+						constraints.push_back(std::make_unique<phys::particle_collision_constraint>(&a, &b, 0.9_r, 0.1_r));
+					}
+				}
+
+				expect(constraints.size()).to_be(20000);
+			});
+
+			it("constraints in an arena", []() {
+				phys::particle a{};
+				phys::particle b{};
+				phys::constraint_arena constraints{};
+
+				for (size_t frame = 0; frame < 100; frame++) {
+					constraints.clear();
+
+					for (size_t i = 0; i < 20000; i++) {
+						constraints.emplace<phys::particle_collision_constraint>(&a, &b, 0.9_r, 0.1_r);
+					}
+				}
+
+				expect(constraints.size()).to_be(20000);
+			});
+		});
+	});
+
+	describe("Particle collision constraint generator", []() {
+		it("generates constraints for overlapping particles", []() {
+			std::vector<phys::particle> particles(3);
+
+			particles[0].p = phys::vec3(0.0_r);
+			particles[0].radius = 0.5_r;
+			particles[1].p = phys::vec3(0.75_r, 0.0_r, 0.0_r);
+			particles[1].radius = 0.5_r;
+			particles[2].p = phys::vec3(3.0_r, 0.0_r, 0.0_r);
+			particles[2].radius = 1.0_r;
+
+			phys::particle_collision_constraint_generator gen(particles, 0.9_r, 0.1_r);
+			phys::constraint_arena constraints{};
+
+			gen.generate_constraints(0.01_r, constraints);
+
+			expect(constraints.size()).to_be(1);
+
+			const auto * c = dynamic_cast<phys::particle_collision_constraint *>(constraints[0]);
+
+			expect(c != nullptr).to_be(true);
+			expect(c->a()).to_be(&particles[0]);
+			expect(c->b()).to_be(&particles[1]);
+			expect(c->restitution).to_be(0.9_r);
+			expect(c->friction).to_be(0.1_r);
+			expect(c->eval_constraint()).to_be_less_than(0.0_r);
+		});
+
+		it("does not generate constraints for fewer than two particles", []() {
+			std::vector<phys::particle> particles(1);
+			phys::constraint_arena constraints{};
+
+			particles[0].radius = 1.0_r;
+
+			phys::particle_collision_constraint_generator gen(particles, 0.9_r, 0.1_r);
+
+			gen.generate_constraints(0.01_r, constraints);
+
+			expect(constraints.size()).to_be(0);
+		});
+
+		it("finds the same pairs as testing every pair", []() {
+			std::vector<phys::particle> particles = seeded_particles(2000, 20.0_r, 1.0_r, 42);
+			phys::particle_collision_constraint_generator gen(particles, 0.9_r, 0.1_r);
+
+			std::vector<std::pair<size_t, size_t>> expected = brute_force_pairs(particles, phys::all_particles{});
+
+			expect(expected.size()).naht().to_be(0);
+
+			if (generated_pairs(gen, particles) != expected) {
+				fail("expected the spatial hash to find every overlapping pair exactly once");
+			}
+
+			// Move the particles and run it again, so that the spatial hash is reused
+			for (phys::particle &p : particles) {
+				p.p += phys::vec3(0.3_r, -0.7_r, 0.1_r);
+			}
+
+			if (generated_pairs(gen, particles) != brute_force_pairs(particles, phys::all_particles{})) {
+				fail("expected the spatial hash to find every overlapping pair after the particles moved");
+			}
+		});
+
+		it("only tests particles accepted by the filter", []() {
+			std::vector<phys::particle> particles = seeded_particles(1000, 10.0_r, 1.0_r, 7);
+			phys::particle_collision_constraint_generator<std::vector<phys::particle>, even_particles> gen(
+				particles,
+				0.9_r,
+				0.1_r
+			);
+
+			if (generated_pairs(gen, particles) != brute_force_pairs(particles, even_particles{})) {
+				fail("expected the spatial hash to ignore particles rejected by the filter");
+			}
+		});
+
+		it("handles particles at negative coordinates and cell boundaries", []() {
+			std::vector<phys::particle> particles(4);
+
+			particles[0].p = phys::vec3(-0.01_r, 0.0_r, 0.0_r);
+			particles[1].p = phys::vec3(0.01_r, 0.0_r, 0.0_r);
+			particles[2].p = phys::vec3(-1.0_r, -1.0_r, -1.0_r);
+			particles[3].p = phys::vec3(-1.0_r, -1.0_r, -0.9_r);
+
+			for (phys::particle &p : particles) {
+				p.radius = 0.25_r;
+			}
+
+			phys::particle_collision_constraint_generator gen(particles, 0.9_r, 0.1_r);
+
+			if (generated_pairs(gen, particles) != brute_force_pairs(particles, phys::all_particles{})) {
+				fail("expected particles in neighboring cells to be tested against each other");
+			}
+		});
+
+		// The test runner prints the time taken by each test
+		describe("benchmark (2000 particles, 10 frames)", []() {
+			it("testing every pair", []() {
+				std::vector<phys::particle> particles = seeded_particles(2000, 20.0_r, 0.5_r, 42);
+				size_t total_pairs = 0;
+
+				for (size_t frame = 0; frame < 10; frame++) {
+					total_pairs += brute_force_pairs(particles, phys::all_particles{}).size();
+				}
+
+				expect(total_pairs).naht().to_be(0);
+			});
+
+			it("spatial hash", []() {
+				std::vector<phys::particle> particles = seeded_particles(2000, 20.0_r, 0.5_r, 42);
+				phys::particle_collision_constraint_generator gen(particles, 0.9_r, 0.1_r);
+				size_t total_pairs = 0;
+
+				for (size_t frame = 0; frame < 10; frame++) {
+					gen.for_each_overlapping_pair([&](phys::particle &, phys::particle &) {
+						total_pairs++;
+					});
+				}
+
+				expect(total_pairs).naht().to_be(0);
+			});
+		});
+	});
+
+	describe("Swept sphere tests", []() {
+		it("find where a sphere hits the face of a triangle", []() {
+			const std::vector<phys::triangle> tris = floor_triangles();
+			const std::optional<phys::sweep_hit> hit = phys::sweep_sphere_triangle(
+				phys::vec3(1.0_r, 5.0_r, 2.0_r),
+				phys::vec3(1.0_r, -5.0_r, 2.0_r),
+				0.5_r,
+				tris[1]
+			);
+
+			expect(hit.has_value()).to_be(true);
+			expect(std::abs(hit->t - 0.45_r)).to_be_less_than(1e-5_r);
+			expect(nearly_equal(hit->center, phys::vec3(1.0_r, 0.5_r, 2.0_r))).to_be(true);
+			expect(nearly_equal(hit->normal, phys::vec3(0.0_r, 1.0_r, 0.0_r))).to_be(true);
+		});
+
+		it("find where a sphere hits the underside of a triangle", []() {
+			const std::vector<phys::triangle> tris = floor_triangles();
+			const std::optional<phys::sweep_hit> hit = phys::sweep_sphere_triangle(
+				phys::vec3(1.0_r, -5.0_r, 2.0_r),
+				phys::vec3(1.0_r, 5.0_r, 2.0_r),
+				0.5_r,
+				tris[1]
+			);
+
+			expect(hit.has_value()).to_be(true);
+			expect(nearly_equal(hit->center, phys::vec3(1.0_r, -0.5_r, 2.0_r))).to_be(true);
+			expect(nearly_equal(hit->normal, phys::vec3(0.0_r, -1.0_r, 0.0_r))).to_be(true);
+		});
+
+		it("find where a sphere hits the edge and the vertex of a triangle", []() {
+			const phys::triangle tri{
+				phys::vec3(0.0_r),
+				phys::vec3(2.0_r, 0.0_r, 0.0_r),
+				phys::vec3(0.0_r, 0.0_r, 2.0_r)
+			};
+
+			// Moves towards the edge along x = 0, in the triangle's plane
+			const std::optional<phys::sweep_hit> edge_hit = phys::sweep_sphere_triangle(
+				phys::vec3(-5.0_r, 0.0_r, 1.0_r),
+				phys::vec3(5.0_r, 0.0_r, 1.0_r),
+				1.0_r,
+				tri
+			);
+
+			expect(edge_hit.has_value()).to_be(true);
+			expect(std::abs(edge_hit->t - 0.4_r)).to_be_less_than(1e-5_r);
+			expect(nearly_equal(edge_hit->normal, phys::vec3(-1.0_r, 0.0_r, 0.0_r))).to_be(true);
+
+			// Moves straight at the vertex at the origin
+			const phys::vec3 dir = phys::normalize(phys::vec3(-1.0_r, 0.0_r, -1.0_r));
+			const std::optional<phys::sweep_hit> vertex_hit = phys::sweep_sphere_triangle(
+				dir * 4.0_r,
+				dir * -4.0_r,
+				1.0_r,
+				tri
+			);
+
+			expect(vertex_hit.has_value()).to_be(true);
+			expect(std::abs(vertex_hit->t - 0.375_r)).to_be_less_than(1e-5_r);
+			expect(nearly_equal(vertex_hit->normal, dir)).to_be(true);
+		});
+
+		it("miss triangles that the sphere doesn't reach or that it moves away from", []() {
+			const std::vector<phys::triangle> tris = floor_triangles();
+
+			expect(phys::sweep_sphere_triangle(
+				phys::vec3(0.0_r, 5.0_r, 0.0_r),
+				phys::vec3(0.0_r, 1.0_r, 0.0_r),
+				0.5_r,
+				tris[0]
+			)).to_be_empty();
+
+			// Passes beside the floor
+			expect(phys::sweep_sphere_triangle(
+				phys::vec3(11.0_r, 5.0_r, 0.0_r),
+				phys::vec3(11.0_r, -5.0_r, 0.0_r),
+				0.5_r,
+				tris[0]
+			)).to_be_empty();
+
+			// Starts in the floor and moves up
+			expect(phys::sweep_sphere_triangle(
+				phys::vec3(1.0_r, 0.25_r, 2.0_r),
+				phys::vec3(1.0_r, 3.0_r, 2.0_r),
+				0.5_r,
+				tris[1]
+			)).to_be_empty();
+		});
+
+		it("find where two spheres that pass through each other touch", []() {
+			const std::optional<phys::sweep_hit> hit = phys::sweep_spheres(
+				phys::vec3(-5.0_r, 0.0_r, 0.0_r),
+				phys::vec3(5.0_r, 0.0_r, 0.0_r),
+				0.5_r,
+				phys::vec3(5.0_r, 0.0_r, 0.0_r),
+				phys::vec3(-5.0_r, 0.0_r, 0.0_r),
+				0.5_r
+			);
+
+			expect(hit.has_value()).to_be(true);
+			expect(std::abs(hit->t - 0.45_r)).to_be_less_than(1e-5_r);
+			expect(nearly_equal(hit->center, phys::vec3(-0.5_r, 0.0_r, 0.0_r))).to_be(true);
+			expect(nearly_equal(hit->normal, phys::vec3(-1.0_r, 0.0_r, 0.0_r))).to_be(true);
+
+			expect(phys::sweep_spheres(
+				phys::vec3(-5.0_r, 0.0_r, 0.0_r),
+				phys::vec3(5.0_r, 0.0_r, 0.0_r),
+				0.5_r,
+				phys::vec3(5.0_r, 2.0_r, 0.0_r),
+				phys::vec3(-5.0_r, 2.0_r, 0.0_r),
+				0.5_r
+			)).to_be_empty();
+		});
+	});
+
+	describe("Particle collision constraint generator with continuous collision detection", []() {
+		it("generates a constraint for particles that pass through each other in one step", []() {
+			std::vector<phys::particle> particles(2);
+
+			particles[0].pos = phys::vec3(-5.0_r, 0.0_r, 0.0_r);
+			particles[0].p = phys::vec3(5.0_r, 0.0_r, 0.0_r);
+			particles[1].pos = phys::vec3(5.0_r, 0.0_r, 0.0_r);
+			particles[1].p = phys::vec3(-5.0_r, 0.0_r, 0.0_r);
+
+			for (phys::particle &p : particles) {
+				p.radius = 0.5_r;
+			}
+
+			phys::particle_collision_constraint_generator gen(particles, 0.9_r, 0.1_r);
+			phys::constraint_arena constraints{};
+
+			gen.generate_constraints(0.01_r, constraints);
+
+			expect(constraints.size()).to_be(0);
+
+			gen.continuous = true;
+			gen.generate_constraints(0.01_r, constraints);
+
+			expect(constraints.size()).to_be(1);
+
+			auto * c = dynamic_cast<phys::particle_collision_constraint *>(constraints[0]);
+
+			expect(c != nullptr).to_be(true);
+			expect(c->a()).to_be(&particles[0]);
+			expect(c->b()).to_be(&particles[1]);
+			expect(c->normal.has_value()).to_be(true);
+			expect(nearly_equal(*c->normal, phys::vec3(-1.0_r, 0.0_r, 0.0_r))).to_be(true);
+
+			c->project(1.0_r);
+
+			// The particles are pushed back to the sides that they came from
+			expect(particles[0].p.x).to_be_less_than(particles[1].p.x);
+			expect(std::abs(c->eval_constraint())).to_be_less_than(1e-5_r);
+		});
+
+		it("finds the same pairs as testing every pair when no particles are fast", []() {
+			std::vector<phys::particle> particles = seeded_particles(2000, 20.0_r, 1.0_r, 42);
+			phys::particle_collision_constraint_generator gen(particles, 0.9_r, 0.1_r);
+			phys::constraint_arena constraints{};
+
+			gen.continuous = true;
+			gen.generate_constraints(0.01_r, constraints);
+
+			std::vector<std::pair<size_t, size_t>> pairs{};
+
+			for (phys::constraint * c : constraints) {
+				const auto * pc = dynamic_cast<phys::particle_collision_constraint *>(c);
+
+				expect(pc->normal.has_value()).to_be(false);
+
+				pairs.push_back({ (size_t)(pc->a() - particles.data()), (size_t)(pc->b() - particles.data()) });
+			}
+
+			std::sort(std::begin(pairs), std::end(pairs));
+
+			if (pairs != brute_force_pairs(particles, phys::all_particles{})) {
+				fail("expected the same pairs as discrete collision detection");
+			}
+		});
+
+		it("tests fast particles against every particle that they sweep past", []() {
+			std::vector<phys::particle> particles = seeded_particles(1000, 10.0_r, 0.5_r, 99);
+			std::mt19937 gen(99);
+			std::uniform_real_distribution<phys::real> distrib(-3.0_r, 3.0_r);
+
+			// Every fifth particle moves several times its radius
+			for (size_t i = 0; i < particles.size(); i += 5) {
+				particles[i].p = particles[i].pos + phys::vec3(distrib(gen), distrib(gen), distrib(gen));
+			}
+
+			phys::particle_collision_constraint_generator ccd(particles, 0.9_r, 0.1_r);
+			phys::constraint_arena constraints{};
+
+			ccd.continuous = true;
+			ccd.generate_constraints(0.01_r, constraints);
+
+			std::vector<std::pair<size_t, size_t>> pairs{};
+
+			for (phys::constraint * c : constraints) {
+				const auto * pc = dynamic_cast<phys::particle_collision_constraint *>(c);
+
+				pairs.push_back({ (size_t)(pc->a() - particles.data()), (size_t)(pc->b() - particles.data()) });
+			}
+
+			std::sort(std::begin(pairs), std::end(pairs));
+
+			std::vector<std::pair<size_t, size_t>> expected{};
+
+			for (size_t i = 0; i < particles.size(); i++) {
+				for (size_t j = i + 1; j < particles.size(); j++) {
+					const phys::particle &a = particles[i];
+					const phys::particle &b = particles[j];
+					const phys::vec3 diff = a.p - b.p;
+					const phys::real min_dist = a.radius + b.radius;
+
+					if (
+						phys::sweep_spheres(a.pos, a.p, a.radius, b.pos, b.p, b.radius) ||
+						phys::dot(diff, diff) < min_dist * min_dist
+					) {
+						expected.push_back({ i, j });
+					}
+				}
+			}
+
+			expect(expected.size()).naht().to_be(0);
+
+			if (pairs != expected) {
+				fail("expected a constraint for every pair of particles that touch during the step");
+			}
+		});
+	});
+
+	describe("Static mesh collision constraint generator", []() {
+		it("stops a fast particle where it first touches the mesh", []() {
+			std::vector<phys::particle> particles(2);
+
+			particles[0].pos = phys::vec3(1.0_r, 5.0_r, 2.0_r);
+			particles[0].p = phys::vec3(3.0_r, -45.0_r, 2.0_r);
+			particles[0].radius = 0.5_r;
+			// Doesn't reach the floor
+			particles[1].pos = phys::vec3(0.0_r, 5.0_r, 0.0_r);
+			particles[1].p = phys::vec3(0.0_r, 4.0_r, 0.0_r);
+			particles[1].radius = 0.5_r;
+
+			phys::static_mesh_collision_constraint_generator gen(particles, floor_triangles(), 0.5_r, 0.1_r);
+			phys::constraint_arena constraints{};
+
+			gen.generate_constraints(0.01_r, constraints);
+
+			expect(constraints.size()).to_be(1);
+
+			auto * c = dynamic_cast<phys::plane_collision_constraint *>(constraints[0]);
+
+			expect(c != nullptr).to_be(true);
+			expect(c->a()).to_be(&particles[0]);
+			expect(nearly_equal(c->normal, phys::vec3(0.0_r, 1.0_r, 0.0_r))).to_be(true);
+			expect(std::abs(c->origin.y - 0.5_r)).to_be_less_than(1e-5_r);
+			expect(c->restitution).to_be(0.5_r);
+			expect(c->friction).to_be(0.1_r);
+
+			c->project(1.0_r);
+
+			expect(std::abs(particles[0].p.y - 0.5_r)).to_be_less_than(1e-5_r);
+		});
+	});
+}
@@ -1,4 +1,5 @@
 #include <fstream>
+#include <limits>
 #include <sstream>
 #include "data_formats/json.h"
 #include "test.h"
@@ -259,5 +260,40 @@ void setup_json_parser_tests() {
 				expect(err.col_num).to_be(1);
 			}
 		});
+
+		it("Writes JSON that parses back to the same values", []() {
+			json original{};
+			const json_array_descriptor arr_desc = original.add(json_array{ 1L, 2.5, true, false, nullptr, L"quote: \", backslash: \\, newline: \n, BEL: \u0007" });
+
+			original.set_root(original.add(json_object{
+				{ L"arr", arr_desc },
+				{ L"empty", original.add(json_object{}) },
+				{ L"not finite", std::numeric_limits<double>::infinity() }
+			}));
+
+			std::wstringstream wss{};
+			write_json(wss, original);
+
+			json result = parse_json(wss);
+			json_value_or_descriptor root = result.get_root();
+
+			expect(root).to_have_type<json_object_descriptor>().assert_now();
+
+			json_object * obj = result.get(std::get<json_object_descriptor>(root)).value();
+			expect(obj->size()).to_be(3);
+			expect(obj->at(L"not finite")).to_be(nullptr);
+			expect(obj->at(L"empty")).to_have_type<json_object_descriptor>().assert_now();
+			expect(result.get(std::get<json_object_descriptor>(obj->at(L"empty"))).value()->size()).to_be(0);
+			expect(obj->at(L"arr")).to_have_type<json_array_descriptor>().assert_now();
+
+			json_array * arr = result.get(std::get<json_array_descriptor>(obj->at(L"arr"))).value();
+			expect(arr->size()).to_be(6);
+			expect(arr->at(0)).to_be(1L);
+			expect(arr->at(1)).to_be(json_value_or_descriptor(2.5));
+			expect(arr->at(2)).to_be(true);
+			expect(arr->at(3)).to_be(false);
+			expect(arr->at(4)).to_be(nullptr);
+			expect(arr->at(5)).to_be(L"quote: \", backslash: \\, newline: \n, BEL: \u0007");
+		});
 	});
 }
\ No newline at end of file
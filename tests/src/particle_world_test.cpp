@@ -0,0 +1,1068 @@
+#define DEBUG
+#include <atomic>
+#include <random>
+#include <set>
+#include <span>
+#include <sstream>
+#include <thread>
+#include <physics/constraints.h>
+#include <physics/particle_force_generators.h>
+#include <physics/particle_world.h>
+#include <physics/thread_pool.h>
+#include "test.h"
+
+using namespace test;
+using namespace phys::literals;
+
+namespace {
+	// A square sheet of particles connected to their neighbors by distance
+	// constraints, hanging from its top row
+	struct cloth {
+		std::vector<phys::particle> particles{};
+		std::vector<std::unique_ptr<phys::distance_constraint>> constraints{};
+		phys::particle_gravity gravity{ phys::vec3(0.0_r, -9.8_r, 0.0_r) };
+		phys::particle_world world;
+
+		cloth(size_t size, phys::thread_pool * pool) :
+			particles(size * size),
+			world(16)
+		{
+			world.set_thread_pool(pool);
+
+			for (size_t y = 0; y < size; y++) {
+				for (size_t x = 0; x < size; x++) {
+					phys::particle &p = particles[y * size + x];
+
+					p.pos = phys::vec3((phys::real)x, 0.0_r, (phys::real)y);
+
+					if (y == 0) {
+						p.set_mass(phys::infinity);
+					} else {
+						world.force_registry.add(&p, &gravity);
+					}
+
+					world.add_particle(&p);
+
+					if (x > 0) {
+						connect(&p, &particles[y * size + x - 1]);
+					}
+
+					if (y > 0) {
+						connect(&p, &particles[(y - 1) * size + x]);
+					}
+				}
+			}
+		}
+
+		void connect(phys::particle * a, phys::particle * b) {
+			constraints.push_back(std::make_unique<phys::distance_constraint>(a, b, 1.0_r, 1.0_r));
+			world.add_fixed_constraint(constraints.back().get());
+		}
+
+		void run(size_t num_frames) {
+			for (size_t i = 0; i < num_frames; i++) {
+				world.prepare_frame();
+				world.run_physics(0.01_r);
+			}
+		}
+
+		phys::real max_error() const {
+			phys::real out = 0.0_r;
+
+			for (const auto &c : constraints) {
+				out = std::max(out, std::abs(c->eval_constraint()));
+			}
+
+			return out;
+		}
+	};
+
+	// A chain of particles connected by compliant distance constraints, hanging
+	// from its top particle
+	struct chain {
+		std::vector<phys::particle> particles{};
+		std::vector<std::unique_ptr<phys::distance_constraint>> links{};
+		phys::particle_gravity gravity{ phys::vec3(0.0_r, -9.8_r, 0.0_r) };
+		phys::particle_world world;
+
+		chain(size_t num_particles, size_t solver_iterations, phys::solver_mode mode, phys::real compliance) :
+			particles(num_particles),
+			// Particles that barely move are held in place, which would stop the chain
+			// before it settles
+			world(solver_iterations, 0.0_r)
+		{
+			world.set_solver_mode(mode);
+
+			for (size_t i = 0; i < num_particles; i++) {
+				phys::particle &p = particles[i];
+
+				p.pos = phys::vec3(0.0_r, -(phys::real)i, 0.0_r);
+
+				if (i == 0) {
+					p.set_mass(phys::infinity);
+				} else {
+					world.force_registry.add(&p, &gravity);
+				}
+
+				world.add_particle(&p);
+
+				if (i > 0) {
+					links.push_back(std::make_unique<phys::distance_constraint>(&p, &particles[i - 1], 1.0_r, 1.0_r));
+					links.back()->compliance = compliance;
+					world.add_fixed_constraint(links.back().get());
+				}
+			}
+		}
+
+		void run(size_t num_frames, phys::real dt) {
+			for (size_t i = 0; i < num_frames; i++) {
+				world.prepare_frame();
+				world.run_physics(dt);
+			}
+		}
+
+		phys::real length() const {
+			return particles[0].pos.y - particles.back().pos.y;
+		}
+	};
+
+	// Applies no force, but counts how many times it was updated
+	struct counting_force_generator : public phys::particle_force_generator {
+		size_t num_updates{};
+
+		void update_force(phys::particle &, phys::real) override {
+			num_updates++;
+		}
+	};
+
+	// Applies no force, but counts how many batches and particles it was given
+	struct batch_counting_force_generator : public phys::particle_force_generator {
+		size_t num_batches{};
+		size_t num_particles{};
+
+		void update_force(phys::particle &, phys::real) override {}
+
+		void update_forces(std::span<phys::particle * const> particles, phys::real) override {
+			num_batches++;
+			num_particles += particles.size();
+		}
+	};
+
+	// Two particles connected by a distance constraint, and a third particle on its
+	// own. All three are still.
+	struct resting_particles {
+		std::vector<phys::particle> particles{ 3 };
+		phys::distance_constraint link;
+		phys::particle_world world;
+
+		resting_particles() :
+			link(&particles[0], &particles[1], 1.0_r, 1.0_r),
+			world(4)
+		{
+			world.set_sleep_thresholds(0.01_r, 0.5_r);
+
+			for (size_t i = 0; i < particles.size(); i++) {
+				particles[i].pos = phys::vec3(2.0_r * (phys::real)i, 0.0_r, 0.0_r);
+				particles[i].radius = 0.5_r;
+				world.add_particle(&particles[i]);
+			}
+
+			particles[1].pos.x = 1.0_r;
+			world.add_fixed_constraint(&link);
+		}
+
+		void run(size_t num_frames) {
+			for (size_t i = 0; i < num_frames; i++) {
+				world.prepare_frame();
+				world.run_physics(0.01_r);
+			}
+		}
+	};
+
+	// The integration that `particle_world` did before particles were kept in a
+	// `particle_store`, with no forces and no constraints. The store only changes
+	// which particles are integrated, so the results should be the same.
+	void reference_step(std::vector<phys::particle> &particles, phys::real dt, phys::real min_pos_change_sqr) {
+		for (phys::particle &p : particles) {
+			p.vel += (dt * p.get_inv_mass() * p.force * p.damping);
+		}
+
+		for (phys::particle &p : particles) {
+			p.p = p.pos + dt * p.vel;
+		}
+
+		for (phys::particle &p : particles) {
+			const phys::vec3 dp = p.pos - p.p;
+
+			if (phys::dot(dp, dp) <= min_pos_change_sqr) {
+				p.p = p.pos;
+			}
+
+			p.vel = (p.p - p.pos) / dt;
+			p.pos = p.p;
+		}
+	}
+
+	std::vector<phys::particle> moving_particles(size_t num_particles, unsigned int seed) {
+		std::mt19937 gen(seed);
+		std::uniform_real_distribution<phys::real> distrib(-1.0_r, 1.0_r);
+		std::vector<phys::particle> out(num_particles);
+
+		for (size_t i = 0; i < num_particles; i++) {
+			phys::particle &p = out[i];
+
+			p.pos = phys::vec3(distrib(gen), distrib(gen), distrib(gen)) * 100.0_r;
+			p.vel = phys::vec3(distrib(gen), distrib(gen), distrib(gen));
+			p.force = phys::vec3(distrib(gen), distrib(gen), distrib(gen));
+
+			// Some particles are slow enough to be held in place
+			if (i % 4 == 0) {
+				p.vel *= 0.0001_r;
+				p.force = phys::vec3(0.0_r);
+			}
+
+			if (i % 3 == 0) {
+				p.set_mass(2.0_r);
+			}
+		}
+
+		return out;
+	}
+}
+
+void setup_particle_world_tests() {
+	describe("Particle store", []() {
+		it("invalidates handles to removed particles", []() {
+			phys::particle a{};
+			phys::particle b{};
+			phys::particle c{};
+			phys::particle_store store{};
+
+			phys::particle_handle ha = store.add(&a);
+			phys::particle_handle hb = store.add(&b);
+
+			expect(store.size()).to_be(2);
+			expect(store.get(ha)).to_be(&a);
+			expect(store.get(hb)).to_be(&b);
+
+			expect(store.remove(ha)).to_be(true);
+			expect(store.remove(ha)).to_be(false);
+			expect(store.get(ha) == nullptr).to_be(true);
+			expect(store.get(hb)).to_be(&b);
+
+			phys::particle_handle hc = store.add(&c);
+
+			expect(hc.index).to_be(ha.index);
+			expect(hc == ha).to_be(false);
+			expect(store.get(ha) == nullptr).to_be(true);
+			expect(store.get(hc)).to_be(&c);
+			expect(store.size()).to_be(2);
+
+			expect(store.remove(&b)).to_be(true);
+			expect(store.remove(&b)).to_be(false);
+			expect(store.get(hb) == nullptr).to_be(true);
+			expect(store.get(hc)).to_be(&c);
+			expect(store.size()).to_be(1);
+		});
+	});
+
+	describe("Thread pool", []() {
+		it("processes every item exactly once", []() {
+			phys::thread_pool pool(4);
+			std::vector<std::atomic<int>> counts(10000);
+
+			pool.parallel_for(counts.size(), 64, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) {
+					counts[i]++;
+				}
+			});
+
+			for (size_t i = 0; i < counts.size(); i++) {
+				if (counts[i] != 1) {
+					fail("expected item " + std::to_string(i) + " to be processed once");
+				}
+			}
+		});
+
+		it("runs everything on the calling thread if it has no workers", []() {
+			phys::thread_pool pool(0);
+			std::set<std::thread::id> threads{};
+
+			pool.parallel_for(1000, 10, [&](size_t, size_t) {
+				threads.insert(std::this_thread::get_id());
+			});
+
+			expect(pool.num_threads()).to_be(0);
+			expect(threads.size()).to_be(1);
+			expect(*std::begin(threads) == std::this_thread::get_id()).to_be(true);
+		});
+
+		it("can be reused for many small jobs", []() {
+			phys::thread_pool pool(3);
+			std::atomic<size_t> total{};
+
+			for (size_t i = 0; i < 2000; i++) {
+				pool.parallel_for(16, 1, [&](size_t begin, size_t end) {
+					total += end - begin;
+				});
+			}
+
+			expect((size_t)total).to_be(2000 * 16);
+		});
+	});
+
+	describe("Particle force registry", []() {
+		it("updates all of a generator's particles with one call", []() {
+			std::vector<phys::particle> particles(100);
+			batch_counting_force_generator a{};
+			batch_counting_force_generator b{};
+			phys::particle_force_registry registry{};
+
+			for (size_t i = 0; i < particles.size(); i++) {
+				registry.add(&particles[i], (i % 4 == 0) ? &a : &b);
+			}
+
+			registry.update_forces(0.01_r);
+
+			expect(a.num_batches).to_be(1);
+			expect(a.num_particles).to_be(25);
+			expect(b.num_batches).to_be(1);
+			expect(b.num_particles).to_be(75);
+		});
+
+		it("removes registrations with handles", []() {
+			std::vector<phys::particle> particles(3);
+			phys::particle_gravity gravity(phys::vec3(0.0_r, -10.0_r, 0.0_r));
+			phys::particle_force_registry registry{};
+
+			registry.add(&particles[0], &gravity);
+			phys::particle_force_handle h1 = registry.add(&particles[1], &gravity);
+			registry.add(&particles[2], &gravity);
+
+			expect(registry.remove(h1)).to_be(true);
+			expect(registry.remove(h1)).to_be(false);
+
+			phys::particle_force_handle h3 = registry.add(&particles[1], &gravity);
+
+			expect(h3.index).to_be(h1.index);
+			expect(h3 == h1).to_be(false);
+			expect(registry.remove(h1)).to_be(false);
+
+			registry.remove(&particles[2], &gravity);
+			registry.update_forces(0.01_r);
+
+			expect(particles[0].force).to_be(gravity.gravity);
+			expect(particles[1].force).to_be(gravity.gravity);
+			expect(particles[2].force).to_be(phys::vec3(0.0_r));
+		});
+
+		it("gives the same forces in batches as one particle at a time", []() {
+			std::vector<phys::particle> expected = moving_particles(1001, 11);
+			phys::particle_gravity gravity(phys::vec3(0.0_r, -9.8_r, 0.0_r));
+			phys::particle_drag drag(0.1_r, 0.01_r);
+			phys::particle_force_registry registry{};
+
+			for (size_t i = 0; i < expected.size(); i += 5) {
+				expected[i].set_mass(phys::infinity);
+			}
+
+			std::vector<phys::particle> actual = expected;
+
+			for (phys::particle &p : expected) {
+				gravity.update_force(p, 0.01_r);
+				drag.update_force(p, 0.01_r);
+			}
+
+			for (phys::particle &p : actual) {
+				registry.add(&p, &gravity);
+				registry.add(&p, &drag);
+			}
+
+			registry.update_forces(0.01_r);
+
+			for (size_t i = 0; i < expected.size(); i++) {
+				const phys::vec3 diff = expected[i].force - actual[i].force;
+
+				if (phys::dot(diff, diff) > 1e-10_r) {
+					fail("expected particle " + std::to_string(i) + " to get the same force");
+				}
+			}
+		});
+
+		// The test runner prints the time taken by each test
+		describe("benchmark (50000 particles with gravity and drag, 100 updates)", []() {
+			it("one virtual call per particle", []() {
+				std::vector<phys::particle> particles = moving_particles(50000, 13);
+				phys::particle_gravity gravity(phys::vec3(0.0_r, -9.8_r, 0.0_r));
+				phys::particle_drag drag(0.1_r, 0.01_r);
+				std::vector<std::pair<phys::particle *, phys::particle_force_generator *>> registrations{};
+
+				for (phys::particle &p : particles) {
+					registrations.push_back({ &p, &gravity });
+					registrations.push_back({ &p, &drag });
+				}
+
+				for (size_t i = 0; i < 100; i++) {
+					for (auto &[p, fg] : registrations) {
+						fg->update_force(*p, 0.01_r);
+					}
+				}
+
+				expect(particles[1].force).naht().to_be(phys::vec3(0.0_r));
+			});
+
+			it("batched registry", []() {
+				std::vector<phys::particle> particles = moving_particles(50000, 13);
+				phys::particle_gravity gravity(phys::vec3(0.0_r, -9.8_r, 0.0_r));
+				phys::particle_drag drag(0.1_r, 0.01_r);
+				phys::particle_force_registry registry{};
+
+				for (phys::particle &p : particles) {
+					registry.add(&p, &gravity);
+					registry.add(&p, &drag);
+				}
+
+				for (size_t i = 0; i < 100; i++) {
+					registry.update_forces(0.01_r);
+				}
+
+				expect(particles[1].force).naht().to_be(phys::vec3(0.0_r));
+			});
+		});
+	});
+
+	describe("Particle world", []() {
+		it("integrates particles the same way as it did with pointer-based storage", []() {
+			std::vector<phys::particle> expected = moving_particles(1001, 42);
+			std::vector<phys::particle> actual = expected;
+			phys::particle_world world(4);
+
+			for (phys::particle &p : actual) {
+				world.add_particle(&p);
+			}
+
+			for (size_t frame = 0; frame < 10; frame++) {
+				reference_step(expected, 0.01_r, 0.00005_r * 0.00005_r);
+				world.run_physics(0.01_r);
+			}
+
+			for (size_t i = 0; i < expected.size(); i++) {
+				if (expected[i].pos != actual[i].pos ||
+					expected[i].vel != actual[i].vel ||
+					expected[i].p != actual[i].p) {
+					fail("expected particle " + std::to_string(i) + " to be integrated the same way");
+				}
+			}
+		});
+
+		it("stops integrating removed particles", []() {
+			std::vector<phys::particle> particles = moving_particles(3, 1);
+			phys::particle_world world(4);
+
+			phys::particle_handle h0 = world.add_particle(&particles[0]);
+			world.add_particle(&particles[1]);
+			phys::particle_handle h2 = world.add_particle(&particles[2]);
+
+			world.remove_particle(h0);
+			world.remove_particle(&particles[1]);
+
+			phys::vec3 pos0 = particles[0].pos;
+			phys::vec3 pos1 = particles[1].pos;
+			phys::vec3 pos2 = particles[2].pos;
+
+			world.run_physics(0.01_r);
+
+			expect(particles[0].pos).to_be(pos0);
+			expect(particles[1].pos).to_be(pos1);
+			expect(particles[2].pos).naht().to_be(pos2);
+			expect(world.get_particle(h0) == nullptr).to_be(true);
+			expect(world.get_particle(h2)).to_be(&particles[2]);
+		});
+
+		describe("with a thread pool", []() {
+			it("colors constraints so that no two constraints of a color share a particle", []() {
+				phys::thread_pool pool(2);
+				cloth c(20, &pool);
+
+				c.run(1);
+
+				const auto &w = c.world;
+
+				expect(w.colored_constraints.size()).to_be(c.constraints.size());
+				expect(w.color_offsets[phys::particle_world::max_colors + 1]).to_be(c.constraints.size());
+
+				std::set<phys::constraint *> seen{};
+
+				for (size_t color = 0; color < phys::particle_world::max_colors; color++) {
+					std::set<const phys::particle *> used{};
+
+					for (size_t i = w.color_offsets[color]; i < w.color_offsets[color + 1]; i++) {
+						seen.insert(w.colored_constraints[i]);
+
+						for (const phys::particle * p : w.colored_constraints[i]->get_particles()) {
+							if (! used.insert(p).second) {
+								fail("expected particles to be used by at most one constraint of color " + std::to_string(color));
+							}
+						}
+					}
+				}
+
+				expect(seen.size()).to_be(c.constraints.size());
+			});
+
+			it("gives the same result with any number of threads", []() {
+				phys::thread_pool serial_pool(0);
+				phys::thread_pool parallel_pool(4);
+				cloth serial(40, &serial_pool);
+				cloth parallel(40, &parallel_pool);
+
+				serial.run(10);
+				parallel.run(10);
+
+				for (size_t i = 0; i < serial.particles.size(); i++) {
+					if (serial.particles[i].pos != parallel.particles[i].pos) {
+						fail("expected particle " + std::to_string(i) + " to end up in the same place");
+					}
+				}
+			});
+
+			it("holds a cloth together as well as the serial solver", []() {
+				phys::thread_pool pool(4);
+				cloth serial(40, nullptr);
+				cloth parallel(40, &pool);
+
+				serial.run(30);
+				parallel.run(30);
+
+				expect(parallel.max_error()).to_be_less_than(serial.max_error() * 1.5_r + 0.01_r);
+			});
+		});
+
+		describe("in XPBD mode", []() {
+			it("stretches a compliant constraint like a spring", []() {
+				// Zero compliance is perfectly stiff, and the spring constant is the
+				// inverse of the compliance
+				chain stiff(2, 4, phys::solver_mode::XPBD, 0.0_r);
+				chain spring(2, 4, phys::solver_mode::XPBD, 0.01_r);
+
+				stiff.run(1500, 0.01_r);
+				spring.run(1500, 0.01_r);
+
+				expect(std::abs(stiff.length() - 1.0_r)).to_be_less_than(1e-3_r);
+				// The spring stretches by mg / k. Particles scale forces by their damping.
+				expect(std::abs(spring.length() - (1.0_r + 9.8_r * 0.995_r * 0.01_r))).to_be_less_than(2e-3_r);
+			});
+
+			it("makes constraints as stiff with any number of iterations and any timestep", []() {
+				// Each link holds up the particles below it, so the links stretch by
+				// 4, 3, 2, and 1 times mg / k
+				const phys::real expected = 4.0_r + 10.0_r * 9.8_r * 0.995_r * 0.001_r;
+				chain few(5, 8, phys::solver_mode::XPBD, 0.001_r);
+				chain many(5, 64, phys::solver_mode::XPBD, 0.001_r);
+				chain small_steps(5, 8, phys::solver_mode::XPBD, 0.001_r);
+
+				few.run(2000, 0.01_r);
+				many.run(2000, 0.01_r);
+				small_steps.run(4000, 0.005_r);
+
+				expect(std::abs(few.length() - expected)).to_be_less_than(1e-3_r);
+				expect(std::abs(many.length() - expected)).to_be_less_than(1e-3_r);
+				expect(std::abs(small_steps.length() - expected)).to_be_less_than(1e-3_r);
+
+				// With PBD, the same stiffness gives a softer chain at a larger timestep
+				chain pbd(5, 8, phys::solver_mode::PBD, 0.0_r);
+				chain pbd_small_steps(5, 8, phys::solver_mode::PBD, 0.0_r);
+
+				for (auto &link : pbd.links) {
+					link->stiffness = 0.5_r;
+				}
+
+				for (auto &link : pbd_small_steps.links) {
+					link->stiffness = 0.5_r;
+				}
+
+				pbd.run(2000, 0.01_r);
+				pbd_small_steps.run(4000, 0.005_r);
+
+				expect(pbd.length() - pbd_small_steps.length()).naht().to_be_less_than(0.01_r);
+			});
+
+			it("gets a compliance from the stiffness of constraints without one", []() {
+				chain stiff(2, 4, phys::solver_mode::XPBD, 0.0_r);
+				chain soft(2, 4, phys::solver_mode::XPBD, 0.0_r);
+
+				stiff.links[0]->compliance.reset();
+				soft.links[0]->compliance.reset();
+				soft.links[0]->stiffness = 0.1_r;
+
+				stiff.run(1500, 0.01_r);
+				soft.run(1500, 0.01_r);
+
+				// A stiffness of one is still perfectly stiff, and a lower stiffness is
+				// no longer ignored
+				expect(std::abs(stiff.length() - 1.0_r)).to_be_less_than(1e-3_r);
+				expect(1.005_r).to_be_less_than(soft.length());
+				expect(soft.length()).to_be_less_than(1.1_r);
+			});
+
+			it("doesn't let a contact pull once it's separating", []() {
+				phys::particle p{};
+				phys::plane_collision_constraint c(&p, phys::vec3(0.0_r, 1.0_r, 0.0_r), phys::vec3(0.0_r), 0.0_r, 0.0_r);
+
+				c.compliance = 1.0_r;
+				c.reset_lambda();
+
+				// Pushes the particle up by half its depth
+				p.p = phys::vec3(0.0_r, -1.0_r, 0.0_r);
+				c.project_xpbd(1.0_r);
+
+				expect(p.p.y).to_be(-0.5_r);
+
+				// Something else moves the particle far above the plane. The contact can
+				// take back its push, but can't pull the particle any further.
+				p.p = phys::vec3(0.0_r, 2.0_r, 0.0_r);
+				c.project_xpbd(1.0_r);
+
+				expect(p.p.y).to_be(1.5_r);
+
+				c.project_xpbd(1.0_r);
+
+				expect(p.p.y).to_be(1.5_r);
+			});
+		});
+
+		describe("with continuous collision detection", []() {
+			it("stops fast particles at a thin floor", []() {
+				std::vector<phys::particle> particles(3);
+				const phys::vec3 a(-10.0_r, 0.0_r, -10.0_r);
+				const phys::vec3 b(10.0_r, 0.0_r, -10.0_r);
+				const phys::vec3 c(10.0_r, 0.0_r, 10.0_r);
+				const phys::vec3 d(-10.0_r, 0.0_r, 10.0_r);
+				phys::static_mesh_collision_constraint_generator floor(
+					particles,
+					{ phys::triangle{ a, c, b }, phys::triangle{ a, d, c } },
+					0.0_r,
+					0.0_r
+				);
+				phys::particle_world world(4);
+
+				for (size_t i = 0; i < particles.size(); i++) {
+					phys::particle &p = particles[i];
+
+					p.pos = phys::vec3((phys::real)i, 1.0_r, 0.0_r);
+					// Moves 2 to 4 units in each frame, much further than its radius
+					p.vel = phys::vec3(0.0_r, -200.0_r * (phys::real)(i + 1), 0.0_r);
+					p.radius = 0.1_r;
+					world.add_particle(&p);
+				}
+
+				world.add_constraint_generator(&floor);
+
+				for (size_t i = 0; i < 20; i++) {
+					world.prepare_frame();
+					world.run_physics(0.01_r);
+				}
+
+				for (const phys::particle &p : particles) {
+					expect(p.pos.y).naht().to_be_less_than(0.1_r - 1e-4_r);
+				}
+			});
+
+			it("doesn't let fast particles pass through each other", []() {
+				std::vector<phys::particle> particles(2);
+				phys::particle_collision_constraint_generator collisions(particles, 1.0_r, 0.0_r);
+				phys::particle_world world(4);
+
+				collisions.continuous = true;
+
+				particles[0].pos = phys::vec3(-3.0_r, 0.0_r, 0.0_r);
+				particles[0].vel = phys::vec3(500.0_r, 0.0_r, 0.0_r);
+				particles[1].pos = phys::vec3(3.0_r, 0.0_r, 0.0_r);
+				particles[1].vel = phys::vec3(-500.0_r, 0.0_r, 0.0_r);
+
+				for (phys::particle &p : particles) {
+					p.radius = 0.5_r;
+					world.add_particle(&p);
+				}
+
+				world.add_constraint_generator(&collisions);
+
+				for (size_t i = 0; i < 5; i++) {
+					world.prepare_frame();
+					world.run_physics(0.01_r);
+
+					expect(particles[0].pos.x).to_be_less_than(particles[1].pos.x);
+				}
+
+				// They bounce off of each other
+				expect(particles[0].vel.x).to_be_less_than(0.0_r);
+				expect(particles[1].vel.x).naht().to_be_less_than(0.0_r);
+			});
+		});
+
+		describe("with substeps", []() {
+			it("moves particles the same way as one frame per substep", []() {
+				std::vector<phys::particle> expected = moving_particles(101, 3);
+				std::vector<phys::particle> actual = expected;
+				phys::particle_gravity gravity(phys::vec3(0.0_r, -9.8_r, 0.0_r));
+				phys::particle_world expected_world(4);
+				phys::particle_world actual_world(4);
+
+				for (size_t i = 0; i < expected.size(); i++) {
+					expected_world.add_particle(&expected[i]);
+					expected_world.force_registry.add(&expected[i], &gravity);
+					actual_world.add_particle(&actual[i]);
+					actual_world.force_registry.add(&actual[i], &gravity);
+				}
+
+				for (size_t frame = 0; frame < 5; frame++) {
+					for (size_t i = 0; i < 4; i++) {
+						expected_world.prepare_frame();
+						expected_world.run_physics(0.01_r);
+					}
+
+					actual_world.step(0.04_r, 4);
+				}
+
+				for (size_t i = 0; i < expected.size(); i++) {
+					if (expected[i].pos != actual[i].pos || expected[i].vel != actual[i].vel) {
+						fail("expected particle " + std::to_string(i) + " to be moved the same way");
+					}
+				}
+			});
+
+			it("finds collisions between particles that only touch in a later substep", []() {
+				std::vector<phys::particle> particles(2);
+				phys::particle_collision_constraint_generator collisions(particles, 1.0_r, 0.0_r);
+				phys::particle_world world(4);
+
+				// They're 3.5 units apart at the start of the frame, and they would move
+				// 2 units towards each other in each substep
+				particles[0].pos = phys::vec3(-2.25_r, 0.0_r, 0.0_r);
+				particles[0].vel = phys::vec3(100.0_r, 0.0_r, 0.0_r);
+				particles[1].pos = phys::vec3(2.25_r, 0.0_r, 0.0_r);
+				particles[1].vel = phys::vec3(-100.0_r, 0.0_r, 0.0_r);
+
+				for (phys::particle &p : particles) {
+					p.radius = 0.5_r;
+					world.add_particle(&p);
+				}
+
+				world.add_constraint_generator(&collisions);
+
+				for (size_t i = 0; i < 5; i++) {
+					world.step(0.04_r, 4);
+
+					expect(particles[0].pos.x).to_be_less_than(particles[1].pos.x);
+				}
+
+				expect(particles[0].vel.x).to_be_less_than(0.0_r);
+				expect(particles[1].vel.x).naht().to_be_less_than(0.0_r);
+			});
+
+			it("reports how long each stage took", []() {
+				std::vector<phys::particle> particles = moving_particles(1000, 5);
+				phys::particle_collision_constraint_generator collisions(particles, 0.5_r, 0.0_r);
+				phys::particle_world world(4);
+
+				for (phys::particle &p : particles) {
+					p.radius = 5.0_r;
+					world.add_particle(&p);
+				}
+
+				world.add_constraint_generator(&collisions);
+				world.step(0.04_r, 4);
+
+				const phys::step_timings &timings = world.get_step_timings();
+
+				expect(timings.candidates.count()).naht().to_be(0);
+				expect(timings.integration.count()).naht().to_be(0);
+				expect(timings.constraint_generation.count()).naht().to_be(0);
+				expect(timings.projection.count()).naht().to_be(0);
+			});
+		});
+
+		describe("with sleeping", []() {
+			it("puts islands that stay still for long enough to sleep", []() {
+				resting_particles r{};
+				counting_force_generator counter{};
+
+				r.particles[2].vel = phys::vec3(0.0_r, 1.0_r, 0.0_r);
+				r.world.force_registry.add(&r.particles[0], &counter);
+
+				r.run(40);
+
+				expect(r.particles[0].is_asleep()).to_be(false);
+
+				r.run(20);
+
+				expect(r.particles[0].is_asleep()).to_be(true);
+				expect(r.particles[1].is_asleep()).to_be(true);
+				expect(r.particles[2].is_asleep()).to_be(false);
+
+				// Sleeping particles' forces aren't updated, and they aren't moved
+				const size_t num_updates = counter.num_updates;
+				const phys::vec3 pos2 = r.particles[2].pos;
+
+				r.run(20);
+
+				expect(counter.num_updates).to_be(num_updates);
+				expect(r.particles[0].pos).to_be(phys::vec3(0.0_r));
+				expect(r.particles[2].pos).naht().to_be(pos2);
+			});
+
+			it("wakes the whole island when one of its particles is woken", []() {
+				resting_particles r{};
+
+				r.run(60);
+
+				expect(r.particles[2].is_asleep()).to_be(true);
+
+				r.world.wake_particle(&r.particles[1]);
+
+				expect(r.particles[0].is_asleep()).to_be(false);
+				expect(r.particles[1].is_asleep()).to_be(false);
+				expect(r.particles[2].is_asleep()).to_be(true);
+			});
+
+			it("wakes a sleeping island when an awake particle collides with it", []() {
+				resting_particles r{};
+				phys::particle_collision_constraint_generator collisions(r.particles, 0.5_r, 0.0_r);
+
+				r.world.add_constraint_generator(&collisions);
+				r.run(60);
+
+				expect(r.particles[0].is_asleep()).to_be(true);
+
+				// Thrown at the sleeping pair from the side
+				r.particles[2].pos = phys::vec3(5.0_r, 0.0_r, 0.0_r);
+				r.particles[2].vel = phys::vec3(-5.0_r, 0.0_r, 0.0_r);
+				r.world.wake_particle(&r.particles[2]);
+
+				r.run(100);
+
+				expect(r.particles[0].pos.x).to_be_less_than(0.0_r);
+				expect(r.particles[1].pos.x).to_be_less_than(r.particles[2].pos.x);
+			});
+
+			it("doesn't generate collision constraints between sleeping particles", []() {
+				resting_particles r{};
+				phys::particle_collision_constraint_generator collisions(r.particles, 0.5_r, 0.0_r);
+				phys::constraint_arena constraints{};
+
+				r.run(60);
+
+				// The linked pair overlaps, but both of its particles are asleep
+				r.particles[0].radius = 0.75_r;
+				r.particles[1].radius = 0.75_r;
+				collisions.generate_constraints(0.01_r, constraints);
+
+				expect(constraints.size()).to_be(0);
+
+				// An awake particle that touches both of them
+				r.world.wake_particle(&r.particles[2]);
+				r.particles[2].p = phys::vec3(1.5_r, 0.0_r, 0.0_r);
+				r.particles[2].radius = 1.0_r;
+				collisions.generate_constraints(0.01_r, constraints);
+
+				expect(constraints.size()).to_be(2);
+
+				for (const phys::constraint * c : constraints) {
+					const auto * pc = dynamic_cast<const phys::particle_collision_constraint *>(c);
+
+					expect(pc->b()).to_be(&r.particles[2]);
+				}
+			});
+
+			it("stops sleeping when sleeping is turned off", []() {
+				resting_particles r{};
+
+				r.run(60);
+				r.world.set_sleep_thresholds(0.0_r, 0.5_r);
+
+				for (const phys::particle &p : r.particles) {
+					expect(p.is_asleep()).to_be(false);
+				}
+
+				r.run(60);
+
+				for (const phys::particle &p : r.particles) {
+					expect(p.is_asleep()).to_be(false);
+				}
+			});
+		});
+
+		describe("solver stats", []() {
+			it("counts iterations and measures the error after each one", []() {
+				cloth c(20, nullptr);
+
+				c.run(1);
+
+				const phys::solver_stats &stats = c.world.get_solver_stats();
+
+				expect(stats.iterations).to_be(16);
+				expect(stats.errors.size()).to_be(17);
+				expect(stats.get_fixed_projections()).naht().to_be(0);
+				expect(stats.projections.size()).to_be(1);
+
+				for (const phys::solver_error &e : stats.errors) {
+					expect(e.num_constraints).to_be(c.constraints.size());
+					expect(e.max).naht().to_be_less_than(e.rms());
+				}
+
+				expect(stats.errors.back().max).to_be_less_than(stats.errors.front().max);
+				expect(std::abs(stats.errors.back().max - c.max_error())).to_be_less_than(1e-4_r);
+			});
+
+			it("stops counting iterations when every constraint is satisfied", []() {
+				resting_particles r{};
+
+				r.run(1);
+
+				const phys::solver_stats &stats = r.world.get_solver_stats();
+
+				expect(stats.iterations).to_be(0);
+				expect(stats.errors.size()).to_be(1);
+				expect(stats.errors[0].max).to_be(0.0_r);
+				expect(stats.errors[0].num_constraints).to_be(1);
+			});
+
+			it("counts the projections of each constraint generator", []() {
+				resting_particles r{};
+				phys::plane_collision_constraint_generator floor(r.particles, phys::vec3(0.0_r, 1.0_r, 0.0_r), phys::vec3(0.0_r), 0.0_r, 0.0_r);
+				phys::particle_collision_constraint_generator collisions(r.particles, 0.0_r, 0.0_r);
+
+				// Every particle falls through the floor in one step, and neighboring
+				// particles overlap
+				for (phys::particle &p : r.particles) {
+					p.radius = 0.75_r;
+					p.vel = phys::vec3(0.0_r, -10.0_r, 0.0_r);
+				}
+
+				r.particles[2].pos.x = 1.5_r;
+				r.world.add_constraint_generator(&collisions);
+				r.world.add_constraint_generator(&floor);
+				r.run(1);
+
+				const phys::solver_stats &stats = r.world.get_solver_stats();
+
+				expect(stats.projections.size()).to_be(3);
+				expect(stats.get_generator_projections(0)).naht().to_be(0);
+				expect(stats.get_generator_projections(1)).naht().to_be(0);
+			});
+
+			it("only measures the error in sampled steps", []() {
+				cloth c(5, nullptr);
+
+				c.world.set_error_sample_interval(3);
+
+				for (size_t i = 0; i < 6; i++) {
+					c.run(1);
+
+					const phys::solver_stats &stats = c.world.get_solver_stats();
+
+					expect(stats.iterations).naht().to_be(0);
+					expect(stats.errors.empty()).to_be((i % 3) != 0);
+				}
+
+				c.world.set_error_sample_interval(0);
+				c.run(1);
+
+				expect(c.world.get_solver_stats().errors.empty()).to_be(true);
+			});
+
+			it("describes the stats as JSON", []() {
+				cloth c(5, nullptr);
+
+				c.run(1);
+
+				const phys::solver_stats &stats = c.world.get_solver_stats();
+				json j = phys::to_json(stats);
+				json_object * root = j.get(std::get<json_object_descriptor>(j.get_root())).value();
+				json_array * errors = j.get(std::get<json_array_descriptor>(root->at(L"errors"))).value();
+				json_object * projections = j.get(std::get<json_object_descriptor>(root->at(L"projections"))).value();
+				json_object * timings = j.get(std::get<json_object_descriptor>(root->at(L"timings"))).value();
+
+				expect(root->at(L"iterations")).to_be(json_value_or_descriptor((long)stats.iterations));
+				expect(errors->size()).to_be(stats.errors.size());
+				expect(projections->at(L"fixed")).to_be(json_value_or_descriptor((long)stats.get_fixed_projections()));
+				expect(timings->at(L"projection")).to_be(json_value_or_descriptor((long)stats.timings.projection.count()));
+
+				std::wstringstream wss{};
+
+				write_json(wss, j);
+
+				expect(wss.str().empty()).to_be(false);
+			});
+		});
+
+		// The test runner prints the time taken by each test
+		describe("benchmark (200000 particles, 10 frames)", []() {
+			it("pointer-based integration", []() {
+				std::vector<phys::particle> particles = moving_particles(200000, 7);
+
+				for (size_t frame = 0; frame < 10; frame++) {
+					reference_step(particles, 0.01_r, 0.00005_r * 0.00005_r);
+				}
+
+				expect(particles[1].pos).naht().to_be(phys::vec3(0.0_r));
+			});
+
+			it("particle_store integration", []() {
+				std::vector<phys::particle> particles = moving_particles(200000, 7);
+				phys::particle_world world(4);
+
+				for (phys::particle &p : particles) {
+					world.add_particle(&p);
+				}
+
+				for (size_t frame = 0; frame < 10; frame++) {
+					world.run_physics(0.01_r);
+				}
+
+				expect(particles[1].pos).naht().to_be(phys::vec3(0.0_r));
+			});
+		});
+
+		describe("benchmark (150x150 resting cloth, 50 frames)", []() {
+			it("without sleeping", []() {
+				cloth c(150, nullptr);
+
+				c.gravity.gravity = phys::vec3(0.0_r);
+				c.run(50);
+
+				expect(c.max_error()).to_be_less_than(0.01_r);
+			});
+
+			it("with sleeping", []() {
+				cloth c(150, nullptr);
+
+				c.gravity.gravity = phys::vec3(0.0_r);
+				c.world.set_sleep_thresholds(0.01_r, 0.1_r);
+				c.run(50);
+
+				expect(c.particles.back().is_asleep()).to_be(true);
+				expect(c.max_error()).to_be_less_than(0.01_r);
+			});
+		});
+
+		describe("benchmark (150x150 cloth, 5 frames)", []() {
+			it("serial solver", []() {
+				cloth c(150, nullptr);
+
+				c.run(5);
+
+				expect(c.max_error()).to_be_less_than(1.0_r);
+			});
+
+			it("parallel solver", []() {
+				phys::thread_pool pool{};
+				cloth c(150, &pool);
+
+				c.run(5);
+
+				expect(c.max_error()).to_be_less_than(1.0_r);
+			});
+		});
+	});
+}
@@ -0,0 +1,518 @@
+#define DEBUG
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <physics/collision/primitives.h>
+#include <physics/rigid_body_force_generators.h>
+#include <physics/rigid_body_world.h>
+#include <physics/thread_pool.h>
+#include "test.h"
+
+using namespace test;
+using namespace phys::literals;
+
+namespace {
+	constexpr phys::real frame_time = 1.0_r / 60.0_r;
+
+	phys::rigid_body body_a{};
+	phys::rigid_body body_b{};
+	phys::sphere sphere_a(&body_a, phys::identity<phys::mat4>(), 1.0_r);
+	phys::sphere sphere_b(&body_b, phys::identity<phys::mat4>(), 1.0_r);
+
+	// A world with a floor at y = 0 and gravity
+	struct scene {
+		phys::rigid_body_gravity gravity{ phys::vec3(0.0_r, -9.8_r, 0.0_r) };
+		phys::plane floor{ nullptr, phys::vec3(0.0_r, 1.0_r, 0.0_r), 0.0_r };
+		std::vector<std::unique_ptr<phys::rigid_body>> bodies{};
+		std::vector<std::unique_ptr<phys::primitive>> primitives{};
+		phys::rigid_body_world world;
+
+		scene(size_t solver_iterations, phys::thread_pool * pool = nullptr) :
+			world(solver_iterations, 0.1_r, pool)
+		{
+			world.add_primitive(&floor);
+		}
+
+		phys::rigid_body * add_body(const phys::vec3 &pos, const phys::quat &rot, phys::real mass, const phys::mat3 &inertia) {
+			bodies.push_back(std::make_unique<phys::rigid_body>());
+
+			phys::rigid_body * body = bodies.back().get();
+
+			body->pos = pos;
+			body->rot = rot;
+			body->set_mass(mass);
+			body->set_inertia_tensor(inertia);
+
+			world.add_body(body);
+			world.add_force_generator(body, &gravity);
+
+			return body;
+		}
+
+		phys::rigid_body * add_box(const phys::vec3 &pos, const phys::vec3 &half_size, const phys::quat &rot = phys::identity<phys::quat>()) {
+			phys::rigid_body * body = add_body(pos, rot, 1.0_r, phys::cuboid_inertia_tensor(1.0_r, half_size));
+
+			primitives.push_back(std::make_unique<phys::box>(body, phys::identity<phys::mat4>(), half_size));
+			world.add_primitive(primitives.back().get());
+
+			return body;
+		}
+
+		phys::rigid_body * add_sphere(const phys::vec3 &pos, phys::real radius) {
+			phys::rigid_body * body = add_body(pos, phys::identity<phys::quat>(), 1.0_r, phys::sphere_inertia_tensor(1.0_r, radius));
+
+			primitives.push_back(std::make_unique<phys::sphere>(body, phys::identity<phys::mat4>(), radius));
+			world.add_primitive(primitives.back().get());
+
+			return body;
+		}
+
+		phys::rigid_body * add_capsule(const phys::vec3 &pos, phys::real radius, phys::real half_height, const phys::quat &rot) {
+			phys::rigid_body * body = add_body(pos, rot, 1.0_r, phys::capsule_inertia_tensor(1.0_r, radius, half_height));
+
+			primitives.push_back(std::make_unique<phys::capsule>(body, phys::identity<phys::mat4>(), radius, half_height));
+			world.add_primitive(primitives.back().get());
+
+			return body;
+		}
+
+		phys::rigid_body * add_cylinder(const phys::vec3 &pos, phys::real radius, phys::real half_height) {
+			phys::rigid_body * body = add_body(pos, phys::identity<phys::quat>(), 1.0_r, phys::cylinder_inertia_tensor(1.0_r, radius, half_height));
+
+			primitives.push_back(std::make_unique<phys::cylinder>(body, phys::identity<phys::mat4>(), radius, half_height));
+			world.add_primitive(primitives.back().get());
+
+			return body;
+		}
+
+		void run(size_t num_frames) {
+			for (size_t i = 0; i < num_frames; i++) {
+				world.run_physics(frame_time);
+			}
+		}
+	};
+
+	// Boxes with a half size of 0.5 stacked on top of each other on the floor, each
+	// turned a little from the one below it. Returns the top box.
+	phys::rigid_body * add_box_stack(scene &s, const phys::vec3 &base, size_t height) {
+		phys::rigid_body * top = nullptr;
+
+		for (size_t i = 0; i < height; i++) {
+			const phys::real angle = (phys::real)i * 0.05_r;
+			const phys::quat rot(std::cos(angle), std::sin(angle) * phys::vec3(0.0_r, 1.0_r, 0.0_r));
+
+			top = s.add_box(base + phys::vec3(0.0_r, 0.5_r + (phys::real)i, 0.0_r), phys::vec3(0.5_r), rot);
+		}
+
+		return top;
+	}
+
+	// Spheres with a radius of 0.5 stacked on top of each other on the floor.
+	// Returns the top sphere.
+	phys::rigid_body * add_sphere_column(scene &s, const phys::vec3 &base, size_t height) {
+		phys::rigid_body * top = nullptr;
+
+		for (size_t i = 0; i < height; i++) {
+			top = s.add_sphere(base + phys::vec3(0.0_r, 0.5_r + (phys::real)i, 0.0_r), 0.5_r);
+		}
+
+		return top;
+	}
+
+	// How far the top of a column of spheres has sunk after resting for a few seconds
+	phys::real column_sag(size_t solver_iterations, bool warm_starting) {
+		scene s(solver_iterations);
+		phys::rigid_body * top = add_sphere_column(s, phys::vec3(0.0_r), 10);
+
+		s.world.solver.warm_starting = warm_starting;
+		s.run(240);
+
+		return 9.5_r - top->pos.y;
+	}
+
+	phys::contact make_contact(const phys::vec3 &point) {
+		return phys::contact(&body_a, &body_b, point, phys::vec3(0.0_r, 1.0_r, 0.0_r), 0.1_r);
+	}
+
+	phys::real length(const phys::vec3 &v) {
+		return std::sqrt(phys::dot(v, v));
+	}
+}
+
+void setup_rigid_body_world_tests() {
+	describe("Rigid body world", []() {
+		it("stops a falling sphere at the floor", []() {
+			scene s(10);
+			phys::rigid_body * sphere = s.add_sphere(phys::vec3(0.0_r, 3.0_r, 0.0_r), 0.5_r);
+
+			s.run(180);
+
+			expect(std::abs(sphere->pos.y - 0.5_r)).to_be_less_than(0.05_r);
+			expect(length(sphere->vel)).to_be_less_than(0.05_r);
+		});
+
+		it("stops a falling box at the floor", []() {
+			scene s(10);
+			phys::rigid_body * box = s.add_box(phys::vec3(0.0_r, 3.0_r, 0.0_r), phys::vec3(0.5_r));
+
+			s.run(180);
+
+			expect(std::abs(box->pos.y - 0.5_r)).to_be_less_than(0.05_r);
+			expect(length(box->vel)).to_be_less_than(0.05_r);
+			expect(length(box->ang_vel)).to_be_less_than(0.05_r);
+		});
+
+		it("lets a tilted box fall flat", []() {
+			scene s(10);
+			const phys::vec3 axis = phys::normalize(phys::vec3(1.0_r, 0.0_r, 1.0_r));
+			const phys::quat rot(std::cos(0.3_r), std::sin(0.3_r) * axis);
+			phys::rigid_body * box = s.add_box(phys::vec3(0.0_r, 2.0_r, 0.0_r), phys::vec3(0.5_r), rot);
+
+			s.run(300);
+
+			expect(std::abs(box->pos.y - 0.5_r)).to_be_less_than(0.05_r);
+			expect(length(box->vel)).to_be_less_than(0.05_r);
+
+			// One of the box's axes should be pointing straight up
+			const phys::mat4 &transform = box->get_transform();
+			const phys::real up = std::max({ std::abs(transform[0].y), std::abs(transform[1].y), std::abs(transform[2].y) });
+
+			expect(up).naht().to_be_less_than(0.99_r);
+		});
+
+		it("lays a falling capsule on the floor", []() {
+			scene s(10);
+			const phys::quat rot(std::cos(0.6_r), std::sin(0.6_r) * phys::vec3(0.0_r, 0.0_r, 1.0_r));
+			phys::rigid_body * capsule = s.add_capsule(phys::vec3(0.0_r, 3.0_r, 0.0_r), 0.25_r, 0.75_r, rot);
+
+			s.run(300);
+
+			expect(std::abs(capsule->pos.y - 0.25_r)).to_be_less_than(0.05_r);
+			expect(length(capsule->vel)).to_be_less_than(0.05_r);
+			// The capsule's axis should be flat
+			expect(std::abs(capsule->get_transform()[1].y)).to_be_less_than(0.05_r);
+		});
+
+		it("stands a cylinder on the floor", []() {
+			scene s(10);
+			phys::rigid_body * cylinder = s.add_cylinder(phys::vec3(0.0_r, 2.0_r, 0.0_r), 0.5_r, 0.5_r);
+
+			s.run(180);
+
+			expect(std::abs(cylinder->pos.y - 0.5_r)).to_be_less_than(0.05_r);
+			expect(length(cylinder->vel)).to_be_less_than(0.05_r);
+			expect(length(cylinder->ang_vel)).to_be_less_than(0.05_r);
+		});
+
+		it("does not test primitives of the same body against each other", []() {
+			scene s(10);
+			phys::rigid_body * body = s.add_sphere(phys::vec3(0.0_r, 5.0_r, 0.0_r), 0.5_r);
+			phys::sphere other(body, phys::translate(phys::vec3(0.5_r, 0.0_r, 0.0_r)), 0.5_r);
+
+			s.world.add_primitive(&other);
+			s.run(1);
+
+			expect(s.world.coarse_pairs.size()).to_be(1);
+			expect(s.world.get_contacts().size()).to_be(0);
+
+			s.world.remove_primitive(&other);
+		});
+
+		it("does not move bodies with infinite mass", []() {
+			scene s(10);
+			phys::rigid_body * box = s.add_box(phys::vec3(0.0_r, 0.25_r, 0.0_r), phys::vec3(0.5_r));
+			phys::rigid_body * sphere = s.add_sphere(phys::vec3(0.0_r, 1.2_r, 0.0_r), 0.5_r);
+
+			box->set_mass(phys::infinity);
+			s.run(120);
+
+			expect(box->pos).to_be(phys::vec3(0.0_r, 0.25_r, 0.0_r));
+			expect(std::abs(sphere->pos.y - 1.25_r)).to_be_less_than(0.05_r);
+		});
+
+		it("keeps a column of spheres up with fewer iterations when warm starting", []() {
+			const phys::real cold_sag = column_sag(16, false);
+			const phys::real warm_sag = column_sag(4, true);
+
+			expect(warm_sag).to_be_less_than(cold_sag);
+			expect(std::abs(warm_sag)).to_be_less_than(0.1_r);
+		});
+
+		it("forgets contacts between primitives that stopped overlapping", []() {
+			scene s(10);
+			phys::rigid_body * sphere = s.add_sphere(phys::vec3(0.0_r, 0.5_r, 0.0_r), 0.5_r);
+
+			s.run(1);
+
+			expect(s.world.persistent_contacts.size()).to_be(1);
+
+			sphere->pos.y = 5.0_r;
+			s.world.remove_primitive(&s.floor);
+			s.run(1);
+
+			expect(s.world.persistent_contacts.size()).to_be(0);
+		});
+
+		it("keeps a stack of boxes up, starting V-Clip from last frame's features", []() {
+			scene s(10);
+			phys::rigid_body * top = add_box_stack(s, phys::vec3(0.0_r), 5);
+
+			s.run(120);
+			s.world.persistent_features.reset_stats();
+			s.run(60);
+
+			const phys::feature_cache::statistics &stats = s.world.persistent_features.get_stats();
+
+			expect(std::abs(top->pos.y - 4.5_r)).to_be_less_than(0.05_r);
+			expect(std::abs(top->pos.x)).to_be_less_than(0.05_r);
+			expect(std::abs(top->pos.z)).to_be_less_than(0.05_r);
+			expect(stats.queries()).to_be(4 * 60);
+			expect(stats.misses).to_be(0);
+			expect(stats.steps_per_query()).to_be_less_than(2.0_r);
+		});
+
+		it("generates the same contacts and moves bodies the same way on a thread pool", []() {
+			phys::thread_pool pool(4);
+			scene serial(10);
+			scene parallel(10, &pool);
+
+			for (size_t i = 0; i < 30; i++) {
+				const phys::vec3 base((phys::real)(i % 6) * 2.0_r, 0.0_r, (phys::real)(i / 6) * 2.0_r);
+
+				add_box_stack(serial, base, 10);
+				add_box_stack(parallel, base, 10);
+			}
+
+			for (size_t frame = 0; frame < 30; frame++) {
+				serial.run(1);
+				parallel.run(1);
+
+				expect(parallel.world.collision_pairs.size()).naht().to_be_less_than(phys::min_parallel_narrowphase_pairs);
+
+				const phys::contact_container &expected = serial.world.get_contacts();
+				const phys::contact_container &actual = parallel.world.get_contacts();
+
+				expect(actual).to_have_size(expected.size());
+
+				for (size_t i = 0; i < expected.size(); i++) {
+					expect(actual[i].point).to_be(expected[i].point);
+					expect(actual[i].normal).to_be(expected[i].normal);
+					expect(actual[i].penetration).to_be(expected[i].penetration);
+					expect(actual[i].normal_impulse).to_be(expected[i].normal_impulse);
+				}
+			}
+
+			for (size_t i = 0; i < serial.bodies.size(); i++) {
+				expect(parallel.bodies[i]->pos).to_be(serial.bodies[i]->pos);
+				expect(parallel.bodies[i]->rot).to_be(serial.bodies[i]->rot);
+			}
+
+			expect(parallel.world.persistent_features.get_stats().hits)
+				.to_be(serial.world.persistent_features.get_stats().hits);
+		});
+
+		describe("contact solver", []() {
+			it("starts from the impulses stored in contacts when warm starting", []() {
+				phys::rigid_body body{};
+				phys::contact_solver solver(0);
+
+				body.vel = phys::vec3(0.0_r, -2.0_r, 0.0_r);
+				body.set_mass(2.0_r);
+				body.calculate_derived_data();
+
+				std::vector<phys::contact> contacts{
+					phys::contact(&body, nullptr, phys::vec3(0.0_r), phys::vec3(0.0_r, -1.0_r, 0.0_r), 0.0_r)
+				};
+
+				contacts[0].normal_impulse = 4.0_r;
+				solver.solve(contacts, frame_time);
+
+				expect(body.vel).to_be(phys::vec3(0.0_r));
+
+				body.vel = phys::vec3(0.0_r, -2.0_r, 0.0_r);
+				solver.warm_starting = false;
+				solver.solve(contacts, frame_time);
+
+				expect(body.vel).to_be(phys::vec3(0.0_r, -2.0_r, 0.0_r));
+				expect(contacts[0].normal_impulse).to_be(0.0_r);
+			});
+
+			it("never pulls bodies together", []() {
+				phys::rigid_body body{};
+				phys::contact_solver solver(10);
+
+				body.vel = phys::vec3(0.0_r, 1.0_r, 0.0_r);
+				body.calculate_derived_data();
+
+				std::vector<phys::contact> contacts{
+					phys::contact(&body, nullptr, phys::vec3(0.0_r), phys::vec3(0.0_r, -1.0_r, 0.0_r), 0.0_r)
+				};
+
+				solver.solve(contacts, frame_time);
+
+				expect(body.vel).to_be(phys::vec3(0.0_r, 1.0_r, 0.0_r));
+				expect(contacts[0].normal_impulse).to_be(0.0_r);
+			});
+
+			it("bounces bodies with restitution", []() {
+				phys::rigid_body body{};
+				phys::contact_solver solver(10);
+
+				body.vel = phys::vec3(0.0_r, -4.0_r, 0.0_r);
+				body.calculate_derived_data();
+				solver.restitution = 0.5_r;
+
+				std::vector<phys::contact> contacts{
+					phys::contact(&body, nullptr, phys::vec3(0.0_r), phys::vec3(0.0_r, -1.0_r, 0.0_r), 0.0_r)
+				};
+
+				solver.solve(contacts, frame_time);
+
+				expect(std::abs(body.vel.y - 2.0_r)).to_be_less_than(0.001_r);
+			});
+		});
+
+		describe("contact cache", []() {
+			before_each([&]() {
+				body_a = {};
+				body_b = {};
+				body_a.calculate_derived_data();
+				body_b.calculate_derived_data();
+			});
+
+			it("copies impulses to contacts that didn't move", [&]() {
+				phys::contact_cache cache(0.05_r);
+				std::vector<phys::contact> contacts{ make_contact(phys::vec3(1.0_r, 0.0_r, 0.0_r)), make_contact(phys::vec3(-1.0_r, 0.0_r, 0.0_r)) };
+
+				cache.begin_frame();
+				cache.warm_start(sphere_a, sphere_b, contacts);
+				contacts[0].normal_impulse = 2.0_r;
+				contacts[0].tangent_impulse = phys::vec3(0.5_r, 0.0_r, 0.0_r);
+				contacts[1].normal_impulse = 3.0_r;
+				cache.store(sphere_a, sphere_b, contacts);
+				cache.end_frame();
+
+				std::vector<phys::contact> next{
+					make_contact(phys::vec3(-1.0_r, 0.0_r, 0.01_r)),
+					make_contact(phys::vec3(0.0_r, 0.0_r, 0.0_r)),
+					make_contact(phys::vec3(1.01_r, 0.0_r, 0.0_r))
+				};
+
+				cache.begin_frame();
+				// The order of the primitives doesn't matter
+				cache.warm_start(sphere_b, sphere_a, next);
+
+				expect(next[0].normal_impulse).to_be(3.0_r);
+				expect(next[1].normal_impulse).to_be(0.0_r);
+				expect(next[2].normal_impulse).to_be(2.0_r);
+				expect(next[2].tangent_impulse).to_be(phys::vec3(0.5_r, 0.0_r, 0.0_r));
+			});
+
+			it("matches contacts in the local space of the first body", [&]() {
+				phys::contact_cache cache(0.05_r);
+				std::vector<phys::contact> contacts{ make_contact(phys::vec3(1.0_r, 0.0_r, 0.0_r)) };
+
+				cache.begin_frame();
+				cache.warm_start(sphere_a, sphere_b, contacts);
+				contacts[0].normal_impulse = 2.0_r;
+				cache.store(sphere_a, sphere_b, contacts);
+				cache.end_frame();
+
+				body_a.pos = phys::vec3(0.0_r, 3.0_r, 0.0_r);
+				body_a.calculate_derived_data();
+
+				std::vector<phys::contact> next{ make_contact(phys::vec3(1.0_r, 3.0_r, 0.0_r)) };
+
+				cache.begin_frame();
+				cache.warm_start(sphere_a, sphere_b, next);
+
+				expect(next[0].normal_impulse).to_be(2.0_r);
+			});
+
+			it("forgets pairs that weren't seen in a frame", [&]() {
+				phys::contact_cache cache{};
+				std::vector<phys::contact> contacts{ make_contact(phys::vec3(0.0_r)) };
+
+				cache.begin_frame();
+				cache.warm_start(sphere_a, sphere_b, contacts);
+				cache.store(sphere_a, sphere_b, contacts);
+				cache.end_frame();
+
+				expect(cache.size()).to_be(1);
+
+				cache.begin_frame();
+				cache.end_frame();
+
+				expect(cache.size()).to_be(0);
+			});
+		});
+
+		// The test runner prints the time taken by each test
+		describe("benchmark (stacks of 10 boxes, 60 frames)", []() {
+			it("10 stacks", []() {
+				scene s(10);
+
+				for (size_t i = 0; i < 10; i++) {
+					add_box_stack(s, phys::vec3((phys::real)i * 2.0_r, 0.0_r, 0.0_r), 10);
+				}
+
+				s.run(60);
+
+				expect(s.world.get_contacts().size()).naht().to_be(0);
+			});
+
+			it("100 stacks", []() {
+				scene s(10);
+
+				for (size_t i = 0; i < 100; i++) {
+					add_box_stack(s, phys::vec3((phys::real)(i % 10) * 2.0_r, 0.0_r, (phys::real)(i / 10) * 2.0_r), 10);
+				}
+
+				s.run(60);
+
+				expect(s.world.get_contacts().size()).naht().to_be(0);
+			});
+
+			it("100 stacks on a thread pool", []() {
+				phys::thread_pool pool{};
+				scene s(10, &pool);
+
+				for (size_t i = 0; i < 100; i++) {
+					add_box_stack(s, phys::vec3((phys::real)(i % 10) * 2.0_r, 0.0_r, (phys::real)(i / 10) * 2.0_r), 10);
+				}
+
+				s.run(60);
+
+				expect(s.world.get_contacts().size()).naht().to_be(0);
+			});
+		});
+
+		describe("benchmark (10 columns of 10 spheres, 240 frames)", []() {
+			it("cold start, 32 iterations", []() {
+				scene s(32);
+
+				s.world.solver.warm_starting = false;
+
+				for (size_t i = 0; i < 10; i++) {
+					add_sphere_column(s, phys::vec3((phys::real)i * 2.0_r, 0.0_r, 0.0_r), 10);
+				}
+
+				s.run(240);
+
+				expect(s.world.get_contacts().size()).naht().to_be(0);
+			});
+
+			it("warm start, 4 iterations", []() {
+				scene s(4);
+
+				for (size_t i = 0; i < 10; i++) {
+					add_sphere_column(s, phys::vec3((phys::real)i * 2.0_r, 0.0_r, 0.0_r), 10);
+				}
+
+				s.run(240);
+
+				expect(s.world.get_contacts().size()).naht().to_be(0);
+			});
+		});
+	});
+}